@@ -68,7 +68,10 @@ struct AttributeInfo
         offset_(0),
         enumNames_(0),
         mode_(AM_DEFAULT),
-        ptr_(0)
+        ptr_(0),
+        quantizeBits_(0),
+        quantizeMin_(0.0f),
+        quantizeMax_(0.0f)
     {
     }
     
@@ -80,7 +83,10 @@ struct AttributeInfo
         enumNames_(0),
         defaultValue_(defaultValue),
         mode_(mode),
-        ptr_(0)
+        ptr_(0),
+        quantizeBits_(0),
+        quantizeMin_(0.0f),
+        quantizeMax_(0.0f)
     {
     }
     
@@ -92,7 +98,10 @@ struct AttributeInfo
         enumNames_(enumNames),
         defaultValue_(defaultValue),
         mode_(mode),
-        ptr_(0)
+        ptr_(0),
+        quantizeBits_(0),
+        quantizeMin_(0.0f),
+        quantizeMax_(0.0f)
     {
     }
     
@@ -105,7 +114,10 @@ struct AttributeInfo
         accessor_(accessor),
         defaultValue_(defaultValue),
         mode_(mode),
-        ptr_(0)
+        ptr_(0),
+        quantizeBits_(0),
+        quantizeMin_(0.0f),
+        quantizeMax_(0.0f)
     {
     }
     
@@ -118,7 +130,10 @@ struct AttributeInfo
         accessor_(accessor),
         defaultValue_(defaultValue),
         mode_(mode),
-        ptr_(0)
+        ptr_(0),
+        quantizeBits_(0),
+        quantizeMin_(0.0f),
+        quantizeMax_(0.0f)
     {
     }
     
@@ -138,6 +153,12 @@ struct AttributeInfo
     unsigned mode_;
     /// Attribute data pointer if elsewhere than in the Serializable.
     void* ptr_;
+    /// Bits per component for quantizing a float, vector or quaternion attribute in network replication. 0 = full precision.
+    unsigned quantizeBits_;
+    /// Quantization range minimum. If the range is empty, values are sent as variable-length multiples of 1 / 2^quantizeBits_.
+    float quantizeMin_;
+    /// Quantization range maximum.
+    float quantizeMax_;
 };
 
 }
@@ -51,6 +51,27 @@ void RemoveNamedAttribute(HashMap<StringHash, Vector<AttributeInfo> >& attribute
         attributes.Erase(i);
 }
 
+void SetNamedAttributeQuantization(HashMap<StringHash, Vector<AttributeInfo> >& attributes, StringHash objectType, const char* name,
+    unsigned bits, float minValue, float maxValue)
+{
+    HashMap<StringHash, Vector<AttributeInfo> >::Iterator i = attributes.Find(objectType);
+    if (i == attributes.End())
+        return;
+
+    Vector<AttributeInfo>& infos = i->second_;
+
+    for (Vector<AttributeInfo>::Iterator j = infos.Begin(); j != infos.End(); ++j)
+    {
+        if (!j->name_.Compare(name, true))
+        {
+            j->quantizeBits_ = bits;
+            j->quantizeMin_ = minValue;
+            j->quantizeMax_ = maxValue;
+            break;
+        }
+    }
+}
+
 Context::Context() :
     eventHandler_(0)
 {
@@ -149,6 +170,12 @@ void Context::UpdateAttributeDefaultValue(StringHash objectType, const char* nam
         info->defaultValue_ = defaultValue;
 }
 
+void Context::SetAttributeQuantization(StringHash objectType, const char* name, unsigned bits, float minValue, float maxValue)
+{
+    SetNamedAttributeQuantization(attributes_, objectType, name, bits, minValue, maxValue);
+    SetNamedAttributeQuantization(networkAttributes_, objectType, name, bits, minValue, maxValue);
+}
+
 VariantMap& Context::GetEventDataMap()
 {
     unsigned nestingLevel = eventSenders_.Size();
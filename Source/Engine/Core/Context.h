@@ -56,6 +56,8 @@ public:
     void RemoveAttribute(StringHash objectType, const char* name);
     /// Update object attribute's default value.
     void UpdateAttributeDefaultValue(StringHash objectType, const char* name, const Variant& defaultValue);
+    /// Set object attribute's quantization for network replication. With an empty range, bits define the precision as 1 / 2^bits.
+    void SetAttributeQuantization(StringHash objectType, const char* name, unsigned bits, float minValue = 0.0f, float maxValue = 0.0f);
     /// Return a preallocated map for event data. Used for optimization to avoid constant re-allocation of event data maps.
     VariantMap& GetEventDataMap();
 
@@ -75,6 +77,8 @@ public:
     template <class T, class U> void CopyBaseAttributes();
     /// Template version of updating an object attribute's default value.
     template <class T> void UpdateAttributeDefaultValue(const char* name, const Variant& defaultValue);
+    /// Template version of setting an object attribute's network quantization.
+    template <class T> void SetAttributeQuantization(const char* name, unsigned bits, float minValue = 0.0f, float maxValue = 0.0f);
 
     /// Return subsystem by type.
     Object* GetSubsystem(StringHash type) const;
@@ -183,5 +187,6 @@ template <class T, class U> void Context::CopyBaseAttributes() { CopyBaseAttribu
 template <class T> T* Context::GetSubsystem() const { return static_cast<T*>(GetSubsystem(T::GetTypeStatic())); }
 template <class T> AttributeInfo* Context::GetAttribute(const char* name) { return GetAttribute(T::GetTypeStatic(), name); }
 template <class T> void Context::UpdateAttributeDefaultValue(const char* name, const Variant& defaultValue) { UpdateAttributeDefaultValue(T::GetTypeStatic(), name, defaultValue); }
+template <class T> void Context::SetAttributeQuantization(const char* name, unsigned bits, float minValue, float maxValue) { SetAttributeQuantization(T::GetTypeStatic(), name, bits, minValue, maxValue); }
 
 }
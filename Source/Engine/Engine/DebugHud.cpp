@@ -21,14 +21,19 @@
 //
 
 #include "Precompiled.h"
+#include "Context.h"
 #include "CoreEvents.h"
 #include "DebugHud.h"
 #include "Engine.h"
 #include "Font.h"
 #include "Graphics.h"
 #include "Log.h"
+#ifdef URHO3D_NETWORK
+#include "Network.h"
+#endif
 #include "Profiler.h"
 #include "Renderer.h"
+#include "Sort.h"
 #include "Text.h"
 #include "UI.h"
 
@@ -52,6 +57,59 @@ static const char* shadowQualityTexts[] =
     "24bit High"
 };
 
+#ifdef URHO3D_NETWORK
+static bool CompareTraffic(const Pair<String, NetworkTraffic>& lhs, const Pair<String, NetworkTraffic>& rhs)
+{
+    return lhs.second_.bytes_ > rhs.second_.bytes_;
+}
+
+static String GetNetworkStats(Context* context, const ConnectionStatistics& statistics)
+{
+    // Before the first interval has completed there are no rates to show
+    float interval = statistics.interval_ > 0.0f ? statistics.interval_ : 1.0f;
+
+    String stats;
+    stats.AppendWithFormat("Network out %s KB/s", ToString("%.2f", statistics.GetTotalBytes() / interval / 1000.0f).CString());
+    if (statistics.numUpdates_)
+    {
+        stats.AppendWithFormat("\nSerialization %s ms/update", ToString("%.3f", statistics.serializationTime_ / 1000.0f /
+            statistics.numUpdates_).CString());
+    }
+
+    Vector<Pair<String, NetworkTraffic> > traffic;
+    for (HashMap<int, NetworkTraffic>::ConstIterator i = statistics.messages_.Begin(); i != statistics.messages_.End(); ++i)
+        traffic.Push(MakePair(GetNetworkMessageName(i->first_), i->second_));
+    Sort(traffic.Begin(), traffic.End(), CompareTraffic);
+
+    if (!traffic.Empty())
+        stats.Append("\n");
+    for (Vector<Pair<String, NetworkTraffic> >::ConstIterator i = traffic.Begin(); i != traffic.End(); ++i)
+    {
+        stats.AppendWithFormat("\n%s %s msg/s %s KB/s", i->first_.CString(), ToString("%.1f", i->second_.count_ / interval).CString(),
+            ToString("%.2f", i->second_.bytes_ / interval / 1000.0f).CString());
+    }
+
+    traffic.Clear();
+    for (HashMap<StringHash, NetworkTraffic>::ConstIterator i = statistics.objects_.Begin(); i != statistics.objects_.End(); ++i)
+    {
+        const String& typeName = context->GetTypeName(i->first_);
+        traffic.Push(MakePair(typeName.Empty() ? i->first_.ToString() : typeName, i->second_));
+    }
+    Sort(traffic.Begin(), traffic.End(), CompareTraffic);
+
+    if (!traffic.Empty())
+        stats.Append("\n");
+    for (Vector<Pair<String, NetworkTraffic> >::ConstIterator i = traffic.Begin(); i != traffic.End(); ++i)
+    {
+        stats.AppendWithFormat("\n%s %s upd/s %s attr/s %s KB/s", i->first_.CString(), ToString("%.1f", i->second_.count_ /
+            interval).CString(), ToString("%.1f", i->second_.attributes_ / interval).CString(), ToString("%.2f",
+            i->second_.bytes_ / interval / 1000.0f).CString());
+    }
+
+    return stats;
+}
+#endif
+
 DebugHud::DebugHud(Context* context) :
     Object(context),
     profilerMaxDepth_(M_MAX_UNSIGNED),
@@ -80,6 +138,12 @@ DebugHud::DebugHud(Context* context) :
     profilerText_->SetVisible(false);
     uiRoot->AddChild(profilerText_);
 
+    networkText_ = new Text(context_);
+    networkText_->SetAlignment(HA_RIGHT, VA_BOTTOM);
+    networkText_->SetPriority(100);
+    networkText_->SetVisible(false);
+    uiRoot->AddChild(networkText_);
+
     SubscribeToEvent(E_POSTUPDATE, HANDLER(DebugHud, HandlePostUpdate));
 }
 
@@ -88,6 +152,7 @@ DebugHud::~DebugHud()
     statsText_->Remove();
     modeText_->Remove();
     profilerText_->Remove();
+    networkText_->Remove();
 }
 
 void DebugHud::Update()
@@ -105,6 +170,7 @@ void DebugHud::Update()
         uiRoot->AddChild(statsText_);
         uiRoot->AddChild(modeText_);
         uiRoot->AddChild(profilerText_);
+        uiRoot->AddChild(networkText_);
     }
 
     if (statsText_->IsVisible())
@@ -177,6 +243,12 @@ void DebugHud::Update()
             profiler->BeginInterval();
         }
     }
+
+    #ifdef URHO3D_NETWORK
+    Network* network = GetSubsystem<Network>();
+    if (network && networkText_->IsVisible())
+        networkText_->SetText(GetNetworkStats(context_, network->GetStatistics()));
+    #endif
 }
 
 void DebugHud::SetDefaultStyle(XMLFile* style)
@@ -190,6 +262,8 @@ void DebugHud::SetDefaultStyle(XMLFile* style)
     modeText_->SetStyle("DebugHudText");
     profilerText_->SetDefaultStyle(style);
     profilerText_->SetStyle("DebugHudText");
+    networkText_->SetDefaultStyle(style);
+    networkText_->SetStyle("DebugHudText");
 }
 
 void DebugHud::SetMode(unsigned mode)
@@ -197,6 +271,14 @@ void DebugHud::SetMode(unsigned mode)
     statsText_->SetVisible((mode & DEBUGHUD_SHOW_STATS) != 0);
     modeText_->SetVisible((mode & DEBUGHUD_SHOW_MODE) != 0);
     profilerText_->SetVisible((mode & DEBUGHUD_SHOW_PROFILER) != 0);
+    networkText_->SetVisible((mode & DEBUGHUD_SHOW_NETWORK) != 0);
+
+    #ifdef URHO3D_NETWORK
+    // Network traffic is only accounted on request, so start tracking when it is first shown
+    Network* network = GetSubsystem<Network>();
+    if (network && (mode & DEBUGHUD_SHOW_NETWORK))
+        network->SetTrackStatistics(true);
+    #endif
 
     mode_ = mode;
 }
@@ -37,9 +37,10 @@ static const unsigned DEBUGHUD_SHOW_NONE = 0x0;
 static const unsigned DEBUGHUD_SHOW_STATS = 0x1;
 static const unsigned DEBUGHUD_SHOW_MODE = 0x2;
 static const unsigned DEBUGHUD_SHOW_PROFILER = 0x4;
+static const unsigned DEBUGHUD_SHOW_NETWORK = 0x8;
 static const unsigned DEBUGHUD_SHOW_ALL = 0x7;
 
-/// Displays rendering stats and profiling information.
+/// Displays rendering stats, profiling information and network traffic.
 class URHO3D_API DebugHud : public Object
 {
     OBJECT(DebugHud);
@@ -75,6 +76,8 @@ public:
     Text* GetModeText() const { return modeText_; }
     /// Return profiler text.
     Text* GetProfilerText() const { return profilerText_; }
+    /// Return network traffic text.
+    Text* GetNetworkText() const { return networkText_; }
     /// Return currently shown elements.
     unsigned GetMode() const { return mode_; }
     /// Return maximum profiler block depth.
@@ -103,6 +106,8 @@ private:
     SharedPtr<Text> modeText_;
     /// Profiling information text.
     SharedPtr<Text> profilerText_;
+    /// Network traffic text.
+    SharedPtr<Text> networkText_;
     /// Hashmap containing application specific stats.
     HashMap<String, String> appStats_;
     /// Profiler timer.
@@ -191,14 +191,18 @@ bool Engine::Initialize(const VariantMap& parameters)
         LOGINFOF("Created %u worker thread%s", numThreads, numThreads > 1 ? "s" : "");
     }
 
-    // Add resource paths
+    // Use a small fixed amount of background loader threads, as they compete for the CPU with the main and worker threads
     ResourceCache* cache = GetSubsystem<ResourceCache>();
+    cache->SetNumBackgroundLoadThreads(GetParameter(parameters, "BackgroundLoadThreads", 2).GetInt());
+
+    // Add resource paths
     FileSystem* fileSystem = GetSubsystem<FileSystem>();
     String exePath = fileSystem->GetProgramDir();
 
     Vector<String> resourcePaths = GetParameter(parameters, "ResourcePaths", "Data;CoreData").GetString().Split(';');
     Vector<String> resourcePackages = GetParameter(parameters, "ResourcePackages").GetString().Split(';');
     Vector<String> autoloadFolders = GetParameter(parameters, "AutoloadPaths", "Extra").GetString().Split(';');
+    bool memoryMapPackages = GetParameter(parameters, "MemoryMapPackages", false).GetBool();
 
     for (unsigned i = 0; i < resourcePaths.Size(); ++i)
     {
@@ -213,6 +217,8 @@ bool Engine::Initialize(const VariantMap& parameters)
                 SharedPtr<PackageFile> package(new PackageFile(context_));
                 if (package->Open(packageName))
                 {
+                    if (memoryMapPackages)
+                        package->SetMemoryMapped(true);
                     cache->AddPackageFile(package);
                     success = true;
                 }
@@ -250,6 +256,8 @@ bool Engine::Initialize(const VariantMap& parameters)
             SharedPtr<PackageFile> package(new PackageFile(context_));
             if (package->Open(packageName))
             {
+                if (memoryMapPackages)
+                    package->SetMemoryMapped(true);
                 cache->AddPackageFile(package);
                 success = true;
             }
@@ -300,7 +308,11 @@ bool Engine::Initialize(const VariantMap& parameters)
                     String autoResourcePak = exePath + autoloadFolder + "/" + pak;
                     SharedPtr<PackageFile> package(new PackageFile(context_));
                     if (package->Open(autoResourcePak))
+                    {
+                        if (memoryMapPackages)
+                            package->SetMemoryMapped(true);
                         cache->AddPackageFile(package, 0);
+                    }
                     else
                     {
                         badResource = autoResourcePak;
@@ -359,6 +371,7 @@ bool Engine::Initialize(const VariantMap& parameters)
             renderer->SetShadowQuality(SHADOWQUALITY_LOW_16BIT);
         renderer->SetMaterialQuality(GetParameter(parameters, "MaterialQuality", QUALITY_HIGH).GetInt());
         renderer->SetTextureQuality(GetParameter(parameters, "TextureQuality", QUALITY_HIGH).GetInt());
+        renderer->SetTextureStreaming(GetParameter(parameters, "TextureStreaming", false).GetBool());
         renderer->SetTextureFilterMode((TextureFilterMode)GetParameter(parameters, "TextureFilterMode", FILTER_TRILINEAR).GetInt());
         renderer->SetTextureAnisotropy(GetParameter(parameters, "TextureAnisotropy", 4).GetInt());
         
@@ -565,7 +578,9 @@ void Engine::DumpResources(bool dumpFileName)
             if (num)
             {
                 LOGRAW("Resource type " + resources.Begin()->second_->GetTypeName() +
-                    ": count " + String(num) + " memory use " + String(memoryUse) + "\n");
+                    ": count " + String(num) + " memory use " + String(memoryUse) + " hits " + String(i->second_.hits_) +
+                    " misses " + String(i->second_.misses_) + " evictions " + String(i->second_.evictions_) + " reloads " +
+                    String(i->second_.reloads_) + "\n");
             }
         }
     }
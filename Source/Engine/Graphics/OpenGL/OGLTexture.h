@@ -77,6 +77,10 @@ public:
     int GetWidth() const { return width_; }
     /// Return height.
     int GetHeight() const { return height_; }
+    /// Return width before texture streaming reduced the size. Use for pixel coordinates within the texture.
+    virtual int GetFullWidth() const { return width_; }
+    /// Return height before texture streaming reduced the size. Use for pixel coordinates within the texture.
+    virtual int GetFullHeight() const { return height_; }
     /// Return height.
     int GetDepth() const { return depth_; }
     /// Return whether parameters are dirty.
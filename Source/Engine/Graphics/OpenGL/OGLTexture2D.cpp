@@ -32,6 +32,8 @@
 #include "Renderer.h"
 #include "ResourceCache.h"
 #include "Texture2D.h"
+#include "TextureStreamer.h"
+#include "WorkQueue.h"
 #include "XMLFile.h"
 
 #include "DebugNew.h"
@@ -40,7 +42,12 @@ namespace Urho3D
 {
 
 Texture2D::Texture2D(Context* context) :
-    Texture(context)
+    Texture(context),
+    streaming_(true),
+    streamingMipsToSkip_(0),
+    streamingRequest_(0.0f),
+    fullWidth_(0),
+    fullHeight_(0)
 {
     target_ = GL_TEXTURE_2D;
 }
@@ -99,6 +106,12 @@ bool Texture2D::EndLoad()
     CheckTextureBudget(GetTypeStatic());
 
     SetParameters(loadParameters_);
+    
+    // When streaming textures, start from the low resolution mip levels
+    Renderer* renderer = GetSubsystem<Renderer>();
+    TextureStreamer* streamer = renderer ? renderer->GetTextureStreamer() : 0;
+    streamingMipsToSkip_ = (streamer && requestedLevels_ != 1) ? streamer->PrepareTexture(this, loadImage_) : 0;
+    
     bool success = SetData(loadImage_);
     
     loadImage_.Reset();
@@ -164,6 +177,25 @@ void Texture2D::Release()
     }
 }
 
+void Texture2D::SetStreaming(bool enable)
+{
+    if (enable == streaming_)
+        return;
+    
+    streaming_ = enable;
+    if (!enable)
+    {
+        Renderer* renderer = GetSubsystem<Renderer>();
+        TextureStreamer* streamer = renderer ? renderer->GetTextureStreamer() : 0;
+        if (streamer)
+            streamer->RemoveTexture(this);
+        
+        // Restore the full size right away
+        if (streamingMipsToSkip_)
+            GetSubsystem<ResourceCache>()->ReloadResource(this);
+    }
+}
+
 bool Texture2D::SetSize(int width, int height, unsigned format, TextureUsage usage)
 {
     // Delete the old rendersurface if any
@@ -284,8 +316,12 @@ bool Texture2D::SetData(SharedPtr<Image> image, bool useAlpha)
         unsigned components = image->GetComponents();
         unsigned format = 0;
         
+        // Remember the size without the mip levels skipped by texture streaming, for pixel coordinates
+        fullWidth_ = Max(levelWidth >> mipsToSkip_[quality], 1);
+        fullHeight_ = Max(levelHeight >> mipsToSkip_[quality], 1);
+        
         // Discard unnecessary mip levels
-        for (unsigned i = 0; i < mipsToSkip_[quality]; ++i)
+        for (unsigned i = 0; i < mipsToSkip_[quality] + streamingMipsToSkip_; ++i)
         {
             image = image->GetNextLevel();
             levelData = image->GetData();
@@ -347,11 +383,15 @@ bool Texture2D::SetData(SharedPtr<Image> image, bool useAlpha)
             needDecompress = true;
         }
         
-        unsigned mipsToSkip = mipsToSkip_[quality];
+        unsigned mipsToSkip = mipsToSkip_[quality] + streamingMipsToSkip_;
         if (mipsToSkip >= levels)
             mipsToSkip = levels - 1;
         while (mipsToSkip && (width / (1 << mipsToSkip) < 4 || height / (1 << mipsToSkip) < 4))
             --mipsToSkip;
+        // Remember the size without the mip levels skipped by texture streaming, for pixel coordinates
+        unsigned fullMipsToSkip = mipsToSkip_[quality] < mipsToSkip ? mipsToSkip_[quality] : mipsToSkip;
+        fullWidth_ = width / (1 << fullMipsToSkip);
+        fullHeight_ = height / (1 << fullMipsToSkip);
         width /= (1 << mipsToSkip);
         height /= (1 << mipsToSkip);
         
@@ -369,7 +409,7 @@ bool Texture2D::SetData(SharedPtr<Image> image, bool useAlpha)
             else
             {
                 unsigned char* rgbaData = new unsigned char[level.width_ * level.height_ * 4];
-                level.Decompress(rgbaData);
+                level.Decompress(rgbaData, GetSubsystem<WorkQueue>());
                 SetData(i, 0, 0, level.width_, level.height_, rgbaData);
                 memoryUse += level.width_ * level.height_ * 4;
                 delete[] rgbaData;
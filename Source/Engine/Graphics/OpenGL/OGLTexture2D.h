@@ -62,11 +62,29 @@ public:
     bool SetData(unsigned level, int x, int y, int width, int height, const void* data);
     /// Set data from an image. Return true if successful. Optionally make a single channel image alpha-only.
     bool SetData(SharedPtr<Image> image, bool useAlpha = false);
+    /// Set whether texture streaming may load the texture at reduced size. Disabled automatically for textures used by the %UI. Disabling reloads a reduced texture at full size.
+    void SetStreaming(bool enable);
+    /// Set number of mip levels to skip in addition to the texture quality when setting data from an image. Used by texture streaming.
+    void SetStreamingMipsToSkip(unsigned mips) { streamingMipsToSkip_ = mips; }
+    /// Record a screen size in pixels the texture is drawn at. Used by texture streaming.
+    void AddStreamingRequest(float size) { if (size > streamingRequest_) streamingRequest_ = size; }
+    /// Clear the recorded screen size.
+    void ClearStreamingRequest() { streamingRequest_ = 0.0f; }
     
     /// Get data from a mip level. The destination buffer must be big enough. Return true if successful.
     bool GetData(unsigned level, void* dest) const;
     /// Return render surface.
     RenderSurface* GetRenderSurface() const { return renderSurface_; }
+    /// Return whether texture streaming may load the texture at reduced size.
+    bool GetStreaming() const { return streaming_; }
+    /// Return number of mip levels skipped by texture streaming.
+    unsigned GetStreamingMipsToSkip() const { return streamingMipsToSkip_; }
+    /// Return width before texture streaming reduced the size. Use for pixel coordinates within the texture.
+    virtual int GetFullWidth() const { return streamingMipsToSkip_ ? fullWidth_ : width_; }
+    /// Return height before texture streaming reduced the size. Use for pixel coordinates within the texture.
+    virtual int GetFullHeight() const { return streamingMipsToSkip_ ? fullHeight_ : height_; }
+    /// Return the largest recorded screen size in pixels.
+    float GetStreamingRequest() const { return streamingRequest_; }
     
 protected:
     /// Create texture.
@@ -82,6 +100,16 @@ private:
     SharedPtr<Image> loadImage_;
     /// Parameter file acquired during BeginLoad.
     SharedPtr<XMLFile> loadParameters_;
+    /// Texture streaming enabled flag.
+    bool streaming_;
+    /// Mip levels skipped by texture streaming.
+    unsigned streamingMipsToSkip_;
+    /// Largest recorded screen size in pixels for texture streaming.
+    float streamingRequest_;
+    /// Width before texture streaming reduced the size.
+    int fullWidth_;
+    /// Height before texture streaming reduced the size.
+    int fullHeight_;
 };
 
 }
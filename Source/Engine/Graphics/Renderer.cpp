@@ -42,6 +42,7 @@
 #include "Technique.h"
 #include "Texture2D.h"
 #include "TextureCube.h"
+#include "TextureStreamer.h"
 #include "VertexBuffer.h"
 #include "View.h"
 #include "XMLFile.h"
@@ -256,6 +257,7 @@ Renderer::Renderer(Context* context) :
     textureAnisotropy_(4),
     textureFilterMode_(FILTER_TRILINEAR),
     textureQuality_(QUALITY_HIGH),
+    textureStreamingBudget_(0),
     materialQuality_(QUALITY_HIGH),
     shadowMapSize_(1024),
     shadowQuality_(SHADOWQUALITY_HIGH_16BIT),
@@ -348,6 +350,29 @@ void Renderer::SetTextureQuality(int quality)
     }
 }
 
+void Renderer::SetTextureStreaming(bool enable)
+{
+    if (enable != textureStreamer_.NotNull())
+    {
+        if (enable)
+        {
+            textureStreamer_ = new TextureStreamer(context_);
+            textureStreamer_->SetBudget(textureStreamingBudget_);
+        }
+        else
+            textureStreamer_.Reset();
+        
+        ReloadTextures();
+    }
+}
+
+void Renderer::SetTextureStreamingBudget(unsigned bytes)
+{
+    textureStreamingBudget_ = bytes;
+    if (textureStreamer_)
+        textureStreamer_->SetBudget(bytes);
+}
+
 void Renderer::SetMaterialQuality(int quality)
 {
     quality = Clamp(quality, QUALITY_LOW, QUALITY_MAX);
@@ -658,6 +683,10 @@ void Renderer::Update(float timeStep)
     
     queuedViewports_.Clear();
     resetViews_ = false;
+    
+    // Stream texture mip levels according to the screen sizes recorded by the views
+    if (textureStreamer_)
+        textureStreamer_->Update();
 }
 
 void Renderer::Render()
@@ -47,6 +47,7 @@ class Skeleton;
 class OcclusionBuffer;
 class Texture2D;
 class TextureCube;
+class TextureStreamer;
 class View;
 class Zone;
 
@@ -175,6 +176,10 @@ public:
     void SetTextureFilterMode(TextureFilterMode mode);
     /// Set texture quality level.
     void SetTextureQuality(int quality);
+    /// Set texture streaming on/off. When on, 2D textures are loaded at low resolution first and higher mip levels are streamed in according to their screen size. Reloads the textures.
+    void SetTextureStreaming(bool enable);
+    /// Set memory budget in bytes for streamed textures. Zero is unlimited.
+    void SetTextureStreamingBudget(unsigned bytes);
     /// Set material quality level.
     void SetMaterialQuality(int quality);
     /// Set shadows on/off.
@@ -226,6 +231,12 @@ public:
     TextureFilterMode GetTextureFilterMode() const { return textureFilterMode_; }
     /// Return texture quality level.
     int GetTextureQuality() const { return textureQuality_; }
+    /// Return whether texture streaming is enabled.
+    bool GetTextureStreaming() const { return textureStreamer_.NotNull(); }
+    /// Return memory budget for streamed textures.
+    unsigned GetTextureStreamingBudget() const { return textureStreamingBudget_; }
+    /// Return the texture streamer, or null if texture streaming is disabled.
+    TextureStreamer* GetTextureStreamer() const { return textureStreamer_; }
     /// Return material quality level.
     int GetMaterialQuality() const { return materialQuality_; }
     /// Return shadow map resolution.
@@ -389,6 +400,8 @@ private:
     SharedPtr<TextureCube> faceSelectCubeMap_;
     /// Indirection cube map for shadowed pointlights.
     SharedPtr<TextureCube> indirectionCubeMap_;
+    /// Texture streamer.
+    SharedPtr<TextureStreamer> textureStreamer_;
     /// Reusable scene nodes with shadow camera components.
     Vector<SharedPtr<Node> > shadowCameraNodes_;
     /// Reusable occlusion buffers.
@@ -429,6 +442,8 @@ private:
     TextureFilterMode textureFilterMode_;
     /// Texture quality level.
     int textureQuality_;
+    /// Memory budget for streamed textures.
+    unsigned textureStreamingBudget_;
     /// Material quality level.
     int materialQuality_;
     /// Shadow map resolution.
@@ -0,0 +1,305 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Camera.h"
+#include "Context.h"
+#include "Drawable.h"
+#include "File.h"
+#include "Image.h"
+#include "Material.h"
+#include "Profiler.h"
+#include "Renderer.h"
+#include "ResourceCache.h"
+#include "Sort.h"
+#include "Texture2D.h"
+#include "TextureStreamer.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned STREAMING_UPDATE_INTERVAL = 100;
+static const unsigned STREAMING_RELEASE_TIME = 5000;
+static const unsigned MAX_STREAMING_LOADS = 2;
+
+static void LoadStreamedImageWork(const WorkItem* item, unsigned threadIndex)
+{
+    const TextureStreamItem* streamItem = static_cast<const TextureStreamItem*>(item);
+    ResourceCache* cache = streamItem->context_->GetSubsystem<ResourceCache>();
+    SharedPtr<File> file = cache->GetFile(streamItem->name_, false);
+    if (!file)
+        return;
+    
+    SharedPtr<Image> image(new Image(streamItem->context_));
+    if (!image->Load(*file))
+        return;
+    
+    // Calculate the mip levels of uncompressed images here instead of the main thread
+    if (!image->IsCompressed())
+        image->PrecalculateLevels();
+    
+    streamItem->image_ = image;
+}
+
+TextureStreamer::TextureStreamer(Context* context) :
+    Object(context),
+    lastUpdateTime_(0),
+    budget_(0),
+    initialSize_(64),
+    numLoads_(0)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::SetBudget(unsigned bytes)
+{
+    budget_ = bytes;
+}
+
+void TextureStreamer::SetInitialSize(int size)
+{
+    initialSize_ = Max(size, 1);
+}
+
+unsigned TextureStreamer::PrepareTexture(Texture2D* texture, Image* image)
+{
+    // Start over if the texture is being reloaded
+    RemoveTexture(texture);
+    
+    // Textures with streaming disabled, such as UI textures, are loaded at full size
+    if (!texture || !image || !texture->GetStreaming() || (image->IsCompressed() && image->GetNumCompressedLevels() < 2))
+        return 0;
+    
+    Renderer* renderer = GetSubsystem<Renderer>();
+    int quality = renderer ? renderer->GetTextureQuality() : QUALITY_HIGH;
+    
+    StreamedTexture entry;
+    entry.texture_ = texture;
+    entry.fullSize_ = Max(Max(image->GetWidth(), image->GetHeight()) >> texture->GetMipsToSkip(quality), 1);
+    entry.lastRequestTime_ = timer_.GetMSec(false);
+    
+    // Textures that are small already are loaded as they are
+    unsigned mipsToSkip = GetMipsToSkip(entry, initialSize_);
+    if (!mipsToSkip)
+        return 0;
+    
+    textures_[texture] = entry;
+    return mipsToSkip;
+}
+
+void TextureStreamer::RemoveTexture(Texture2D* texture)
+{
+    HashMap<Texture2D*, StreamedTexture>::Iterator i = textures_.Find(texture);
+    if (i != textures_.End())
+    {
+        if (i->second_.load_)
+            --numLoads_;
+        textures_.Erase(i);
+    }
+}
+
+void TextureStreamer::RequestTextures(Material* material, float screenSize)
+{
+    const SharedPtr<Texture>* textures = material->GetTextures();
+    
+    for (unsigned i = 0; i < MAX_MATERIAL_TEXTURE_UNITS; ++i)
+    {
+        Texture* texture = textures[i];
+        if (texture && texture->GetType() == Texture2D::GetTypeStatic())
+            static_cast<Texture2D*>(texture)->AddStreamingRequest(screenSize);
+    }
+}
+
+void TextureStreamer::Update()
+{
+    PROFILE(UpdateTextureStreaming);
+    
+    // Apply the finished loads
+    if (numLoads_)
+    {
+        for (HashMap<Texture2D*, StreamedTexture>::Iterator i = textures_.Begin(); i != textures_.End(); ++i)
+        {
+            StreamedTexture& entry = i->second_;
+            if (!entry.load_ || !entry.load_->completed_)
+                continue;
+            
+            SharedPtr<TextureStreamItem> load = entry.load_;
+            entry.load_.Reset();
+            --numLoads_;
+            
+            Texture2D* texture = entry.texture_;
+            if (texture && load->image_)
+            {
+                texture->SetStreamingMipsToSkip(load->mipsToSkip_);
+                texture->SetData(load->image_);
+            }
+        }
+    }
+    
+    unsigned time = timer_.GetMSec(false);
+    if (time - lastUpdateTime_ < STREAMING_UPDATE_INTERVAL)
+        return;
+    lastUpdateTime_ = time;
+    
+    // Collect the textures shown larger than their top mip level, and the memory use. Forget destroyed textures
+    PODVector<Pair<float, Texture2D*> > upgrades;
+    unsigned memoryUse = 0;
+    for (HashMap<Texture2D*, StreamedTexture>::Iterator i = textures_.Begin(); i != textures_.End();)
+    {
+        StreamedTexture& entry = i->second_;
+        Texture2D* texture = entry.texture_;
+        if (!texture)
+        {
+            if (entry.load_)
+                --numLoads_;
+            i = textures_.Erase(i);
+            continue;
+        }
+        
+        memoryUse += texture->GetMemoryUse();
+        float request = texture->GetStreamingRequest();
+        texture->ClearStreamingRequest();
+        
+        if (request > 0.0f)
+        {
+            entry.lastRequestTime_ = time;
+            int currentSize = Max(texture->GetWidth(), texture->GetHeight());
+            if (!entry.load_ && GetMipsToSkip(entry, (int)request) < GetMipsToSkip(entry, currentSize))
+                upgrades.Push(MakePair(request / (float)currentSize, texture));
+        }
+        
+        ++i;
+    }
+    
+    // Load the textures that are most short of resolution first
+    Sort(upgrades.Begin(), upgrades.End());
+    for (unsigned i = upgrades.Size() - 1; i < upgrades.Size() && numLoads_ < MAX_STREAMING_LOADS; --i)
+    {
+        Texture2D* texture = upgrades[i].second_;
+        StreamedTexture& entry = textures_[texture];
+        int currentSize = Max(texture->GetWidth(), texture->GetHeight());
+        unsigned currentMipsToSkip = GetMipsToSkip(entry, currentSize);
+        unsigned mipsToSkip = GetMipsToSkip(entry, (int)(upgrades[i].first_ * (float)currentSize));
+        
+        // Each mip level more quadruples the memory use
+        unsigned increase = (texture->GetMemoryUse() << (2 * (currentMipsToSkip - mipsToSkip))) - texture->GetMemoryUse();
+        if (budget_ && memoryUse + increase > budget_)
+        {
+            memoryUse -= ReleaseTextures(memoryUse + increase - budget_, time);
+            if (memoryUse + increase > budget_)
+                break;
+        }
+        
+        StartLoad(entry, mipsToSkip);
+        memoryUse += increase;
+    }
+}
+
+unsigned TextureStreamer::GetMemoryUse() const
+{
+    unsigned memoryUse = 0;
+    
+    for (HashMap<Texture2D*, StreamedTexture>::ConstIterator i = textures_.Begin(); i != textures_.End(); ++i)
+    {
+        if (i->second_.texture_)
+            memoryUse += i->second_.texture_->GetMemoryUse();
+    }
+    
+    return memoryUse;
+}
+
+float TextureStreamer::GetScreenSize(Drawable* drawable, Camera* camera, int viewHeight)
+{
+    // Use the bounding box diagonal, as the textures may be mapped along any axis
+    float size = drawable->GetWorldBoundingBox().Size().Length();
+    float viewExtent = 2.0f * camera->GetHalfViewSize();
+    if (!camera->IsOrthographic())
+        viewExtent *= Max(drawable->GetDistance(), camera->GetNearClip());
+    
+    return size / viewExtent * (float)viewHeight;
+}
+
+void TextureStreamer::StartLoad(StreamedTexture& entry, unsigned mipsToSkip)
+{
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    
+    SharedPtr<TextureStreamItem> item(new TextureStreamItem());
+    item->workFunction_ = LoadStreamedImageWork;
+    item->context_ = context_;
+    item->name_ = entry.texture_->GetName();
+    item->mipsToSkip_ = mipsToSkip;
+    queue->AddWorkItem(SharedPtr<WorkItem>(item.Get()));
+    
+    entry.load_ = item;
+    ++numLoads_;
+}
+
+unsigned TextureStreamer::ReleaseTextures(unsigned bytes, unsigned time)
+{
+    // Find streamed in textures which have not been requested recently, oldest first
+    PODVector<Pair<unsigned, Texture2D*> > candidates;
+    for (HashMap<Texture2D*, StreamedTexture>::Iterator i = textures_.Begin(); i != textures_.End(); ++i)
+    {
+        StreamedTexture& entry = i->second_;
+        Texture2D* texture = entry.texture_;
+        if (texture && !entry.load_ && time - entry.lastRequestTime_ >= STREAMING_RELEASE_TIME &&
+            Max(texture->GetWidth(), texture->GetHeight()) > initialSize_)
+            candidates.Push(MakePair(entry.lastRequestTime_, texture));
+    }
+    
+    Sort(candidates.Begin(), candidates.End());
+    
+    unsigned released = 0;
+    for (unsigned i = 0; i < candidates.Size() && released < bytes; ++i)
+    {
+        Texture2D* texture = candidates[i].second_;
+        StreamedTexture& entry = textures_[texture];
+        unsigned currentMipsToSkip = GetMipsToSkip(entry, Max(texture->GetWidth(), texture->GetHeight()));
+        unsigned mipsToSkip = GetMipsToSkip(entry, initialSize_);
+        if (mipsToSkip <= currentMipsToSkip)
+            continue;
+        
+        released += texture->GetMemoryUse() - (texture->GetMemoryUse() >> (2 * (mipsToSkip - currentMipsToSkip)));
+        StartLoad(entry, mipsToSkip);
+    }
+    
+    return released;
+}
+
+unsigned TextureStreamer::GetMipsToSkip(const StreamedTexture& entry, int size) const
+{
+    size = Max(size, 1);
+    
+    unsigned mipsToSkip = 0;
+    while ((entry.fullSize_ >> (mipsToSkip + 1)) >= size)
+        ++mipsToSkip;
+    
+    return mipsToSkip;
+}
+
+}
@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Object.h"
+#include "Timer.h"
+#include "WorkQueue.h"
+
+namespace Urho3D
+{
+
+class Camera;
+class Drawable;
+class Image;
+class Material;
+class Texture2D;
+
+/// Work item loading the image of a streamed texture in the background.
+struct TextureStreamItem : public WorkItem
+{
+    /// Execution context.
+    Context* context_;
+    /// Texture resource name.
+    String name_;
+    /// Mip levels to skip when setting the texture data.
+    unsigned mipsToSkip_;
+    /// Loaded image. Written by the worker thread.
+    mutable SharedPtr<Image> image_;
+};
+
+/// Streaming state of a texture.
+struct StreamedTexture
+{
+    /// Construct.
+    StreamedTexture() :
+        fullSize_(0),
+        lastRequestTime_(0)
+    {
+    }
+    
+    /// Texture.
+    WeakPtr<Texture2D> texture_;
+    /// Largest dimension of the top mip level when fully loaded.
+    int fullSize_;
+    /// Time of the last request for the texture in milliseconds.
+    unsigned lastRequestTime_;
+    /// Mip level load in progress.
+    SharedPtr<TextureStreamItem> load_;
+};
+
+/// %Texture streaming subsystem. Loads 2D textures at low resolution first, and streams in higher mip levels in the background according to their screen size.
+class URHO3D_API TextureStreamer : public Object
+{
+    OBJECT(TextureStreamer);
+    
+public:
+    /// Construct.
+    TextureStreamer(Context* context);
+    /// Destruct.
+    virtual ~TextureStreamer();
+    
+    /// Set memory budget in bytes for the streamed textures. Zero is unlimited.
+    void SetBudget(unsigned bytes);
+    /// Set the largest dimension of the top mip level textures are first loaded at.
+    void SetInitialSize(int size);
+    /// Register a texture which is being loaded from an image and return the mip levels to skip initially. Return 0 if the texture is not streamed. Called by Texture2D.
+    unsigned PrepareTexture(Texture2D* texture, Image* image);
+    /// Stop streaming a texture. Called by Texture2D when streaming is disabled for it.
+    void RemoveTexture(Texture2D* texture);
+    /// Record the screen size in pixels of a material's 2D textures. Called during view batch building.
+    void RequestTextures(Material* material, float screenSize);
+    /// Apply finished mip level loads, and start new loads according to the requests. Called by the Renderer after updating the views.
+    void Update();
+    
+    /// Return memory budget in bytes.
+    unsigned GetBudget() const { return budget_; }
+    /// Return the largest dimension of the top mip level textures are first loaded at.
+    int GetInitialSize() const { return initialSize_; }
+    /// Return number of streamed textures.
+    unsigned GetNumTextures() const { return textures_.Size(); }
+    /// Return number of mip level loads in progress.
+    unsigned GetNumLoads() const { return numLoads_; }
+    /// Return memory use of the streamed textures.
+    unsigned GetMemoryUse() const;
+    
+    /// Return the screen size in pixels of a drawable, as seen from a camera.
+    static float GetScreenSize(Drawable* drawable, Camera* camera, int viewHeight);
+    
+private:
+    /// Start loading a texture again with the given mip levels skipped.
+    void StartLoad(StreamedTexture& entry, unsigned mipsToSkip);
+    /// Start loading textures that have not been requested recently at the initial size, until enough memory would be released. Return the estimated memory released.
+    unsigned ReleaseTextures(unsigned bytes, unsigned time);
+    /// Return the mip levels to skip for the smallest top mip level that is at least the given size.
+    unsigned GetMipsToSkip(const StreamedTexture& entry, int size) const;
+    
+    /// Streamed textures.
+    HashMap<Texture2D*, StreamedTexture> textures_;
+    /// Timer for request times.
+    Timer timer_;
+    /// Time of the last request evaluation in milliseconds.
+    unsigned lastUpdateTime_;
+    /// Memory budget in bytes.
+    unsigned budget_;
+    /// Largest dimension of the top mip level textures are first loaded at.
+    int initialSize_;
+    /// Number of mip level loads in progress.
+    unsigned numLoads_;
+};
+
+}
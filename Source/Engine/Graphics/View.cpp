@@ -42,6 +42,7 @@
 #include "Texture2D.h"
 #include "Texture3D.h"
 #include "TextureCube.h"
+#include "TextureStreamer.h"
 #include "VertexBuffer.h"
 #include "View.h"
 #include "WorkQueue.h"
@@ -1079,11 +1080,14 @@ void View::GetBatches()
     {
         PROFILE(GetBaseBatches);
         
+        TextureStreamer* streamer = renderer_->GetTextureStreamer();
+        
         for (PODVector<Drawable*>::ConstIterator i = geometries_.Begin(); i != geometries_.End(); ++i)
         {
             Drawable* drawable = *i;
             Zone* zone = GetZone(drawable);
             const Vector<SourceBatch>& batches = drawable->GetBatches();
+            float screenSize = streamer ? TextureStreamer::GetScreenSize(drawable, camera_, viewSize_.y_) : 0.0f;
             
             const PODVector<Light*>& drawableVertexLights = drawable->GetVertexLights();
             if (!drawableVertexLights.Empty())
@@ -1102,6 +1106,10 @@ void View::GetBatches()
                 if (!srcBatch.geometry_ || !srcBatch.numWorldTransforms_ || !tech)
                     continue;
                 
+                // Record how large the material's textures are shown, for streaming in their mip levels
+                if (streamer && srcBatch.material_)
+                    streamer->RequestTextures(srcBatch.material_, screenSize);
+                
                 Batch destBatch(srcBatch);
                 destBatch.camera_ = camera_;
                 destBatch.zone_ = zone;
@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "BitDeserializer.h"
+#include "Deserializer.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const float QUATERNION_COMPONENT_RANGE = 0.70710678f;
+
+BitDeserializer::BitDeserializer(Deserializer& source) :
+    source_(source),
+    current_(0),
+    numBits_(0),
+    numBitsRead_(0)
+{
+}
+
+unsigned BitDeserializer::ReadBits(unsigned numBits)
+{
+    numBits = Min((int)numBits, 32);
+    numBitsRead_ += numBits;
+
+    unsigned ret = 0;
+    unsigned shift = 0;
+
+    while (numBits)
+    {
+        if (!numBits_)
+        {
+            current_ = source_.ReadUByte();
+            numBits_ = 8;
+        }
+
+        unsigned count = Min((int)numBits_, (int)numBits);
+        ret |= (current_ & ((1 << count) - 1)) << shift;
+        current_ >>= count;
+        numBits_ -= count;
+        numBits -= count;
+        shift += count;
+    }
+
+    return ret;
+}
+
+bool BitDeserializer::ReadBool()
+{
+    return ReadBits(1) != 0;
+}
+
+float BitDeserializer::ReadQuantizedFloat(float minValue, float maxValue, unsigned numBits)
+{
+    numBits = Clamp((int)numBits, 1, 24);
+    unsigned maxStep = (1 << numBits) - 1;
+
+    return minValue + (maxValue - minValue) * (float)ReadBits(numBits) / (float)maxStep;
+}
+
+float BitDeserializer::ReadFixedFloat(unsigned precisionBits)
+{
+    unsigned zigzag = ReadBits(ReadBits(5));
+    int intValue = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+
+    return (float)intValue / (float)(1 << Min((int)precisionBits, 24));
+}
+
+Quaternion BitDeserializer::ReadQuantizedQuaternion(unsigned numBits)
+{
+    unsigned largest = ReadBits(2);
+    float components[4];
+    float sumSquares = 0.0f;
+
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i != largest)
+        {
+            components[i] = ReadQuantizedFloat(-QUATERNION_COMPONENT_RANGE, QUATERNION_COMPONENT_RANGE, numBits);
+            sumSquares += components[i] * components[i];
+        }
+    }
+    components[largest] = sqrtf(Max(1.0f - sumSquares, 0.0f));
+
+    return Quaternion(components).Normalized();
+}
+
+void BitDeserializer::Align()
+{
+    numBitsRead_ += numBits_;
+    current_ = 0;
+    numBits_ = 0;
+}
+
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Quaternion.h"
+
+namespace Urho3D
+{
+
+class Deserializer;
+
+/// Bit-level reader for data written by BitSerializer.
+class URHO3D_API BitDeserializer
+{
+public:
+    /// Construct with source deserializer.
+    BitDeserializer(Deserializer& source);
+
+    /// Read up to 32 bits as an unsigned value.
+    unsigned ReadBits(unsigned numBits);
+    /// Read a one-bit bool.
+    bool ReadBool();
+    /// Read a float quantized to the specified range with the specified number of bits (max 24.)
+    float ReadQuantizedFloat(float minValue, float maxValue, unsigned numBits);
+    /// Read a float written as a variable-length multiple of 1 / 2^precisionBits.
+    float ReadFixedFloat(unsigned precisionBits);
+    /// Read a quaternion written with the specified number of bits per component.
+    Quaternion ReadQuantizedQuaternion(unsigned numBits);
+    /// Skip the remaining bits of the current byte, so that the source deserializer can be read from again.
+    void Align();
+
+    /// Return number of bits read so far.
+    unsigned GetNumBitsRead() const { return numBitsRead_; }
+
+private:
+    /// Source deserializer.
+    Deserializer& source_;
+    /// Remaining bits of the current byte.
+    unsigned current_;
+    /// Number of remaining bits in the current byte.
+    unsigned numBits_;
+    /// Total number of bits read.
+    unsigned numBitsRead_;
+};
+
+}
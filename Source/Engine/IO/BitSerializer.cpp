@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "BitSerializer.h"
+#include "BoundingBox.h"
+#include "Serializer.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const float QUATERNION_COMPONENT_RANGE = 0.70710678f;
+static const int MAX_FIXED_STEPS = (1 << 30) - 1;
+
+BitSerializer::BitSerializer(Serializer& dest) :
+    dest_(dest),
+    current_(0),
+    numBits_(0),
+    numBitsWritten_(0)
+{
+}
+
+BitSerializer::~BitSerializer()
+{
+    Flush();
+}
+
+void BitSerializer::WriteBits(unsigned value, unsigned numBits)
+{
+    numBits = Min((int)numBits, 32);
+    numBitsWritten_ += numBits;
+
+    while (numBits)
+    {
+        unsigned count = Min((int)(8 - numBits_), (int)numBits);
+        current_ |= (value & ((1 << count) - 1)) << numBits_;
+        numBits_ += count;
+        numBits -= count;
+        value >>= count;
+
+        if (numBits_ == 8)
+        {
+            dest_.WriteUByte((unsigned char)current_);
+            current_ = 0;
+            numBits_ = 0;
+        }
+    }
+}
+
+void BitSerializer::WriteBool(bool value)
+{
+    WriteBits(value ? 1 : 0, 1);
+}
+
+void BitSerializer::WriteQuantizedFloat(float value, float minValue, float maxValue, unsigned numBits)
+{
+    numBits = Clamp((int)numBits, 1, 24);
+    unsigned maxStep = (1 << numBits) - 1;
+    float range = maxValue - minValue;
+    float t = range > 0.0f ? (Clamp(value, minValue, maxValue) - minValue) / range : 0.0f;
+
+    WriteBits((unsigned)(t * (float)maxStep + 0.5f), numBits);
+}
+
+void BitSerializer::WriteFixedFloat(float value, unsigned precisionBits)
+{
+    static const float maxSteps = (float)MAX_FIXED_STEPS;
+
+    float steps = Clamp(value * (float)(1 << Min((int)precisionBits, 24)), -maxSteps, maxSteps);
+    int intValue = Clamp((int)(steps < 0.0f ? steps - 0.5f : steps + 0.5f), -MAX_FIXED_STEPS, MAX_FIXED_STEPS);
+
+    // Zigzag encode so that small negative values also have few significant bits, then write the bit count first
+    unsigned zigzag = ((unsigned)intValue << 1) ^ (unsigned)(intValue >> 31);
+    unsigned numBits = 0;
+    while (numBits < 32 && (zigzag >> numBits))
+        ++numBits;
+
+    WriteBits(numBits, 5);
+    WriteBits(zigzag, numBits);
+}
+
+void BitSerializer::WriteQuantizedQuaternion(const Quaternion& value, unsigned numBits)
+{
+    Quaternion normalized = value.Normalized();
+    float components[4] = { normalized.w_, normalized.x_, normalized.y_, normalized.z_ };
+
+    // Omit the largest component, which can be reconstructed from the others. Flip the sign so that it is positive
+    unsigned largest = 0;
+    for (unsigned i = 1; i < 4; ++i)
+    {
+        if (Abs(components[i]) > Abs(components[largest]))
+            largest = i;
+    }
+    float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+    WriteBits(largest, 2);
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        if (i != largest)
+            WriteQuantizedFloat(components[i] * sign, -QUATERNION_COMPONENT_RANGE, QUATERNION_COMPONENT_RANGE, numBits);
+    }
+}
+
+void BitSerializer::Flush()
+{
+    if (numBits_)
+    {
+        dest_.WriteUByte((unsigned char)current_);
+        numBitsWritten_ += 8 - numBits_;
+        current_ = 0;
+        numBits_ = 0;
+    }
+}
+
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Quaternion.h"
+
+namespace Urho3D
+{
+
+class Serializer;
+
+/// Bit-level writer that packs values into bytes of an underlying serializer. Bits are stored starting from the least significant bit of each byte.
+class URHO3D_API BitSerializer
+{
+public:
+    /// Construct with destination serializer.
+    BitSerializer(Serializer& dest);
+    /// Destruct. Write any pending bits.
+    ~BitSerializer();
+
+    /// Write up to 32 low bits of an unsigned value.
+    void WriteBits(unsigned value, unsigned numBits);
+    /// Write a bool as one bit.
+    void WriteBool(bool value);
+    /// Write a float quantized to the specified range with the specified number of bits (max 24.)
+    void WriteQuantizedFloat(float value, float minValue, float maxValue, unsigned numBits);
+    /// Write a float as a variable-length multiple of 1 / 2^precisionBits. Magnitude is limited to 2^30 steps.
+    void WriteFixedFloat(float value, unsigned precisionBits);
+    /// Write a normalized quaternion as the three smallest components with the specified number of bits each (max 24), plus 2 bits for the index of the omitted component.
+    void WriteQuantizedQuaternion(const Quaternion& value, unsigned numBits);
+    /// Write pending bits padded to a whole byte.
+    void Flush();
+
+    /// Return number of bits written so far.
+    unsigned GetNumBitsWritten() const { return numBitsWritten_; }
+
+private:
+    /// Destination serializer.
+    Serializer& dest_;
+    /// Pending bits of the current byte.
+    unsigned current_;
+    /// Number of pending bits in the current byte.
+    unsigned numBits_;
+    /// Total number of bits written.
+    unsigned numBitsWritten_;
+};
+
+}
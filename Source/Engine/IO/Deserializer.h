@@ -48,6 +48,8 @@ public:
     virtual const String& GetName() const;
     /// Return a checksum if applicable.
     virtual unsigned GetChecksum();
+    /// Return pointer to the data at the current position if the whole stream is in memory and can be read without copying, or null if not. Valid while the stream is open.
+    virtual const unsigned char* GetReadPointer() const { return 0; }
     /// Return current position.
     unsigned GetPosition() const { return position_; }
     /// Return size.
@@ -21,12 +21,15 @@
 //
 
 #include "Precompiled.h"
+#include "Condition.h"
 #include "File.h"
 #include "FileSystem.h"
 #include "Log.h"
 #include "MemoryBuffer.h"
 #include "PackageFile.h"
 #include "Profiler.h"
+#include "Thread.h"
+#include "WorkQueue.h"
 
 #include <cstdio>
 #include <lz4.h>
@@ -58,6 +61,88 @@ static const char* openMode[] =
 static const unsigned READ_BUFFER_SIZE = 32768;
 #endif
 static const unsigned SKIP_BUFFER_SIZE = 1024;
+static const unsigned MIN_PARALLEL_DECOMPRESS_BLOCKS = 4;
+
+/// Decompression of consecutive blocks of a block-indexed compressed file, shared by the reading thread and worker threads.
+struct BlockDecompressJob : public RefCounted
+{
+    /// Construct.
+    BlockDecompressJob() :
+        nextBlock_(0),
+        finishedBlocks_(0),
+        failed_(false)
+    {
+    }
+    
+    /// Compressed data of the first block.
+    const unsigned char* packedData_;
+    /// Compressed block offsets of the file.
+    const unsigned* blockOffsets_;
+    /// Destination for the uncompressed data.
+    unsigned char* dest_;
+    /// Index of the first block.
+    unsigned firstBlock_;
+    /// Number of blocks.
+    unsigned numBlocks_;
+    /// Uncompressed block size.
+    unsigned blockSize_;
+    /// Uncompressed file size.
+    unsigned fileSize_;
+    /// Mutex for picking blocks.
+    Mutex mutex_;
+    /// Condition set when the last block has been decompressed.
+    Condition finished_;
+    /// Next block to pick, relative to the first block.
+    unsigned nextBlock_;
+    /// Number of blocks decompressed.
+    volatile unsigned finishedBlocks_;
+    /// Decompression failure flag.
+    volatile bool failed_;
+};
+
+/// Work item helping to decompress blocks of a compressed file.
+struct BlockDecompressItem : public WorkItem
+{
+    /// Decompression job.
+    SharedPtr<BlockDecompressJob> job_;
+};
+
+/// Pick and decompress the next block of a decompression job. Return false if no blocks left.
+static bool DecompressNextBlock(BlockDecompressJob* job)
+{
+    unsigned index;
+    {
+        MutexLock lock(job->mutex_);
+        if (job->nextBlock_ >= job->numBlocks_)
+            return false;
+        index = job->nextBlock_++;
+    }
+    
+    unsigned block = job->firstBlock_ + index;
+    const unsigned char* packedData = job->packedData_ + job->blockOffsets_[block] - job->blockOffsets_[job->firstBlock_];
+    int packedSize = job->blockOffsets_[block + 1] - job->blockOffsets_[block];
+    int unpackedSize = Min((int)job->blockSize_, (int)(job->fileSize_ - block * job->blockSize_));
+    if (LZ4_decompress_safe((const char*)packedData, (char*)job->dest_ + index * job->blockSize_, packedSize, unpackedSize) !=
+        unpackedSize)
+        job->failed_ = true;
+    
+    bool last;
+    {
+        MutexLock lock(job->mutex_);
+        last = ++job->finishedBlocks_ == job->numBlocks_;
+    }
+    if (last)
+        job->finished_.Set();
+    return true;
+}
+
+static void DecompressBlocksWork(const WorkItem* item, unsigned threadIndex)
+{
+    BlockDecompressJob* job = static_cast<const BlockDecompressItem*>(item)->job_;
+    while (DecompressNextBlock(job))
+    {
+    }
+}
 
 File::File(Context* context) :
     Object(context),
@@ -68,6 +153,10 @@ File::File(Context* context) :
     #endif
     readBufferOffset_(0),
     readBufferSize_(0),
+    package_(0),
+    mappedData_(0),
+    mappedSize_(0),
+    mappedPosition_(0),
     offset_(0),
     checksum_(0),
     compressed_(false),
@@ -85,6 +174,10 @@ File::File(Context* context, const String& fileName, FileMode mode) :
     #endif
     readBufferOffset_(0),
     readBufferSize_(0),
+    package_(0),
+    mappedData_(0),
+    mappedSize_(0),
+    mappedPosition_(0),
     offset_(0),
     checksum_(0),
     compressed_(false),
@@ -103,6 +196,10 @@ File::File(Context* context, PackageFile* package, const String& fileName) :
     #endif
     readBufferOffset_(0),
     readBufferSize_(0),
+    package_(0),
+    mappedData_(0),
+    mappedSize_(0),
+    mappedPosition_(0),
     offset_(0),
     checksum_(0),
     compressed_(false),
@@ -213,15 +310,27 @@ bool File::Open(PackageFile* package, const String& fileName)
     if (!entry)
         return false;
 
-    #ifdef WIN32
-    handle_ = _wfopen(GetWideNativePath(package->GetName()).CString(), L"rb");
-    #else
-    handle_ = fopen(GetNativePath(package->GetName()).CString(), "rb");
-    #endif
-    if (!handle_)
+    // If the package is memory-mapped, read from the mapping instead of opening a file handle
+    if (package->IsMemoryMapped())
     {
-        LOGERROR("Could not open package file " + fileName);
-        return false;
+        package_ = package;
+        package_->AddMappedFile();
+        mappedData_ = package->GetMappedData() + entry->offset_;
+        mappedSize_ = package->GetTotalSize() - entry->offset_;
+        mappedPosition_ = 0;
+    }
+    else
+    {
+        #ifdef WIN32
+        handle_ = _wfopen(GetWideNativePath(package->GetName()).CString(), L"rb");
+        #else
+        handle_ = fopen(GetNativePath(package->GetName()).CString(), "rb");
+        #endif
+        if (!handle_)
+        {
+            LOGERROR("Could not open package file " + fileName);
+            return false;
+        }
     }
 
     fileName_ = fileName;
@@ -230,21 +339,43 @@ bool File::Open(PackageFile* package, const String& fileName)
     checksum_ = entry->checksum_;
     position_ = 0;
     size_ = entry->size_;
-    compressed_ = package->IsCompressed();
+    compressed_ = entry->compressed_;
     readSyncNeeded_ = false;
     writeSyncNeeded_ = false;
     
-    fseek((FILE*)handle_, offset_, SEEK_SET);
+    if (handle_)
+        fseek((FILE*)handle_, offset_, SEEK_SET);
+    
+    // Read the block index of a block-indexed compressed file
+    if (compressed_ && package->GetBlockSize())
+    {
+        blockSize_ = package->GetBlockSize();
+        unsigned numBlocks = (size_ + blockSize_ - 1) / blockSize_;
+        blockOffsets_.Resize(numBlocks + 1);
+        bool success = ReadCompressed(&blockOffsets_[0], blockOffsets_.Size() * sizeof(unsigned));
+        
+        unsigned maxPackedSize = LZ4_compressBound(blockSize_);
+        for (unsigned i = 0; i < numBlocks && success; ++i)
+        {
+            if (blockOffsets_[i + 1] < blockOffsets_[i] || blockOffsets_[i + 1] - blockOffsets_[i] > maxPackedSize ||
+                blockOffsets_[i + 1] > package->GetTotalSize() - offset_)
+                success = false;
+        }
+        
+        if (!success)
+        {
+            LOGERROR("Corrupt block index in package file entry " + fileName);
+            Close();
+            return false;
+        }
+    }
+    
     return true;
 }
 
 unsigned File::Read(void* dest, unsigned size)
 {
-    #ifdef ANDROID
-    if (!handle_ && !assetHandle_)
-    #else
-    if (!handle_)
-    #endif
+    if (!IsOpen())
     {
         // Do not log the error further here to prevent spamming the stderr stream
         return 0;
@@ -294,10 +425,43 @@ unsigned File::Read(void* dest, unsigned size)
 
         while (sizeLeft)
         {
-            if (!readBuffer_ || readBufferOffset_ >= readBufferSize_)
+            if (blockSize_ && readBufferOffset_ >= readBufferSize_)
+            {
+                unsigned block = position_ / blockSize_;
+                unsigned blockOffset = position_ - block * blockSize_;
+                
+                // If whole blocks are to be read, decompress them directly to the destination
+                unsigned numBlocks = 0;
+                if (!blockOffset)
+                    numBlocks = position_ + sizeLeft == size_ ? blockOffsets_.Size() - 1 - block : sizeLeft / blockSize_;
+                if (numBlocks)
+                {
+                    unsigned unpackedSize = Min((int)(numBlocks * blockSize_), (int)sizeLeft);
+                    if (!DecompressBlocks(destPtr, block, numBlocks))
+                        return size - sizeLeft;
+                    destPtr += unpackedSize;
+                    sizeLeft -= unpackedSize;
+                    position_ += unpackedSize;
+                    readBufferSize_ = 0;
+                    readBufferOffset_ = 0;
+                    continue;
+                }
+                
+                if (!readBuffer_)
+                    readBuffer_ = new unsigned char[blockSize_];
+                if (!DecompressBlocks(readBuffer_.Get(), block, 1))
+                    return size - sizeLeft;
+                readBufferSize_ = Min((int)blockSize_, (int)(size_ - block * blockSize_));
+                readBufferOffset_ = blockOffset;
+            }
+            else if (!blockSize_ && (!readBuffer_ || readBufferOffset_ >= readBufferSize_))
             {
                 unsigned char blockHeaderBytes[4];
-                fread(blockHeaderBytes, sizeof blockHeaderBytes, 1, (FILE*)handle_);
+                if (!ReadCompressed(blockHeaderBytes, sizeof blockHeaderBytes))
+                {
+                    LOGERROR("Error while reading from file " + GetName());
+                    return size - sizeLeft;
+                }
 
                 MemoryBuffer blockHeader(&blockHeaderBytes[0], sizeof blockHeaderBytes);
                 unsigned unpackedSize = blockHeader.ReadUShort();
@@ -306,12 +470,48 @@ unsigned File::Read(void* dest, unsigned size)
                 if (!readBuffer_)
                 {
                     readBuffer_ = new unsigned char[unpackedSize];
-                    inputBuffer_ = new unsigned char[LZ4_compressBound(unpackedSize)];
+                    if (!mappedData_)
+                        inputBuffer_ = new unsigned char[LZ4_compressBound(unpackedSize)];
                 }
 
-                /// \todo Handle errors
-                fread(inputBuffer_.Get(), packedSize, 1, (FILE*)handle_);
-                LZ4_decompress_fast((const char*)inputBuffer_.Get(), (char *)readBuffer_.Get(), unpackedSize);
+                // Decompress from the mapping without copying the compressed data
+                const char* packedData;
+                if (mappedData_)
+                {
+                    if (packedSize > mappedSize_ - mappedPosition_)
+                    {
+                        LOGERROR("Compressed block outside package file in file " + GetName());
+                        return size - sizeLeft;
+                    }
+                    packedData = (const char*)mappedData_ + mappedPosition_;
+                    mappedPosition_ += packedSize;
+                }
+                else
+                {
+                    /// \todo Handle errors
+                    fread(inputBuffer_.Get(), packedSize, 1, (FILE*)handle_);
+                    packedData = (const char*)inputBuffer_.Get();
+                }
+
+                // If the whole block is to be read, decompress directly to the destination. Decompress with input bounds
+                // checking, as the compressed size has not been validated
+                bool direct = sizeLeft >= unpackedSize;
+                char* blockDest = (char*)(direct ? destPtr : readBuffer_.Get());
+                if (LZ4_decompress_safe(packedData, blockDest, packedSize, unpackedSize) != (int)unpackedSize)
+                {
+                    LOGERROR("Error while decompressing file " + GetName());
+                    return size - sizeLeft;
+                }
+                
+                if (direct)
+                {
+                    destPtr += unpackedSize;
+                    sizeLeft -= unpackedSize;
+                    position_ += unpackedSize;
+                    readBufferSize_ = 0;
+                    readBufferOffset_ = 0;
+                    continue;
+                }
 
                 readBufferSize_ = unpackedSize;
                 readBufferOffset_ = 0;
@@ -328,6 +528,13 @@ unsigned File::Read(void* dest, unsigned size)
         return size;
     }
 
+    if (mappedData_)
+    {
+        memcpy(dest, mappedData_ + position_, size);
+        position_ += size;
+        return size;
+    }
+
     // Need to reassign the position due to internal buffering when transitioning from writing to reading
     if (readSyncNeeded_)
     {
@@ -351,11 +558,7 @@ unsigned File::Read(void* dest, unsigned size)
 
 unsigned File::Seek(unsigned position)
 {
-    #ifdef ANDROID
-    if (!handle_ && !assetHandle_)
-    #else
-    if (!handle_)
-    #endif
+    if (!IsOpen())
     {
         // Do not log the error further here to prevent spamming the stderr stream
         return 0;
@@ -377,13 +580,29 @@ unsigned File::Seek(unsigned position)
     #endif
     if (compressed_)
     {
+        // With a block index, decompress the block containing the new position on the next read, unless already decompressed
+        if (blockSize_)
+        {
+            unsigned bufferStart = position_ - readBufferOffset_;
+            if (readBufferSize_ && position >= bufferStart && position < bufferStart + readBufferSize_)
+                readBufferOffset_ = position - bufferStart;
+            else
+            {
+                readBufferOffset_ = 0;
+                readBufferSize_ = 0;
+            }
+            position_ = position;
+        }
         // Start over from the beginning
-        if (position == 0)
+        else if (position == 0)
         {
             position_ = 0;
             readBufferOffset_ = 0;
             readBufferSize_ = 0;
-            fseek((FILE*)handle_, offset_, SEEK_SET);
+            if (mappedData_)
+                mappedPosition_ = 0;
+            else
+                fseek((FILE*)handle_, offset_, SEEK_SET);
         }
         // Skip bytes
         else if (position >= position_)
@@ -398,6 +617,12 @@ unsigned File::Seek(unsigned position)
         return position_;
     }
 
+    if (mappedData_)
+    {
+        position_ = position;
+        return position_;
+    }
+
     fseek((FILE*)handle_, position + offset_, SEEK_SET);
     position_ = position;
     readSyncNeeded_ = false;
@@ -449,11 +674,7 @@ unsigned File::GetChecksum()
 {
     if (offset_ || checksum_)
         return checksum_;
-    #ifdef ANDROID
-    if ((!handle_ && !assetHandle_) || mode_ == FILE_WRITE)
-    #else
-    if (!handle_ || mode_ == FILE_WRITE)
-    #endif
+    if (!IsOpen() || mode_ == FILE_WRITE)
         return 0;
 
     PROFILE(CalculateFileChecksum);
@@ -486,6 +707,23 @@ void File::Close()
 
     readBuffer_.Reset();
     inputBuffer_.Reset();
+    readBufferOffset_ = 0;
+    readBufferSize_ = 0;
+    blockOffsets_.Clear();
+    blockSize_ = 0;
+
+    if (mappedData_)
+    {
+        package_->RemoveMappedFile();
+        package_ = 0;
+        mappedData_ = 0;
+        mappedSize_ = 0;
+        mappedPosition_ = 0;
+        position_ = 0;
+        size_ = 0;
+        offset_ = 0;
+        checksum_ = 0;
+    }
 
     if (handle_)
     {
@@ -512,10 +750,105 @@ void File::SetName(const String& name)
 bool File::IsOpen() const
 {
     #ifdef ANDROID
-        return handle_ != 0 || assetHandle_ != 0;
+        return handle_ != 0 || assetHandle_ != 0 || mappedData_ != 0;
     #else
-        return handle_ != 0;
+        return handle_ != 0 || mappedData_ != 0;
     #endif
 }
 
+const unsigned char* File::GetReadPointer() const
+{
+    return mappedData_ && !compressed_ ? mappedData_ + position_ : 0;
+}
+
+bool File::ReadCompressed(void* dest, unsigned size)
+{
+    if (mappedData_)
+    {
+        if (size > mappedSize_ - mappedPosition_)
+            return false;
+        memcpy(dest, mappedData_ + mappedPosition_, size);
+        mappedPosition_ += size;
+        return true;
+    }
+    else
+        return fread(dest, size, 1, (FILE*)handle_) == 1;
+}
+
+bool File::DecompressBlocks(unsigned char* dest, unsigned firstBlock, unsigned numBlocks)
+{
+    // Use the compressed data directly from the mapping, or read all of it at once
+    unsigned packedStart = blockOffsets_[firstBlock];
+    unsigned packedSize = blockOffsets_[firstBlock + numBlocks] - packedStart;
+    SharedArrayPtr<unsigned char> packedBuffer;
+    const unsigned char* packedData;
+    if (mappedData_)
+        packedData = mappedData_ + packedStart;
+    else
+    {
+        if (numBlocks == 1)
+        {
+            if (!inputBuffer_)
+                inputBuffer_ = new unsigned char[LZ4_compressBound(blockSize_)];
+            packedBuffer = inputBuffer_;
+        }
+        else
+            packedBuffer = new unsigned char[packedSize];
+        
+        fseek((FILE*)handle_, offset_ + packedStart, SEEK_SET);
+        if (fread(packedBuffer.Get(), packedSize, 1, (FILE*)handle_) != 1)
+        {
+            LOGERROR("Error while reading from file " + GetName());
+            return false;
+        }
+        packedData = packedBuffer.Get();
+    }
+    
+    SharedPtr<BlockDecompressJob> job(new BlockDecompressJob());
+    job->packedData_ = packedData;
+    job->blockOffsets_ = &blockOffsets_[0];
+    job->dest_ = dest;
+    job->firstBlock_ = firstBlock;
+    job->numBlocks_ = numBlocks;
+    job->blockSize_ = blockSize_;
+    job->fileSize_ = size_;
+    
+    // Let worker threads help with large reads. The work queue can only be added to from the main thread; background
+    // loading threads decompress by themselves. Work items left over after this thread has finished the job do nothing
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (numBlocks >= MIN_PARALLEL_DECOMPRESS_BLOCKS && queue && queue->GetNumThreads() && Thread::IsMainThread())
+    {
+        unsigned numItems = Min((int)queue->GetNumThreads(), (int)numBlocks - 1);
+        for (unsigned i = 0; i < numItems; ++i)
+        {
+            BlockDecompressItem* item = new BlockDecompressItem();
+            item->workFunction_ = DecompressBlocksWork;
+            item->job_ = job;
+            item->priority_ = M_MAX_UNSIGNED;
+            queue->AddWorkItem(SharedPtr<WorkItem>(item));
+        }
+    }
+    
+    while (DecompressNextBlock(job))
+    {
+    }
+    
+    // Wait for the blocks picked by worker threads. The thread that finishes the last block sets the condition
+    bool finished;
+    {
+        MutexLock lock(job->mutex_);
+        finished = job->finishedBlocks_ == numBlocks;
+    }
+    if (!finished)
+        job->finished_.Wait();
+    
+    if (job->failed_)
+    {
+        LOGERROR("Error while decompressing file " + GetName());
+        return false;
+    }
+    
+    return true;
+}
+
 }
@@ -69,6 +69,8 @@ public:
     virtual const String& GetName() const { return fileName_; }
     /// Return a checksum of the file contents using the SDBM hash algorithm.
     virtual unsigned GetChecksum();
+    /// Return pointer to the data at the current position if opened from an uncompressed memory-mapped package, or null if not.
+    virtual const unsigned char* GetReadPointer() const;
     
     /// Open a filesystem file. Return true if successful.
     bool Open(const String& fileName, FileMode mode = FILE_READ);
@@ -91,6 +93,11 @@ public:
     bool IsPackaged() const { return offset_ != 0; }
     
 private:
+    /// Read bytes of the compressed data from the package file or its memory mapping. Return true if successful.
+    bool ReadCompressed(void* dest, unsigned size);
+    /// Decompress consecutive blocks of a block-indexed compressed file. Return true if successful.
+    bool DecompressBlocks(unsigned char* dest, unsigned firstBlock, unsigned numBlocks);
+    
     /// File name.
     String fileName_;
     /// Open mode.
@@ -109,6 +116,18 @@ private:
     unsigned readBufferOffset_;
     /// Bytes in the current read buffer.
     unsigned readBufferSize_;
+    /// Memory-mapped package file the file was opened from. Not a shared pointer, as files may be opened and closed in background loading threads. The package keeps count of the files reading from its mapping.
+    PackageFile* package_;
+    /// File contents within the memory-mapped package file.
+    const unsigned char* mappedData_;
+    /// Bytes available in the memory mapping from the start of the file contents.
+    unsigned mappedSize_;
+    /// Position in the compressed data within the memory-mapped package file.
+    unsigned mappedPosition_;
+    /// Compressed block offsets from the file start for a block-indexed compressed file. Has one more element than there are blocks.
+    PODVector<unsigned> blockOffsets_;
+    /// Uncompressed block size for a block-indexed compressed file, 0 if the blocks have inline headers.
+    unsigned blockSize_;
     /// Start position within a package file, 0 for regular files.
     unsigned offset_;
     /// Content checksum.
@@ -47,6 +47,8 @@ public:
     virtual unsigned Seek(unsigned position);
     /// Write bytes to the memory area.
     virtual unsigned Write(const void* data, unsigned size);
+    /// Return pointer to the memory area at the current position.
+    virtual const unsigned char* GetReadPointer() const { return buffer_ + position_; }
     
     /// Return memory area.
     unsigned char* GetData() { return buffer_; }
@@ -22,9 +22,18 @@
 
 #include "Precompiled.h"
 #include "File.h"
+#include "FileSystem.h"
 #include "Log.h"
 #include "PackageFile.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace Urho3D
 {
 
@@ -32,6 +41,9 @@ PackageFile::PackageFile(Context* context) :
     Object(context),
     totalSize_(0),
     checksum_(0),
+    blockSize_(0),
+    mappedData_(0),
+    numMappedFiles_(0),
     compressed_(false)
 {
 }
@@ -40,6 +52,9 @@ PackageFile::PackageFile(Context* context, const String& fileName, unsigned star
     Object(context),
     totalSize_(0),
     checksum_(0),
+    blockSize_(0),
+    mappedData_(0),
+    numMappedFiles_(0),
     compressed_(false)
 {
     Open(fileName, startOffset);
@@ -47,10 +62,17 @@ PackageFile::PackageFile(Context* context, const String& fileName, unsigned star
 
 PackageFile::~PackageFile()
 {
+    if (GetNumMappedFiles())
+        LOGERROR("Package file " + fileName_ + " destroyed while files are open from its memory mapping");
+    Unmap();
 }
 
 bool PackageFile::Open(const String& fileName, unsigned startOffset)
 {
+    // Files reading from the mapping would be left with dangling pointers
+    if (!SetMemoryMapped(false))
+        return false;
+    
     #ifdef ANDROID
     if (fileName.StartsWith("/apk/"))
     {
@@ -66,7 +88,7 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
     // Check ID, then read the directory
     file->Seek(startOffset);
     String id = file->ReadFileID();
-    if (id != "UPAK" && id != "ULZ4")
+    if (id != "UPAK" && id != "ULZ4" && id != "ULZ5")
     {
         // If start offset has not been explicitly specified, also try to read package size from the end of file
         // to know how much we must rewind to find the package start
@@ -83,7 +105,7 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
             }
         }
         
-        if (id != "UPAK" && id != "ULZ4")
+        if (id != "UPAK" && id != "ULZ4" && id != "ULZ5")
         {
             LOGERROR(fileName + " is not a valid package file");
             return false;
@@ -93,10 +115,18 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
     fileName_ = fileName;
     nameHash_ = fileName_;
     totalSize_ = file->GetSize();
-    compressed_ = id == "ULZ4";
+    compressed_ = id != "UPAK";
     
     unsigned numFiles = file->ReadUInt();
     checksum_ = file->ReadUInt();
+    // The block-indexed format stores the block size in the header and a compressed flag for each entry
+    bool blockIndexed = id == "ULZ5";
+    blockSize_ = blockIndexed ? file->ReadUInt() : 0;
+    if (blockIndexed && !blockSize_)
+    {
+        LOGERROR(fileName + " has zero block size");
+        return false;
+    }
     
     for (unsigned i = 0; i < numFiles; ++i)
     {
@@ -105,7 +135,9 @@ bool PackageFile::Open(const String& fileName, unsigned startOffset)
         newEntry.offset_ = file->ReadUInt() + startOffset;
         newEntry.size_ = file->ReadUInt();
         newEntry.checksum_ = file->ReadUInt();
-        if (!compressed_ && newEntry.offset_ + newEntry.size_ > totalSize_)
+        newEntry.compressed_ = blockIndexed ? file->ReadUByte() != 0 : compressed_;
+        // The compressed size is not known from the directory, so check just the offset of compressed entries
+        if (newEntry.offset_ > totalSize_ || (!newEntry.compressed_ && newEntry.size_ > totalSize_ - newEntry.offset_))
             LOGERROR("File entry " + entryName + " outside package file");
         else
             entries_[entryName.ToLower()] = newEntry;
@@ -119,6 +151,84 @@ bool PackageFile::Exists(const String& fileName) const
     return entries_.Find(fileName.ToLower()) != entries_.End();
 }
 
+bool PackageFile::SetMemoryMapped(bool enable)
+{
+    if (enable == (mappedData_ != 0))
+        return true;
+    
+    if (!enable)
+    {
+        if (GetNumMappedFiles())
+        {
+            LOGERROR("Can not unmap package file " + fileName_ + " while files are open from it");
+            return false;
+        }
+        
+        Unmap();
+        return true;
+    }
+    
+    if (fileName_.Empty())
+    {
+        LOGERROR("Package file not open, can not memory-map");
+        return false;
+    }
+    
+    // The mapping stays valid after closing the file and mapping handles
+    void* data = 0;
+    #ifdef WIN32
+    HANDLE file = CreateFileW(GetWideNativePath(fileName_).CString(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, 0);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+    }
+    #else
+    int file = open(GetNativePath(fileName_).CString(), O_RDONLY);
+    if (file >= 0)
+    {
+        data = mmap(0, totalSize_, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+            data = 0;
+        close(file);
+    }
+    #endif
+    
+    if (!data)
+    {
+        LOGERROR("Could not memory-map package file " + fileName_);
+        return false;
+    }
+    
+    mappedData_ = (unsigned char*)data;
+    return true;
+}
+
+void PackageFile::AddMappedFile()
+{
+    MutexLock lock(mappedFilesMutex_);
+    ++numMappedFiles_;
+}
+
+void PackageFile::RemoveMappedFile()
+{
+    MutexLock lock(mappedFilesMutex_);
+    if (numMappedFiles_)
+        --numMappedFiles_;
+}
+
+unsigned PackageFile::GetNumMappedFiles() const
+{
+    MutexLock lock(mappedFilesMutex_);
+    return numMappedFiles_;
+}
+
 const PackageEntry* PackageFile::GetEntry(const String& fileName) const
 {
     HashMap<String, PackageEntry>::ConstIterator i = entries_.Find(fileName.ToLower());
@@ -128,4 +238,17 @@ const PackageEntry* PackageFile::GetEntry(const String& fileName) const
         return 0;
 }
 
+void PackageFile::Unmap()
+{
+    if (!mappedData_)
+        return;
+    
+    #ifdef WIN32
+    UnmapViewOfFile(mappedData_);
+    #else
+    munmap(mappedData_, totalSize_);
+    #endif
+    mappedData_ = 0;
+}
+
 }
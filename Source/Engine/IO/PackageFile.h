@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include "Mutex.h"
 #include "Object.h"
 
 namespace Urho3D
@@ -36,6 +37,8 @@ struct PackageEntry
     unsigned size_;
     /// File checksum.
     unsigned checksum_;
+    /// Compressed flag.
+    bool compressed_;
 };
 
 /// Stores files of a directory tree sequentially for convenient access.
@@ -53,6 +56,12 @@ public:
     
     /// Open the package file. Return true if successful.
     bool Open(const String& fileName, unsigned startOffset = 0);
+    /// Set whether to memory-map the package file after opening. Files opened from a mapped package read from the mapping without file handles. The package must not be destroyed while such files are open, and can not be unmapped or reopened. Return true if successful.
+    bool SetMemoryMapped(bool enable);
+    /// Register a file reading from the memory mapping. Is thread-safe.
+    void AddMappedFile();
+    /// Unregister a file reading from the memory mapping. Is thread-safe.
+    void RemoveMappedFile();
     /// Check if a file exists within the package file.
     bool Exists(const String& fileName) const;
     /// Return the file entry corresponding to the name, or null if not found.
@@ -69,12 +78,23 @@ public:
     unsigned GetTotalSize() const { return totalSize_; }
     /// Return checksum of the package file contents.
     unsigned GetChecksum() const { return checksum_; }
-    /// Return whether the files are compressed.
+    /// Return whether the files are compressed. Entries of a block-indexed package may still be stored uncompressed individually.
     bool IsCompressed() const { return compressed_; }
+    /// Return uncompressed size of the compressed blocks in a block-indexed package, or 0 if the blocks have inline headers.
+    unsigned GetBlockSize() const { return blockSize_; }
+    /// Return whether the package file is memory-mapped.
+    bool IsMemoryMapped() const { return mappedData_ != 0; }
+    /// Return the memory-mapped package file contents, or null if not mapped.
+    const unsigned char* GetMappedData() const { return mappedData_; }
+    /// Return number of open files reading from the memory mapping. Is thread-safe.
+    unsigned GetNumMappedFiles() const;
     /// Return list of entry names
     const Vector<String> GetEntryNames() const { return entries_.Keys(); }
     
 private:
+    /// Unmap the package file.
+    void Unmap();
+    
     /// File entries.
     HashMap<String, PackageEntry> entries_;
     /// File name.
@@ -85,6 +105,14 @@ private:
     unsigned totalSize_;
     /// Package file checksum.
     unsigned checksum_;
+    /// Uncompressed block size in a block-indexed package.
+    unsigned blockSize_;
+    /// Memory-mapped package file contents.
+    unsigned char* mappedData_;
+    /// Number of open files reading from the memory mapping.
+    unsigned numMappedFiles_;
+    /// Mutex for the mapped file count, as files are opened and closed also in background loading threads.
+    mutable Mutex mappedFilesMutex_;
     /// Compressed flag.
     bool compressed_;
 };
@@ -47,6 +47,8 @@ public:
     virtual unsigned Seek(unsigned position);
     /// Write bytes to the buffer. Return number of bytes actually written.
     virtual unsigned Write(const void* data, unsigned size);
+    /// Return pointer to the data at the current position.
+    virtual const unsigned char* GetReadPointer() const { return size_ ? &buffer_[0] + position_ : 0; }
     
     /// Set data from another buffer.
     void SetData(const PODVector<unsigned char>& data);
@@ -22,9 +22,13 @@
 
 #include "Precompiled.h"
 #include "Component.h"
+#include "Compression.h"
 #include "Connection.h"
 #include "File.h"
 #include "FileSystem.h"
+#include "InterpolatedTransform.h"
+#include "JoinSnapshot.h"
+#include "KNetTransport.h"
 #include "Log.h"
 #include "MemoryBuffer.h"
 #include "Network.h"
@@ -33,10 +37,13 @@
 #include "PackageFile.h"
 #include "Profiler.h"
 #include "Protocol.h"
+#include "RelevanceGrid.h"
 #include "ResourceCache.h"
 #include "Scene.h"
 #include "SceneEvents.h"
+#include "SimulatedLink.h"
 #include "SmoothedTransform.h"
+#include "WorkQueue.h"
 
 #include <kNet.h>
 
@@ -46,9 +53,109 @@ namespace Urho3D
 {
 
 static const int STATS_INTERVAL_MSEC = 2000;
+static const float RELEVANCE_HYSTERESIS = 1.25f;
+static const unsigned TIMESTAMP_MASK = 0x7fffffff;
+static const unsigned CONTROLS_SEQUENCE_FLAG = 0x80000000;
+static const unsigned char SNAPSHOT_COMPONENT = 1;
+static const unsigned char SNAPSHOT_OWNED = 2;
+static const unsigned MAX_UNACKED_SNAPSHOTS = 64;
+static const int SNAPSHOT_ACK_TIMEOUT_MSEC = 1000;
+
+/// Add the set bits of an attribute mask to another.
+static void AddDirtyBits(DirtyBits& dest, const DirtyBits& bits)
+{
+    for (unsigned i = 0; i < MAX_NETWORK_ATTRIBUTES; ++i)
+    {
+        if (bits.IsSet(i))
+            dest.Set(i);
+    }
+}
+
+/// Return world position of a node without updating its cached world transform, so that it is safe to call from several threads.
+static Vector3 GetWorldPositionNoUpdate(const Node* node)
+{
+    Vector3 position = node->GetPosition();
+    for (Node* parent = node->GetParent(); parent; parent = parent->GetParent())
+        position = parent->GetTransform() * position;
+    return position;
+}
+
+/// Background work item writing received package fragments to the download file.
+struct PackageWriteItem : public WorkItem
+{
+    /// Construct.
+    PackageWriteItem(Context* context) :
+        context_(context),
+        failed_(false)
+    {
+    }
+    
+    /// Context for opening the resume file.
+    Context* context_;
+    /// Download file.
+    SharedPtr<File> file_;
+    /// Indices of the fragments to write.
+    PODVector<unsigned> fragments_;
+    /// Data of the fragments to write.
+    VectorBuffer data_;
+    /// Package file size.
+    unsigned fileSize_;
+    /// Fragments on disk after this write as a bitmask, to be recorded in the resume file.
+    PODVector<unsigned char> writtenFragments_;
+    /// Resume file name.
+    String resumeFileName_;
+    /// Write failure flag.
+    volatile bool failed_;
+};
+
+/// Return the checksum of a package fragment.
+static unsigned GetFragmentChecksum(const unsigned char* data, unsigned size)
+{
+    unsigned checksum = 0;
+    for (unsigned i = 0; i < size; ++i)
+        checksum = SDBMHash(checksum, data[i]);
+    return checksum;
+}
+
+/// Return the size of a package fragment.
+static unsigned GetFragmentSize(unsigned index, unsigned fileSize)
+{
+    return (unsigned)Min((int)(fileSize - index * PACKAGE_FRAGMENT_SIZE), (int)PACKAGE_FRAGMENT_SIZE);
+}
+
+static void WritePackageFragmentsWork(const WorkItem* item, unsigned threadIndex)
+{
+    PackageWriteItem* writeItem = static_cast<PackageWriteItem*>(const_cast<WorkItem*>(item));
+    File* file = writeItem->file_;
+    const unsigned char* data = writeItem->data_.GetData();
+    
+    for (unsigned i = 0; i < writeItem->fragments_.Size(); ++i)
+    {
+        unsigned index = writeItem->fragments_[i];
+        unsigned size = GetFragmentSize(index, writeItem->fileSize_);
+        file->Seek(index * PACKAGE_FRAGMENT_SIZE);
+        if (file->Write(data, size) != size)
+        {
+            writeItem->failed_ = true;
+            return;
+        }
+        data += size;
+    }
+    file->Flush();
+    
+    // Record the fragments that are now on disk, so that an interrupted download can be resumed
+    File resumeFile(writeItem->context_, writeItem->resumeFileName_, FILE_WRITE);
+    if (resumeFile.IsOpen())
+    {
+        resumeFile.WriteUInt(writeItem->fileSize_);
+        resumeFile.Write(&writeItem->writtenFragments_[0], writeItem->writtenFragments_.Size());
+    }
+}
 
 PackageDownload::PackageDownload() :
+    fileSize_(0),
     totalFragments_(0),
+    numReceivedFragments_(0),
     checksum_(0),
     initiated_(false)
 {
@@ -60,23 +167,107 @@ PackageUpload::PackageUpload() :
 {
 }
 
-Connection::Connection(Context* context, bool isClient, kNet::SharedPtr<kNet::MessageConnection> connection) :
+NetworkTraffic::NetworkTraffic() :
+    count_(0),
+    bytes_(0),
+    attributes_(0)
+{
+}
+
+ConnectionStatistics::ConnectionStatistics() :
+    serializationTime_(0),
+    numUpdates_(0),
+    interval_(0.0f)
+{
+}
+
+void ConnectionStatistics::Clear()
+{
+    messages_.Clear();
+    objects_.Clear();
+    serializationTime_ = 0;
+    numUpdates_ = 0;
+    interval_ = 0.0f;
+}
+
+void ConnectionStatistics::Merge(const ConnectionStatistics& statistics)
+{
+    for (HashMap<int, NetworkTraffic>::ConstIterator i = statistics.messages_.Begin(); i != statistics.messages_.End(); ++i)
+    {
+        NetworkTraffic& traffic = messages_[i->first_];
+        traffic.count_ += i->second_.count_;
+        traffic.bytes_ += i->second_.bytes_;
+    }
+    for (HashMap<StringHash, NetworkTraffic>::ConstIterator i = statistics.objects_.Begin(); i != statistics.objects_.End(); ++i)
+    {
+        NetworkTraffic& traffic = objects_[i->first_];
+        traffic.count_ += i->second_.count_;
+        traffic.bytes_ += i->second_.bytes_;
+        traffic.attributes_ += i->second_.attributes_;
+    }
+    
+    serializationTime_ += statistics.serializationTime_;
+    numUpdates_ += statistics.numUpdates_;
+    interval_ = Max(interval_, statistics.interval_);
+}
+
+unsigned ConnectionStatistics::GetTotalBytes() const
+{
+    unsigned bytes = 0;
+    for (HashMap<int, NetworkTraffic>::ConstIterator i = messages_.Begin(); i != messages_.End(); ++i)
+        bytes += i->second_.bytes_;
+    return bytes;
+}
+
+Connection::Connection(Context* context, bool isClient, kNet::SharedPtr<kNet::MessageConnection> connection, SimulatedLink* link) :
     Object(context),
     connection_(connection),
+    link_(link),
     sendMode_(OPSM_NONE),
+    relevanceDistance_(0.0f),
+    relevanceActive_(false),
+    sentSnapshotID_(0),
+    ackedSnapshotID_(0),
+    receiveSnapshotID_(0),
+    receivedSnapshotParts_(0),
+    appliedSnapshotID_(0),
+    resendSnapshotID_(0),
+    snapshotComplete_(false),
+    snapshotReplication_(false),
+    snapshotActive_(false),
+    snapshotResend_(false),
+    controlsSequence_(0),
+    ackedControlsSequence_(0),
+    serverTime_(0.0),
+    serverTimeStamp_(0),
+    serverTimeValid_(false),
     isClient_(isClient),
     connectPending_(false),
     sceneLoaded_(false),
-    logStatistics_(false)
+    logStatistics_(false),
+    trackStatistics_(false)
 {
     sceneState_.connection_ = this;
     
     // Store address and port now for accurate logging (kNet may already have destroyed the socket on disconnection,
     // in which case we would log a zero address:port on disconnect)
-    kNet::EndPoint endPoint = connection_->RemoteEndPoint();
-    ///\todo Not IPv6-capable.
-    address_ = Urho3D::ToString("%d.%d.%d.%d", endPoint.ip[0], endPoint.ip[1], endPoint.ip[2], endPoint.ip[3]);
-    port_ = endPoint.port;
+    if (connection_)
+    {
+        kNet::EndPoint endPoint = connection_->RemoteEndPoint();
+        ///\todo Not IPv6-capable.
+        address_ = Urho3D::ToString("%d.%d.%d.%d", endPoint.ip[0], endPoint.ip[1], endPoint.ip[2], endPoint.ip[3]);
+        port_ = endPoint.port;
+    }
+    else
+    {
+        address_ = "loopback";
+        port_ = 0;
+    }
+    
+    if (link_)
+        transport_ = new SimulatedTransport(link_, this);
+    else
+        transport_ = new KNetTransport(connection_);
 }
 
 Connection::~Connection()
@@ -106,21 +297,14 @@ void Connection::SendMessage(int msgID, bool reliable, bool inOrder, const unsig
         return;
     }
     
-    kNet::NetworkMessage *msg = connection_->StartNewMessage(msgID, numBytes);
-    if (!msg)
+    if (trackStatistics_)
     {
-        LOGERROR("Can not start new network message");
-        return;
+        NetworkTraffic& traffic = statistics_.messages_[msgID];
+        ++traffic.count_;
+        traffic.bytes_ += numBytes;
     }
     
-    msg->reliable = reliable;
-    msg->inOrder = inOrder;
-    msg->priority = 0;
-    msg->contentID = contentID;
-    if (numBytes)
-        memcpy(msg->data, data, numBytes);
-    
-    connection_->EndAndQueueMessage(msg);
+    transport_->SendMessage(msgID, reliable, inOrder, data, numBytes, contentID);
 }
 
 void Connection::SendRemoteEvent(StringHash eventType, bool inOrder, const VariantMap& eventData)
@@ -169,6 +353,16 @@ void Connection::SetScene(Scene* newScene)
     
     scene_ = newScene;
     sceneLoaded_ = false;
+    relevantNodes_.Clear();
+    relevanceActive_ = false;
+    snapshotNodes_.Clear();
+    snapshotActive_ = false;
+    sentSnapshotID_ = 0;
+    ackedSnapshotID_ = 0;
+    receiveSnapshotID_ = 0;
+    appliedSnapshotID_ = 0;
+    resendSnapshotID_ = 0;
+    joinSnapshotData_.Clear();
     UnsubscribeFromEvent(E_ASYNCLOADFINISHED);
     
     if (!scene_)
@@ -225,6 +419,16 @@ void Connection::SetRotation(const Quaternion& rotation)
         sendMode_ = OPSM_POSITION_ROTATION;
 }
 
+void Connection::SetRelevanceDistance(float distance)
+{
+    relevanceDistance_ = Max(distance, 0.0f);
+}
+
+void Connection::SetSnapshotReplication(bool enable)
+{
+    snapshotReplication_ = enable;
+}
+
 void Connection::SetConnectPending(bool connectPending)
 {
     connectPending_ = connectPending;
@@ -235,21 +439,44 @@ void Connection::SetLogStatistics(bool enable)
     logStatistics_ = enable;
 }
 
+void Connection::SetTrackStatistics(bool enable)
+{
+    trackStatistics_ = enable;
+    if (!enable)
+    {
+        statistics_.Clear();
+        lastStatistics_.Clear();
+    }
+}
+
 void Connection::Disconnect(int waitMSec)
 {
-    connection_->Disconnect(waitMSec);
+    transport_->Disconnect(waitMSec);
 }
 
-void Connection::SendServerUpdate()
+void Connection::PrepareServerUpdate(const RelevanceGrid* relevanceGrid, const JoinSnapshot* joinSnapshot)
 {
     if (!scene_ || !sceneLoaded_)
         return;
     
-    // Always check the root node (scene) first so that the scene-wide components get sent first,
-    // and all other replicated nodes get added to the dirty set for sending the initial state
+    HiresTimer serializationTimer;
+    
+    UpdateRelevance(relevanceGrid);
+    UpdateSnapshotState();
+    
     unsigned sceneID = scene_->GetID();
-    nodesToProcess_.Insert(sceneID);
-    ProcessNode(sceneID);
+    if (joinSnapshot && !relevanceActive_ && sceneState_.nodeStates_.Empty())
+    {
+        // The client has just loaded the scene: send the whole replicated state at once from the shared join snapshot
+        QueueJoinSnapshot(joinSnapshot);
+    }
+    else
+    {
+        // Always check the root node (scene) first so that the scene-wide components get sent first,
+        // and all other replicated nodes get added to the dirty set for sending the initial state
+        nodesToProcess_.Insert(sceneID);
+        ProcessNode(sceneID);
+    }
     
     // Then go through all dirtied nodes
     nodesToProcess_.Insert(sceneState_.dirtyNodes_);
@@ -260,6 +487,86 @@ void Connection::SendServerUpdate()
         unsigned nodeID = nodesToProcess_.Front();
         ProcessNode(nodeID);
     }
+    
+    // Tell the client which snapshot the resent changes bring it up to. Snapshots delta-compressed against it are held back
+    // until this arrives, so that the late reliable delta updates can not overwrite newer snapshot data
+    if (snapshotResend_)
+    {
+        msg_.Clear();
+        msg_.WriteUInt(scene_->GetSnapshotID());
+        QueueMessage(MSG_SNAPSHOTRESEND, true, true, msg_);
+    }
+    
+    if (snapshotActive_)
+        QueueSnapshot();
+    
+    if (trackStatistics_)
+    {
+        statistics_.serializationTime_ += serializationTimer.GetUSec(false);
+        ++statistics_.numUpdates_;
+    }
+}
+
+void Connection::SendServerUpdate()
+{
+    // Register the replication states created during the update. This modifies the nodes and components, so is not done
+    // while serializing. Use the Node base implementation also for the scene: its replicated nodes were already marked dirty
+    // while preparing the update (or sent in a join snapshot), and Scene::AddReplicationState would mark them all again
+    for (PODVector<Pair<NodeReplicationState*, Node*> >::ConstIterator i = newNodeStates_.Begin(); i != newNodeStates_.End(); ++i)
+    {
+        i->first_->node_ = i->second_;
+        i->second_->Node::AddReplicationState(i->first_);
+    }
+    for (PODVector<Pair<ComponentReplicationState*, Component*> >::ConstIterator i = newComponentStates_.Begin();
+        i != newComponentStates_.End(); ++i)
+    {
+        i->first_->component_ = i->second_;
+        i->second_->AddReplicationState(i->first_);
+    }
+    
+    // Unregister and remove the replication states of nodes that are no longer relevant
+    for (PODVector<unsigned>::ConstIterator i = irrelevantNodes_.Begin(); i != irrelevantNodes_.End(); ++i)
+    {
+        HashMap<unsigned, NodeReplicationState>::Iterator j = sceneState_.nodeStates_.Find(*i);
+        if (j == sceneState_.nodeStates_.End())
+            continue;
+        
+        NodeReplicationState& nodeState = j->second_;
+        Node* node = nodeState.node_;
+        if (node)
+            node->RemoveReplicationState(&nodeState);
+        for (HashMap<unsigned, ComponentReplicationState>::Iterator k = nodeState.componentStates_.Begin();
+            k != nodeState.componentStates_.End(); ++k)
+        {
+            Component* component = k->second_.component_;
+            if (component)
+                component->RemoveReplicationState(&k->second_);
+        }
+        
+        sceneState_.nodeStates_.Erase(j);
+    }
+    
+    // Erase the replication states of removed nodes and components. This destroys their weak pointers, which share the
+    // reference count with the other connections, so is not done while serializing
+    for (PODVector<unsigned>::ConstIterator i = removedNodes_.Begin(); i != removedNodes_.End(); ++i)
+        sceneState_.nodeStates_.Erase(*i);
+    for (PODVector<Pair<unsigned, unsigned> >::ConstIterator i = removedComponents_.Begin(); i != removedComponents_.End(); ++i)
+    {
+        HashMap<unsigned, NodeReplicationState>::Iterator j = sceneState_.nodeStates_.Find(i->first_);
+        if (j != sceneState_.nodeStates_.End())
+            j->second_.componentStates_.Erase(i->second_);
+    }
+    
+    for (PODVector<QueuedMessage>::ConstIterator i = queuedMessages_.Begin(); i != queuedMessages_.End(); ++i)
+        SendMessage(i->msgID_, i->reliable_, i->inOrder_, queuedData_.GetData() + i->offset_, i->size_, i->contentID_);
+    
+    newNodeStates_.Clear();
+    newComponentStates_.Clear();
+    irrelevantNodes_.Clear();
+    removedNodes_.Clear();
+    removedComponents_.Clear();
+    queuedMessages_.Clear();
+    queuedData_.Clear();
 }
 
 void Connection::SendClientUpdate()
@@ -268,6 +575,7 @@ void Connection::SendClientUpdate()
         return;
     
     msg_.Clear();
+    msg_.WriteUInt(++controlsSequence_);
     msg_.WriteUInt(controls_.buttons_);
     msg_.WriteFloat(controls_.yaw_);
     msg_.WriteFloat(controls_.pitch_);
@@ -281,16 +589,27 @@ void Connection::SendClientUpdate()
 
 void Connection::SendRemoteEvents()
 {
-    #ifdef URHO3D_LOGGING
-    if (logStatistics_ && statsTimer_.GetMSec(false) > STATS_INTERVAL_MSEC)
+    if (statsTimer_.GetMSec(false) > STATS_INTERVAL_MSEC)
     {
-        statsTimer_.Reset();
-        char statsBuffer[256];
-        sprintf(statsBuffer, "RTT %.3f ms Pkt in %d Pkt out %d Data in %.3f KB/s Data out %.3f KB/s", connection_->RoundTripTime(), (int)connection_->PacketsInPerSec(),
-            (int)connection_->PacketsOutPerSec(), connection_->BytesInPerSec() / 1000.0f, connection_->BytesOutPerSec() / 1000.0f);
-        LOGINFO(statsBuffer);
+        float interval = statsTimer_.GetMSec(true) / 1000.0f;
+        
+        if (trackStatistics_)
+        {
+            statistics_.interval_ = interval;
+            lastStatistics_ = statistics_;
+            statistics_.Clear();
+        }
+        
+        #ifdef URHO3D_LOGGING
+        if (logStatistics_ && connection_)
+        {
+            char statsBuffer[256];
+            sprintf(statsBuffer, "RTT %.3f ms Pkt in %d Pkt out %d Data in %.3f KB/s Data out %.3f KB/s", connection_->RoundTripTime(), (int)connection_->PacketsInPerSec(),
+                (int)connection_->PacketsOutPerSec(), connection_->BytesInPerSec() / 1000.0f, connection_->BytesOutPerSec() / 1000.0f);
+            LOGINFO(statsBuffer);
+        }
+        #endif
     }
-    #endif
     
     if (remoteEvents_.Empty())
         return;
@@ -320,7 +639,8 @@ void Connection::SendRemoteEvents()
 
 void Connection::SendPackages()
 {
-    while (!uploads_.Empty() && connection_->NumOutboundMessagesPending() < 1000)
+    // Keep sending fragments as long as the outbound queue is below the window, so that the transfer stays pipelined
+    while (!uploads_.Empty() && transport_->GetNumPendingMessages() < PACKAGE_SEND_WINDOW)
     {
         unsigned char buffer[PACKAGE_FRAGMENT_SIZE];
         
@@ -328,17 +648,22 @@ void Connection::SendPackages()
         {
             HashMap<StringHash, PackageUpload>::Iterator current = i++;
             PackageUpload& upload = current->second_;
-            unsigned fragmentSize = Min((int)(upload.file_->GetSize() - upload.file_->GetPosition()), (int)PACKAGE_FRAGMENT_SIZE);
+            unsigned index = upload.fragments_[upload.fragment_++];
+            unsigned offset = index * PACKAGE_FRAGMENT_SIZE;
+            unsigned fragmentSize = GetFragmentSize(index, upload.file_->GetSize());
+            if (upload.file_->GetPosition() != offset)
+                upload.file_->Seek(offset);
             upload.file_->Read(buffer, fragmentSize);
             
             msg_.Clear();
             msg_.WriteStringHash(current->first_);
-            msg_.WriteUInt(upload.fragment_++);
+            msg_.WriteUInt(index);
+            msg_.WriteUInt(GetFragmentChecksum(buffer, fragmentSize));
             msg_.Write(buffer, fragmentSize);
             SendMessage(MSG_PACKAGEDATA, true, false, msg_);
             
             // Check if upload finished
-            if (upload.fragment_ == upload.totalFragments_)
+            if (upload.fragment_ == upload.fragments_.Size())
                 uploads_.Erase(current);
         }
     }
@@ -358,6 +683,8 @@ void Connection::ProcessPendingLatestData()
         {
             MemoryBuffer msg(current->second_);
             msg.ReadNetID(); // Skip the node ID
+            if (ReadUpdateHeader(msg))
+                reconcileNodes_.Insert(current->first_);
             node->ReadLatestDataUpdate(msg);
             // ApplyAttributes() is deliberately skipped, as Node has no attributes that require late applying.
             // Furthermore it would propagate to components and child nodes, which is not desired in this case
@@ -374,6 +701,8 @@ void Connection::ProcessPendingLatestData()
         {
             MemoryBuffer msg(current->second_);
             msg.ReadNetID(); // Skip the component ID
+            if (ReadUpdateHeader(msg))
+                reconcileNodes_.Insert(component->GetNode()->GetID());
             component->ReadLatestDataUpdate(msg);
             component->ApplyAttributes();
             componentLatestData_.Erase(current);
@@ -427,6 +756,22 @@ bool Connection::ProcessMessage(int msgID, MemoryBuffer &msg)
         case MSG_REMOTENODEEVENT:
             ProcessRemoteEvent(msgID, msg);
             break;
+            
+        case MSG_SNAPSHOT:
+            ProcessSnapshot(msgID, msg);
+            break;
+            
+        case MSG_SNAPSHOTACK:
+            ProcessSnapshotAck(msgID, msg);
+            break;
+            
+        case MSG_JOINSNAPSHOT:
+            ProcessJoinSnapshot(msgID, msg);
+            break;
+            
+        case MSG_SNAPSHOTRESEND:
+            ProcessSnapshotResend(msgID, msg);
+            break;
 
         case MSG_PACKAGEINFO:
             ProcessPackageInfo(msgID, msg);
@@ -461,6 +806,11 @@ void Connection::ProcessLoadScene(int msgID, MemoryBuffer& msg)
     nodeLatestData_.Clear();
     componentLatestData_.Clear();
     downloads_.Clear();
+    receiveSnapshotID_ = 0;
+    appliedSnapshotID_ = 0;
+    resendSnapshotID_ = 0;
+    reconcileNodes_.Clear();
+    serverTimeValid_ = false;
     
     // In case we have joined other scenes in this session, remove first all downloaded package files from the resource system
     // to prevent resource conflicts
@@ -520,7 +870,8 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             unsigned nodeID = msg.ReadNetID();
             // In case of the root node (scene), it should already exist. Do not create in that case
             Node* node = scene_->GetNode(nodeID);
-            if (!node)
+            bool newNode = !node;
+            if (newNode)
             {
                 // Add initially to the root level. May be moved as we receive the parent attribute
                 node = scene_->CreateChild(nodeID, REPLICATED);
@@ -534,6 +885,13 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             if (transform)
                 transform->Update(1.0f, 0.0f);
             
+            // If the scene uses interpolation, further transform updates are buffered and played back with a delay
+            if (newNode && scene_->GetInterpolationDelay() > 0.0f)
+            {
+                InterpolatedTransform* interpolated = node->CreateComponent<InterpolatedTransform>(LOCAL);
+                interpolated->SetDelay(scene_->GetInterpolationDelay());
+            }
+            
             // Read initial user variables
             unsigned numVars = msg.ReadVLE();
             while (numVars)
@@ -603,6 +961,8 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             Node* node = scene_->GetNode(nodeID);
             if (node)
             {
+                if (ReadUpdateHeader(msg))
+                    reconcileNodes_.Insert(nodeID);
                 node->ReadLatestDataUpdate(msg);
                 // ApplyAttributes() is deliberately skipped, as Node has no attributes that require late applying.
                 // Furthermore it would propagate to components and child nodes, which is not desired in this case
@@ -681,6 +1041,8 @@ void Connection::ProcessSceneUpdate(int msgID, MemoryBuffer& msg)
             Component* component = scene_->GetComponent(componentID);
             if (component)
             {
+                if (ReadUpdateHeader(msg))
+                    reconcileNodes_.Insert(component->GetNode()->GetID());
                 component->ReadLatestDataUpdate(msg);
                 component->ApplyAttributes();
             }
@@ -736,27 +1098,41 @@ void Connection::ProcessPackageDownload(int msgID, MemoryBuffer& msg)
                 {
                     StringHash nameHash(name);
                     
-                    // Do not restart upload if already exists
-                    if (uploads_.Contains(nameHash))
+                    // If the upload is already in transfer, the client is requesting fragments again, so add to it
+                    HashMap<StringHash, PackageUpload>::Iterator j = uploads_.Find(nameHash);
+                    if (j == uploads_.End())
                     {
-                        LOGWARNING("Received a request for package " + name + " already in transfer");
-                        return;
+                        // Try to open the file now
+                        SharedPtr<File> file(new File(context_, packageFullName));
+                        if (!file->IsOpen())
+                        {
+                            LOGERROR("Failed to transmit package file " + name);
+                            SendPackageError(name);
+                            return;
+                        }
+                        
+                        LOGINFO("Transmitting package file " + name + " to client " + ToString());
+                        
+                        j = uploads_.Insert(MakePair(nameHash, PackageUpload()));
+                        j->second_.file_ = file;
+                        j->second_.totalFragments_ = (file->GetSize() + PACKAGE_FRAGMENT_SIZE - 1) / PACKAGE_FRAGMENT_SIZE;
                     }
                     
-                    // Try to open the file now
-                    SharedPtr<File> file(new File(context_, packageFullName));
-                    if (!file->IsOpen())
+                    PackageUpload& upload = j->second_;
+                    unsigned numRanges = msg.ReadVLE();
+                    for (unsigned k = 0; k < numRanges; ++k)
                     {
-                        LOGERROR("Failed to transmit package file " + name);
-                        SendPackageError(name);
-                        return;
+                        unsigned start = msg.ReadVLE();
+                        unsigned end = (unsigned)Min((int)(start + msg.ReadVLE()), (int)upload.totalFragments_);
+                        for (unsigned index = start; index < end; ++index)
+                            upload.fragments_.Push(index);
                     }
                     
-                    LOGINFO("Transmitting package file " + name + " to client " + ToString());
-                    
-                    uploads_[nameHash].file_ = file;
-                    uploads_[nameHash].fragment_ = 0;
-                    uploads_[nameHash].totalFragments_ = (file->GetSize() + PACKAGE_FRAGMENT_SIZE - 1) / PACKAGE_FRAGMENT_SIZE;
+                    if (upload.fragment_ == upload.fragments_.Size())
+                    {
+                        LOGWARNING("Received a request for package " + name + " without any fragments");
+                        uploads_.Erase(j);
+                    }
                     return;
                 }
             }
@@ -793,52 +1169,43 @@ void Connection::ProcessPackageDownload(int msgID, MemoryBuffer& msg)
                 return;
             }
             
-            // If file has not yet been opened, try to open now. Prepend the checksum to the filename to allow multiple versions
-            if (!download.file_)
-            {
-                download.file_ = new File(context_, GetSubsystem<Network>()->GetPackageCacheDir() + ToStringHex(download.checksum_) + "_" + download.name_, FILE_WRITE);
-                if (!download.file_->IsOpen())
-                {
-                    OnPackageDownloadFailed(download.name_);
-                    return;
-                }
-            }
+            // Data for a download that has not been requested, or has already been received in full, is disregarded
+            if (!download.file_ || download.numReceivedFragments_ == download.totalFragments_)
+                return;
             
-            // Write the fragment data to the proper index
-            unsigned char buffer[PACKAGE_FRAGMENT_SIZE];
             unsigned index = msg.ReadUInt();
+            unsigned checksum = msg.ReadUInt();
             unsigned fragmentSize = msg.GetSize() - msg.GetPosition();
+            const unsigned char* data = msg.GetData() + msg.GetPosition();
+            if (index >= download.totalFragments_ || fragmentSize != GetFragmentSize(index, download.fileSize_))
+            {
+                LOGWARNING("Received invalid fragment of package " + download.name_);
+                return;
+            }
+            if (download.receivedFragments_[index >> 3] & (1 << (index & 7)))
+                return;
             
-            msg.Read(buffer, fragmentSize);
-            download.file_->Seek(index * PACKAGE_FRAGMENT_SIZE);
-            download.file_->Write(buffer, fragmentSize);
-            download.receivedFragments_.Insert(index);
-            
-            // Check if all fragments received
-            if (download.receivedFragments_.Size() == download.totalFragments_)
+            // Request a corrupted fragment again instead of restarting the whole download
+            if (GetFragmentChecksum(data, fragmentSize) != checksum)
             {
-                LOGINFO("Package " + download.name_ + " downloaded successfully");
-                
-                // Instantiate the package and add to the resource system, as we will need it to load the scene
-                download.file_->Close();
-                SharedPtr<PackageFile> newPackage(new PackageFile(context_, download.file_->GetName()));
-                GetSubsystem<ResourceCache>()->AddPackageFile(newPackage, true);
-                
-                // Then start the next download if there are more
-                downloads_.Erase(i);
-                if (downloads_.Empty())
-                    OnPackagesReady();
-                else
-                {
-                    PackageDownload& nextDownload = downloads_.Begin()->second_;
-                    
-                    LOGINFO("Requesting package " + nextDownload.name_ + " from server");
-                    msg_.Clear();
-                    msg_.WriteString(nextDownload.name_);
-                    SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
-                    nextDownload.initiated_ = true;
-                }
+                LOGWARNING("Checksum mismatch in fragment " + String(index) + " of package " + download.name_ +
+                    ", requesting it again");
+                PODVector<unsigned> ranges;
+                ranges.Push(index);
+                ranges.Push(1);
+                RequestFragments(download.name_, ranges);
+                return;
             }
+            
+            // Queue the fragment to be written to the file in the background
+            download.receivedFragments_[index >> 3] |= 1 << (index & 7);
+            ++download.numReceivedFragments_;
+            download.pendingFragments_.Push(index);
+            download.pendingData_.Write(data, fragmentSize);
+            
+            // When all fragments are received, request the next package while this one is still being written
+            if (download.numReceivedFragments_ == download.totalFragments_)
+                StartNextDownload();
         }
         break;
     }
@@ -866,6 +1233,238 @@ void Connection::ProcessIdentity(int msgID, MemoryBuffer& msg)
         Disconnect();
 }
 
+void Connection::ProcessSnapshot(int msgID, MemoryBuffer& msg)
+{
+    if (IsClient())
+    {
+        LOGWARNING("Received unexpected Snapshot message from client " + ToString());
+        return;
+    }
+    
+    if (!scene_)
+        return;
+    
+    unsigned snapshotID = msg.ReadUInt();
+    unsigned baseSnapshotID = msg.ReadUInt();
+    unsigned numParts = msg.ReadVLE();
+    ReadUpdateHeader(msg);
+    
+    // Parts of snapshots older than the one being received, or than the applied state, would overwrite newer data, so ignore
+    // them. Snapshots delta-compressed against resent changes that have not arrived yet can not be applied either. They are
+    // not acknowledged, so the server keeps sending the changes
+    unsigned currentSnapshotID = resendSnapshotID_ > appliedSnapshotID_ ? resendSnapshotID_ : appliedSnapshotID_;
+    if (snapshotID <= currentSnapshotID || snapshotID < receiveSnapshotID_ || baseSnapshotID > currentSnapshotID)
+        return;
+    if (snapshotID != receiveSnapshotID_)
+    {
+        receiveSnapshotID_ = snapshotID;
+        receivedSnapshotParts_ = 0;
+        snapshotComplete_ = true;
+    }
+    ++receivedSnapshotParts_;
+    
+    while (!msg.IsEof())
+    {
+        unsigned size = msg.ReadVLE();
+        unsigned next = msg.GetPosition() + size;
+        unsigned char flags = msg.ReadUByte();
+        unsigned id = msg.ReadNetID();
+        
+        // Entries for nodes or components that have not been created yet are skipped
+        if (!(flags & SNAPSHOT_COMPONENT))
+        {
+            Node* node = scene_->GetNode(id);
+            if (node)
+            {
+                node->ReadDeltaUpdate(msg);
+                if (flags & SNAPSHOT_OWNED)
+                    reconcileNodes_.Insert(id);
+            }
+            else
+                snapshotComplete_ = false;
+        }
+        else
+        {
+            Component* component = scene_->GetComponent(id);
+            if (component)
+            {
+                component->ReadDeltaUpdate(msg);
+                component->ApplyAttributes();
+                if (flags & SNAPSHOT_OWNED)
+                    reconcileNodes_.Insert(component->GetNode()->GetID());
+            }
+            else
+                snapshotComplete_ = false;
+        }
+        
+        msg.Seek(next);
+    }
+    
+    // Acknowledge only when the whole snapshot has been applied, so that the server can delta-compress against it
+    if (receivedSnapshotParts_ == numParts && snapshotComplete_)
+    {
+        appliedSnapshotID_ = snapshotID;
+        msg_.Clear();
+        msg_.WriteUInt(snapshotID);
+        SendMessage(MSG_SNAPSHOTACK, false, false, msg_, SNAPSHOTACK_CONTENT_ID);
+    }
+}
+
+void Connection::ProcessJoinSnapshot(int msgID, MemoryBuffer& msg)
+{
+    if (IsClient())
+    {
+        LOGWARNING("Received unexpected JoinSnapshot message from client " + ToString());
+        return;
+    }
+    
+    if (!scene_)
+        return;
+    
+    // The parts arrive in order, so append until the whole compressed data has been received
+    unsigned size = msg.ReadVLE();
+    unsigned partSize = msg.GetSize() - msg.GetPosition();
+    if (joinSnapshotData_.GetSize() + partSize > size)
+    {
+        LOGERROR("Received invalid JoinSnapshot message");
+        joinSnapshotData_.Clear();
+        return;
+    }
+    joinSnapshotData_.Write(msg.GetData() + msg.GetPosition(), partSize);
+    if (joinSnapshotData_.GetSize() < size)
+        return;
+    
+    VectorBuffer entries;
+    joinSnapshotData_.Seek(0);
+    bool success = DecompressStream(entries, joinSnapshotData_);
+    joinSnapshotData_.Clear();
+    if (!success)
+    {
+        LOGERROR("Failed to decompress join snapshot");
+        return;
+    }
+    
+    // Each entry has the same layout as a CreateNode message
+    MemoryBuffer buffer(entries.GetData(), entries.GetSize());
+    while (!buffer.IsEof())
+    {
+        unsigned entrySize = buffer.ReadVLE();
+        if (entrySize > buffer.GetSize() - buffer.GetPosition())
+        {
+            LOGERROR("Received invalid JoinSnapshot entry");
+            return;
+        }
+        MemoryBuffer entry(buffer.GetData() + buffer.GetPosition(), entrySize);
+        ProcessSceneUpdate(MSG_CREATENODE, entry);
+        buffer.Seek(buffer.GetPosition() + entrySize);
+    }
+}
+
+void Connection::SendServerStateEvents()
+{
+    if (!scene_ || reconcileNodes_.Empty())
+        return;
+    
+    using namespace ServerStateApplied;
+    
+    VariantMap& eventData = GetEventDataMap();
+    for (HashSet<unsigned>::ConstIterator i = reconcileNodes_.Begin(); i != reconcileNodes_.End(); ++i)
+    {
+        Node* node = scene_->GetNode(*i);
+        if (node)
+        {
+            eventData[P_CONNECTION] = this;
+            eventData[P_NODE] = node;
+            eventData[P_CONTROLSSEQUENCE] = ackedControlsSequence_;
+            SendEvent(E_SERVERSTATEAPPLIED, eventData);
+        }
+    }
+    
+    reconcileNodes_.Clear();
+}
+
+void Connection::WriteUpdateHeader(Serializer& dest, bool sendControlsSequence)
+{
+    // Write the server time as a 31-bit millisecond timestamp, with the top bit telling whether the sequence number of the
+    // latest applied client controls follows. The timestamp wraps only after 24 days, so the client can unwrap it
+    // regardless of how long there have been no updates
+    unsigned timeStamp = (unsigned)(scene_->GetNetworkTime() * 1000.0 + 0.5) & TIMESTAMP_MASK;
+    if (sendControlsSequence)
+    {
+        dest.WriteUInt(timeStamp | CONTROLS_SEQUENCE_FLAG);
+        dest.WriteUShort((unsigned short)controlsSequence_);
+    }
+    else
+        dest.WriteUInt(timeStamp);
+}
+
+bool Connection::ReadUpdateHeader(MemoryBuffer& msg)
+{
+    unsigned timeStamp = msg.ReadUInt();
+    bool hasControlsSequence = (timeStamp & CONTROLS_SEQUENCE_FLAG) != 0;
+    timeStamp &= TIMESTAMP_MASK;
+    
+    if (!serverTimeValid_)
+    {
+        serverTime_ = 0.0;
+        serverTimeStamp_ = timeStamp;
+        serverTimeValid_ = true;
+    }
+    
+    // Unwrap the timestamp relative to the latest received. Updates may arrive out of order, so the difference can be negative
+    unsigned difference = (timeStamp - serverTimeStamp_) & TIMESTAMP_MASK;
+    int delta = difference > (TIMESTAMP_MASK >> 1) ? -(int)(TIMESTAMP_MASK - difference + 1) : (int)difference;
+    double time = serverTime_ + delta * 0.001;
+    if (delta > 0)
+    {
+        serverTime_ = time;
+        serverTimeStamp_ = timeStamp;
+    }
+    scene_->SetNetworkTime(time);
+    
+    if (hasControlsSequence)
+    {
+        // The acknowledged sequence number can not be newer than the latest sent, so reconstruct it from the difference
+        unsigned short sequence = msg.ReadUShort();
+        unsigned acked = controlsSequence_ - (unsigned short)((unsigned short)controlsSequence_ - sequence);
+        if ((int)(acked - ackedControlsSequence_) > 0)
+            ackedControlsSequence_ = acked;
+    }
+    
+    return hasControlsSequence;
+}
+
+void Connection::ProcessSnapshotResend(int msgID, MemoryBuffer& msg)
+{
+    if (IsClient())
+    {
+        LOGWARNING("Received unexpected SnapshotResend message from client " + ToString());
+        return;
+    }
+    
+    // The resent delta updates were sent reliably in order before this message, so they have all been applied now
+    unsigned snapshotID = msg.ReadUInt();
+    if (snapshotID > resendSnapshotID_)
+        resendSnapshotID_ = snapshotID;
+}
+
+void Connection::ProcessSnapshotAck(int msgID, MemoryBuffer& msg)
+{
+    if (!IsClient())
+    {
+        LOGWARNING("Received unexpected SnapshotAck message from server");
+        return;
+    }
+    
+    // Acknowledgements may arrive out of order, and can not refer to a snapshot that has not been sent
+    unsigned snapshotID = msg.ReadUInt();
+    if (snapshotID > ackedSnapshotID_ && snapshotID <= sentSnapshotID_)
+    {
+        ackedSnapshotID_ = snapshotID;
+        snapshotAckTimer_.Reset();
+    }
+}
+
 void Connection::ProcessControls(int msgID, MemoryBuffer& msg)
 {
     if (!IsClient())
@@ -874,6 +1473,7 @@ void Connection::ProcessControls(int msgID, MemoryBuffer& msg)
         return;
     }
     
+    controlsSequence_ = msg.ReadUInt();
     Controls newControls;
     newControls.buttons_ = msg.ReadUInt();
     newControls.yaw_ = msg.ReadFloat();
@@ -973,6 +1573,11 @@ kNet::MessageConnection* Connection::GetMessageConnection() const
     return const_cast<kNet::MessageConnection*>(connection_.ptr());
 }
 
+SimulatedLink* Connection::GetSimulatedLink() const
+{
+    return link_;
+}
+
 Scene* Connection::GetScene() const
 {
     return scene_;
@@ -980,7 +1585,7 @@ Scene* Connection::GetScene() const
 
 bool Connection::IsConnected() const
 {
-    return connection_->GetConnectionState() == kNet::ConnectionOK;
+    return transport_->IsConnected();
 }
 
 String Connection::ToString() const
@@ -1008,7 +1613,7 @@ float Connection::GetDownloadProgress() const
     for (HashMap<StringHash, PackageDownload>::ConstIterator i = downloads_.Begin(); i != downloads_.End(); ++i)
     {
         if (i->second_.initiated_)
-            return (float)i->second_.receivedFragments_.Size() / (float)i->second_.totalFragments_;
+            return (float)i->second_.numReceivedFragments_ / (float)i->second_.totalFragments_;
     }
     return 1.0f;
 }
@@ -1042,9 +1647,11 @@ void Connection::ProcessNode(unsigned nodeID)
             // Note: we will send MSG_REMOVENODE redundantly for each node in the hierarchy, even if removing the root node
             // would be enough. However, this may be better due to the client not possibly having updated parenting
             // information at the time of receiving this message
-            SendMessage(MSG_REMOVENODE, true, true, msg_);
-            sceneState_.nodeStates_.Erase(nodeID);
+            QueueMessage(MSG_REMOVENODE, true, true, msg_);
+            removedNodes_.Push(nodeID);
         }
+        else if (!IsRelevant(node))
+            RemoveIrrelevantNode(nodeID, i->second_);
         else
             ProcessExistingNode(node, i->second_);
     }
@@ -1052,16 +1659,312 @@ void Connection::ProcessNode(unsigned nodeID)
     {
         // Replication state not found: this is a new node
         Node* node = scene_->GetNode(nodeID);
-        if (node)
+        if (node && IsRelevant(node))
             ProcessNewNode(node);
         else
         {
-            // Did not find the new node (may have been created, then removed immediately): erase from dirty set.
+            // Did not find the new node (may have been created, then removed immediately), or it is not relevant to the
+            // client: erase from dirty set
             sceneState_.dirtyNodes_.Erase(nodeID);
         }
     }
 }
 
+void Connection::UpdateRelevance(const RelevanceGrid* relevanceGrid)
+{
+    bool active = relevanceDistance_ > 0.0f && relevanceGrid;
+    
+    // When relevance is switched on or off, all nodes need to be checked
+    if (active != relevanceActive_)
+    {
+        relevanceActive_ = active;
+        relevantNodes_.Clear();
+        
+        const Vector<SharedPtr<Node> >& children = scene_->GetChildren();
+        for (Vector<SharedPtr<Node> >::ConstIterator i = children.Begin(); i != children.End(); ++i)
+            MarkHierarchyDirty(*i);
+    }
+    
+    if (!active)
+        return;
+    
+    // Nodes become relevant within the relevance distance, but are dropped only beyond the hysteresis distance, to avoid
+    // repeatedly removing and recreating nodes at the border
+    relevanceGrid->GetNodes(relevanceQueryResult_, position_, relevanceDistance_ * RELEVANCE_HYSTERESIS);
+    newRelevantNodes_.Clear();
+    float distanceSquared = relevanceDistance_ * relevanceDistance_;
+    
+    for (PODVector<const RelevanceGridEntry*>::ConstIterator i = relevanceQueryResult_.Begin(); i != relevanceQueryResult_.End(); ++i)
+    {
+        const RelevanceGridEntry* entry = *i;
+        unsigned nodeID = entry->node_->GetID();
+        bool wasRelevant = relevantNodes_.Contains(nodeID);
+        
+        if (wasRelevant || (entry->position_ - position_).LengthSquared() <= distanceSquared)
+        {
+            newRelevantNodes_.Insert(nodeID);
+            if (!wasRelevant)
+                MarkHierarchyDirty(entry->node_);
+        }
+    }
+    
+    for (HashSet<unsigned>::ConstIterator i = relevantNodes_.Begin(); i != relevantNodes_.End(); ++i)
+    {
+        if (!newRelevantNodes_.Contains(*i))
+        {
+            Node* node = scene_->GetNode(*i);
+            if (node)
+                MarkHierarchyDirty(node);
+        }
+    }
+    
+    relevantNodes_.Swap(newRelevantNodes_);
+}
+
+void Connection::MarkHierarchyDirty(Node* node)
+{
+    if (node->GetID() < FIRST_LOCAL_ID)
+        sceneState_.dirtyNodes_.Insert(node->GetID());
+    
+    const Vector<SharedPtr<Node> >& children = node->GetChildren();
+    for (Vector<SharedPtr<Node> >::ConstIterator i = children.Begin(); i != children.End(); ++i)
+        MarkHierarchyDirty(*i);
+}
+
+bool Connection::IsRelevant(Node* node) const
+{
+    if (!relevanceActive_)
+        return true;
+    
+    // Relevance is decided by the top-level node of the hierarchy. Nodes owned by this connection are always relevant
+    Node* parent = node->GetParent();
+    while (parent && parent != scene_)
+    {
+        node = parent;
+        parent = node->GetParent();
+    }
+    
+    return !parent || node->GetOwner() == this || relevantNodes_.Contains(node->GetID());
+}
+
+void Connection::RemoveIrrelevantNode(unsigned nodeID, NodeReplicationState& nodeState)
+{
+    msg_.Clear();
+    msg_.WriteNetID(nodeID);
+    QueueMessage(MSG_REMOVENODE, true, true, msg_);
+    
+    // The replication state is still referenced by the node and its components, so it is removed when sending
+    irrelevantNodes_.Push(nodeID);
+    nodeState.markedDirty_ = false;
+    sceneState_.dirtyNodes_.Erase(nodeID);
+}
+
+void Connection::UpdateSnapshotState()
+{
+    snapshotResend_ = false;
+    
+    if (snapshotReplication_ != snapshotActive_)
+    {
+        snapshotActive_ = snapshotReplication_;
+        
+        if (snapshotActive_)
+        {
+            // The client's acknowledged state is not known yet, so check all nodes for attributes changed since the start
+            for (HashMap<unsigned, NodeReplicationState>::ConstIterator i = sceneState_.nodeStates_.Begin();
+                i != sceneState_.nodeStates_.End(); ++i)
+                sceneState_.dirtyNodes_.Insert(i->first_);
+        }
+        else
+        {
+            // Send the changes the client has not acknowledged as reliable delta updates instead
+            ResendSnapshotChanges();
+            snapshotResend_ = true;
+        }
+        
+        snapshotNodes_.Clear();
+        ackedSnapshotID_ = 0;
+    }
+    
+    if (!snapshotActive_)
+        return;
+    
+    // If the client has stopped acknowledging, the unacknowledged changes would be resent in every snapshot, and keep
+    // accumulating. Resend them once as reliable delta updates instead, and diff the following snapshots against the
+    // current state. The client applies those snapshots only after receiving the resend
+    if (sentSnapshotID_ > ackedSnapshotID_ && (sentSnapshotID_ - ackedSnapshotID_ > MAX_UNACKED_SNAPSHOTS ||
+        snapshotAckTimer_.GetMSec(false) > SNAPSHOT_ACK_TIMEOUT_MSEC))
+    {
+        ResendSnapshotChanges();
+        snapshotNodes_.Clear();
+        snapshotResend_ = true;
+        ackedSnapshotID_ = scene_->GetSnapshotID();
+        snapshotAckTimer_.Reset();
+        return;
+    }
+    
+    // Keep sending the changes the client has not acknowledged yet
+    for (HashSet<unsigned>::Iterator i = snapshotNodes_.Begin(); i != snapshotNodes_.End(); )
+    {
+        if (sceneState_.nodeStates_.Contains(*i))
+        {
+            sceneState_.dirtyNodes_.Insert(*i);
+            ++i;
+        }
+        else
+            i = snapshotNodes_.Erase(i);
+    }
+}
+
+void Connection::ResendSnapshotChanges()
+{
+    DirtyBits changedAttributes;
+    for (HashSet<unsigned>::ConstIterator i = snapshotNodes_.Begin(); i != snapshotNodes_.End(); ++i)
+    {
+        HashMap<unsigned, NodeReplicationState>::Iterator j = sceneState_.nodeStates_.Find(*i);
+        if (j == sceneState_.nodeStates_.End())
+            continue;
+        
+        NodeReplicationState& nodeState = j->second_;
+        Node* node = nodeState.node_;
+        if (node && node->GetNetworkChanges(changedAttributes, ackedSnapshotID_))
+            AddDirtyBits(nodeState.dirtyAttributes_, changedAttributes);
+        
+        for (HashMap<unsigned, ComponentReplicationState>::Iterator k = nodeState.componentStates_.Begin();
+            k != nodeState.componentStates_.End(); ++k)
+        {
+            Component* component = k->second_.component_;
+            if (component && component->GetNetworkChanges(changedAttributes, ackedSnapshotID_))
+                AddDirtyBits(k->second_.dirtyAttributes_, changedAttributes);
+        }
+        
+        sceneState_.dirtyNodes_.Insert(*i);
+    }
+}
+
+void Connection::WriteSnapshotEntries(Node* node, NodeReplicationState& nodeState)
+{
+    DirtyBits changedAttributes;
+    bool pending = false;
+    bool owned = node->GetOwner() == this;
+    
+    if (node->GetNetworkChanges(changedAttributes, ackedSnapshotID_))
+    {
+        msg_.Clear();
+        msg_.WriteUByte(owned ? SNAPSHOT_OWNED : 0);
+        msg_.WriteNetID(node->GetID());
+        node->WriteDeltaUpdate(msg_, changedAttributes);
+        AddSnapshotEntry(msg_);
+        AddObjectTraffic(node->GetType(), msg_.GetSize(), changedAttributes.Count());
+        pending = true;
+    }
+    
+    for (HashMap<unsigned, ComponentReplicationState>::ConstIterator i = nodeState.componentStates_.Begin();
+        i != nodeState.componentStates_.End(); ++i)
+    {
+        // Components created during this update are not registered yet, and their state is sent in full
+        Component* component = i->second_.component_;
+        if (component && component->GetNetworkChanges(changedAttributes, ackedSnapshotID_))
+        {
+            msg_.Clear();
+            msg_.WriteUByte(owned ? SNAPSHOT_COMPONENT | SNAPSHOT_OWNED : SNAPSHOT_COMPONENT);
+            msg_.WriteNetID(component->GetID());
+            component->WriteDeltaUpdate(msg_, changedAttributes);
+            AddSnapshotEntry(msg_);
+            AddObjectTraffic(component->GetType(), msg_.GetSize(), changedAttributes.Count());
+            pending = true;
+        }
+    }
+    
+    if (pending)
+        snapshotNodes_.Insert(node->GetID());
+    else
+        snapshotNodes_.Erase(node->GetID());
+}
+
+void Connection::AddSnapshotEntry(const VectorBuffer& entry)
+{
+    unsigned size = snapshotData_.GetSize();
+    if (snapshotParts_.Empty() || (size > snapshotParts_.Back() && size - snapshotParts_.Back() + entry.GetSize() >
+        SNAPSHOT_PART_SIZE))
+        snapshotParts_.Push(size);
+    
+    snapshotData_.WriteVLE(entry.GetSize());
+    snapshotData_.Write(entry.GetData(), entry.GetSize());
+}
+
+void Connection::QueueSnapshot()
+{
+    if (snapshotData_.GetSize())
+    {
+        unsigned snapshotID = scene_->GetSnapshotID();
+        unsigned numParts = snapshotParts_.Size();
+        
+        // Start timing the acknowledgement if there were no snapshots waiting for it
+        if (sentSnapshotID_ <= ackedSnapshotID_)
+            snapshotAckTimer_.Reset();
+        
+        for (unsigned i = 0; i < numParts; ++i)
+        {
+            unsigned start = snapshotParts_[i];
+            unsigned end = i + 1 < numParts ? snapshotParts_[i + 1] : snapshotData_.GetSize();
+            
+            msg_.Clear();
+            msg_.WriteUInt(snapshotID);
+            msg_.WriteUInt(ackedSnapshotID_);
+            msg_.WriteVLE(numParts);
+            WriteUpdateHeader(msg_, true);
+            msg_.Write(snapshotData_.GetData() + start, end - start);
+            QueueMessage(MSG_SNAPSHOT, false, false, msg_);
+        }
+        
+        sentSnapshotID_ = snapshotID;
+    }
+    
+    snapshotData_.Clear();
+    snapshotParts_.Clear();
+}
+
+void Connection::QueueJoinSnapshot(const JoinSnapshot* joinSnapshot)
+{
+    // The client will create all the nodes and components of the snapshot, so create their replication states now
+    const PODVector<Node*>& nodes = joinSnapshot->GetNodes();
+    for (PODVector<Node*>::ConstIterator i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Node* node = *i;
+        NodeReplicationState& nodeState = sceneState_.nodeStates_[node->GetID()];
+        nodeState.connection_ = this;
+        nodeState.sceneState_ = &sceneState_;
+        newNodeStates_.Push(MakePair(&nodeState, node));
+        
+        const Vector<SharedPtr<Component> >& components = node->GetComponents();
+        for (Vector<SharedPtr<Component> >::ConstIterator j = components.Begin(); j != components.End(); ++j)
+        {
+            Component* component = *j;
+            if (component->GetID() >= FIRST_LOCAL_ID)
+                continue;
+            
+            ComponentReplicationState& componentState = nodeState.componentStates_[component->GetID()];
+            componentState.connection_ = this;
+            componentState.nodeState_ = &nodeState;
+            newComponentStates_.Push(MakePair(&componentState, component));
+        }
+        
+        // The scene's replication state is registered without marking all nodes dirty again, see SendServerUpdate()
+        nodeState.markedDirty_ = false;
+        sceneState_.dirtyNodes_.Erase(node->GetID());
+    }
+    
+    const VectorBuffer& data = joinSnapshot->GetData();
+    unsigned size = data.GetSize();
+    for (unsigned start = 0; start < size; start += JOIN_SNAPSHOT_PART_SIZE)
+    {
+        msg_.Clear();
+        msg_.WriteVLE(size);
+        msg_.Write(data.GetData() + start, Min((int)(size - start), (int)JOIN_SNAPSHOT_PART_SIZE));
+        QueueMessage(MSG_JOINSNAPSHOT, true, true, msg_);
+    }
+}
+
 void Connection::ProcessNewNode(Node* node)
 {
     // Process depended upon nodes first, if they are dirty
@@ -1079,8 +1982,11 @@ void Connection::ProcessNewNode(Node* node)
     NodeReplicationState& nodeState = sceneState_.nodeStates_[node->GetID()];
     nodeState.connection_ = this;
     nodeState.sceneState_ = &sceneState_;
-    nodeState.node_ = node;
-    node->AddReplicationState(&nodeState);
+    newNodeStates_.Push(MakePair(&nodeState, node));
+    
+    // For a new connection, mark all replicated nodes dirty right away so that their initial state is sent in this update
+    if (node == scene_)
+        scene_->MarkAllReplicationDirty(sceneState_);
     
     // Write node's attributes
     node->WriteInitialDeltaUpdate(msg_);
@@ -1094,6 +2000,12 @@ void Connection::ProcessNewNode(Node* node)
         msg_.WriteVariant(i->second_);
     }
     
+    if (trackStatistics_)
+    {
+        const Vector<AttributeInfo>* attributes = node->GetNetworkAttributes();
+        AddObjectTraffic(node->GetType(), msg_.GetSize(), attributes ? attributes->Size() : 0);
+    }
+    
     // Write node's components
     msg_.WriteVLE(node->GetNumNetworkComponents());
     const Vector<SharedPtr<Component> >& components = node->GetComponents();
@@ -1107,15 +2019,21 @@ void Connection::ProcessNewNode(Node* node)
         ComponentReplicationState& componentState = nodeState.componentStates_[component->GetID()];
         componentState.connection_ = this;
         componentState.nodeState_ = &nodeState;
-        componentState.component_ = component;
-        component->AddReplicationState(&componentState);
+        newComponentStates_.Push(MakePair(&componentState, component));
         
+        unsigned start = msg_.GetSize();
         msg_.WriteStringHash(component->GetType());
         msg_.WriteNetID(component->GetID());
         component->WriteInitialDeltaUpdate(msg_);
+        
+        if (trackStatistics_)
+        {
+            const Vector<AttributeInfo>* attributes = component->GetNetworkAttributes();
+            AddObjectTraffic(component->GetType(), msg_.GetSize() - start, attributes ? attributes->Size() : 0);
+        }
     }
     
-    SendMessage(MSG_CREATENODE, true, true, msg_);
+    QueueMessage(MSG_CREATENODE, true, true, msg_);
     
     nodeState.markedDirty_ = false;
     sceneState_.dirtyNodes_.Erase(node->GetID());
@@ -1137,35 +2055,47 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
     NetworkPriority* priority = node->GetComponent<NetworkPriority>();
     if (priority && (!priority->GetAlwaysUpdateOwner() || node->GetOwner() != this))
     {
-        float distance = (node->GetWorldPosition() - position_).Length();
+        float distance = (GetWorldPositionNoUpdate(node) - position_).Length();
         if (!priority->CheckUpdate(distance, nodeState.priorityAcc_))
             return;
     }
     
+    // In snapshot mode attribute changes are sent in the snapshot, and only user variables use the reliable delta update,
+    // unless unacknowledged changes are being resent
+    if (snapshotActive_ && !snapshotResend_)
+    {
+        nodeState.dirtyAttributes_.ClearAll();
+        for (HashMap<unsigned, ComponentReplicationState>::Iterator i = nodeState.componentStates_.Begin();
+            i != nodeState.componentStates_.End(); ++i)
+            i->second_.dirtyAttributes_.ClearAll();
+    }
+    
     // Check if attributes have changed
     if (nodeState.dirtyAttributes_.Count() || nodeState.dirtyVars_.Size())
     {
         const Vector<AttributeInfo>* attributes = node->GetNetworkAttributes();
         unsigned numAttributes = attributes->Size();
-        bool hasLatestData = false;
+        unsigned numLatestData = 0;
         
         for (unsigned i = 0; i < numAttributes; ++i)
         {
             if (nodeState.dirtyAttributes_.IsSet(i) && (attributes->At(i).mode_ & AM_LATESTDATA))
             {
-                hasLatestData = true;
+                ++numLatestData;
                 nodeState.dirtyAttributes_.Clear(i);
             }
         }
         
         // Send latestdata message if necessary
-        if (hasLatestData)
+        if (numLatestData)
         {
             msg_.Clear();
             msg_.WriteNetID(node->GetID());
+            WriteUpdateHeader(msg_, node->GetOwner() == this);
             node->WriteLatestDataUpdate(msg_);
             
-            SendMessage(MSG_NODELATESTDATA, true, false, msg_, node->GetID());
+            QueueMessage(MSG_NODELATESTDATA, true, false, msg_, node->GetID());
+            AddObjectTraffic(node->GetType(), msg_.GetSize(), numLatestData);
         }
         
         // Send deltaupdate if remaining dirty bits, or vars have changed
@@ -1195,7 +2125,8 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 }
             }
             
-            SendMessage(MSG_NODEDELTAUPDATE, true, true, msg_);
+            QueueMessage(MSG_NODEDELTAUPDATE, true, true, msg_);
+            AddObjectTraffic(node->GetType(), msg_.GetSize(), nodeState.dirtyAttributes_.Count() + nodeState.dirtyVars_.Size());
             
             nodeState.dirtyAttributes_.ClearAll();
             nodeState.dirtyVars_.Clear();
@@ -1203,6 +2134,7 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
     }
     
     // Check for removed or changed components
+    unsigned numRemovedComponents = 0;
     for (HashMap<unsigned, ComponentReplicationState>::Iterator i = nodeState.componentStates_.Begin();
         i != nodeState.componentStates_.End(); )
     {
@@ -1211,12 +2143,13 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
         Component* component = componentState.component_;
         if (!component)
         {
-            // Removed component
+            // Removed component. Its replication state is erased when sending
             msg_.Clear();
             msg_.WriteNetID(current->first_);
             
-            SendMessage(MSG_REMOVECOMPONENT, true, true, msg_);
-            nodeState.componentStates_.Erase(current);
+            QueueMessage(MSG_REMOVECOMPONENT, true, true, msg_);
+            removedComponents_.Push(MakePair(node->GetID(), current->first_));
+            ++numRemovedComponents;
         }
         else
         {
@@ -1225,25 +2158,27 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
             {
                 const Vector<AttributeInfo>* attributes = component->GetNetworkAttributes();
                 unsigned numAttributes = attributes->Size();
-                bool hasLatestData = false;
+                unsigned numLatestData = 0;
                 
                 for (unsigned i = 0; i < numAttributes; ++i)
                 {
                     if (componentState.dirtyAttributes_.IsSet(i) && (attributes->At(i).mode_ & AM_LATESTDATA))
                     {
-                        hasLatestData = true;
+                        ++numLatestData;
                         componentState.dirtyAttributes_.Clear(i);
                     }
                 }
                 
                 // Send latestdata message if necessary
-                if (hasLatestData)
+                if (numLatestData)
                 {
                     msg_.Clear();
                     msg_.WriteNetID(component->GetID());
+                    WriteUpdateHeader(msg_, node->GetOwner() == this);
                     component->WriteLatestDataUpdate(msg_);
                     
-                    SendMessage(MSG_COMPONENTLATESTDATA, true, false, msg_, component->GetID());
+                    QueueMessage(MSG_COMPONENTLATESTDATA, true, false, msg_, component->GetID());
+                    AddObjectTraffic(component->GetType(), msg_.GetSize(), numLatestData);
                 }
                 
                 // Send deltaupdate if remaining dirty bits
@@ -1253,7 +2188,8 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                     msg_.WriteNetID(component->GetID());
                     component->WriteDeltaUpdate(msg_, componentState.dirtyAttributes_);
                     
-                    SendMessage(MSG_COMPONENTDELTAUPDATE, true, true, msg_);
+                    QueueMessage(MSG_COMPONENTDELTAUPDATE, true, true, msg_);
+                    AddObjectTraffic(component->GetType(), msg_.GetSize(), componentState.dirtyAttributes_.Count());
                     
                     componentState.dirtyAttributes_.ClearAll();
                 }
@@ -1261,8 +2197,11 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
         }
     }
     
+    if (snapshotActive_)
+        WriteSnapshotEntries(node, nodeState);
+    
     // Check for new components
-    if (nodeState.componentStates_.Size() != node->GetNumNetworkComponents())
+    if (nodeState.componentStates_.Size() - numRemovedComponents != node->GetNumNetworkComponents())
     {
         const Vector<SharedPtr<Component> >& components = node->GetComponents();
         for (unsigned i = 0; i < components.Size(); ++i)
@@ -1279,8 +2218,7 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 ComponentReplicationState& componentState = nodeState.componentStates_[component->GetID()];
                 componentState.connection_ = this;
                 componentState.nodeState_ = &nodeState;
-                componentState.component_ = component;
-                component->AddReplicationState(&componentState);
+                newComponentStates_.Push(MakePair(&componentState, component));
                 
                 msg_.Clear();
                 msg_.WriteNetID(node->GetID());
@@ -1288,7 +2226,12 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
                 msg_.WriteNetID(component->GetID());
                 component->WriteInitialDeltaUpdate(msg_);
                 
-                SendMessage(MSG_CREATECOMPONENT, true, true, msg_);
+                QueueMessage(MSG_CREATECOMPONENT, true, true, msg_);
+                if (trackStatistics_)
+                {
+                    const Vector<AttributeInfo>* attributes = component->GetNetworkAttributes();
+                    AddObjectTraffic(component->GetType(), msg_.GetSize(), attributes ? attributes->Size() : 0);
+                }
             }
         }
     }
@@ -1297,6 +2240,30 @@ void Connection::ProcessExistingNode(Node* node, NodeReplicationState& nodeState
     sceneState_.dirtyNodes_.Erase(node->GetID());
 }
 
+void Connection::QueueMessage(int msgID, bool reliable, bool inOrder, const VectorBuffer& msg, unsigned contentID)
+{
+    QueuedMessage queued;
+    queued.msgID_ = msgID;
+    queued.contentID_ = contentID;
+    queued.offset_ = queuedData_.GetSize();
+    queued.size_ = msg.GetSize();
+    queued.reliable_ = reliable;
+    queued.inOrder_ = inOrder;
+    queuedMessages_.Push(queued);
+    queuedData_.Write(msg.GetData(), msg.GetSize());
+}
+
+void Connection::AddObjectTraffic(StringHash type, unsigned bytes, unsigned attributes)
+{
+    if (!trackStatistics_)
+        return;
+    
+    NetworkTraffic& traffic = statistics_.objects_[type];
+    ++traffic.count_;
+    traffic.bytes_ += bytes;
+    traffic.attributes_ += attributes;
+}
+
 bool Connection::RequestNeededPackages(unsigned numPackages, MemoryBuffer& msg)
 {
     ResourceCache* cache = GetSubsystem<ResourceCache>();
@@ -1376,17 +2343,188 @@ void Connection::RequestPackage(const String& name, unsigned fileSize, unsigned
     
     PackageDownload& download = downloads_[nameHash];
     download.name_ = name;
+    download.fileSize_ = fileSize;
     download.totalFragments_ = (fileSize + PACKAGE_FRAGMENT_SIZE - 1) / PACKAGE_FRAGMENT_SIZE;
     download.checksum_ = checksum;
     
-    // Start download now only if no existing downloads, else wait for the existing ones to finish
-    if (downloads_.Size() == 1)
+    // Start download now only if the existing downloads have received all their data, else wait for them
+    for (HashMap<StringHash, PackageDownload>::ConstIterator i = downloads_.Begin(); i != downloads_.End(); ++i)
     {
-        LOGINFO("Requesting package " + name + " from server");
-        msg_.Clear();
-        msg_.WriteString(name);
-        SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
+        if (i->second_.initiated_ && i->second_.numReceivedFragments_ < i->second_.totalFragments_)
+            return;
+    }
+    
+    StartNextDownload();
+}
+
+void Connection::StartNextDownload()
+{
+    for (HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Begin(); i != downloads_.End(); ++i)
+    {
+        PackageDownload& download = i->second_;
+        if (download.initiated_)
+            continue;
+        
+        // Prepend the checksum to the filename to allow multiple versions
+        download.fileName_ = GetSubsystem<Network>()->GetPackageCacheDir() + ToStringHex(download.checksum_) + "_" + download.name_;
         download.initiated_ = true;
+        unsigned maskSize = (download.totalFragments_ + 7) >> 3;
+        download.receivedFragments_.Resize(maskSize);
+        memset(&download.receivedFragments_[0], 0, maskSize);
+        
+        // If an earlier download of the same package was interrupted, resume from the fragments recorded as written
+        FileSystem* fileSystem = GetSubsystem<FileSystem>();
+        String partFileName = download.fileName_ + ".part";
+        String resumeFileName = download.fileName_ + ".resume";
+        if (fileSystem->FileExists(partFileName) && fileSystem->FileExists(resumeFileName))
+        {
+            File resumeFile(context_, resumeFileName);
+            if (resumeFile.GetSize() == sizeof(unsigned) + maskSize && resumeFile.ReadUInt() == download.fileSize_)
+            {
+                resumeFile.Read(&download.receivedFragments_[0], maskSize);
+                for (unsigned j = 0; j < download.totalFragments_; ++j)
+                {
+                    if (download.receivedFragments_[j >> 3] & (1 << (j & 7)))
+                        ++download.numReceivedFragments_;
+                }
+            }
+        }
+        download.writtenFragments_ = download.receivedFragments_;
+        
+        download.file_ = new File(context_, partFileName, download.numReceivedFragments_ ? FILE_READWRITE : FILE_WRITE);
+        if (!download.file_->IsOpen())
+        {
+            OnPackageDownloadFailed(download.name_);
+            return;
+        }
+        
+        if (download.numReceivedFragments_ == download.totalFragments_)
+        {
+            // Already complete on disk. It is finished on the next update, so check the next package
+            continue;
+        }
+        
+        PODVector<unsigned> ranges;
+        for (unsigned j = 0; j < download.totalFragments_; ++j)
+        {
+            if (download.receivedFragments_[j >> 3] & (1 << (j & 7)))
+                continue;
+            if (!ranges.Empty() && ranges[ranges.Size() - 2] + ranges.Back() == j)
+                ++ranges.Back();
+            else
+            {
+                ranges.Push(j);
+                ranges.Push(1);
+            }
+        }
+        
+        if (download.numReceivedFragments_)
+        {
+            LOGINFO("Resuming download of package " + download.name_ + " from " + String(download.numReceivedFragments_) + "/" +
+                String(download.totalFragments_) + " fragments");
+        }
+        else
+            LOGINFO("Requesting package " + download.name_ + " from server");
+        
+        RequestFragments(download.name_, ranges);
+        return;
+    }
+}
+
+void Connection::RequestFragments(const String& name, const PODVector<unsigned>& ranges)
+{
+    msg_.Clear();
+    msg_.WriteString(name);
+    msg_.WriteVLE(ranges.Size() / 2);
+    for (unsigned i = 0; i < ranges.Size(); ++i)
+        msg_.WriteVLE(ranges[i]);
+    SendMessage(MSG_REQUESTPACKAGE, true, true, msg_);
+}
+
+void Connection::UpdatePackageDownloads()
+{
+    for (HashMap<StringHash, PackageDownload>::Iterator i = downloads_.Begin(); i != downloads_.End();)
+    {
+        HashMap<StringHash, PackageDownload>::Iterator current = i++;
+        PackageDownload& download = current->second_;
+        if (!download.file_)
+            continue;
+        
+        // Wait for the previous write to finish, as the file can only be accessed from one thread at a time
+        if (download.writeItem_)
+        {
+            if (!download.writeItem_->completed_)
+                continue;
+            bool failed = download.writeItem_->failed_;
+            download.writeItem_.Reset();
+            if (failed)
+            {
+                OnPackageDownloadFailed(download.name_);
+                return;
+            }
+        }
+        
+        if (!download.pendingFragments_.Empty())
+        {
+            for (unsigned j = 0; j < download.pendingFragments_.Size(); ++j)
+            {
+                unsigned index = download.pendingFragments_[j];
+                download.writtenFragments_[index >> 3] |= 1 << (index & 7);
+            }
+            
+            download.writeItem_ = new PackageWriteItem(context_);
+            download.writeItem_->workFunction_ = WritePackageFragmentsWork;
+            download.writeItem_->file_ = download.file_;
+            download.writeItem_->fragments_.Swap(download.pendingFragments_);
+            download.writeItem_->data_.SetData(download.pendingData_.GetBuffer());
+            download.pendingData_.Clear();
+            download.writeItem_->fileSize_ = download.fileSize_;
+            download.writeItem_->writtenFragments_ = download.writtenFragments_;
+            download.writeItem_->resumeFileName_ = download.fileName_ + ".resume";
+            
+            WorkQueue* queue = GetSubsystem<WorkQueue>();
+            if (queue)
+                queue->AddWorkItem(SharedPtr<WorkItem>(download.writeItem_));
+            else
+            {
+                WritePackageFragmentsWork(download.writeItem_, 0);
+                download.writeItem_->completed_ = true;
+            }
+            continue;
+        }
+        
+        if (download.numReceivedFragments_ < download.totalFragments_)
+            continue;
+        
+        // All fragments are on disk: move the file into place and check that it is the expected package
+        download.file_->Close();
+        download.file_.Reset();
+        FileSystem* fileSystem = GetSubsystem<FileSystem>();
+        fileSystem->Delete(download.fileName_ + ".resume");
+        if (fileSystem->FileExists(download.fileName_))
+            fileSystem->Delete(download.fileName_);
+        
+        SharedPtr<PackageFile> newPackage;
+        if (fileSystem->Rename(download.fileName_ + ".part", download.fileName_))
+            newPackage = new PackageFile(context_, download.fileName_);
+        if (!newPackage || newPackage->GetTotalSize() != download.fileSize_ || newPackage->GetChecksum() != download.checksum_)
+        {
+            if (newPackage)
+                fileSystem->Delete(download.fileName_);
+            OnPackageDownloadFailed(download.name_);
+            return;
+        }
+        
+        LOGINFO("Package " + download.name_ + " downloaded successfully");
+        
+        // Add the package to the resource system, as we will need it to load the scene
+        GetSubsystem<ResourceCache>()->AddPackageFile(newPackage, true);
+        downloads_.Erase(current);
+        if (downloads_.Empty())
+        {
+            OnPackagesReady();
+            return;
+        }
     }
 }
 
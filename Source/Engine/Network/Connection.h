@@ -39,12 +39,20 @@
 namespace Urho3D
 {
 
+class Component;
 class File;
+class JoinSnapshot;
 class MemoryBuffer;
+class MessageTransport;
 class Node;
 class Scene;
 class Serializable;
+class Serializer;
 class PackageFile;
+class RelevanceGrid;
+class SimulatedLink;
+struct PackageWriteItem;
+struct RelevanceGridEntry;
 
 /// Queued remote event.
 struct RemoteEvent
@@ -65,14 +73,28 @@ struct PackageDownload
     /// Construct with defaults.
     PackageDownload();
     
-    /// Destination file.
+    /// Destination file, which has a .part extension until the download is finished.
     SharedPtr<File> file_;
-    /// Already received fragments.
-    HashSet<unsigned> receivedFragments_;
+    /// Received fragments as a bitmask.
+    PODVector<unsigned char> receivedFragments_;
+    /// Fragments written or being written to the file as a bitmask.
+    PODVector<unsigned char> writtenFragments_;
+    /// Received fragments waiting to be written.
+    PODVector<unsigned> pendingFragments_;
+    /// Data of the received fragments waiting to be written.
+    VectorBuffer pendingData_;
+    /// Background work item writing fragments to the file.
+    SharedPtr<PackageWriteItem> writeItem_;
     /// Package name.
     String name_;
+    /// Final file name in the package cache directory.
+    String fileName_;
+    /// Package file size.
+    unsigned fileSize_;
     /// Total number of fragments.
     unsigned totalFragments_;
+    /// Number of received fragments.
+    unsigned numReceivedFragments_;
     /// Checksum.
     unsigned checksum_;
     /// Download initiated flag.
@@ -87,12 +109,70 @@ struct PackageUpload
     
     /// Source file.
     SharedPtr<File> file_;
-    /// Current fragment index.
+    /// Indices of the fragments to send, in order.
+    PODVector<unsigned> fragments_;
+    /// Position of the next fragment to send in the fragment indices.
     unsigned fragment_;
     /// Total number of fragments
     unsigned totalFragments_;
 };
 
+/// Serialized message waiting to be sent.
+struct QueuedMessage
+{
+    /// Message ID.
+    int msgID_;
+    /// Content ID.
+    unsigned contentID_;
+    /// Offset of the message data in the queued data buffer.
+    unsigned offset_;
+    /// Message data size.
+    unsigned size_;
+    /// Reliable flag.
+    bool reliable_;
+    /// In order flag.
+    bool inOrder_;
+};
+
+/// Sent traffic of one message type or replicated object type.
+struct NetworkTraffic
+{
+    /// Construct with defaults.
+    NetworkTraffic();
+    
+    /// Number of messages, or number of serialized updates of an object type.
+    unsigned count_;
+    /// Bytes sent.
+    unsigned bytes_;
+    /// Attributes sent. Only counted for object types.
+    unsigned attributes_;
+};
+
+/// Traffic statistics of a connection over a time interval.
+struct ConnectionStatistics
+{
+    /// Construct with defaults.
+    ConnectionStatistics();
+    
+    /// Reset to empty.
+    void Clear();
+    /// Add the statistics of another connection.
+    void Merge(const ConnectionStatistics& statistics);
+    /// Return total bytes sent.
+    unsigned GetTotalBytes() const;
+    
+    /// Sent traffic by message ID.
+    HashMap<int, NetworkTraffic> messages_;
+    /// Sent traffic of attribute updates by node or component type.
+    HashMap<StringHash, NetworkTraffic> objects_;
+    /// Time spent serializing server updates in microseconds.
+    long long serializationTime_;
+    /// Number of server updates serialized.
+    unsigned numUpdates_;
+    /// Length of the interval in seconds.
+    float interval_;
+};
+
 /// Send modes for observer position/rotation. Activated by the client setting either position or rotation.
 enum ObserverPositionSendMode
 {
@@ -107,8 +187,8 @@ class URHO3D_API Connection : public Object
     OBJECT(Connection);
     
 public:
-    /// Construct with context and kNet message connection pointers.
-    Connection(Context* context, bool isClient, kNet::SharedPtr<kNet::MessageConnection> connection);
+    /// Construct with context and kNet message connection pointers, or with a simulated link instead of a kNet connection.
+    Connection(Context* context, bool isClient, kNet::SharedPtr<kNet::MessageConnection> connection, SimulatedLink* link = 0);
     /// Destruct.
     ~Connection();
     
@@ -130,13 +210,21 @@ public:
     void SetPosition(const Vector3& position);
     /// Set the observer rotation for interest management, to be sent to the server. Note: not used by the NetworkPriority component.
     void SetRotation(const Quaternion& rotation);
+    /// Set distance from the observer position within which top-level scene nodes and their children are replicated to the client. 0 (default) replicates all nodes.
+    void SetRelevanceDistance(float distance);
+    /// Set whether to replicate attribute changes as unreliable snapshots, delta-compressed against the last snapshot acknowledged by the client, instead of reliable delta and latest data messages.
+    void SetSnapshotReplication(bool enable);
     /// Set the connection pending status. Called by Network.
     void SetConnectPending(bool connectPending);
     /// Set whether to log data in/out statistics.
     void SetLogStatistics(bool enable);
+    /// Set whether to account sent bytes per message type and per replicated object type, and server update serialization time.
+    void SetTrackStatistics(bool enable);
     /// Disconnect. If wait time is non-zero, will block while waiting for disconnect to finish.
     void Disconnect(int waitMSec = 0);
-    /// Send scene update messages. Called by Network.
+    /// Serialize scene update messages without sending them. Does not modify shared scene state, so can be called for several connections in parallel. If the client has just loaded the scene, sends the initial state from the join snapshot if given. Called by Network.
+    void PrepareServerUpdate(const RelevanceGrid* relevanceGrid = 0, const JoinSnapshot* joinSnapshot = 0);
+    /// Send the scene update messages serialized by PrepareServerUpdate(). Called by Network.
     void SendServerUpdate();
     /// Send latest controls from the client. Called by Network.
     void SendClientUpdate();
@@ -146,11 +234,17 @@ public:
     void SendPackages();
     /// Process pending latest data for nodes and components.
     void ProcessPendingLatestData();
+    /// Write received package fragments in the background and finish completed package downloads. Called by Network.
+    void UpdatePackageDownloads();
+    /// Send server state applied events for the client-owned nodes updated by the server, for prediction reconciliation. Called by Network.
+    void SendServerStateEvents();
     /// Process a message from the server or client. Called by Network.
     bool ProcessMessage(int msgID, MemoryBuffer& msg);
     
     /// Return the kNet message connection.
     kNet::MessageConnection* GetMessageConnection() const;
+    /// Return the simulated link, or null if the connection uses kNet.
+    SimulatedLink* GetSimulatedLink() const;
     /// Return client identity.
     VariantMap& GetIdentity() { return identity_; }
     /// Return the scene used by this connection.
@@ -169,8 +263,24 @@ public:
     bool IsConnectPending() const { return connectPending_; }
     /// Return whether the scene is loaded and ready to receive server updates.
     bool IsSceneLoaded() const { return sceneLoaded_; }
+    /// Return whether the client has loaded the scene but has not been sent any replicated state yet.
+    bool IsJoinPending() const { return sceneLoaded_ && sceneState_.nodeStates_.Empty(); }
     /// Return whether to log data in/out statistics.
     bool GetLogStatistics() const { return logStatistics_; }
+    /// Return whether sent traffic is accounted.
+    bool GetTrackStatistics() const { return trackStatistics_; }
+    /// Return the traffic statistics of the last completed interval. Empty unless tracking statistics.
+    const ConnectionStatistics& GetStatistics() const { return lastStatistics_; }
+    /// Return the relevance distance for replicating nodes, or 0 if all nodes are replicated.
+    float GetRelevanceDistance() const { return relevanceDistance_; }
+    /// Return whether attribute changes are replicated as snapshots.
+    bool GetSnapshotReplication() const { return snapshotReplication_; }
+    /// Return sequence number of the latest controls sent on the client, or received on the server.
+    unsigned GetControlsSequence() const { return controlsSequence_; }
+    /// Return sequence number of the latest client controls the server had applied when it sent its latest update. Client only.
+    unsigned GetAckedControlsSequence() const { return ackedControlsSequence_; }
+    /// Return the latest server time received in seconds, counted from the first update. Client only.
+    double GetServerTime() const { return serverTime_; }
     /// Return remote address.
     String GetAddress() const { return address_; }
     /// Return remote port.
@@ -210,18 +320,58 @@ private:
     void ProcessSceneLoaded(int msgID, MemoryBuffer& msg);
     /// Process a remote event message from the client or server. Called by Network.
     void ProcessRemoteEvent(int msgID, MemoryBuffer& msg);
+    /// Process a Snapshot message from the server. Called by Network.
+    void ProcessSnapshot(int msgID, MemoryBuffer& msg);
+    /// Process a SnapshotAck message from the client. Called by Network.
+    void ProcessSnapshotAck(int msgID, MemoryBuffer& msg);
+    /// Process a JoinSnapshot message from the server. Called by Network.
+    void ProcessJoinSnapshot(int msgID, MemoryBuffer& msg);
+    /// Process a SnapshotResend message from the server. Called by Network.
+    void ProcessSnapshotResend(int msgID, MemoryBuffer& msg);
+    /// Update the set of relevant top-level nodes and mark the nodes that entered or left relevance dirty.
+    void UpdateRelevance(const RelevanceGrid* relevanceGrid);
+    /// Mark a node and its child nodes dirty for processing.
+    void MarkHierarchyDirty(Node* node);
+    /// Return whether a node is relevant for replication to the client.
+    bool IsRelevant(Node* node) const;
+    /// Remove a node that is no longer relevant from the client.
+    void RemoveIrrelevantNode(unsigned nodeID, NodeReplicationState& nodeState);
+    /// Handle snapshot replication being switched on or off, and mark the nodes with unacknowledged changes dirty.
+    void UpdateSnapshotState();
+    /// Mark the attribute changes the client has not acknowledged for sending as reliable delta updates.
+    void ResendSnapshotChanges();
+    /// Write the node and component attributes changed after the acknowledged snapshot to the snapshot being serialized.
+    void WriteSnapshotEntries(Node* node, NodeReplicationState& nodeState);
+    /// Add a serialized node or component entry to the snapshot, starting a new part if necessary.
+    void AddSnapshotEntry(const VectorBuffer& entry);
+    /// Queue the parts of the serialized snapshot for sending.
+    void QueueSnapshot();
+    /// Create the replication states of the nodes in a join snapshot and queue its parts for sending.
+    void QueueJoinSnapshot(const JoinSnapshot* joinSnapshot);
+    /// Write the server time and optionally the latest applied controls sequence number to a server update.
+    void WriteUpdateHeader(Serializer& dest, bool sendControlsSequence);
+    /// Read the header of a server update and set the scene network time. Return whether a controls sequence number was included.
+    bool ReadUpdateHeader(MemoryBuffer& msg);
     /// Process a node for sending a network update. Recurses to process depended on node(s) first.
     void ProcessNode(unsigned nodeID);
     /// Process a node that the client has not yet received.
     void ProcessNewNode(Node* node);
     /// Process a node that the client has already received.
     void ProcessExistingNode(Node* node, NodeReplicationState& nodeState);
+    /// Queue a scene update message to be sent by SendServerUpdate().
+    void QueueMessage(int msgID, bool reliable, bool inOrder, const VectorBuffer& msg, unsigned contentID = 0);
+    /// Account a serialized attribute update of a node or component type if tracking statistics.
+    void AddObjectTraffic(StringHash type, unsigned bytes, unsigned attributes);
     /// Process a SyncPackagesInfo message from server.
     void ProcessPackageInfo(int msgID, MemoryBuffer& msg);
     /// Check a package list received from server and initiate package downloads as necessary. Return true on success, or false if failed to initialze downloads (cache dir not set)
     bool RequestNeededPackages(unsigned numPackages, MemoryBuffer& msg);
     /// Initiate a package download.
     void RequestPackage(const String& name, unsigned fileSize, unsigned checksum);
+    /// Request the next package that has not been requested yet, resuming from a partially downloaded file if possible.
+    void StartNextDownload();
+    /// Request ranges of package fragments, given as pairs of first fragment and fragment count.
+    void RequestFragments(const String& name, const PODVector<unsigned>& ranges);
     /// Send an error reply for a package download.
     void SendPackageError(const String& name);
     /// Handle scene load failure on the server or client.
@@ -233,6 +383,10 @@ private:
     
     /// kNet message connection.
     kNet::SharedPtr<kNet::MessageConnection> connection_;
+    /// Simulated link used instead of a kNet connection.
+    SharedPtr<SimulatedLink> link_;
+    /// %Message transport, using either the kNet connection or the simulated link.
+    SharedPtr<MessageTransport> transport_;
     /// Scene.
     WeakPtr<Scene> scene_;
     /// Network replication state of the scene.
@@ -249,12 +403,48 @@ private:
     HashSet<unsigned> nodesToProcess_;
     /// Reusable message buffer.
     VectorBuffer msg_;
+    /// Serialized scene update messages waiting to be sent.
+    PODVector<QueuedMessage> queuedMessages_;
+    /// Data of the queued scene update messages.
+    VectorBuffer queuedData_;
+    /// Node replication states created during the scene update, to be registered to the nodes when sending.
+    PODVector<Pair<NodeReplicationState*, Node*> > newNodeStates_;
+    /// Component replication states created during the scene update, to be registered to the components when sending.
+    PODVector<Pair<ComponentReplicationState*, Component*> > newComponentStates_;
+    /// IDs of nodes that are no longer relevant, to be unregistered from the nodes when sending.
+    PODVector<unsigned> irrelevantNodes_;
+    /// IDs of removed nodes, whose replication states are erased when sending.
+    PODVector<unsigned> removedNodes_;
+    /// Node and component IDs of removed components, whose replication states are erased when sending.
+    PODVector<Pair<unsigned, unsigned> > removedComponents_;
+    /// Relevant top-level node IDs.
+    HashSet<unsigned> relevantNodes_;
+    /// Relevant top-level node IDs being collected during the update.
+    HashSet<unsigned> newRelevantNodes_;
+    /// Relevance grid query result.
+    PODVector<const RelevanceGridEntry*> relevanceQueryResult_;
+    /// IDs of nodes with attribute changes not yet acknowledged by the client.
+    HashSet<unsigned> snapshotNodes_;
+    /// Entries of the snapshot being serialized.
+    VectorBuffer snapshotData_;
+    /// Start offsets of the snapshot parts.
+    PODVector<unsigned> snapshotParts_;
+    /// Compressed join snapshot data received so far.
+    VectorBuffer joinSnapshotData_;
+    /// Client-owned node IDs updated by the server since the last server state applied events.
+    HashSet<unsigned> reconcileNodes_;
     /// Queued remote events.
     Vector<RemoteEvent> remoteEvents_;
     /// Scene file to load once all packages (if any) have been downloaded.
     String sceneFileName_;
     /// Statistics timer.
     Timer statsTimer_;
+    /// Time since the oldest unacknowledged snapshot was sent, or since the latest acknowledgement.
+    Timer snapshotAckTimer_;
+    /// Traffic statistics being accumulated.
+    ConnectionStatistics statistics_;
+    /// Traffic statistics of the last completed interval.
+    ConnectionStatistics lastStatistics_;
     /// Remote endpoint address.
     String address_;
     /// Remote endpoint port.
@@ -265,6 +455,40 @@ private:
     Quaternion rotation_;
     /// Send mode for the observer position & rotation.
     ObserverPositionSendMode sendMode_;
+    /// Relevance distance for replicating nodes.
+    float relevanceDistance_;
+    /// Whether relevance was in use during the last update.
+    bool relevanceActive_;
+    /// Latest snapshot ID sent to the client.
+    unsigned sentSnapshotID_;
+    /// Latest snapshot ID acknowledged by the client.
+    unsigned ackedSnapshotID_;
+    /// Snapshot ID being received from the server.
+    unsigned receiveSnapshotID_;
+    /// Number of parts received of the snapshot.
+    unsigned receivedSnapshotParts_;
+    /// Latest fully applied snapshot ID.
+    unsigned appliedSnapshotID_;
+    /// Snapshot ID up to which resent changes have been received.
+    unsigned resendSnapshotID_;
+    /// Whether all entries of the snapshot being received could be applied.
+    bool snapshotComplete_;
+    /// Snapshot replication flag.
+    bool snapshotReplication_;
+    /// Whether snapshot replication was in use during the last update.
+    bool snapshotActive_;
+    /// Whether unacknowledged snapshot changes are being resent as reliable delta updates during this update. The client is then told the snapshot ID the resend brings it up to.
+    bool snapshotResend_;
+    /// Latest controls sequence number.
+    unsigned controlsSequence_;
+    /// Latest controls sequence number acknowledged by the server.
+    unsigned ackedControlsSequence_;
+    /// Latest server time received, unwrapped from the timestamps.
+    double serverTime_;
+    /// Timestamp of the latest server time received.
+    unsigned serverTimeStamp_;
+    /// Server time received flag.
+    bool serverTimeValid_;
     /// Client connection flag.
     bool isClient_;
     /// Connection pending flag.
@@ -273,6 +497,8 @@ private:
     bool sceneLoaded_;
     /// Show statistics flag.
     bool logStatistics_;
+    /// Track statistics flag.
+    bool trackStatistics_;
 };
 
 }
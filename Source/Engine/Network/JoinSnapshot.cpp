@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Component.h"
+#include "Compression.h"
+#include "JoinSnapshot.h"
+#include "Scene.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+JoinSnapshot::JoinSnapshot()
+{
+}
+
+void JoinSnapshot::Build(Scene* scene)
+{
+    nodes_.Clear();
+    addedNodes_.Clear();
+    entries_.Clear();
+    data_.Clear();
+
+    AddHierarchy(scene);
+
+    entries_.Seek(0);
+    CompressStream(data_, entries_);
+}
+
+void JoinSnapshot::AddHierarchy(Node* node)
+{
+    AddNode(node);
+
+    const Vector<SharedPtr<Node> >& children = node->GetChildren();
+    for (Vector<SharedPtr<Node> >::ConstIterator i = children.Begin(); i != children.End(); ++i)
+        AddHierarchy(*i);
+}
+
+void JoinSnapshot::AddNode(Node* node)
+{
+    unsigned nodeID = node->GetID();
+    if (nodeID >= FIRST_LOCAL_ID || addedNodes_.Contains(nodeID))
+        return;
+    addedNodes_.Insert(nodeID);
+
+    // The client resolves the parent and node references as the entries are read, so write those nodes first
+    Node* parent = node->GetParent();
+    if (parent)
+        AddNode(parent);
+    const PODVector<Node*>& dependencyNodes = node->GetDependencyNodes();
+    for (PODVector<Node*>::ConstIterator i = dependencyNodes.Begin(); i != dependencyNodes.End(); ++i)
+        AddNode(*i);
+
+    // The entry has the same layout as a node creation message
+    entry_.Clear();
+    entry_.WriteNetID(nodeID);
+    node->WriteInitialDeltaUpdate(entry_);
+
+    const VariantMap& vars = node->GetVars();
+    entry_.WriteVLE(vars.Size());
+    for (VariantMap::ConstIterator i = vars.Begin(); i != vars.End(); ++i)
+    {
+        entry_.WriteStringHash(i->first_);
+        entry_.WriteVariant(i->second_);
+    }
+
+    entry_.WriteVLE(node->GetNumNetworkComponents());
+    const Vector<SharedPtr<Component> >& components = node->GetComponents();
+    for (Vector<SharedPtr<Component> >::ConstIterator i = components.Begin(); i != components.End(); ++i)
+    {
+        Component* component = *i;
+        if (component->GetID() >= FIRST_LOCAL_ID)
+            continue;
+
+        entry_.WriteStringHash(component->GetType());
+        entry_.WriteNetID(component->GetID());
+        component->WriteInitialDeltaUpdate(entry_);
+    }
+
+    entries_.WriteVLE(entry_.GetSize());
+    entries_.Write(entry_.GetData(), entry_.GetSize());
+    nodes_.Push(node);
+}
+
+}
@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "HashSet.h"
+#include "VectorBuffer.h"
+
+namespace Urho3D
+{
+
+class Node;
+class Scene;
+
+/// Replicated state of a whole scene serialized once and compressed, to be shared by the clients that join the scene during the same network update.
+class URHO3D_API JoinSnapshot
+{
+public:
+    /// Construct.
+    JoinSnapshot();
+
+    /// Rebuild from the prepared network state of a scene. The nodes are ordered so that parents and dependencies come first.
+    void Build(Scene* scene);
+
+    /// Return the replicated nodes in the order they were written.
+    const PODVector<Node*>& GetNodes() const { return nodes_; }
+    /// Return the compressed node creation entries.
+    const VectorBuffer& GetData() const { return data_; }
+    /// Return uncompressed size of the node creation entries.
+    unsigned GetUncompressedSize() const { return entries_.GetSize(); }
+
+private:
+    /// Add a node and its children.
+    void AddHierarchy(Node* node);
+    /// Add a node after its parent and the nodes it depends on.
+    void AddNode(Node* node);
+
+    /// Replicated nodes in the order they were written.
+    PODVector<Node*> nodes_;
+    /// IDs of the nodes already written.
+    HashSet<unsigned> addedNodes_;
+    /// Uncompressed node creation entries.
+    VectorBuffer entries_;
+    /// Entry being written.
+    VectorBuffer entry_;
+    /// Compressed node creation entries.
+    VectorBuffer data_;
+};
+
+}
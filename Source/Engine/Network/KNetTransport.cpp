@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "KNetTransport.h"
+#include "Log.h"
+
+#include <kNet.h>
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+KNetTransport::KNetTransport(kNet::SharedPtr<kNet::MessageConnection> connection) :
+    connection_(connection)
+{
+}
+
+void KNetTransport::SendMessage(int msgID, bool reliable, bool inOrder, const unsigned char* data, unsigned numBytes,
+    unsigned contentID)
+{
+    kNet::NetworkMessage *msg = connection_->StartNewMessage(msgID, numBytes);
+    if (!msg)
+    {
+        LOGERROR("Can not start new network message");
+        return;
+    }
+
+    msg->reliable = reliable;
+    msg->inOrder = inOrder;
+    msg->priority = 0;
+    msg->contentID = contentID;
+    if (numBytes)
+        memcpy(msg->data, data, numBytes);
+
+    connection_->EndAndQueueMessage(msg);
+}
+
+void KNetTransport::Disconnect(int waitMSec)
+{
+    connection_->Disconnect(waitMSec);
+}
+
+bool KNetTransport::IsConnected() const
+{
+    return connection_->GetConnectionState() == kNet::ConnectionOK;
+}
+
+unsigned KNetTransport::GetNumPendingMessages() const
+{
+    return (unsigned)connection_->NumOutboundMessagesPending();
+}
+
+}
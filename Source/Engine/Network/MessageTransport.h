@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "RefCounted.h"
+
+namespace Urho3D
+{
+
+/// %Message transport of a network connection. Implemented by kNet connections and by the ends of a simulated link.
+class URHO3D_API MessageTransport : public RefCounted
+{
+public:
+    /// Destruct.
+    virtual ~MessageTransport() {}
+
+    /// Send a message.
+    virtual void SendMessage(int msgID, bool reliable, bool inOrder, const unsigned char* data, unsigned numBytes, unsigned contentID) = 0;
+    /// Disconnect. Wait up to the specified time for the disconnection to be acknowledged, if applicable.
+    virtual void Disconnect(int waitMSec) = 0;
+
+    /// Return whether is connected.
+    virtual bool IsConnected() const = 0;
+    /// Return number of sent messages that are still queued or in flight.
+    virtual unsigned GetNumPendingMessages() const = 0;
+};
+
+}
@@ -36,6 +36,9 @@
 #include "Profiler.h"
 #include "Protocol.h"
 #include "Scene.h"
+#include "SimulatedLink.h"
+#include "Timer.h"
+#include "WorkQueue.h"
 
 #include <kNet.h>
 
@@ -46,11 +49,45 @@ namespace Urho3D
 
 static const int DEFAULT_UPDATE_FPS = 30;
 
+static const char* messageNames[] =
+{
+    "Identity",
+    "Controls",
+    "SceneLoaded",
+    "RequestPackage",
+    "PackageData",
+    "LoadScene",
+    "SceneChecksumError",
+    "CreateNode",
+    "NodeDeltaUpdate",
+    "NodeLatestData",
+    "RemoveNode",
+    "CreateComponent",
+    "ComponentDeltaUpdate",
+    "ComponentLatestData",
+    "RemoveComponent",
+    "RemoteEvent",
+    "RemoteNodeEvent",
+    "PackageInfo",
+    "Snapshot",
+    "SnapshotAck",
+    "JoinSnapshot",
+    "SnapshotResend"
+};
+
+/// Work function for preparing a connection's server update in a worker thread.
+static void PrepareServerUpdateWork(const WorkItem* item, unsigned threadIndex)
+{
+    static_cast<Connection*>(item->start_)->PrepareServerUpdate(reinterpret_cast<const RelevanceGrid*>(item->aux_),
+        reinterpret_cast<const JoinSnapshot*>(item->end_));
+}
+
 Network::Network(Context* context) :
     Object(context),
     updateFps_(DEFAULT_UPDATE_FPS),
     updateInterval_(1.0f / (float)DEFAULT_UPDATE_FPS),
-    updateAcc_(0.0f)
+    updateAcc_(0.0f),
+    trackStatistics_(false)
 {
     network_ = new kNet::Network();
     
@@ -111,6 +148,7 @@ Network::~Network()
     serverConnection_.Reset();
     
     clientConnections_.Clear();
+    loopbackConnections_.Clear();
     
     delete network_;
     network_ = 0;
@@ -123,17 +161,7 @@ void Network::HandleMessage(kNet::MessageConnection *source, kNet::packet_id_t p
     if (connection)
     {
         MemoryBuffer msg(data, numBytes);
-        if (connection->ProcessMessage(msgId, msg))
-            return;
-        
-        // If message was not handled internally, forward as an event
-        using namespace NetworkMessage;
-        
-        VariantMap& eventData = GetEventDataMap();
-        eventData[P_CONNECTION] = connection;
-        eventData[P_MESSAGEID] = (int)msgId;
-        eventData[P_DATA].SetBuffer(msg.GetData(), msg.GetSize());
-        connection->SendEvent(E_NETWORKMESSAGE, eventData);
+        DispatchMessage(connection, msgId, msg);
     }
     else
         LOGWARNING("Discarding message from unknown MessageConnection " + ToString((void*)source));
@@ -147,6 +175,10 @@ u32 Network::ComputeContentID(kNet::message_id_t msgId, const char* data, size_t
         // Return fixed content ID for controls
         return CONTROLS_CONTENT_ID;
         
+    case MSG_SNAPSHOTACK:
+        // Return fixed content ID for snapshot acknowledgements
+        return SNAPSHOTACK_CONTENT_ID;
+        
     case MSG_NODELATESTDATA:
     case MSG_COMPONENTLATESTDATA:
         {
@@ -167,6 +199,7 @@ void Network::NewConnectionEstablished(kNet::MessageConnection* connection)
     
     // Create a new client connection corresponding to this MessageConnection
     SharedPtr<Connection> newConnection(new Connection(context_, true, kNet::SharedPtr<kNet::MessageConnection>(connection)));
+    newConnection->SetTrackStatistics(trackStatistics_);
     clientConnections_[connection] = newConnection;
     LOGINFO("Client " + newConnection->ToString() + " connected");
     
@@ -182,20 +215,7 @@ void Network::ClientDisconnected(kNet::MessageConnection* connection)
     connection->Disconnect(0);
     
     // Remove the client connection that corresponds to this MessageConnection
-    HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Find(connection);
-    if (i != clientConnections_.End())
-    {
-        Connection* connection = i->second_;
-        LOGINFO("Client " + connection->ToString() + " disconnected");
-        
-        using namespace ClientDisconnected;
-        
-        VariantMap& eventData = GetEventDataMap();
-        eventData[P_CONNECTION] = connection;
-        connection->SendEvent(E_CLIENTDISCONNECTED, eventData);
-        
-        clientConnections_.Erase(i);
-    }
+    RemoveClientConnection(connection);
 }
 
 bool Network::Connect(const String& address, unsigned short port, Scene* scene, const VariantMap& identity)
@@ -213,6 +233,7 @@ bool Network::Connect(const String& address, unsigned short port, Scene* scene,
     if (connection)
     {
         serverConnection_ = new Connection(context_, false, connection);
+        serverConnection_->SetTrackStatistics(trackStatistics_);
         serverConnection_->SetScene(scene);
         serverConnection_->SetIdentity(identity);
         serverConnection_->SetConnectPending(true);
@@ -227,6 +248,43 @@ bool Network::Connect(const String& address, unsigned short port, Scene* scene,
     }
 }
 
+Connection* Network::ConnectLoopback(Scene* scene, const VariantMap& identity)
+{
+    if (!scene)
+    {
+        LOGERROR("Null scene specified for ConnectLoopback");
+        return 0;
+    }
+    
+    SharedPtr<SimulatedLink> link(new SimulatedLink());
+    SharedPtr<Connection> clientConnection(new Connection(context_, false, kNet::SharedPtr<kNet::MessageConnection>(), link));
+    SharedPtr<Connection> newConnection(new Connection(context_, true, kNet::SharedPtr<kNet::MessageConnection>(), link));
+    link->SetConnections(clientConnection, newConnection);
+    clientConnection->SetTrackStatistics(trackStatistics_);
+    newConnection->SetTrackStatistics(trackStatistics_);
+    loopbackConnections_.Push(clientConnection);
+    clientConnections_[link.Get()] = newConnection;
+    
+    clientConnection->SetScene(scene);
+    clientConnection->SetIdentity(identity);
+    LOGINFO("Loopback client connected");
+    
+    {
+        using namespace ClientConnected;
+        
+        VariantMap& eventData = GetEventDataMap();
+        eventData[P_CONNECTION] = newConnection;
+        newConnection->SendEvent(E_CLIENTCONNECTED, eventData);
+    }
+    
+    // The link is connected immediately, so send the identity map now
+    VectorBuffer msg;
+    msg.WriteVariantMap(identity);
+    clientConnection->SendMessage(MSG_IDENTITY, true, true, msg);
+    
+    return clientConnection;
+}
+
 void Network::Disconnect(int waitMSec)
 {
     if (!serverConnection_)
@@ -283,22 +341,33 @@ void Network::BroadcastMessage(int msgID, bool reliable, bool inOrder, const uns
     }
     
     kNet::NetworkServer* server = network_->GetServer();
+    if (!server && loopbackConnections_.Empty())
+    {
+        LOGERROR("Server not running, can not broadcast messages");
+        return;
+    }
+    
     if (server)
         server->BroadcastMessage(msgID, reliable, inOrder, 0, contentID, (const char*)data, numBytes);
-    else
-        LOGERROR("Server not running, can not broadcast messages");
+    
+    for (Vector<SharedPtr<Connection> >::ConstIterator i = loopbackConnections_.Begin(); i != loopbackConnections_.End(); ++i)
+    {
+        Connection* connection = (*i)->GetSimulatedLink()->GetServerConnection();
+        if (connection)
+            connection->SendMessage(msgID, reliable, inOrder, data, numBytes, contentID);
+    }
 }
 
 void Network::BroadcastRemoteEvent(StringHash eventType, bool inOrder, const VariantMap& eventData)
 {
-    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
         i != clientConnections_.End(); ++i)
         i->second_->SendRemoteEvent(eventType, inOrder, eventData);
 }
 
 void Network::BroadcastRemoteEvent(Scene* scene, StringHash eventType, bool inOrder, const VariantMap& eventData)
 {
-    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
         i != clientConnections_.End(); ++i)
     {
         if (i->second_->GetScene() == scene)
@@ -320,7 +389,7 @@ void Network::BroadcastRemoteEvent(Node* node, StringHash eventType, bool inOrde
     }
     
     Scene* scene = node->GetScene();
-    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
         i != clientConnections_.End(); ++i)
     {
         if (i->second_->GetScene() == scene)
@@ -361,6 +430,18 @@ void Network::SetPackageCacheDir(const String& path)
     packageCacheDir_ = AddTrailingSlash(path);
 }
 
+void Network::SetTrackStatistics(bool enable)
+{
+    trackStatistics_ = enable;
+    
+    if (serverConnection_)
+        serverConnection_->SetTrackStatistics(enable);
+    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin(); i != clientConnections_.End(); ++i)
+        i->second_->SetTrackStatistics(enable);
+    for (Vector<SharedPtr<Connection> >::Iterator i = loopbackConnections_.Begin(); i != loopbackConnections_.End(); ++i)
+        (*i)->SetTrackStatistics(enable);
+}
+
 void Network::SendPackageToClients(Scene* scene, PackageFile* package)
 {
     if (!scene)
@@ -374,7 +455,7 @@ void Network::SendPackageToClients(Scene* scene, PackageFile* package)
         return;
     }
     
-    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
         i != clientConnections_.End(); ++i)
     {
         if (i->second_->GetScene() == scene)
@@ -397,7 +478,7 @@ Connection* Network::GetConnection(kNet::MessageConnection* connection) const
         return serverConnection_;
     else
     {
-        HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Find(connection);
+        HashMap<void*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Find(connection);
         if (i != clientConnections_.End())
             return i->second_;
         else
@@ -413,13 +494,25 @@ Connection* Network::GetServerConnection() const
 Vector<SharedPtr<Connection> > Network::GetClientConnections() const
 {
     Vector<SharedPtr<Connection> > ret;
-    for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Begin();
+    for (HashMap<void*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Begin();
         i != clientConnections_.End(); ++i)
         ret.Push(i->second_);
     
     return ret;
 }
 
+ConnectionStatistics Network::GetStatistics() const
+{
+    ConnectionStatistics ret;
+    if (serverConnection_)
+        ret.Merge(serverConnection_->GetStatistics());
+    for (HashMap<void*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Begin(); i != clientConnections_.End(); ++i)
+        ret.Merge(i->second_->GetStatistics());
+    // The client ends of loopback links are not included, as the server ends already count the same traffic
+    
+    return ret;
+}
+
 bool Network::IsServerRunning() const
 {
     return network_->GetServer();
@@ -445,6 +538,12 @@ void Network::Update(float timeStep)
         // Process latest data messages waiting for the correct nodes or components to be created
         serverConnection_->ProcessPendingLatestData();
         
+        // Write received package data to disk and finish completed downloads
+        serverConnection_->UpdatePackageDownloads();
+        
+        // Notify of the client-owned nodes updated by the server
+        serverConnection_->SendServerStateEvents();
+        
         // Check for state transitions
         kNet::ConnectionState state = connection->GetConnectionState();
         if (serverConnection_->IsConnectPending() && state == kNet::ConnectionOK)
@@ -459,6 +558,10 @@ void Network::Update(float timeStep)
     kNet::SharedPtr<kNet::NetworkServer> server = network_->GetServer();
     if (server)
         server->Process();
+    
+    // Process simulated links
+    if (!loopbackConnections_.Empty())
+        UpdateLoopbackConnections(timeStep);
 }
 
 void Network::PostUpdate(float timeStep)
@@ -475,14 +578,14 @@ void Network::PostUpdate(float timeStep)
         SendEvent(E_NETWORKUPDATE);
         updateAcc_ = fmodf(updateAcc_, updateInterval_);
         
-        if (IsServerRunning())
+        if (!clientConnections_.Empty())
         {
             // Collect and prepare all networked scenes
             {
                 PROFILE(PrepareServerUpdate);
                 
                 networkScenes_.Clear();
-                for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+                for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
                     i != clientConnections_.End(); ++i)
                 {
                     Scene* scene = i->second_->GetScene();
@@ -490,15 +593,56 @@ void Network::PostUpdate(float timeStep)
                         networkScenes_.Insert(scene);
                 }
                 
+                // Take the server time from the integer millisecond clock, as the float elapsed time loses precision over long uptimes
+                double networkTime = networkTimer_.GetMSec(false) * 0.001;
                 for (HashSet<Scene*>::ConstIterator i = networkScenes_.Begin(); i != networkScenes_.End(); ++i)
+                {
+                    (*i)->SetNetworkTime(networkTime);
                     (*i)->PrepareNetworkUpdate();
+                }
+                
+                UpdateRelevanceGrids();
+                UpdateJoinSnapshots();
+            }
+            
+            {
+                PROFILE(PrepareConnectionUpdates);
+                
+                // Serialize the scene updates of each client connection. This only reads the prepared network state of
+                // the scenes, so use worker threads if there is more than one client
+                WorkQueue* queue = GetSubsystem<WorkQueue>();
+                if (queue && queue->GetNumThreads() && clientConnections_.Size() > 1)
+                {
+                    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+                        i != clientConnections_.End(); ++i)
+                    {
+                        SharedPtr<WorkItem> item = queue->GetFreeItem();
+                        item->priority_ = M_MAX_UNSIGNED;
+                        item->workFunction_ = PrepareServerUpdateWork;
+                        item->start_ = i->second_.Get();
+                        item->aux_ = const_cast<RelevanceGrid*>(GetRelevanceGrid(i->second_->GetScene()));
+                        item->end_ = const_cast<JoinSnapshot*>(GetJoinSnapshot(i->second_->GetScene()));
+                        queue->AddWorkItem(item);
+                    }
+                    
+                    queue->Complete(M_MAX_UNSIGNED);
+                }
+                else
+                {
+                    for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+                        i != clientConnections_.End(); ++i)
+                    {
+                        Scene* scene = i->second_->GetScene();
+                        i->second_->PrepareServerUpdate(GetRelevanceGrid(scene), GetJoinSnapshot(scene));
+                    }
+                }
             }
             
             {
                 PROFILE(SendServerUpdate);
                 
                 // Then send server updates for each client connection
-                for (HashMap<kNet::MessageConnection*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
+                for (HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Begin();
                     i != clientConnections_.End(); ++i)
                 {
                     i->second_->SendServerUpdate();
@@ -515,11 +659,166 @@ void Network::PostUpdate(float timeStep)
             serverConnection_->SendRemoteEvents();
         }
         
+        // Send the client updates of simulated clients
+        for (Vector<SharedPtr<Connection> >::Iterator i = loopbackConnections_.Begin(); i != loopbackConnections_.End(); ++i)
+        {
+            (*i)->SendClientUpdate();
+            (*i)->SendRemoteEvents();
+        }
+        
         // Notify that the update was sent
         SendEvent(E_NETWORKUPDATESENT);
     }
 }
 
+void Network::DispatchMessage(Connection* connection, int msgID, MemoryBuffer& msg)
+{
+    if (connection->ProcessMessage(msgID, msg))
+        return;
+    
+    // If message was not handled internally, forward as an event
+    using namespace NetworkMessage;
+    
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_CONNECTION] = connection;
+    eventData[P_MESSAGEID] = msgID;
+    eventData[P_DATA].SetBuffer(msg.GetData(), msg.GetSize());
+    connection->SendEvent(E_NETWORKMESSAGE, eventData);
+}
+
+void Network::RemoveClientConnection(void* key)
+{
+    HashMap<void*, SharedPtr<Connection> >::Iterator i = clientConnections_.Find(key);
+    if (i != clientConnections_.End())
+    {
+        Connection* connection = i->second_;
+        LOGINFO("Client " + connection->ToString() + " disconnected");
+        
+        using namespace ClientDisconnected;
+        
+        VariantMap& eventData = GetEventDataMap();
+        eventData[P_CONNECTION] = connection;
+        connection->SendEvent(E_CLIENTDISCONNECTED, eventData);
+        
+        clientConnections_.Erase(i);
+    }
+}
+
+void Network::UpdateLoopbackConnections(float timeStep)
+{
+    PROFILE(UpdateLoopbackConnections);
+    
+    SimulatedMessage message;
+    
+    // Message handlers may connect or disconnect simulated clients, so iterate by index and hold references
+    for (unsigned i = 0; i < loopbackConnections_.Size();)
+    {
+        SharedPtr<Connection> clientConnection = loopbackConnections_[i];
+        SharedPtr<SimulatedLink> link(clientConnection->GetSimulatedLink());
+        SharedPtr<Connection> serverConnection(link->GetServerConnection());
+        
+        link->Update(timeStep);
+        if (serverConnection)
+        {
+            while (link->ReceiveMessage(serverConnection, message))
+            {
+                MemoryBuffer msg(message.data_);
+                DispatchMessage(serverConnection, message.msgID_, msg);
+            }
+        }
+        while (link->ReceiveMessage(clientConnection, message))
+        {
+            MemoryBuffer msg(message.data_);
+            DispatchMessage(clientConnection, message.msgID_, msg);
+        }
+        
+        clientConnection->ProcessPendingLatestData();
+        clientConnection->UpdatePackageDownloads();
+        clientConnection->SendServerStateEvents();
+        
+        // Remove both ends once the link has been closed from either end, or the server has dropped its connection
+        if (!link->IsConnected() || !serverConnection)
+        {
+            link->Disconnect();
+            RemoveClientConnection(link.Get());
+            clientConnection->SetScene(0);
+            loopbackConnections_.Remove(clientConnection);
+        }
+        else
+            ++i;
+    }
+}
+
+void Network::UpdateRelevanceGrids()
+{
+    // Size the grid cells by the largest relevance distance of the clients in each scene
+    HashMap<Scene*, float> cellSizes;
+    for (HashMap<void*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Begin();
+        i != clientConnections_.End(); ++i)
+    {
+        Scene* scene = i->second_->GetScene();
+        float distance = i->second_->GetRelevanceDistance();
+        if (scene && distance > 0.0f)
+        {
+            HashMap<Scene*, float>::Iterator j = cellSizes.Find(scene);
+            if (j == cellSizes.End())
+                cellSizes[scene] = distance;
+            else
+                j->second_ = Max(j->second_, distance);
+        }
+    }
+    
+    for (HashMap<Scene*, RelevanceGrid>::Iterator i = relevanceGrids_.Begin(); i != relevanceGrids_.End();)
+    {
+        HashMap<Scene*, RelevanceGrid>::Iterator current = i++;
+        if (!cellSizes.Contains(current->first_))
+            relevanceGrids_.Erase(current);
+    }
+    
+    for (HashMap<Scene*, float>::ConstIterator i = cellSizes.Begin(); i != cellSizes.End(); ++i)
+        relevanceGrids_[i->first_].Build(i->first_, i->second_);
+}
+
+const RelevanceGrid* Network::GetRelevanceGrid(Scene* scene) const
+{
+    HashMap<Scene*, RelevanceGrid>::ConstIterator i = relevanceGrids_.Find(scene);
+    return i != relevanceGrids_.End() ? &i->second_ : 0;
+}
+
+void Network::UpdateJoinSnapshots()
+{
+    // Serialize each scene once for all the clients that join it during this update
+    HashSet<Scene*> joinScenes;
+    for (HashMap<void*, SharedPtr<Connection> >::ConstIterator i = clientConnections_.Begin();
+        i != clientConnections_.End(); ++i)
+    {
+        Scene* scene = i->second_->GetScene();
+        if (scene && i->second_->IsJoinPending() && i->second_->GetRelevanceDistance() <= 0.0f)
+            joinScenes.Insert(scene);
+    }
+    
+    for (HashMap<Scene*, JoinSnapshot>::Iterator i = joinSnapshots_.Begin(); i != joinSnapshots_.End();)
+    {
+        HashMap<Scene*, JoinSnapshot>::Iterator current = i++;
+        if (!joinScenes.Contains(current->first_))
+            joinSnapshots_.Erase(current);
+    }
+    
+    for (HashSet<Scene*>::ConstIterator i = joinScenes.Begin(); i != joinScenes.End(); ++i)
+    {
+        JoinSnapshot& snapshot = joinSnapshots_[*i];
+        snapshot.Build(*i);
+        LOGDEBUG("Built join snapshot of " + String(snapshot.GetNodes().Size()) + " nodes, " +
+            String(snapshot.GetData().GetSize()) + " bytes compressed from " + String(snapshot.GetUncompressedSize()));
+    }
+}
+
+const JoinSnapshot* Network::GetJoinSnapshot(Scene* scene) const
+{
+    HashMap<Scene*, JoinSnapshot>::ConstIterator i = joinSnapshots_.Find(scene);
+    return i != joinSnapshots_.End() ? &i->second_ : 0;
+}
+
 void Network::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
     using namespace BeginFrame;
@@ -571,4 +870,12 @@ void RegisterNetworkLibrary(Context* context)
     NetworkPriority::RegisterObject(context);
 }
 
+String GetNetworkMessageName(int msgID)
+{
+    if (msgID >= MSG_IDENTITY && msgID <= MSG_SNAPSHOTRESEND)
+        return messageNames[msgID - MSG_IDENTITY];
+    else
+        return String(msgID);
+}
+
 }
@@ -24,7 +24,10 @@
 
 #include "Connection.h"
 #include "HashSet.h"
+#include "JoinSnapshot.h"
 #include "Object.h"
+#include "RelevanceGrid.h"
+#include "Timer.h"
 #include "VectorBuffer.h"
 
 #include <kNet/IMessageHandler.h>
@@ -65,6 +68,8 @@ public:
     
     /// Connect to a server using UDP protocol. Return true if connection process successfully started.
     bool Connect(const String& address, unsigned short port, Scene* scene, const VariantMap& identity = Variant::emptyVariantMap);
+    /// Connect a client to the server in this process through a simulated link instead of a socket, for headless testing and benchmarking. The scene must be separate from the server's scene. Return the client-side connection, whose simulated link can be used to set the network conditions.
+    Connection* ConnectLoopback(Scene* scene, const VariantMap& identity = Variant::emptyVariantMap);
     /// Disconnect the connection to the server. If wait time is non-zero, will block while waiting for disconnect to finish.
     void Disconnect(int waitMSec = 0);
     /// Start a server on a port using UDP protocol. Return true if successful.
@@ -91,6 +96,8 @@ public:
     void UnregisterAllRemoteEvents();
     /// Set the package download cache directory.
     void SetPackageCacheDir(const String& path);
+    /// Set whether to account sent traffic per message type and replicated object type on all current and future connections.
+    void SetTrackStatistics(bool enable);
     /// Trigger all client connections in the specified scene to download a package file from the server. Can be used to download additional resource packages when clients are already joined in the scene. The package must have been added as a requirement to the scene, or else the eventual download will fail.
     void SendPackageToClients(Scene* scene, PackageFile* package);
     /// Perform an HTTP request to the specified URL. Empty verb defaults to a GET request. Return a request object which can be used to read the response data.
@@ -104,12 +111,18 @@ public:
     Connection* GetServerConnection() const;
     /// Return all client connections.
     Vector<SharedPtr<Connection> > GetClientConnections() const;
+    /// Return the client-side connections of simulated links.
+    const Vector<SharedPtr<Connection> >& GetLoopbackConnections() const { return loopbackConnections_; }
     /// Return whether the server is running.
     bool IsServerRunning() const;
     /// Return whether a remote event is allowed to be received.
     bool CheckRemoteEvent(StringHash eventType) const;
     /// Return the package download cache directory.
     const String& GetPackageCacheDir() const { return packageCacheDir_; }
+    /// Return whether sent traffic is accounted on new connections.
+    bool GetTrackStatistics() const { return trackStatistics_; }
+    /// Return the traffic statistics of the last completed interval summed over the server connection and all client connections. Loopback traffic is counted once, from the server end.
+    ConnectionStatistics GetStatistics() const;
     
     /// Process incoming messages from connections. Called by HandleBeginFrame.
     void Update(float timeStep);
@@ -125,30 +138,56 @@ private:
     void OnServerConnected();
     /// Handle server disconnection.
     void OnServerDisconnected();
+    /// Process a message received by a connection, or forward it as an event if not handled internally.
+    void DispatchMessage(Connection* connection, int msgID, MemoryBuffer& msg);
+    /// Remove a client connection by its kNet MessageConnection or simulated link.
+    void RemoveClientConnection(void* key);
+    /// Deliver arrived messages on simulated links and remove closed links.
+    void UpdateLoopbackConnections(float timeStep);
+    /// Rebuild the relevance grids of networked scenes.
+    void UpdateRelevanceGrids();
+    /// Return the relevance grid of a scene, or null if none of its clients use a relevance distance.
+    const RelevanceGrid* GetRelevanceGrid(Scene* scene) const;
+    /// Rebuild the join snapshots of networked scenes that have clients waiting for the initial scene state.
+    void UpdateJoinSnapshots();
+    /// Return the join snapshot of a scene built during this update, or null if none.
+    const JoinSnapshot* GetJoinSnapshot(Scene* scene) const;
     
     /// kNet instance.
     kNet::Network* network_;
     /// Client's server connection.
     SharedPtr<Connection> serverConnection_;
-    /// Server's client connections.
-    HashMap<kNet::MessageConnection*, SharedPtr<Connection> > clientConnections_;
+    /// Server's client connections, keyed by kNet MessageConnection or simulated link.
+    HashMap<void*, SharedPtr<Connection> > clientConnections_;
+    /// Client-side connections of simulated links.
+    Vector<SharedPtr<Connection> > loopbackConnections_;
     /// Allowed remote events.
     HashSet<StringHash> allowedRemoteEvents_;
     /// Remote event fixed blacklist.
     HashSet<StringHash> blacklistedRemoteEvents_;
     /// Networked scenes.
     HashSet<Scene*> networkScenes_;
+    /// Relevance grids of networked scenes that have clients with a relevance distance.
+    HashMap<Scene*, RelevanceGrid> relevanceGrids_;
+    /// Join snapshots of networked scenes that have clients waiting for the initial scene state.
+    HashMap<Scene*, JoinSnapshot> joinSnapshots_;
     /// Update FPS.
     int updateFps_;
     /// Update time interval.
     float updateInterval_;
     /// Update time accumulator.
     float updateAcc_;
+    /// Millisecond clock for the server time sent in network updates.
+    Timer networkTimer_;
     /// Package cache directory.
     String packageCacheDir_;
+    /// Track statistics flag for new connections.
+    bool trackStatistics_;
 };
 
 /// Register Network library objects.
 void URHO3D_API RegisterNetworkLibrary(Context* context);
+/// Return the name of a built-in network message ID, or the ID as a string for application messages.
+String URHO3D_API GetNetworkMessageName(int msgID);
 
 }
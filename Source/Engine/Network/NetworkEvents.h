@@ -91,6 +91,14 @@ EVENT(E_NETWORKSCENELOADFAILED, NetworkSceneLoadFailed)
     PARAM(P_CONNECTION, Connection);      // Connection pointer
 }
 
+/// Client-owned node state received from the server has been applied. Reapply the controls sent after the acknowledged sequence number for client-side prediction.
+EVENT(E_SERVERSTATEAPPLIED, ServerStateApplied)
+{
+    PARAM(P_CONNECTION, Connection);      // Connection pointer
+    PARAM(P_NODE, Node);                  // Node pointer
+    PARAM(P_CONTROLSSEQUENCE, ControlsSequence);  // unsigned
+}
+
 /// Remote event: adds Connection parameter to the event data
 EVENT(E_REMOTEEVENTDATA, RemoteEventData)
 {
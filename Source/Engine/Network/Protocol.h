@@ -31,10 +31,10 @@ static const int MSG_IDENTITY = 0x5;
 static const int MSG_CONTROLS = 0x6;
 /// Client->server: scene has been loaded and client is ready to proceed.
 static const int MSG_SCENELOADED = 0x7;
-/// Client->server: request a package file.
+/// Client->server: request ranges of package file fragments. Also used to request a fragment again after a checksum mismatch.
 static const int MSG_REQUESTPACKAGE = 0x8;
 
-/// Server->client: package file data fragment.
+/// Server->client: package file data fragment with its checksum.
 static const int MSG_PACKAGEDATA = 0x9;
 /// Server->client: load new scene. In case of empty filename the client should just empty the scene.
 static const int MSG_LOADSCENE = 0xa;
@@ -63,10 +63,26 @@ static const int MSG_REMOTEEVENT = 0x14;
 static const int MSG_REMOTENODEEVENT = 0x15;
 /// Server->client: info about package.
 static const int MSG_PACKAGEINFO = 0x16;
+/// Server->client: part of a delta-compressed scene snapshot.
+static const int MSG_SNAPSHOT = 0x17;
+/// Client->server: acknowledge a fully applied scene snapshot.
+static const int MSG_SNAPSHOTACK = 0x18;
+/// Server->client: part of the compressed node creation entries of the whole scene, sent to a client that has just loaded the scene.
+static const int MSG_JOINSNAPSHOT = 0x19;
+/// Server->client: unacknowledged snapshot changes up to the snapshot ID have been resent as reliable delta updates.
+static const int MSG_SNAPSHOTRESEND = 0x1a;
 
 /// Fixed content ID for client controls update.
 static const unsigned CONTROLS_CONTENT_ID = 1;
+/// Fixed content ID for snapshot acknowledgements.
+static const unsigned SNAPSHOTACK_CONTENT_ID = 1;
 /// Package file fragment size.
 static const unsigned PACKAGE_FRAGMENT_SIZE = 1024;
+/// Maximum number of outbound messages pending on a connection before more package fragments are sent.
+static const unsigned PACKAGE_SEND_WINDOW = 1000;
+/// Maximum scene snapshot part size, to keep the parts from being fragmented.
+static const unsigned SNAPSHOT_PART_SIZE = 1024;
+/// Join snapshot part size, to keep the parts from being fragmented.
+static const unsigned JOIN_SNAPSHOT_PART_SIZE = 1024;
 
 }
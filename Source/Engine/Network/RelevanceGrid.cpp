@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Node.h"
+#include "RelevanceGrid.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+RelevanceGrid::RelevanceGrid() :
+    cellSize_(1.0f)
+{
+}
+
+void RelevanceGrid::Build(Node* scene, float cellSize)
+{
+    cellSize_ = Max(cellSize, M_EPSILON);
+
+    // Clear the cells but keep them in the map, so that the cells still occupied after the rebuild reuse their vectors. Only the
+    // cells left empty are erased below
+    for (HashMap<unsigned, PODVector<RelevanceGridEntry> >::Iterator i = cells_.Begin(); i != cells_.End(); ++i)
+        i->second_.Clear();
+
+    const Vector<SharedPtr<Node> >& children = scene->GetChildren();
+    for (Vector<SharedPtr<Node> >::ConstIterator i = children.Begin(); i != children.End(); ++i)
+    {
+        RelevanceGridEntry entry;
+        entry.node_ = *i;
+        entry.position_ = entry.node_->GetWorldPosition();
+
+        int x = (int)floorf(entry.position_.x_ / cellSize_);
+        int z = (int)floorf(entry.position_.z_ / cellSize_);
+        cells_[GetCellKey(x, z)].Push(entry);
+    }
+
+    // Remove the cells that were left empty, so that the map does not grow without bound as nodes move around the world
+    for (HashMap<unsigned, PODVector<RelevanceGridEntry> >::Iterator i = cells_.Begin(); i != cells_.End();)
+    {
+        if (i->second_.Empty())
+            i = cells_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void RelevanceGrid::GetNodes(PODVector<const RelevanceGridEntry*>& result, const Vector3& position, float distance) const
+{
+    result.Clear();
+
+    int minX = (int)floorf((position.x_ - distance) / cellSize_);
+    int maxX = (int)floorf((position.x_ + distance) / cellSize_);
+    int minZ = (int)floorf((position.z_ - distance) / cellSize_);
+    int maxZ = (int)floorf((position.z_ + distance) / cellSize_);
+    float distanceSquared = distance * distance;
+
+    for (int z = minZ; z <= maxZ; ++z)
+    {
+        for (int x = minX; x <= maxX; ++x)
+        {
+            HashMap<unsigned, PODVector<RelevanceGridEntry> >::ConstIterator i = cells_.Find(GetCellKey(x, z));
+            if (i == cells_.End())
+                continue;
+
+            // Cell keys may wrap around in very large worlds, so check the actual distance
+            const PODVector<RelevanceGridEntry>& entries = i->second_;
+            for (PODVector<RelevanceGridEntry>::ConstIterator j = entries.Begin(); j != entries.End(); ++j)
+            {
+                if ((j->position_ - position).LengthSquared() <= distanceSquared)
+                    result.Push(&(*j));
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,68 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "HashMap.h"
+#include "Vector3.h"
+
+namespace Urho3D
+{
+
+class Node;
+
+/// Top-level scene node stored in a relevance grid.
+struct RelevanceGridEntry
+{
+    /// Node.
+    Node* node_;
+    /// World position of the node at the time the grid was built.
+    Vector3 position_;
+};
+
+/// Grid of the top-level nodes of a scene on the XZ plane, for finding the nodes relevant to a network client. Read-only after building, so it can be queried from several threads.
+class URHO3D_API RelevanceGrid
+{
+public:
+    /// Construct.
+    RelevanceGrid();
+
+    /// Rebuild from the child nodes of a scene with the specified cell size.
+    void Build(Node* scene, float cellSize);
+    /// Return the nodes within the specified distance of a position.
+    void GetNodes(PODVector<const RelevanceGridEntry*>& result, const Vector3& position, float distance) const;
+
+    /// Return cell size.
+    float GetCellSize() const { return cellSize_; }
+
+private:
+    /// Return the key of a cell by its coordinates.
+    unsigned GetCellKey(int x, int z) const { return ((unsigned)x & 0xffff) << 16 | ((unsigned)z & 0xffff); }
+
+    /// Nodes by cell key.
+    HashMap<unsigned, PODVector<RelevanceGridEntry> > cells_;
+    /// Cell size.
+    float cellSize_;
+};
+
+}
@@ -0,0 +1,274 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Connection.h"
+#include "SimulatedLink.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Additional delay of a lost reliable message before it is resent, on top of the round trip.
+static const float RESEND_DELAY = 0.02f;
+/// Maximum number of simulated resends of a reliable message.
+static const unsigned MAX_RESENDS = 16;
+
+SimulatedChannel::SimulatedChannel() :
+    freeTime_(0.0f),
+    lastInOrderTime_(0.0f),
+    bytesSent_(0),
+    messagesSent_(0),
+    messagesDropped_(0)
+{
+}
+
+SimulatedLink::SimulatedLink() :
+    time_(0.0f),
+    latency_(0.0f),
+    jitter_(0.0f),
+    packetLoss_(0.0f),
+    bandwidth_(0),
+    randomSeed_(1),
+    connected_(true)
+{
+}
+
+void SimulatedLink::SetConnections(Connection* clientConnection, Connection* serverConnection)
+{
+    clientConnection_ = clientConnection;
+    serverConnection_ = serverConnection;
+}
+
+void SimulatedLink::SetLatency(float latency)
+{
+    latency_ = Max(latency, 0.0f);
+}
+
+void SimulatedLink::SetJitter(float jitter)
+{
+    jitter_ = Max(jitter, 0.0f);
+}
+
+void SimulatedLink::SetPacketLoss(float packetLoss)
+{
+    packetLoss_ = Clamp(packetLoss, 0.0f, 1.0f);
+}
+
+void SimulatedLink::SetBandwidth(unsigned bandwidth)
+{
+    bandwidth_ = bandwidth;
+}
+
+void SimulatedLink::SetRandomSeed(unsigned seed)
+{
+    randomSeed_ = seed;
+}
+
+void SimulatedLink::SendMessage(Connection* sender, int msgID, bool reliable, bool inOrder, const unsigned char* data,
+    unsigned numBytes, unsigned contentID)
+{
+    SimulatedChannel* channel = GetSendChannel(sender);
+    if (!channel || !connected_)
+        return;
+
+    channel->bytesSent_ += numBytes;
+    ++channel->messagesSent_;
+
+    // The message occupies the link for its transmission time, after any messages still being transmitted
+    float sendTime = Max(time_, channel->freeTime_);
+    if (bandwidth_)
+        sendTime += (float)numBytes / (float)bandwidth_;
+    channel->freeTime_ = sendTime;
+
+    float deliveryTime = sendTime + latency_;
+    if (jitter_ > 0.0f)
+        deliveryTime += NextRandom() * jitter_;
+
+    if (packetLoss_ > 0.0f)
+    {
+        if (!reliable)
+        {
+            if (NextRandom() < packetLoss_)
+            {
+                ++channel->messagesDropped_;
+                return;
+            }
+        }
+        else
+        {
+            // A lost reliable message arrives after the sender has noticed the missing acknowledgement and resent it
+            for (unsigned i = 0; i < MAX_RESENDS && NextRandom() < packetLoss_; ++i)
+                deliveryTime += 2.0f * latency_ + RESEND_DELAY;
+        }
+    }
+
+    if (inOrder)
+    {
+        deliveryTime = Max(deliveryTime, channel->lastInOrderTime_);
+        channel->lastInOrderTime_ = deliveryTime;
+    }
+
+    // Like kNet, a newer unreliable message with the same content ID replaces one still in flight
+    List<SimulatedMessage>& messages = channel->messages_;
+    if (!reliable && contentID)
+    {
+        for (List<SimulatedMessage>::Iterator i = messages.Begin(); i != messages.End(); ++i)
+        {
+            if (!i->reliable_ && i->msgID_ == msgID && i->contentID_ == contentID)
+            {
+                messages.Erase(i);
+                break;
+            }
+        }
+    }
+
+    // Keep the messages sorted by delivery time. Search from the back, as new messages usually arrive last
+    List<SimulatedMessage>::Iterator dest = messages.End();
+    while (dest != messages.Begin())
+    {
+        List<SimulatedMessage>::Iterator prev = dest;
+        --prev;
+        if (prev->deliveryTime_ <= deliveryTime)
+            break;
+        dest = prev;
+    }
+
+    SimulatedMessage message;
+    message.msgID_ = msgID;
+    message.contentID_ = contentID;
+    message.reliable_ = reliable;
+    message.deliveryTime_ = deliveryTime;
+    messages.Insert(dest, message);
+
+    // Copy the data in place to avoid copying it twice
+    --dest;
+    dest->data_.Resize(numBytes);
+    if (numBytes)
+        memcpy(&dest->data_[0], data, numBytes);
+}
+
+void SimulatedLink::Update(float timeStep)
+{
+    time_ += timeStep;
+}
+
+bool SimulatedLink::ReceiveMessage(Connection* receiver, SimulatedMessage& dest)
+{
+    SimulatedChannel* channel = 0;
+    if (receiver && receiver == serverConnection_)
+        channel = &toServer_;
+    else if (receiver && receiver == clientConnection_)
+        channel = &toClient_;
+
+    if (!channel || !connected_ || channel->messages_.Empty() || channel->messages_.Front().deliveryTime_ > time_)
+        return false;
+
+    dest = channel->messages_.Front();
+    channel->messages_.PopFront();
+    return true;
+}
+
+void SimulatedLink::Disconnect()
+{
+    connected_ = false;
+    toServer_.messages_.Clear();
+    toClient_.messages_.Clear();
+}
+
+unsigned SimulatedLink::GetNumPendingMessages(Connection* sender) const
+{
+    const SimulatedChannel* channel = GetSendChannel(sender);
+    return channel ? channel->messages_.Size() : 0;
+}
+
+unsigned SimulatedLink::GetBytesSent(Connection* sender) const
+{
+    const SimulatedChannel* channel = GetSendChannel(sender);
+    return channel ? channel->bytesSent_ : 0;
+}
+
+unsigned SimulatedLink::GetMessagesSent(Connection* sender) const
+{
+    const SimulatedChannel* channel = GetSendChannel(sender);
+    return channel ? channel->messagesSent_ : 0;
+}
+
+unsigned SimulatedLink::GetMessagesDropped(Connection* sender) const
+{
+    const SimulatedChannel* channel = GetSendChannel(sender);
+    return channel ? channel->messagesDropped_ : 0;
+}
+
+SimulatedChannel* SimulatedLink::GetSendChannel(Connection* sender)
+{
+    if (!sender)
+        return 0;
+    else if (sender == clientConnection_)
+        return &toServer_;
+    else if (sender == serverConnection_)
+        return &toClient_;
+    else
+        return 0;
+}
+
+const SimulatedChannel* SimulatedLink::GetSendChannel(Connection* sender) const
+{
+    return const_cast<SimulatedLink*>(this)->GetSendChannel(sender);
+}
+
+float SimulatedLink::NextRandom()
+{
+    randomSeed_ = randomSeed_ * 214013 + 2531011;
+    return ((randomSeed_ >> 16) & 32767) / 32768.0f;
+}
+
+SimulatedTransport::SimulatedTransport(SimulatedLink* link, Connection* connection) :
+    link_(link),
+    connection_(connection)
+{
+}
+
+void SimulatedTransport::SendMessage(int msgID, bool reliable, bool inOrder, const unsigned char* data, unsigned numBytes,
+    unsigned contentID)
+{
+    link_->SendMessage(connection_, msgID, reliable, inOrder, data, numBytes, contentID);
+}
+
+void SimulatedTransport::Disconnect(int waitMSec)
+{
+    link_->Disconnect();
+}
+
+bool SimulatedTransport::IsConnected() const
+{
+    return link_->IsConnected();
+}
+
+unsigned SimulatedTransport::GetNumPendingMessages() const
+{
+    return link_->GetNumPendingMessages(connection_);
+}
+
+}
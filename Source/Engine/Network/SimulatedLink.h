@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "List.h"
+#include "MessageTransport.h"
+#include "Ptr.h"
+
+namespace Urho3D
+{
+
+class Connection;
+
+/// Message in flight on a simulated link.
+struct SimulatedMessage
+{
+    /// Message ID.
+    int msgID_;
+    /// Content ID.
+    unsigned contentID_;
+    /// Reliable flag.
+    bool reliable_;
+    /// Time at which the message arrives.
+    float deliveryTime_;
+    /// Message data.
+    PODVector<unsigned char> data_;
+};
+
+/// One direction of a simulated link.
+struct SimulatedChannel
+{
+    /// Construct.
+    SimulatedChannel();
+
+    /// Messages in flight, sorted by delivery time.
+    List<SimulatedMessage> messages_;
+    /// Time at which the bandwidth-limited link is free to send again.
+    float freeTime_;
+    /// Delivery time of the last in-order message.
+    float lastInOrderTime_;
+    /// Total bytes sent.
+    unsigned bytesSent_;
+    /// Total messages sent.
+    unsigned messagesSent_;
+    /// Unreliable messages dropped.
+    unsigned messagesDropped_;
+};
+
+/// In-process message transport between a client-side and a server-side Connection, with simulated latency, jitter, packet loss and bandwidth. Replaces kNet sockets for headless testing and benchmarking of replication.
+class URHO3D_API SimulatedLink : public RefCounted
+{
+public:
+    /// Construct.
+    SimulatedLink();
+
+    /// Set the connections at the client and server ends.
+    void SetConnections(Connection* clientConnection, Connection* serverConnection);
+    /// Set one-way latency in seconds.
+    void SetLatency(float latency);
+    /// Set maximum random additional one-way delay in seconds.
+    void SetJitter(float jitter);
+    /// Set packet loss probability (0-1). Unreliable messages are dropped, reliable messages are delayed by a resend.
+    void SetPacketLoss(float packetLoss);
+    /// Set bandwidth in bytes per second in each direction. 0 is unlimited.
+    void SetBandwidth(unsigned bandwidth);
+    /// Set the seed of the link's own random number generator, for reproducible conditions.
+    void SetRandomSeed(unsigned seed);
+    /// Queue a message from one end of the link to the other.
+    void SendMessage(Connection* sender, int msgID, bool reliable, bool inOrder, const unsigned char* data, unsigned numBytes, unsigned contentID);
+    /// Advance the link time.
+    void Update(float timeStep);
+    /// Take the next message that has arrived at a connection. Return true if one was available.
+    bool ReceiveMessage(Connection* receiver, SimulatedMessage& dest);
+    /// Close the link. Messages in flight are discarded.
+    void Disconnect();
+
+    /// Return the client-side connection.
+    Connection* GetClientConnection() const { return clientConnection_; }
+    /// Return the server-side connection.
+    Connection* GetServerConnection() const { return serverConnection_; }
+    /// Return one-way latency in seconds.
+    float GetLatency() const { return latency_; }
+    /// Return maximum random additional one-way delay in seconds.
+    float GetJitter() const { return jitter_; }
+    /// Return packet loss probability.
+    float GetPacketLoss() const { return packetLoss_; }
+    /// Return bandwidth in bytes per second. 0 is unlimited.
+    unsigned GetBandwidth() const { return bandwidth_; }
+    /// Return whether the link is open.
+    bool IsConnected() const { return connected_; }
+    /// Return number of messages sent by a connection that are still in flight.
+    unsigned GetNumPendingMessages(Connection* sender) const;
+    /// Return total bytes sent by a connection.
+    unsigned GetBytesSent(Connection* sender) const;
+    /// Return total messages sent by a connection.
+    unsigned GetMessagesSent(Connection* sender) const;
+    /// Return number of unreliable messages sent by a connection that were dropped.
+    unsigned GetMessagesDropped(Connection* sender) const;
+
+private:
+    /// Return the channel that messages from a connection are sent on, or null if the connection is not an end of the link.
+    SimulatedChannel* GetSendChannel(Connection* sender);
+    /// Return the channel that messages from a connection are sent on, or null if the connection is not an end of the link.
+    const SimulatedChannel* GetSendChannel(Connection* sender) const;
+    /// Return a random number in the range 0-1.
+    float NextRandom();
+
+    /// Client-side connection.
+    WeakPtr<Connection> clientConnection_;
+    /// Server-side connection.
+    WeakPtr<Connection> serverConnection_;
+    /// Messages from the client to the server.
+    SimulatedChannel toServer_;
+    /// Messages from the server to the client.
+    SimulatedChannel toClient_;
+    /// Current link time.
+    float time_;
+    /// One-way latency in seconds.
+    float latency_;
+    /// Maximum random additional one-way delay in seconds.
+    float jitter_;
+    /// Packet loss probability.
+    float packetLoss_;
+    /// Bandwidth in bytes per second.
+    unsigned bandwidth_;
+    /// Random number generator state.
+    unsigned randomSeed_;
+    /// Open flag.
+    bool connected_;
+};
+
+/// %Message transport using one end of a simulated link.
+class URHO3D_API SimulatedTransport : public MessageTransport
+{
+public:
+    /// Construct with the link and the connection at this end.
+    SimulatedTransport(SimulatedLink* link, Connection* connection);
+
+    /// Send a message to the other end of the link.
+    virtual void SendMessage(int msgID, bool reliable, bool inOrder, const unsigned char* data, unsigned numBytes, unsigned contentID);
+    /// Close the link. Does not wait.
+    virtual void Disconnect(int waitMSec);
+
+    /// Return whether the link is open.
+    virtual bool IsConnected() const;
+    /// Return number of messages sent from this end that are still in flight.
+    virtual unsigned GetNumPendingMessages() const;
+
+private:
+    /// Simulated link.
+    SharedPtr<SimulatedLink> link_;
+    /// Connection at this end. Owns the transport.
+    Connection* connection_;
+};
+
+}
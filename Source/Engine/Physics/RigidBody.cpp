@@ -129,6 +129,9 @@ void RigidBody::RegisterObject(Context* context)
     ATTRIBUTE(RigidBody, VAR_BOOL, "Is Kinematic", kinematic_, false, AM_DEFAULT);
     ATTRIBUTE(RigidBody, VAR_BOOL, "Is Trigger", trigger_, false, AM_DEFAULT);
     REF_ACCESSOR_ATTRIBUTE(RigidBody, VAR_VECTOR3, "Gravity Override", GetGravityOverride, SetGravityOverride, Vector3, Vector3::ZERO, AM_DEFAULT);
+
+    // Send the linear velocity with 1/256 unit precision
+    context->SetAttributeQuantization<RigidBody>("Linear Velocity", 8);
 }
 
 void RigidBody::OnSetAttribute(const AttributeInfo& attr, const Variant& src)
@@ -34,86 +34,144 @@
 namespace Urho3D
 {
 
-BackgroundLoader::BackgroundLoader(ResourceCache* owner) :
-    owner_(owner)
+/// Return whether a queued resource should be loaded before another: higher priority first, and of equal priority the one
+/// that more resources are waiting for.
+static bool IsLoadedBefore(const BackgroundLoadItem* lhs, const BackgroundLoadItem* rhs)
 {
+    if (lhs->priority_ != rhs->priority_)
+        return lhs->priority_ > rhs->priority_;
+    else
+        return lhs->dependents_.Size() > rhs->dependents_.Size();
 }
 
-void BackgroundLoader::ThreadFunction()
+/// Loader thread managed by the background loader.
+class BackgroundLoaderThread : public Thread, public RefCounted
 {
-    while (shouldRun_)
+public:
+    /// Construct.
+    BackgroundLoaderThread(BackgroundLoader* owner) :
+        owner_(owner)
     {
-        backgroundLoadMutex_.Acquire();
-        
-        // Search for a queued resource that has not been loaded yet
-        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Begin();
-        while (i != backgroundLoadQueue_.End())
-        {
-            if (i->second_.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
-                break;
-            else
-                ++i;
-        }
-        
-        if (i == backgroundLoadQueue_.End())
+    }
+    
+    /// Load queued resources until stopped.
+    virtual void ThreadFunction()
+    {
+        while (shouldRun_)
         {
-            // No resources to load found
-            backgroundLoadMutex_.Release();
-            Time::Sleep(5);
+            if (!owner_->LoadNextResource())
+                Time::Sleep(5);
         }
-        else
+    }
+    
+private:
+    /// Background loader.
+    BackgroundLoader* owner_;
+};
+
+BackgroundLoader::BackgroundLoader(ResourceCache* owner) :
+    owner_(owner),
+    numThreads_(1)
+{
+}
+
+BackgroundLoader::~BackgroundLoader()
+{
+    for (unsigned i = 0; i < threads_.Size(); ++i)
+        threads_[i]->Stop();
+}
+
+void BackgroundLoader::SetNumThreads(unsigned num)
+{
+    num = Max((int)num, 1);
+    if (num == numThreads_)
+        return;
+    
+    numThreads_ = num;
+    if (threads_.Empty())
+        return;
+    
+    for (unsigned i = 0; i < threads_.Size(); ++i)
+        threads_[i]->Stop();
+    threads_.Clear();
+    StartThreads();
+}
+
+bool BackgroundLoader::LoadNextResource()
+{
+    backgroundLoadMutex_.Acquire();
+    
+    // The ready list is kept in load order, so the next resource to load is at its end
+    if (readyItems_.Empty())
+    {
+        // No resources to load found
+        backgroundLoadMutex_.Release();
+        return false;
+    }
+    
+    BackgroundLoadItem& item = *readyItems_.Back();
+    readyItems_.Pop();
+    Resource* resource = item.resource_;
+    // Claim the resource while holding the mutex so that no other loader thread picks it. We can be sure that the item
+    // is not removed from the queue as long as it is in the "queued" or "loading" state
+    resource->SetAsyncLoadState(ASYNC_LOADING);
+    item.waitTime_ = item.timer_.GetUSec(true);
+    backgroundLoadMutex_.Release();
+    
+    bool success = false;
+    SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
+    if (file)
+        success = resource->BeginLoad(*file);
+    
+    // Process dependencies now
+    // Need to lock the queue again when manipulating other entries
+    Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
+    backgroundLoadMutex_.Acquire();
+    item.beginLoadTime_ = item.timer_.GetUSec(true);
+    if (item.dependents_.Size())
+    {
+        for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin(); i != item.dependents_.End(); ++i)
         {
-            BackgroundLoadItem& item = i->second_;
-            Resource* resource = item.resource_;
-            // We can be sure that the item is not removed from the queue as long as it is in the
-            // "queued" or "loading" state
-            backgroundLoadMutex_.Release();
-            
-            bool success = false;
-            SharedPtr<File> file = owner_->GetFile(resource->GetName(), item.sendEventOnFailure_);
-            if (file)
-            {
-                resource->SetAsyncLoadState(ASYNC_LOADING);
-                success = resource->BeginLoad(*file);
-            }
-            
-            // Process dependencies now
-            // Need to lock the queue again when manipulating other entries
-            Pair<StringHash, StringHash> key = MakePair(resource->GetType(), resource->GetNameHash());
-            backgroundLoadMutex_.Acquire();
-            if (item.dependents_.Size())
-            {
-                for (HashSet<Pair<StringHash, StringHash> >::Iterator i = item.dependents_.Begin(); i != item.dependents_.End();
-                    ++i)
-                {
-                    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j =
-                        backgroundLoadQueue_.Find(*i);
-                    if (j != backgroundLoadQueue_.End())
-                        j->second_.dependencies_.Erase(key);
-                }
-                
-                item.dependents_.Clear();
-            }
-            
-            resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
-            backgroundLoadMutex_.Release();
+            HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
+            if (j != backgroundLoadQueue_.End())
+                j->second_.dependencies_.Erase(key);
         }
+        
+        item.dependents_.Clear();
     }
+    
+    resource->SetAsyncLoadState(success ? ASYNC_SUCCESS : ASYNC_FAIL);
+    backgroundLoadMutex_.Release();
+    
+    return true;
 }
 
-bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller)
+bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller,
+    int priority)
 {
     StringHash nameHash(name);
     Pair<StringHash, StringHash> key = MakePair(type, nameHash);
     
     MutexLock lock(backgroundLoadMutex_);
     
-    // Check if already exists in the queue
-    if (backgroundLoadQueue_.Find(key) != backgroundLoadQueue_.End())
+    // Check if already exists in the queue. If requested again with a higher priority, raise it
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
+    if (i != backgroundLoadQueue_.End())
+    {
+        // If the resource was queued before the caller requested it, for example when prefetching, the caller still
+        // needs to wait for it unless it has already been loaded
+        AsyncLoadState state = i->second_.resource_->GetAsyncLoadState();
+        if (caller && (state == ASYNC_QUEUED || state == ASYNC_LOADING))
+            AddDependent(i->second_, key, caller);
+        RaisePriority(i->second_, priority);
         return false;
+    }
     
     BackgroundLoadItem& item = backgroundLoadQueue_[key];
+    item.priority_ = priority;
     item.sendEventOnFailure_ = sendEventOnFailure;
+    item.waitTime_ = 0;
+    item.beginLoadTime_ = 0;
     
     // Make sure the pointer is non-null and is a Resource subclass
     item.resource_ = DynamicCast<Resource>(owner_->GetContext()->CreateObject(type));
@@ -138,25 +196,15 @@ bool BackgroundLoader::QueueResource(StringHash type, const String& name, bool s
 
     item.resource_->SetName(name);
     item.resource_->SetAsyncLoadState(ASYNC_QUEUED);
+    AddReadyItem(&item);
     
     // If this is a resource calling for the background load of more resources, mark the dependency as necessary
     if (caller)
-    {
-        Pair<StringHash, StringHash> callerKey = MakePair(caller->GetType(), caller->GetNameHash());
-        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(callerKey);
-        if (j != backgroundLoadQueue_.End())
-        {
-            BackgroundLoadItem& callerItem = j->second_;
-            item.dependents_.Insert(callerKey);
-            callerItem.dependencies_.Insert(key);
-        }
-        else
-            LOGWARNING("Resource " + caller->GetName() + " requested for a background loaded resource but was not in the background load queue");
-    }
+        AddDependent(item, key, caller);
     
-    // Start the background loader thread now
-    if (!IsStarted())
-        Run();
+    // Start the background loader threads now
+    if (threads_.Empty())
+        StartThreads();
     
     return true;
 }
@@ -170,6 +218,8 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator i = backgroundLoadQueue_.Find(key);
     if (i != backgroundLoadQueue_.End())
     {
+        // The main thread is stalled until the resource finishes, so have it loaded next
+        RaisePriority(i->second_, M_MAX_INT);
         backgroundLoadMutex_.Release();
         
         {
@@ -207,7 +257,7 @@ void BackgroundLoader::WaitForResource(StringHash type, StringHash nameHash)
 
 void BackgroundLoader::FinishResources(int maxMs)
 {
-    if (IsStarted())
+    if (!threads_.Empty())
     {
         HiresTimer timer;
 
@@ -246,11 +296,86 @@ unsigned BackgroundLoader::GetNumQueuedResources() const
     return backgroundLoadQueue_.Size();
 }
 
+void BackgroundLoader::StartThreads()
+{
+    for (unsigned i = 0; i < numThreads_; ++i)
+    {
+        SharedPtr<BackgroundLoaderThread> thread(new BackgroundLoaderThread(this));
+        thread->Run();
+        threads_.Push(thread);
+    }
+}
+
+void BackgroundLoader::AddReadyItem(BackgroundLoadItem* item)
+{
+    // Binary search for the position after the resources that load later. Resources that load at the same time stay in
+    // queuing order
+    unsigned start = 0;
+    unsigned end = readyItems_.Size();
+    while (start < end)
+    {
+        unsigned middle = (start + end) >> 1;
+        if (IsLoadedBefore(item, readyItems_[middle]))
+            start = middle + 1;
+        else
+            end = middle;
+    }
+    
+    readyItems_.Insert(start, item);
+}
+
+void BackgroundLoader::RaisePriority(BackgroundLoadItem& item, int priority)
+{
+    if (priority <= item.priority_)
+        return;
+    
+    // Move in the ready list if not loading yet
+    if (item.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
+    {
+        readyItems_.Remove(&item);
+        item.priority_ = priority;
+        AddReadyItem(&item);
+    }
+    else
+        item.priority_ = priority;
+    for (HashSet<Pair<StringHash, StringHash> >::ConstIterator i = item.dependencies_.Begin(); i != item.dependencies_.End(); ++i)
+    {
+        HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(*i);
+        if (j != backgroundLoadQueue_.End())
+            RaisePriority(j->second_, priority);
+    }
+}
+
+void BackgroundLoader::AddDependent(BackgroundLoadItem& item, const Pair<StringHash, StringHash>& key, Resource* caller)
+{
+    Pair<StringHash, StringHash> callerKey = MakePair(caller->GetType(), caller->GetNameHash());
+    HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem>::Iterator j = backgroundLoadQueue_.Find(callerKey);
+    if (j != backgroundLoadQueue_.End())
+    {
+        BackgroundLoadItem& callerItem = j->second_;
+        callerItem.dependencies_.Insert(key);
+        // The amount of dependents affects the load order, so move in the ready list if not loading yet
+        if (item.resource_->GetAsyncLoadState() == ASYNC_QUEUED)
+        {
+            readyItems_.Remove(&item);
+            item.dependents_.Insert(callerKey);
+            AddReadyItem(&item);
+        }
+        else
+            item.dependents_.Insert(callerKey);
+        // The caller can not finish before its dependencies, so load them at least at its priority
+        RaisePriority(item, callerItem.priority_);
+    }
+    else
+        LOGWARNING("Resource " + caller->GetName() + " requested for a background loaded resource but was not in the background load queue");
+}
+
 void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
 {
     Resource* resource = item.resource_;
     
     bool success = resource->GetAsyncLoadState() == ASYNC_SUCCESS;
+    HiresTimer endLoadTimer;
     // If BeginLoad() phase was successful, call EndLoad() and get the final success/failure result
     if (success)
     {
@@ -270,6 +395,10 @@ void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
 #endif
     }
     resource->SetAsyncLoadState(ASYNC_DONE);
+    long long endLoadTime = endLoadTimer.GetUSec(false);
+    
+    LOGDEBUGF("Background loaded resource %s: waited %d us, BeginLoad %d us, EndLoad %d us", resource->GetName().CString(),
+        (int)item.waitTime_, (int)item.beginLoadTime_, (int)endLoadTime);
     
     if (!success && item.sendEventOnFailure_)
     {
@@ -288,6 +417,9 @@ void BackgroundLoader::FinishBackgroundLoading(BackgroundLoadItem& item)
         eventData[P_RESOURCENAME] = resource->GetName();
         eventData[P_SUCCESS] = success;
         eventData[P_RESOURCE] = resource;
+        eventData[P_WAITTIME] = (int)item.waitTime_;
+        eventData[P_BEGINLOADTIME] = (int)item.beginLoadTime_;
+        eventData[P_ENDLOADTIME] = (int)endLoadTime;
         owner_->SendEvent(E_RESOURCEBACKGROUNDLOADED, eventData);
     }
     
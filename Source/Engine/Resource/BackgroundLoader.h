@@ -29,10 +29,12 @@
 #include "RefCounted.h"
 #include "StringHash.h"
 #include "Thread.h"
+#include "Timer.h"
 
 namespace Urho3D
 {
 
+class BackgroundLoaderThread;
 class Resource;
 class ResourceCache;
 
@@ -45,40 +47,69 @@ struct BackgroundLoadItem
     HashSet<Pair<StringHash, StringHash> > dependencies_;
     /// Resources that depend on this resource's loading.
     HashSet<Pair<StringHash, StringHash> > dependents_;
+    /// Load priority. Higher value = will be loaded first.
+    int priority_;
     /// Whether to send failure event.
     bool sendEventOnFailure_;
+    /// Timer started when queued.
+    HiresTimer timer_;
+    /// Time spent in the queue before loading started, in microseconds.
+    long long waitTime_;
+    /// Time spent in BeginLoad(), in microseconds.
+    long long beginLoadTime_;
 };
 
-/// Background loader of resources. Owned by the ResourceCache.
-class BackgroundLoader : public RefCounted, public Thread
+/// Background loader of resources, using a pool of loader threads. Owned by the ResourceCache.
+class BackgroundLoader : public RefCounted
 {
+    friend class BackgroundLoaderThread;
+    
 public:
     /// Construct.
     BackgroundLoader(ResourceCache* owner);
+    /// Destruct. Stop the loader threads.
+    ~BackgroundLoader();
     
-    /// Resource background loading loop.
-    virtual void ThreadFunction();
-    
+    /// Set number of loader threads, minimum 1. Running threads are stopped after finishing their current resource, and loading continues with the new amount.
+    void SetNumThreads(unsigned num);
     /// Queue loading of a resource. The name must be sanitated to ensure consistent format. Return true if queued (not a duplicate and resource was a known type).
-    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller);
+    bool QueueResource(StringHash type, const String& name, bool sendEventOnFailure, Resource* caller, int priority);
     /// Wait and finish possible loading of a resource when being requested from the cache.
     void WaitForResource(StringHash type, StringHash nameHash);
     /// Process resources that are ready to finish.
     void FinishResources(int maxMs);
     
+    /// Return number of loader threads.
+    unsigned GetNumThreads() const { return numThreads_; }
     /// Return amount of resources in the load queue.
     unsigned GetNumQueuedResources() const;
     
 private:
+    /// Start the loader threads.
+    void StartThreads();
+    /// Begin loading the highest priority queued resource. Called by the loader threads. Return false if there was none.
+    bool LoadNextResource();
+    /// Insert a queued resource to the ready list according to its load order.
+    void AddReadyItem(BackgroundLoadItem* item);
+    /// Raise the priority of a queued resource and the resources it depends on.
+    void RaisePriority(BackgroundLoadItem& item, int priority);
+    /// Mark a queued resource as necessary for loading the resource that requested it.
+    void AddDependent(BackgroundLoadItem& item, const Pair<StringHash, StringHash>& key, Resource* caller);
     /// Finish one background loaded resource.
     void FinishBackgroundLoading(BackgroundLoadItem& item);
     
     /// Resource cache.
     ResourceCache* owner_;
+    /// Loader threads.
+    Vector<SharedPtr<BackgroundLoaderThread> > threads_;
+    /// Number of loader threads.
+    unsigned numThreads_;
     /// Mutex for thread-safe access to the background load queue.
     mutable Mutex backgroundLoadMutex_;
     /// Resources that are queued for background loading.
     HashMap<Pair<StringHash, StringHash>, BackgroundLoadItem> backgroundLoadQueue_;
+    /// Queued resources that have not started loading, from last to first in load order.
+    PODVector<BackgroundLoadItem*> readyItems_;
 };
 
 }
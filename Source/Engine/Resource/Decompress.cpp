@@ -23,6 +23,8 @@
 #include "Precompiled.h"
 #include "Decompress.h"
 
+#include <cstring>
+
 // DXT decompression based on the Squish library, modified for Urho3D
 
 namespace Urho3D
@@ -105,26 +107,18 @@ static void DecompressColourDXT( unsigned char* rgba, void const* block, bool is
     codes[8 + 3] = 255;
     codes[12 + 3] = ( isDxt1 && a <= b ) ? 0 : 255;
     
+    // treat the codebook as whole pixels
+    unsigned palette[4];
+    memcpy( palette, codes, sizeof( palette ) );
+    
     // unpack the indices
-    unsigned char indices[16];
-    for( int i = 0; i < 4; ++i )
-    {
-        unsigned char* ind = indices + 4*i;
-        unsigned char packed = bytes[4 + i];
-        
-        ind[0] = packed & 0x3;
-        ind[1] = ( packed >> 2 ) & 0x3;
-        ind[2] = ( packed >> 4 ) & 0x3;
-        ind[3] = ( packed >> 6 ) & 0x3;
-    }
+    unsigned indices = ( unsigned )bytes[4] | ( ( unsigned )bytes[5] << 8 ) | ( ( unsigned )bytes[6] << 16 ) |
+        ( ( unsigned )bytes[7] << 24 );
     
-    // store out the colours
+    // store out the colours a pixel at a time, the destination must be aligned for this
+    unsigned* pixels = reinterpret_cast< unsigned* >( rgba );
     for( int i = 0; i < 16; ++i )
-    {
-        unsigned char offset = 4*indices[i];
-        for( int j = 0; j < 4; ++j )
-            rgba[4*i + j] = codes[offset + j];
-    }
+        pixels[i] = palette[( indices >> 2*i ) & 0x3];
 }
 
 static void DecompressAlphaDXT3( unsigned char* rgba, void const* block )
@@ -219,51 +213,38 @@ static void DecompressDXT( unsigned char* rgba, const void* block, CompressedFor
 }
 
 void DecompressImageDXT( unsigned char* rgba, const void* blocks, int width, int height, int depth, CompressedFormat format )
+{
+    DecompressImageRowsDXT( rgba, blocks, width, height, 0, depth*( ( height + 3 )/4 ), format );
+}
+
+void DecompressImageRowsDXT( unsigned char* rgba, const void* blocks, int width, int height, int firstRow, int numRows, CompressedFormat format )
 {
     // initialise the block input
-    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks );
     int bytesPerBlock = format == CF_DXT1 ? 8 : 16;
+    int blocksX = ( width + 3 )/4;
+    int blocksY = ( height + 3 )/4;
+    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks ) + firstRow*blocksX*bytesPerBlock;
     
-    // loop over blocks
-    for( int z = 0; z < depth; ++z )
+    // loop over block rows, which continue from one depth slice to the next
+    for( int row = firstRow; row < firstRow + numRows; ++row )
     {
-        int sz = width*height*4*z;
-        for( int y = 0; y < height; y += 4 )
+        unsigned char* slice = rgba + width*height*4*( row/blocksY );
+        int y = 4*( row%blocksY );
+        int rowsInside = height - y < 4 ? height - y : 4;
+        
+        for( int x = 0; x < width; x += 4 )
         {
-            for( int x = 0; x < width; x += 4 )
-            {
-                // decompress the block
-                unsigned char targetRgba[4*16];
-                DecompressDXT( targetRgba, sourceBlock, format );
-                
-                // write the decompressed pixels to the correct image locations
-                unsigned char const* sourcePixel = targetRgba;
-                for( int py = 0; py < 4; ++py )
-                {
-                    for( int px = 0; px < 4; ++px )
-                    {
-                        // get the target location
-                        int sx = x + px;
-                        int sy = y + py;
-                        if( sx < width && sy < height )
-                        {
-                            unsigned char* targetPixel = rgba + sz + 4*( width*sy + sx );
-                            
-                            // copy the rgba value
-                            for( int i = 0; i < 4; ++i )
-                                *targetPixel++ = *sourcePixel++;
-                        }
-                        else
-                        {
-                            // skip this pixel as its outside the image
-                            sourcePixel += 4;
-                        }
-                    }
-                }
-                
-                // advance
-                sourceBlock += bytesPerBlock;
-            }
+            // decompress the block into aligned storage
+            unsigned targetRgba[16];
+            DecompressDXT( reinterpret_cast< unsigned char* >( targetRgba ), sourceBlock, format );
+            
+            // write the pixel rows of the block that are inside the image
+            int bytesInside = 4*( width - x < 4 ? width - x : 4 );
+            for( int py = 0; py < rowsInside; ++py )
+                memcpy( slice + 4*( width*( y + py ) + x ), targetRgba + 4*py, bytesInside );
+            
+            // advance
+            sourceBlock += bytesPerBlock;
         }
     }
 }
@@ -302,34 +283,35 @@ const int mod[8][4]={{2, 8,-2,-8},
                     {33, 106, -33, -106},
                     {47, 183, -47, -183}};
 
-// lsb: hgfedcba ponmlkji msb: hgfedcba ponmlkji due to endianness
-static unsigned long ModifyPixel(int red, int green, int blue, int x, int y, unsigned long modBlock, int modTable)
+// build the four modified colours of a subblock as whole pixels
+static void BuildPaletteETC(unsigned* palette, int red, int green, int blue, int modTable)
 {
-    int index = x*4+y, pixelMod;
-    unsigned long mostSig = modBlock<<1;
-    if (index<8)    //hgfedcba
-        pixelMod = mod[modTable][((modBlock>>(index+24))&0x1)+((mostSig>>(index+8))&0x2)];
-    else    // ponmlkj
-        pixelMod = mod[modTable][((modBlock>>(index+8))&0x1)+((mostSig>>(index-8))&0x2)];
-    
-    red = _CLAMP_(red+pixelMod,0,255);
-    green = _CLAMP_(green+pixelMod,0,255);
-    blue = _CLAMP_(blue+pixelMod,0,255);
-    
-    return ((blue<<16) + (green<<8) + red)|0xff000000;
+    for (int i=0;i<4;i++)
+    {
+        int pixelMod = mod[modTable][i];
+        unsigned char* colour = (unsigned char*)(palette+i);
+        colour[0] = (unsigned char)_CLAMP_(red+pixelMod,0,255);
+        colour[1] = (unsigned char)_CLAMP_(green+pixelMod,0,255);
+        colour[2] = (unsigned char)_CLAMP_(blue+pixelMod,0,255);
+        colour[3] = 255;
+    }
 }
 
-static void DecompressETC(unsigned char* pDestData, const void* pSrcData)
+static void DecompressETC(unsigned* output, const void* pSrcData)
 {
-    unsigned long blockTop, blockBot, *input = (unsigned long*)pSrcData, *output;
+    const unsigned char* input = (const unsigned char*)pSrcData;
+    unsigned blockTop, lsbBits, msbBits, palettes[2][4];
     unsigned char red1, green1, blue1, red2, green2, blue2;
     bool bFlip, bDiff;
     int modtable1,modtable2;
     
-    blockTop = *(input++);
-    blockBot = *(input++);
+    // read the colour word in little-endian order regardless of the platform, so that the masks below hold
+    blockTop = input[0] | (input[1]<<8) | (input[2]<<16) | ((unsigned)input[3]<<24);
+    
+    // the modulation indices are stored as big-endian msb and lsb planes, in column order of the pixels
+    msbBits = (input[4]<<8) | input[5];
+    lsbBits = (input[6]<<8) | input[7];
     
-    output = (unsigned long*)pDestData;
     // check flipbit
     bFlip = (blockTop & ETC_FLIP) != 0;
     bDiff = (blockTop & ETC_DIFF) != 0;
@@ -380,69 +362,50 @@ static void DecompressETC(unsigned char* pDestData, const void* pSrcData)
     modtable1 = (blockTop>>29)&0x7; 
     modtable2 = (blockTop>>26)&0x7; 
     
-    if(!bFlip)
-    {   // 2 2x4 blocks side by side
-        for(int j=0;j<4;j++)    // vertical
-        {
-            for(int k=0;k<2;k++)    // horizontal
-            {
-                *(output+j*4+k) = ModifyPixel(red1,green1,blue1,k,j,blockBot,modtable1);
-                *(output+j*4+k+2) = ModifyPixel(red2,green2,blue2,k+2,j,blockBot,modtable2);
-            }
-        }
-    }
-    else
-    {   // 2 4x2 blocks on top of each other
-        for(int j=0;j<2;j++)
+    // modify the base colours only once per subblock, then look the pixels up
+    BuildPaletteETC(palettes[0],red1,green1,blue1,modtable1);
+    BuildPaletteETC(palettes[1],red2,green2,blue2,modtable2);
+    
+    for(int j=0;j<4;j++)    // vertical
+    {
+        for(int k=0;k<4;k++)    // horizontal
         {
-            for(int k=0;k<4;k++)
-            {
-                *(output+j*4+k) = ModifyPixel(red1,green1,blue1,k,j,blockBot,modtable1);
-                *(output+(j+2)*4+k) = ModifyPixel(red2,green2,blue2,k,j+2,blockBot,modtable2);
-            }
+            // flipped: 2 4x2 blocks on top of each other, otherwise 2 2x4 blocks side by side
+            int index = k*4+j;
+            int subBlock = bFlip ? j>>1 : k>>1;
+            output[j*4+k] = palettes[subBlock][((lsbBits>>index)&0x1)|(((msbBits>>index)&0x1)<<1)];
         }
     }
 }
 
 void DecompressImageETC( unsigned char* rgba, const void* blocks, int width, int height )
+{
+    DecompressImageRowsETC( rgba, blocks, width, height, 0, ( height + 3 )/4 );
+}
+
+void DecompressImageRowsETC( unsigned char* rgba, const void* blocks, int width, int height, int firstRow, int numRows )
 {
     // initialise the block input
-    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks );
     int bytesPerBlock = 8;
+    int blocksX = ( width + 3 )/4;
+    unsigned char const* sourceBlock = reinterpret_cast< unsigned char const* >( blocks ) + firstRow*blocksX*bytesPerBlock;
     
-    // loop over blocks
-    for( int y = 0; y < height; y += 4 )
+    // loop over block rows
+    for( int row = firstRow; row < firstRow + numRows; ++row )
     {
+        int y = 4*row;
+        int rowsInside = height - y < 4 ? height - y : 4;
+        
         for( int x = 0; x < width; x += 4 )
         {
             // decompress the block
-            unsigned char targetRgba[4*16];
+            unsigned targetRgba[16];
             DecompressETC( targetRgba, sourceBlock );
             
-            // write the decompressed pixels to the correct image locations
-            unsigned char const* sourcePixel = targetRgba;
-            for( int py = 0; py < 4; ++py )
-            {
-                for( int px = 0; px < 4; ++px )
-                {
-                    // get the target location
-                    int sx = x + px;
-                    int sy = y + py;
-                    if( sx < width && sy < height )
-                    {
-                        unsigned char* targetPixel = rgba + 4*( width*sy + sx );
-                        
-                        // copy the rgba value
-                        for( int i = 0; i < 4; ++i )
-                            *targetPixel++ = *sourcePixel++;
-                    }
-                    else
-                    {
-                        // skip this pixel as its outside the image
-                        sourcePixel += 4;
-                    }
-                }
-            }
+            // write the pixel rows of the block that are inside the image
+            int bytesInside = 4*( width - x < 4 ? width - x : 4 );
+            for( int py = 0; py < rowsInside; ++py )
+                memcpy( rgba + 4*( width*( y + py ) + x ), targetRgba + 4*py, bytesInside );
             
             // advance
             sourceBlock += bytesPerBlock;
@@ -799,6 +762,11 @@ static unsigned TwiddleUV(unsigned YSize, unsigned XSize, unsigned YPos, unsigne
 }
 
 void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, int height, CompressedFormat format)
+{
+    DecompressImageRowsPVRTC(dest, blocks, width, height, 0, (height + BLK_Y_SIZE - 1) / BLK_Y_SIZE, format);
+}
+
+void DecompressImageRowsPVRTC(unsigned char* dest, const void *blocks, int width, int height, int firstRow, int numRows, CompressedFormat format)
 {
     AMTC_BLOCK_STRUCT* pCompressedData = (AMTC_BLOCK_STRUCT*)blocks;
     int AssumeImageTiles = 1;
@@ -806,6 +774,7 @@ void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, in
     
     int x, y;
     int i, j;
+    int StartRowY, EndRowY;
     
     int BlkX, BlkY;
     int BlkXp1, BlkYp1;
@@ -849,10 +818,14 @@ void DecompressImagePVRTC(unsigned char* dest, const void *blocks, int width, in
     BlkXDim = _MAX(2, width / XBlockSize);
     BlkYDim = _MAX(2, height / BLK_Y_SIZE);
     
+    // Limit to the requested rows. Each pixel only depends on the compressed data, so rows can be decompressed in any order
+    StartRowY = firstRow * BLK_Y_SIZE;
+    EndRowY = _MIN(height, (firstRow + numRows) * BLK_Y_SIZE);
+    
     // Step through the pixels of the image decompressing each one in turn
     //
     // Note that this is a hideously inefficient way to do this!
-    for(y = 0; y < height; y++)
+    for(y = StartRowY; y < EndRowY; y++)
     {
         for(x = 0; x < width; x++)
         {
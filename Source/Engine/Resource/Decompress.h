@@ -29,10 +29,16 @@ namespace Urho3D
 
 /// Decompress a DXT compressed image to RGBA.
 URHO3D_API void DecompressImageDXT(unsigned char* dest, const void* blocks, int width, int height, int depth, CompressedFormat format);
+/// Decompress a range of 4 pixel high rows of a DXT compressed image to RGBA. The rows of a volume continue from one depth slice to the next.
+URHO3D_API void DecompressImageRowsDXT(unsigned char* dest, const void* blocks, int width, int height, int firstRow, int numRows, CompressedFormat format);
 /// Decompress an ETC1 compressed image to RGBA.
 URHO3D_API void DecompressImageETC(unsigned char* dest, const void* blocks, int width, int height);
+/// Decompress a range of 4 pixel high rows of an ETC1 compressed image to RGBA.
+URHO3D_API void DecompressImageRowsETC(unsigned char* dest, const void* blocks, int width, int height, int firstRow, int numRows);
 /// Decompress a PVRTC compressed image to RGBA.
 URHO3D_API void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width, int height, CompressedFormat format);
+/// Decompress a range of 4 pixel high rows of a PVRTC compressed image to RGBA.
+URHO3D_API void DecompressImageRowsPVRTC(unsigned char* dest, const void* blocks, int width, int height, int firstRow, int numRows, CompressedFormat format);
 /// Flip a compressed block vertically.
 URHO3D_API void FlipBlockVertical(unsigned char* dest, unsigned char* src, CompressedFormat format);
 /// Flip a compressed block horizontally.
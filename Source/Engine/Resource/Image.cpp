@@ -21,12 +21,16 @@
 //
 
 #include "Precompiled.h"
+#include "Condition.h"
 #include "Context.h"
 #include "Decompress.h"
 #include "File.h"
 #include "FileSystem.h"
+#include "ImageKernels.h"
 #include "Log.h"
 #include "Profiler.h"
+#include "Thread.h"
+#include "WorkQueue.h"
 
 #include <cstdlib>
 #include <cstring>
@@ -49,9 +53,17 @@ extern "C" unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int strid
 #define FOURCC_DXT4 (MAKEFOURCC('D','X','T','4'))
 #define FOURCC_DXT5 (MAKEFOURCC('D','X','T','5'))
 
+#define DDPF_ALPHAPIXELS 0x00000001
+#define DDPF_FOURCC 0x00000004
+#define DDPF_RGB 0x00000040
+#define DDPF_LUMINANCE 0x00020000
+
 namespace Urho3D
 {
 
+static const int MIN_PARALLEL_DECOMPRESS_ROWS = 32;
+static const int DECOMPRESS_ROWS_PER_PICK = 8;
+
 /// DirectDraw color key definition.
 struct DDColorKey
 {
@@ -169,34 +181,159 @@ struct DDSurfaceDesc2
     unsigned dwTextureStage_;
 };
 
-bool CompressedLevel::Decompress(unsigned char* dest)
+/// Decompression of a compressed image level by rows, shared by the calling thread and worker threads.
+struct LevelDecompressJob : public RefCounted
+{
+    /// Construct.
+    LevelDecompressJob() :
+        nextRow_(0),
+        finishedRows_(0)
+    {
+    }
+    
+    /// Compressed level.
+    CompressedLevel level_;
+    /// Destination for the RGBA data.
+    unsigned char* dest_;
+    /// Total number of 4 pixel high rows.
+    int numRows_;
+    /// Mutex for picking rows.
+    Mutex mutex_;
+    /// Next row to pick.
+    int nextRow_;
+    /// Number of rows decompressed.
+    int finishedRows_;
+    /// Event set when the last rows have been decompressed.
+    Condition finished_;
+};
+
+/// Work item helping to decompress a compressed image level.
+struct LevelDecompressItem : public WorkItem
+{
+    /// Decompression job.
+    SharedPtr<LevelDecompressJob> job_;
+};
+
+/// Decompress a range of 4 pixel high rows of a compressed level.
+static void DecompressLevelRows(const CompressedLevel& level, unsigned char* dest, int firstRow, int numRows)
+{
+    switch (level.format_)
+    {
+    case CF_DXT1:
+    case CF_DXT3:
+    case CF_DXT5:
+        DecompressImageRowsDXT(dest, level.data_, level.width_, level.height_, firstRow, numRows, level.format_);
+        break;
+        
+    case CF_ETC1:
+        DecompressImageRowsETC(dest, level.data_, level.width_, level.height_, firstRow, numRows);
+        break;
+        
+    default:
+        DecompressImageRowsPVRTC(dest, level.data_, level.width_, level.height_, firstRow, numRows, level.format_);
+        break;
+    }
+}
+
+/// Pick and decompress the next rows of a decompression job. Return false if no rows left.
+static bool DecompressNextRows(LevelDecompressJob* job)
+{
+    int firstRow;
+    int numRows;
+    {
+        MutexLock lock(job->mutex_);
+        if (job->nextRow_ >= job->numRows_)
+            return false;
+        firstRow = job->nextRow_;
+        numRows = Min(DECOMPRESS_ROWS_PER_PICK, job->numRows_ - firstRow);
+        job->nextRow_ += numRows;
+    }
+    
+    DecompressLevelRows(job->level_, job->dest_, firstRow, numRows);
+    
+    bool last;
+    {
+        MutexLock lock(job->mutex_);
+        job->finishedRows_ += numRows;
+        last = job->finishedRows_ == job->numRows_;
+    }
+    
+    if (last)
+        job->finished_.Set();
+    return true;
+}
+
+static void DecompressRowsWork(const WorkItem* item, unsigned threadIndex)
+{
+    LevelDecompressJob* job = static_cast<const LevelDecompressItem*>(item)->job_;
+    while (DecompressNextRows(job))
+    {
+    }
+}
+
+bool CompressedLevel::Decompress(unsigned char* dest, WorkQueue* queue) const
 {
     if (!data_)
         return false;
 
+    // Rows are 4 pixels high for all formats. For volumes they continue from one depth slice to the next
+    int numRows = (height_ + 3) / 4;
     switch (format_)
     {
     case CF_DXT1:
     case CF_DXT3:
     case CF_DXT5:
-        DecompressImageDXT(dest, data_, width_, height_, depth_, format_);
-        return true;
+        numRows *= depth_;
+        break;
 
     case CF_ETC1:
-        DecompressImageETC(dest, data_, width_, height_);
-        return true;
-
     case CF_PVRTC_RGB_2BPP:
     case CF_PVRTC_RGBA_2BPP:
     case CF_PVRTC_RGB_4BPP:
     case CF_PVRTC_RGBA_4BPP:
-        DecompressImagePVRTC(dest, data_, width_, height_, format_);
-        return true;
+        break;
 
     default:
          // Unknown format
          return false;
     }
+    
+    // Decompress small levels, or when worker threads can not be used, directly
+    if (numRows < MIN_PARALLEL_DECOMPRESS_ROWS || !queue || !queue->GetNumThreads() || !Thread::IsMainThread())
+    {
+        DecompressLevelRows(*this, dest, 0, numRows);
+        return true;
+    }
+    
+    SharedPtr<LevelDecompressJob> job(new LevelDecompressJob());
+    job->level_ = *this;
+    job->dest_ = dest;
+    job->numRows_ = numRows;
+    
+    // Let worker threads help, while this thread decompresses too. Work items left over after the job has finished do nothing
+    unsigned numItems = Min((int)queue->GetNumThreads(), (numRows + DECOMPRESS_ROWS_PER_PICK - 1) / DECOMPRESS_ROWS_PER_PICK - 1);
+    for (unsigned i = 0; i < numItems; ++i)
+    {
+        LevelDecompressItem* item = new LevelDecompressItem();
+        item->workFunction_ = DecompressRowsWork;
+        item->job_ = job;
+        item->priority_ = M_MAX_UNSIGNED;
+        queue->AddWorkItem(SharedPtr<WorkItem>(item));
+    }
+    
+    while (DecompressNextRows(job))
+    {
+    }
+    
+    // Wait for the rows picked by worker threads
+    bool finished;
+    {
+        MutexLock lock(job->mutex_);
+        finished = job->finishedRows_ == numRows;
+    }
+    if (!finished)
+        job->finished_.Wait();
+    return true;
 }
 
 Image::Image(Context* context) :
@@ -228,6 +365,14 @@ bool Image::BeginLoad(Deserializer& source)
         DDSurfaceDesc2 ddsd;
         source.Read(&ddsd, sizeof(ddsd));
 
+        // Uncompressed DDS, as written by TextureTool: read the precalculated mip levels instead of filtering at load time
+        if (!(ddsd.ddpfPixelFormat_.dwFlags_ & DDPF_FOURCC))
+        {
+            const DDPixelFormat& format = ddsd.ddpfPixelFormat_;
+            return LoadUncompressedDDS(source, ddsd.dwWidth_, ddsd.dwHeight_, ddsd.dwDepth_, ddsd.dwMipMapCount_, format.dwFlags_,
+                format.dwRGBBitCount_, format.dwRBitMask_, format.dwGBitMask_, format.dwBBitMask_, format.dwRGBAlphaBitMask_);
+        }
+
         switch (ddsd.ddpfPixelFormat_.dwFourCC_)
         {
         case FOURCC_DXT1:
@@ -563,6 +708,7 @@ void Image::SetPixelInt(int x, int y, int z, unsigned uintColor)
     if (!data_ || x < 0 || x >= width_ || y < 0 || y >= height_ || z < 0 || z >= depth_ || IsCompressed())
         return;
 
+    nextLevel_.Reset();
     unsigned char* dest = data_ + (z * width_ * height_ + y * width_ + x) * components_;
     unsigned char* src = (unsigned char*)&uintColor;
 
@@ -663,17 +809,7 @@ bool Image::FlipHorizontal()
     if (!IsCompressed())
     {
         SharedArrayPtr<unsigned char> newData(new unsigned char[width_ * height_ * components_]);
-        unsigned rowSize = width_ * components_;
-
-        for (int y = 0; y < height_; ++y)
-        {
-            for (int x = 0; x < width_; ++x)
-            {
-                for (unsigned c = 0; c < components_; ++c)
-                    newData[y * rowSize + x * components_ + c] = data_[y * rowSize + (width_ - x - 1) * components_ + c];
-            }
-        }
-        
+        FlipImageDataHorizontal(newData.Get(), data_.Get(), width_, height_, components_);
         data_ = newData;
     }
     else
@@ -713,6 +849,8 @@ bool Image::FlipHorizontal()
         data_ = newData;
     }
     
+    // Precalculated or loaded mip levels are not valid anymore
+    nextLevel_.Reset();
     return true;
 }
 
@@ -730,11 +868,7 @@ bool Image::FlipVertical()
     if (!IsCompressed())
     {
         SharedArrayPtr<unsigned char> newData(new unsigned char[width_ * height_ * components_]);
-        unsigned rowSize = width_ * components_;
-
-        for (int y = 0; y < height_; ++y)
-            memcpy(&newData[(height_ - y - 1) * rowSize], &data_[y * rowSize], rowSize);
-
+        FlipImageDataVertical(newData.Get(), data_.Get(), width_, height_, components_);
         data_ = newData;
     }
     else
@@ -773,10 +907,12 @@ bool Image::FlipVertical()
         data_ = newData;
     }
     
+    // Precalculated or loaded mip levels are not valid anymore
+    nextLevel_.Reset();
     return true;
 }
 
-bool Image::Resize(int width, int height)
+bool Image::Resize(int width, int height, ImageResizeFilter filter)
 {
     PROFILE(ResizeImage);
 
@@ -795,44 +931,52 @@ bool Image::Resize(int width, int height)
     if (!data_ || width <= 0 || height <= 0)
         return false;
 
-    /// \todo Reducing image size does not sample all needed pixels
+    // When reducing, the filter covers all source pixels
     SharedArrayPtr<unsigned char> newData(new unsigned char[width * height * components_]);
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
-        {
-            // Calculate float coordinates between 0 - 1 for resampling
-            float xF = (width_ > 1) ? (float)x / (float)(width - 1) : 0.0f;
-            float yF = (height_ > 1) ? (float)y / (float)(height - 1) : 0.0f;
-            unsigned uintColor = GetPixelBilinear(xF, yF).ToUInt();
-            unsigned char* dest = newData + (y * width + x) * components_;
-            unsigned char* src = (unsigned char*)&uintColor;
-
-            switch (components_)
-            {
-            case 4:
-                dest[3] = src[3];
-                // Fall through
-            case 3:
-                dest[2] = src[2];
-                // Fall through
-            case 2:
-                dest[1] = src[1];
-                // Fall through
-            default:
-                dest[0] = src[0];
-                break;
-            }
-        }
-    }
+    ResizeImageData(newData.Get(), width, height, data_.Get(), width_, height_, components_, filter);
 
     width_ = width;
     height_ = height;
     data_ = newData;
+    nextLevel_.Reset();
     SetMemoryUse(width * height * depth_ * components_);
     return true;
 }
 
+bool Image::SwizzleChannels(const String& order)
+{
+    if (!data_)
+        return false;
+
+    if (IsCompressed())
+    {
+        LOGERROR("SwizzleChannels not supported for compressed images");
+        return false;
+    }
+
+    if (order.Length() != components_)
+    {
+        LOGERROR("Channel order " + order + " does not match the number of image components");
+        return false;
+    }
+
+    unsigned char channels[4];
+    for (unsigned i = 0; i < components_; ++i)
+    {
+        unsigned index = String("rgba").Find(order[i]);
+        if (index >= components_)
+        {
+            LOGERROR("Illegal channel order " + order);
+            return false;
+        }
+        channels[i] = (unsigned char)index;
+    }
+
+    SwizzleImageData(data_.Get(), width_ * height_ * depth_, components_, channels);
+    nextLevel_.Reset();
+    return true;
+}
+
 void Image::Clear(const Color& color)
 {
     ClearInt(color.ToUInt());
@@ -854,6 +998,7 @@ void Image::ClearInt(unsigned uintColor)
     unsigned char* src = (unsigned char*)&uintColor;
     for (unsigned i = 0; i < width_ * height_ * depth_ * components_; ++i)
         data_[i] = src[i % components_];
+    nextLevel_.Reset();
 }
 
 bool Image::SaveBMP(const String& fileName) const
@@ -1598,7 +1743,8 @@ SDL_Surface* Image::GetSDLSurface(const IntRect& rect) const
 
 void Image::PrecalculateLevels()
 {
-    if (!data_ || IsCompressed())
+    // Mip levels loaded from an uncompressed DDS file are already available
+    if (!data_ || IsCompressed() || nextLevel_)
         return;
 
     PROFILE(PrecalculateImageMipLevels);
@@ -1617,13 +1763,106 @@ void Image::PrecalculateLevels()
     }
 }
 
+bool Image::LoadUncompressedDDS(Deserializer& source, int width, int height, int depth, unsigned levels, unsigned flags,
+    unsigned bitCount, unsigned redMask, unsigned greenMask, unsigned blueMask, unsigned alphaMask)
+{
+    // Only 8 bits per channel layouts are supported: luminance, luminance-alpha, and RGB or RGBA in either red-blue order.
+    // 32-bit RGB without alpha is loaded as RGBA with opaque alpha
+    bool hasAlpha = (flags & DDPF_ALPHAPIXELS) != 0;
+    unsigned components = 0;
+    bool swapRedBlue = false;
+    bool fillAlpha = false;
+    if (flags & DDPF_LUMINANCE)
+    {
+        if (bitCount == 8 && redMask == 0xff && !hasAlpha)
+            components = 1;
+        else if (bitCount == 16 && redMask == 0xff && hasAlpha && alphaMask == 0xff00)
+            components = 2;
+    }
+    else if ((flags & DDPF_RGB) && greenMask == 0x0000ff00 && ((redMask == 0x000000ff && blueMask == 0x00ff0000) ||
+        (redMask == 0x00ff0000 && blueMask == 0x000000ff)))
+    {
+        swapRedBlue = redMask == 0x00ff0000;
+        if (bitCount == 24 && !hasAlpha)
+            components = 3;
+        else if (bitCount == 32 && (!hasAlpha || alphaMask == 0xff000000))
+        {
+            components = 4;
+            fillAlpha = !hasAlpha;
+        }
+    }
+    if (!components)
+    {
+        LOGERROR("Unsupported DDS format");
+        return false;
+    }
+    if (depth > 1)
+    {
+        LOGERROR("Uncompressed 3D DDS files not supported");
+        return false;
+    }
+
+    // Chain the mip levels as precalculated levels
+    Image* level = this;
+    unsigned memoryUse = 0;
+    if (!levels)
+        levels = 1;
+    for (unsigned i = 0; i < levels; ++i)
+    {
+        if (i)
+        {
+            SharedPtr<Image> nextLevel(new Image(context_));
+            level->nextLevel_ = nextLevel;
+            level = nextLevel;
+        }
+
+        if (!level->SetSize(width, height, components))
+            return false;
+        unsigned dataSize = width * height * components;
+        if (source.Read(level->data_.Get(), dataSize) != dataSize)
+        {
+            LOGERROR("DDS mip level data size exceeds file size");
+            return false;
+        }
+        if (swapRedBlue || fillAlpha)
+        {
+            unsigned char* pixel = level->data_.Get();
+            for (unsigned j = 0; j < dataSize; j += components)
+            {
+                if (swapRedBlue)
+                    Swap(pixel[j], pixel[j + 2]);
+                if (fillAlpha)
+                    pixel[j + 3] = 255;
+            }
+        }
+        memoryUse += dataSize;
+
+        if (width == 1 && height == 1)
+            break;
+        width = Max(width / 2, 1);
+        height = Max(height / 2, 1);
+    }
+
+    SetMemoryUse(memoryUse);
+    return true;
+}
+
 unsigned char* Image::GetImageData(Deserializer& source, int& width, int& height, unsigned& components)
 {
-    unsigned dataSize = source.GetSize();
+    unsigned dataSize = source.GetSize() - source.GetPosition();
 
-    SharedArrayPtr<unsigned char> buffer(new unsigned char[dataSize]);
-    source.Read(buffer.Get(), dataSize);
-    return stbi_load_from_memory(buffer.Get(), dataSize, &width, &height, (int *)&components, 0);
+    // Decode directly from memory if possible, else read a copy of the data
+    const unsigned char* data = source.GetReadPointer();
+    SharedArrayPtr<unsigned char> buffer;
+    if (data)
+        source.Seek(source.GetPosition() + dataSize);
+    else
+    {
+        buffer = new unsigned char[dataSize];
+        source.Read(buffer.Get(), dataSize);
+        data = buffer.Get();
+    }
+    return stbi_load_from_memory(data, dataSize, &width, &height, (int *)&components, 0);
 }
 
 void Image::FreeImageData(unsigned char* pixelData)
@@ -30,6 +30,8 @@ struct SDL_Surface;
 namespace Urho3D
 {
 
+class WorkQueue;
+
 static const int COLOR_LUT_SIZE = 16;
 
 /// Supported compressed image formats.
@@ -46,6 +48,14 @@ enum CompressedFormat
     CF_PVRTC_RGBA_4BPP,
 };
 
+/// Image resize filters.
+enum ImageResizeFilter
+{
+    IRF_BILINEAR = 0,
+    IRF_BOX,
+    IRF_LANCZOS
+};
+
 /// Compressed image mip level.
 struct CompressedLevel
 {
@@ -62,8 +72,8 @@ struct CompressedLevel
     {
     }
 
-    /// Decompress to RGBA. The destination buffer required is width * height * 4 bytes. Return true if successful.
-    bool Decompress(unsigned char* dest);
+    /// Decompress to RGBA. The destination buffer required is width * height * depth * 4 bytes. Large levels are split by rows between the calling thread and the work queue threads when called from the main thread with a work queue. Return true if successful.
+    bool Decompress(unsigned char* dest, WorkQueue* queue = 0) const;
 
     /// Compressed image data.
     unsigned char* data_;
@@ -123,8 +133,10 @@ public:
     bool FlipHorizontal();
     /// Flip image vertically. Return true if successful.
     bool FlipVertical();
-    /// Resize image by bilinear resampling. Return true if successful.
-    bool Resize(int width, int height);
+    /// Resize image by resampling with a filter. Return true if successful.
+    bool Resize(int width, int height, ImageResizeFilter filter = IRF_BILINEAR);
+    /// Reorder the color channels. Each character of the order (r, g, b or a) selects the source channel for a channel. Return true if successful.
+    bool SwizzleChannels(const String& order);
     /// Clear the image with a color.
     void Clear(const Color& color);
     /// Clear the image with an integer color. R component is in the 8 lowest bits.
@@ -174,10 +186,12 @@ public:
     Image* GetSubimage(const IntRect& rect) const;
     /// Return an SDL surface from the image, or null if failed. Only RGB images are supported. Specify rect to only return partial image. You must free the surface yourself.
     SDL_Surface* GetSDLSurface(const IntRect& rect = IntRect::ZERO) const;
-    /// Precalculate the mip levels. Used by asynchronous texture loading.
+    /// Precalculate the mip levels, unless they were loaded from the image file. Used by asynchronous texture loading.
     void PrecalculateLevels();
 
 private:
+    /// Load an uncompressed DDS image and its mip levels after the header. Return true if successful.
+    bool LoadUncompressedDDS(Deserializer& source, int width, int height, int depth, unsigned levels, unsigned flags, unsigned bitCount, unsigned redMask, unsigned greenMask, unsigned blueMask, unsigned alphaMask);
     /// Decode an image using stb_image.
     static unsigned char* GetImageData(Deserializer& source, int& width, int& height, unsigned& components);
     /// Free an image file's pixel data.
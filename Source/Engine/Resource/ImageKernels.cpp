@@ -0,0 +1,307 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "ImageKernels.h"
+
+#include <cstring>
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const int WEIGHT_BITS = 14;
+static const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+/// Fixed-point filter taps for resampling one image dimension.
+struct ResampleWeights
+{
+    /// Number of taps per output coordinate.
+    unsigned taps_;
+    /// Source coordinates of the taps, clamped to the image.
+    PODVector<int> indices_;
+    /// Tap weights in fixed point.
+    PODVector<int> weights_;
+};
+
+/// Return the radius of a resize filter in source pixels when not reducing.
+static float GetFilterSupport(ImageResizeFilter filter)
+{
+    switch (filter)
+    {
+    case IRF_BOX:
+        return 0.5f;
+        
+    case IRF_LANCZOS:
+        return 3.0f;
+        
+    default:
+        return 1.0f;
+    }
+}
+
+/// Evaluate a resize filter at a distance from the filter center.
+static float GetFilterWeight(ImageResizeFilter filter, float x)
+{
+    x = Abs(x);
+    
+    switch (filter)
+    {
+    case IRF_BOX:
+        return x <= 0.5f ? 1.0f : 0.0f;
+        
+    case IRF_LANCZOS:
+        {
+            if (x < M_EPSILON)
+                return 1.0f;
+            if (x >= 3.0f)
+                return 0.0f;
+            float px = M_PI * x;
+            return 3.0f * sinf(px) * sinf(px / 3.0f) / (px * px);
+        }
+        
+    default:
+        return x < 1.0f ? 1.0f - x : 0.0f;
+    }
+}
+
+/// Calculate the filter taps for resampling one image dimension. When reducing, the filter is widened to cover all source pixels.
+static void CalculateResampleWeights(ResampleWeights& weights, int srcSize, int destSize, ImageResizeFilter filter)
+{
+    float scale = (float)srcSize / (float)destSize;
+    float filterScale = Max(scale, 1.0f);
+    float support = GetFilterSupport(filter) * filterScale;
+    
+    weights.taps_ = (unsigned)ceilf(2.0f * support) + 1;
+    weights.indices_.Resize(destSize * weights.taps_);
+    weights.weights_.Resize(destSize * weights.taps_);
+    PODVector<float> floatWeights(weights.taps_);
+    
+    for (int i = 0; i < destSize; ++i)
+    {
+        // Pixel centers are at half coordinates
+        float center = ((float)i + 0.5f) * scale;
+        int first = (int)floorf(center - support - 0.5f);
+        int* indices = &weights.indices_[i * weights.taps_];
+        int* fixedWeights = &weights.weights_[i * weights.taps_];
+        
+        float total = 0.0f;
+        for (unsigned j = 0; j < weights.taps_; ++j)
+        {
+            floatWeights[j] = GetFilterWeight(filter, ((float)(first + (int)j) + 0.5f - center) / filterScale);
+            total += floatWeights[j];
+        }
+        
+        // Normalize, and give the rounding error to the strongest tap so that flat areas stay exact
+        unsigned strongest = 0;
+        int fixedTotal = 0;
+        for (unsigned j = 0; j < weights.taps_; ++j)
+        {
+            indices[j] = Clamp(first + (int)j, 0, srcSize - 1);
+            fixedWeights[j] = total > 0.0f ? (int)floorf(floatWeights[j] / total * (float)WEIGHT_ONE + 0.5f) : 0;
+            fixedTotal += fixedWeights[j];
+            if (floatWeights[j] > floatWeights[strongest])
+                strongest = j;
+        }
+        fixedWeights[strongest] += WEIGHT_ONE - fixedTotal;
+    }
+}
+
+/// Convert a fixed-point filtered value back to a byte.
+static inline unsigned char ToByte(int value)
+{
+    value = (value + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+    return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+/// Resample the rows of an image horizontally.
+static void ResampleRows(unsigned char* dest, int destWidth, const unsigned char* src, int srcWidth, int height,
+    unsigned components, const ResampleWeights& weights)
+{
+    unsigned taps = weights.taps_;
+    
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* srcRow = src + y * srcWidth * components;
+        unsigned char* destRow = dest + y * destWidth * components;
+        const int* indices = &weights.indices_[0];
+        const int* fixedWeights = &weights.weights_[0];
+        
+        for (int x = 0; x < destWidth; ++x)
+        {
+            int sum[4] = { 0, 0, 0, 0 };
+            for (unsigned j = 0; j < taps; ++j)
+            {
+                const unsigned char* pixel = srcRow + indices[j] * components;
+                int weight = fixedWeights[j];
+                for (unsigned c = 0; c < components; ++c)
+                    sum[c] += weight * pixel[c];
+            }
+            
+            for (unsigned c = 0; c < components; ++c)
+                *destRow++ = ToByte(sum[c]);
+            
+            indices += taps;
+            fixedWeights += taps;
+        }
+    }
+}
+
+/// Resample the columns of an image vertically, accumulating whole rows.
+static void ResampleColumns(unsigned char* dest, int destHeight, const unsigned char* src, int width, unsigned components,
+    const ResampleWeights& weights)
+{
+    unsigned taps = weights.taps_;
+    unsigned rowSize = width * components;
+    PODVector<int> sum(rowSize);
+    
+    for (int y = 0; y < destHeight; ++y)
+    {
+        const int* indices = &weights.indices_[y * taps];
+        const int* fixedWeights = &weights.weights_[y * taps];
+        memset(&sum[0], 0, rowSize * sizeof(int));
+        
+        for (unsigned j = 0; j < taps; ++j)
+        {
+            int weight = fixedWeights[j];
+            if (!weight)
+                continue;
+            const unsigned char* srcRow = src + indices[j] * rowSize;
+            for (unsigned i = 0; i < rowSize; ++i)
+                sum[i] += weight * srcRow[i];
+        }
+        
+        unsigned char* destRow = dest + y * rowSize;
+        for (unsigned i = 0; i < rowSize; ++i)
+            destRow[i] = ToByte(sum[i]);
+    }
+}
+
+void ResizeImageData(unsigned char* dest, int destWidth, int destHeight, const unsigned char* src, int srcWidth, int srcHeight,
+    unsigned components, ImageResizeFilter filter)
+{
+    if (!dest || !src || destWidth <= 0 || destHeight <= 0 || srcWidth <= 0 || srcHeight <= 0 || !components || components > 4)
+        return;
+    
+    // Filter horizontally into a temporary image, then vertically. Dimensions that do not change are copied
+    SharedArrayPtr<unsigned char> temp;
+    const unsigned char* rows = src;
+    if (destWidth != srcWidth)
+    {
+        ResampleWeights weights;
+        CalculateResampleWeights(weights, srcWidth, destWidth, filter);
+        if (destHeight != srcHeight)
+        {
+            temp = new unsigned char[destWidth * srcHeight * components];
+            ResampleRows(temp.Get(), destWidth, src, srcWidth, srcHeight, components, weights);
+            rows = temp.Get();
+        }
+        else
+        {
+            ResampleRows(dest, destWidth, src, srcWidth, srcHeight, components, weights);
+            return;
+        }
+    }
+    
+    if (destHeight != srcHeight)
+    {
+        ResampleWeights weights;
+        CalculateResampleWeights(weights, srcHeight, destHeight, filter);
+        ResampleColumns(dest, destHeight, rows, destWidth, components, weights);
+    }
+    else
+        memcpy(dest, src, destWidth * destHeight * components);
+}
+
+void FlipImageDataHorizontal(unsigned char* dest, const unsigned char* src, int width, int height, unsigned components)
+{
+    unsigned rowSize = width * components;
+    
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* srcPixel = src + y * rowSize;
+        unsigned char* destPixel = dest + y * rowSize + rowSize - components;
+        
+        switch (components)
+        {
+        case 1:
+            for (int x = 0; x < width; ++x)
+                *destPixel-- = *srcPixel++;
+            break;
+            
+        case 4:
+            for (int x = 0; x < width; ++x, srcPixel += 4, destPixel -= 4)
+                memcpy(destPixel, srcPixel, 4);
+            break;
+            
+        default:
+            for (int x = 0; x < width; ++x, srcPixel += components, destPixel -= components)
+            {
+                for (unsigned c = 0; c < components; ++c)
+                    destPixel[c] = srcPixel[c];
+            }
+            break;
+        }
+    }
+}
+
+void FlipImageDataVertical(unsigned char* dest, const unsigned char* src, int width, int height, unsigned components)
+{
+    unsigned rowSize = width * components;
+    
+    for (int y = 0; y < height; ++y)
+        memcpy(dest + (height - y - 1) * rowSize, src + y * rowSize, rowSize);
+}
+
+void SwizzleImageData(unsigned char* data, unsigned numPixels, unsigned components, const unsigned char* order)
+{
+    if (!data || !order || !components || components > 4)
+        return;
+    
+    unsigned char pixel[4];
+    
+    if (components == 4)
+    {
+        unsigned char r = order[0], g = order[1], b = order[2], a = order[3];
+        for (unsigned i = 0; i < numPixels; ++i, data += 4)
+        {
+            memcpy(pixel, data, 4);
+            data[0] = pixel[r];
+            data[1] = pixel[g];
+            data[2] = pixel[b];
+            data[3] = pixel[a];
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < numPixels; ++i, data += components)
+        {
+            memcpy(pixel, data, components);
+            for (unsigned c = 0; c < components; ++c)
+                data[c] = pixel[order[c]];
+        }
+    }
+}
+
+}
@@ -0,0 +1,40 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Image.h"
+
+namespace Urho3D
+{
+
+/// Resample an image to a new size using a separable filter. Both images have the same number of components.
+URHO3D_API void ResizeImageData(unsigned char* dest, int destWidth, int destHeight, const unsigned char* src, int srcWidth, int srcHeight, unsigned components, ImageResizeFilter filter);
+/// Copy an image mirrored horizontally.
+URHO3D_API void FlipImageDataHorizontal(unsigned char* dest, const unsigned char* src, int width, int height, unsigned components);
+/// Copy an image mirrored vertically.
+URHO3D_API void FlipImageDataVertical(unsigned char* dest, const unsigned char* src, int width, int height, unsigned components);
+/// Reorder the channels of pixels in place. The order gives the source channel index for each channel.
+URHO3D_API void SwizzleImageData(unsigned char* data, unsigned numPixels, unsigned components, const unsigned char* order);
+
+}
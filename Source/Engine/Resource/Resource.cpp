@@ -31,7 +31,8 @@ namespace Urho3D
 Resource::Resource(Context* context) :
     Object(context),
     memoryUse_(0),
-    asyncLoadState_(ASYNC_DONE)
+    asyncLoadState_(ASYNC_DONE),
+    pinned_(false)
 {
 }
 
@@ -96,6 +97,11 @@ void Resource::ResetUseTimer()
     useTimer_.Reset();
 }
 
+void Resource::SetPinned(bool enable)
+{
+    pinned_ = enable;
+}
+
 void Resource::SetAsyncLoadState(AsyncLoadState newState)
 {
     asyncLoadState_ = newState;
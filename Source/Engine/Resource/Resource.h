@@ -71,6 +71,8 @@ public:
     void SetMemoryUse(unsigned size);
     /// Reset last used timer.
     void ResetUseTimer();
+    /// Set whether is pinned. Pinned resources are never released by the resource cache due to exceeding the memory budget.
+    void SetPinned(bool enable);
     /// Set the asynchronous loading state. Called by ResourceCache. Resources in the middle of asynchronous loading are not normally returned to user.
     void SetAsyncLoadState(AsyncLoadState newState);
     
@@ -82,6 +84,8 @@ public:
     unsigned GetMemoryUse() const { return memoryUse_; }
     /// Return time since last use in milliseconds. If referred to elsewhere than in the resource cache, returns always zero.
     unsigned GetUseTimer();
+    /// Return whether is pinned.
+    bool IsPinned() const { return pinned_; }
     /// Return the asynchronous loading state.
     AsyncLoadState GetAsyncLoadState() const { return asyncLoadState_; }
     
@@ -96,6 +100,8 @@ private:
     unsigned memoryUse_;
     /// Asynchronous loading state.
     AsyncLoadState asyncLoadState_;
+    /// Pinned flag.
+    bool pinned_;
 };
 
 inline const String& GetResourceName(Resource* resource)
@@ -34,6 +34,8 @@
 #include "Profiler.h"
 #include "ResourceCache.h"
 #include "ResourceEvents.h"
+#include "ResourceManifest.h"
+#include "Sort.h"
 #include "WorkQueue.h"
 #include "XMLFile.h"
 
@@ -62,9 +64,13 @@ static const char* checkDirs[] = {
 };
 
 static const SharedPtr<Resource> noResource;
+static const unsigned MEMORY_BUDGET_CHECK_INTERVAL = 1000;
+static const unsigned MAX_EVICTED_RESOURCES = 1024;
 
 ResourceCache::ResourceCache(Context* context) :
     Object(context),
+    searchPaths_(new ResourceSearchPaths()),
+    activeSearches_(0),
     autoReloadResources_(false),
     returnFailedResources_(false),
     searchPackagesFirst_(true),
@@ -73,7 +79,7 @@ ResourceCache::ResourceCache(Context* context) :
     // Register Resource library object factories
     RegisterResourceLibrary(context_);
     
-    // Create resource background loader. Its thread will start on the first background request
+    // Create resource background loader. Its threads will start on the first background request
     backgroundLoader_ = new BackgroundLoader(this);
     
     // Subscribe BeginFrame for handling directory watchers and background loaded resource finalization
@@ -111,6 +117,7 @@ bool ResourceCache::AddResourceDir(const String& pathName, unsigned priority)
         resourceDirs_.Insert(priority, fixedPath);
     else
         resourceDirs_.Push(fixedPath);
+    UpdateSearchPaths();
     
     // If resource auto-reloading active, create a file watcher for the directory
     if (autoReloadResources_)
@@ -136,6 +143,7 @@ void ResourceCache::AddPackageFile(PackageFile* package, unsigned priority)
         packages_.Insert(priority, SharedPtr<PackageFile>(package));
     else
         packages_.Push(SharedPtr<PackageFile>(package));
+    UpdateSearchPaths();
     
     LOGINFO("Added resource package " + package->GetName());
 }
@@ -155,9 +163,7 @@ bool ResourceCache::AddManualResource(Resource* resource)
         return false;
     }
     
-    resource->ResetUseTimer();
-    resourceGroups_[resource->GetType()].resources_[resource->GetNameHash()] = resource;
-    UpdateResourceGroup(resource->GetType());
+    StoreResource(resource);
     return true;
 }
 
@@ -172,6 +178,7 @@ void ResourceCache::RemoveResourceDir(const String& pathName)
         if (!resourceDirs_[i].Compare(fixedPath, false))
         {
             resourceDirs_.Erase(i);
+            UpdateSearchPaths();
             // Remove the filewatcher with the matching path
             for (unsigned j = 0; j < fileWatchers_.Size(); ++j)
             {
@@ -199,6 +206,7 @@ void ResourceCache::RemovePackageFile(PackageFile* package, bool releaseResource
                 ReleasePackageResources(*i, forceRelease);
             LOGINFO("Removed resource package " + (*i)->GetName());
             packages_.Erase(i);
+            UpdateSearchPaths();
             return;
         }
     }
@@ -219,6 +227,7 @@ void ResourceCache::RemovePackageFile(const String& fileName, bool releaseResour
                 ReleasePackageResources(*i, forceRelease);
             LOGINFO("Removed resource package " + (*i)->GetName());
             packages_.Erase(i);
+            UpdateSearchPaths();
             return;
         }
     }
@@ -417,6 +426,7 @@ void ResourceCache::ReloadResourceWithDependencies(const String& fileName)
 void ResourceCache::SetMemoryBudget(StringHash type, unsigned budget)
 {
     resourceGroups_[type].memoryBudget_ = budget;
+    UpdateResourceGroup(type);
 }
 
 void ResourceCache::SetAutoReloadResources(bool enable)
@@ -444,13 +454,32 @@ void ResourceCache::SetReturnFailedResources(bool enable)
     returnFailedResources_ = enable;
 }
 
-SharedPtr<File> ResourceCache::GetFile(const String& nameIn, bool sendEventOnFailure)
+void ResourceCache::SetRecordingManifest(ResourceManifest* manifest)
 {
-    MutexLock lock(resourceMutex_);
+    MutexLock lock(manifestMutex_);
     
-    String name = SanitateResourceName(nameIn);
-    if (resourceRouter_)
-        resourceRouter_->Route(name, RESOURCE_GETFILE);
+    // Fill in the memory use of the resources that were already loaded when requested from the background loader threads
+    if (recordingManifest_ && recordingManifest_ != manifest)
+    {
+        const Vector<ManifestResource>& resources = recordingManifest_->GetResources();
+        for (unsigned i = 0; i < resources.Size(); ++i)
+        {
+            if (resources[i].size_)
+                continue;
+            const SharedPtr<Resource>& resource = FindResource(resources[i].type_, StringHash(resources[i].name_));
+            if (resource)
+                recordingManifest_->SetResourceSize(i, resource->GetMemoryUse());
+        }
+    }
+    
+    recordingManifest_ = manifest;
+}
+
+SharedPtr<File> ResourceCache::GetFile(const String& nameIn, bool sendEventOnFailure)
+{
+    // Search and open the file without holding the resource mutex, so that threads do not wait for each other's file access
+    String name;
+    const ResourceSearchPaths* paths = BeginSearch(name, nameIn, RESOURCE_GETFILE);
     
     if (name.Length())
     {
@@ -458,21 +487,26 @@ SharedPtr<File> ResourceCache::GetFile(const String& nameIn, bool sendEventOnFai
 
         if (searchPackagesFirst_)
         {
-            file = SearchPackages(name);
+            file = SearchPackages(*paths, name);
             if (!file)
-                file = SearchResourceDirs(name);
+                file = SearchResourceDirs(*paths, name);
         }
         else
         {
-            file = SearchResourceDirs(name);
+            file = SearchResourceDirs(*paths, name);
             if (!file)
-                file = SearchPackages(name);
+                file = SearchPackages(*paths, name);
         }
         
         if (file)
+        {
+            EndSearch();
             return SharedPtr<File>(file);
+        }
     }
     
+    EndSearch();
+    
     if (sendEventOnFailure)
     {
         if (resourceRouter_ && name.Empty() && !nameIn.Empty())
@@ -508,13 +542,20 @@ Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool
         return 0;
     
     StringHash nameHash(name);
+    Resource* dependent = loadingResources_.Size() ? loadingResources_.Back() : 0;
 
     // Check if the resource is being background loaded but is now needed immediately
     backgroundLoader_->WaitForResource(type, nameHash);
 
     const SharedPtr<Resource>& existing = FindResource(type, nameHash);
     if (existing)
+    {
+        existing->ResetUseTimer();
+        ++resourceGroups_[type].hits_;
+        if (recordingManifest_)
+            RecordResource(type, name, existing, dependent);
         return existing;
+    }
     
     SharedPtr<Resource> resource;
     // Make sure the pointer is non-null and is a Resource subclass
@@ -543,7 +584,11 @@ Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool
     LOGDEBUG("Loading resource " + name);
     resource->SetName(name);
 
-    if (!resource->Load(*(file.Get())))
+    loadingResources_.Push(resource);
+    bool success = resource->Load(*(file.Get()));
+    loadingResources_.Pop();
+    
+    if (!success)
     {
         // Error should already been logged by corresponding resource descendant class
         if (sendEventOnFailure)
@@ -560,14 +605,48 @@ Resource* ResourceCache::GetResource(StringHash type, const String& nameIn, bool
     }
     
     // Store to cache
-    resource->ResetUseTimer();
-    resourceGroups_[type].resources_[nameHash] = resource;
-    UpdateResourceGroup(type);
+    ++resourceGroups_[type].misses_;
+    StoreResource(resource);
+    if (recordingManifest_)
+        RecordResource(type, name, resource, dependent);
     
     return resource;
 }
 
-bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn, bool sendEventOnFailure, Resource* caller)
+Resource* ResourceCache::GetExistingResource(StringHash type, const String& nameIn)
+{
+    String name = SanitateResourceName(nameIn);
+    
+    if (!Thread::IsMainThread())
+    {
+        LOGERROR("Attempted to get resource " + name + " from outside the main thread");
+        return 0;
+    }
+    
+    if (name.Empty())
+        return 0;
+    
+    StringHash nameHash(name);
+    HashMap<StringHash, ResourceGroup>::Iterator i = resourceGroups_.Find(type);
+    if (i == resourceGroups_.End())
+        return 0;
+    
+    HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Find(nameHash);
+    if (j != i->second_.resources_.End())
+    {
+        j->second_->ResetUseTimer();
+        ++i->second_.hits_;
+        return j->second_;
+    }
+    
+    ++i->second_.misses_;
+    if (i->second_.evicted_.Contains(nameHash))
+        BackgroundLoadResource(type, name);
+    return 0;
+}
+
+bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn, bool sendEventOnFailure, Resource* caller,
+    int priority)
 {
     // If empty name, fail immediately
     String name = SanitateResourceName(nameIn);
@@ -576,10 +655,15 @@ bool ResourceCache::BackgroundLoadResource(StringHash type, const String& nameIn
     
     // First check if already exists as a loaded resource
     StringHash nameHash(name);
-    if (FindResource(type, nameHash) != noResource)
+    const SharedPtr<Resource>& existing = FindResource(type, nameHash);
+    // The main thread may release the existing resource meanwhile, so record only the name from the background loader
+    // threads. The memory use is filled in when the resource is stored, or when the recording stops
+    if (recordingManifest_)
+        RecordResource(type, name, Thread::IsMainThread() ? existing.Get() : 0, caller);
+    if (existing != noResource)
         return false;
     
-    return backgroundLoader_->QueueResource(type, name, sendEventOnFailure, caller);
+    return backgroundLoader_->QueueResource(type, name, sendEventOnFailure, caller, priority);
 }
 
 SharedPtr<Resource> ResourceCache::GetTempResource(StringHash type, const String& nameIn, bool sendEventOnFailure)
@@ -640,6 +724,16 @@ unsigned ResourceCache::GetNumBackgroundLoadResources() const
     return backgroundLoader_->GetNumQueuedResources();
 }
 
+void ResourceCache::SetNumBackgroundLoadThreads(unsigned num)
+{
+    backgroundLoader_->SetNumThreads(num);
+}
+
+unsigned ResourceCache::GetNumBackgroundLoadThreads() const
+{
+    return backgroundLoader_->GetNumThreads();
+}
+
 void ResourceCache::GetResources(PODVector<Resource*>& result, StringHash type) const
 {
     result.Clear();
@@ -654,33 +748,26 @@ void ResourceCache::GetResources(PODVector<Resource*>& result, StringHash type)
 
 bool ResourceCache::Exists(const String& nameIn) const
 {
-    MutexLock lock(resourceMutex_);
-    
-    String name = SanitateResourceName(nameIn);
-    if (resourceRouter_)
-        resourceRouter_->Route(name, RESOURCE_CHECKEXISTS);
+    String name;
+    const ResourceSearchPaths* paths = BeginSearch(name, nameIn, RESOURCE_CHECKEXISTS);
     
-    if (name.Empty())
-        return false;
-    
-    for (unsigned i = 0; i < packages_.Size(); ++i)
-    {
-        if (packages_[i]->Exists(name))
-            return true;
-    }
-    
-    FileSystem* fileSystem = GetSubsystem<FileSystem>();
-    for (unsigned i = 0; i < resourceDirs_.Size(); ++i)
+    bool found = false;
+    if (name.Length())
     {
-        if (fileSystem->FileExists(resourceDirs_[i] + name))
-            return true;
+        for (unsigned i = 0; i < paths->packages_.Size() && !found; ++i)
+            found = paths->packages_[i]->Exists(name);
+        
+        FileSystem* fileSystem = GetSubsystem<FileSystem>();
+        for (unsigned i = 0; i < paths->resourceDirs_.Size() && !found; ++i)
+            found = fileSystem->FileExists(paths->resourceDirs_[i] + name);
+        
+        // Fallback using absolute path
+        if (!found)
+            found = fileSystem->FileExists(name);
     }
     
-    // Fallback using absolute path
-    if (fileSystem->FileExists(name))
-        return true;
-
-    return false;
+    EndSearch();
+    return found;
 }
 
 unsigned ResourceCache::GetMemoryBudget(StringHash type) const
@@ -711,16 +798,26 @@ unsigned ResourceCache::GetTotalMemoryUse() const
 
 String ResourceCache::GetResourceFileName(const String& name) const
 {
-    MutexLock lock(resourceMutex_);
+    const ResourceSearchPaths* paths;
+    {
+        MutexLock lock(resourceMutex_);
+        paths = searchPaths_;
+        ++activeSearches_;
+    }
     
+    String fileName;
     FileSystem* fileSystem = GetSubsystem<FileSystem>();
-    for (unsigned i = 0; i < resourceDirs_.Size(); ++i)
+    for (unsigned i = 0; i < paths->resourceDirs_.Size(); ++i)
     {
-        if (fileSystem->FileExists(resourceDirs_[i] + name))
-            return resourceDirs_[i] + name;
+        if (fileSystem->FileExists(paths->resourceDirs_[i] + name))
+        {
+            fileName = paths->resourceDirs_[i] + name;
+            break;
+        }
     }
     
-    return String();
+    EndSearch();
+    return fileName;
 }
 
 String ResourceCache::GetPreferredResourceDir(const String& path) const
@@ -901,40 +998,88 @@ void ResourceCache::UpdateResourceGroup(StringHash type)
     if (i == resourceGroups_.End())
         return;
     
-    for (;;)
+    ResourceGroup& group = i->second_;
+    unsigned totalSize = 0;
+    for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator j = group.resources_.Begin(); j != group.resources_.End(); ++j)
+        totalSize += j->second_->GetMemoryUse();
+    group.memoryUse_ = totalSize;
+    
+    if (!group.memoryBudget_ || group.memoryUse_ <= group.memoryBudget_)
+        return;
+    
+    // Collect the resources that can be released, sorted by time since last use
+    // (resources in use always return a zero timer and can not be released)
+    Vector<Pair<unsigned, StringHash> > candidates;
+    for (HashMap<StringHash, SharedPtr<Resource> >::ConstIterator j = group.resources_.Begin(); j != group.resources_.End(); ++j)
     {
-        unsigned totalSize = 0;
-        unsigned oldestTimer = 0;
-        HashMap<StringHash, SharedPtr<Resource> >::Iterator oldestResource = i->second_.resources_.End();
-        
-        for (HashMap<StringHash, SharedPtr<Resource> >::Iterator j = i->second_.resources_.Begin();
-            j != i->second_.resources_.End(); ++j)
-        {
-            totalSize += j->second_->GetMemoryUse();
-            unsigned useTimer = j->second_->GetUseTimer();
-            if (useTimer > oldestTimer)
-            {
-                oldestTimer = useTimer;
-                oldestResource = j;
-            }
-        }
-        
-        i->second_.memoryUse_ = totalSize;
-        
-        // If memory budget defined and is exceeded, remove the oldest resource and loop again
-        // (resources in use always return a zero timer and can not be removed)
-        if (i->second_.memoryBudget_ && i->second_.memoryUse_ > i->second_.memoryBudget_ &&
-            oldestResource != i->second_.resources_.End())
+        unsigned useTimer = j->second_->GetUseTimer();
+        if (useTimer && !j->second_->IsPinned())
+            candidates.Push(MakePair(useTimer, j->first_));
+    }
+    Sort(candidates.Begin(), candidates.End());
+    
+    // Release the least recently used resources until within the budget. Remember them to be able to count reloads, and to
+    // reload in the background when requested with GetExistingResource()
+    for (unsigned j = candidates.Size() - 1; j < candidates.Size() && group.memoryUse_ > group.memoryBudget_; --j)
+    {
+        HashMap<StringHash, SharedPtr<Resource> >::Iterator k = group.resources_.Find(candidates[j].second_);
+        LOGDEBUG("Resource group " + k->second_->GetTypeName() + " over memory budget, releasing resource " +
+            k->second_->GetName());
+        group.memoryUse_ -= k->second_->GetMemoryUse();
+        group.evicted_[k->first_] = group.evictions_++;
+        group.resources_.Erase(k);
+    }
+    
+    // Forget the older half of the evicted resources when there are too many, so that the set does not grow without bound when
+    // many different resources cycle through the budget
+    if (group.evicted_.Size() > MAX_EVICTED_RESOURCES)
+    {
+        unsigned oldest = group.evictions_ - MAX_EVICTED_RESOURCES / 2;
+        for (HashMap<StringHash, unsigned>::Iterator j = group.evicted_.Begin(); j != group.evicted_.End();)
         {
-            LOGDEBUG("Resource group " + oldestResource->second_->GetTypeName() + " over memory budget, releasing resource " +
-                oldestResource->second_->GetName());
-            i->second_.resources_.Erase(oldestResource);
+            if ((int)(j->second_ - oldest) < 0)
+                j = group.evicted_.Erase(j);
+            else
+                ++j;
         }
-        else
-            break;
     }
 }
 
+void ResourceCache::StoreResource(Resource* resource)
+{
+    StringHash type = resource->GetType();
+    ResourceGroup& group = resourceGroups_[type];
+    if (group.evicted_.Erase(resource->GetNameHash()))
+        ++group.reloads_;
+    
+    resource->ResetUseTimer();
+    group.resources_[resource->GetNameHash()] = resource;
+    UpdateResourceGroup(type);
+    
+    // Update the memory use of a resource recorded when it was queued for background loading
+    if (recordingManifest_)
+    {
+        MutexLock lock(manifestMutex_);
+        unsigned index = recordingManifest_ ? recordingManifest_->FindResource(type, resource->GetNameHash()) : M_MAX_UNSIGNED;
+        if (index != M_MAX_UNSIGNED)
+            recordingManifest_->SetResourceSize(index, resource->GetMemoryUse());
+    }
+}
+
+void ResourceCache::RecordResource(StringHash type, const String& name, const Resource* resource, const Resource* dependent)
+{
+    MutexLock lock(manifestMutex_);
+    
+    if (!recordingManifest_)
+        return;
+    
+    unsigned index = recordingManifest_->AddResource(type, name);
+    if (resource)
+        recordingManifest_->SetResourceSize(index, resource->GetMemoryUse());
+    if (dependent)
+        recordingManifest_->AddDependency(recordingManifest_->AddResource(dependent->GetType(), dependent->GetName()), index);
+}
+
 void ResourceCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
 {
     for (unsigned i = 0; i < fileWatchers_.Size(); ++i)
@@ -954,23 +1099,41 @@ void ResourceCache::HandleBeginFrame(StringHash eventType, VariantMap& eventData
         }
     }
     
+    // Free replaced search path snapshots that searches were still using at the time
+    if (retiredSearchPaths_.Size())
+    {
+        MutexLock lock(resourceMutex_);
+        FreeRetiredSearchPaths();
+    }
+    
     // Check for background loaded resources that can be finished
     {
         PROFILE(FinishBackgroundResources);
         backgroundLoader_->FinishResources(finishBackgroundResourcesMs_);
     }
+    
+    // Enforce the memory budgets periodically, as resources may have become unused or changed their memory use since loading
+    if (memoryBudgetTimer_.GetMSec(false) >= MEMORY_BUDGET_CHECK_INTERVAL)
+    {
+        memoryBudgetTimer_.Reset();
+        for (HashMap<StringHash, ResourceGroup>::ConstIterator i = resourceGroups_.Begin(); i != resourceGroups_.End(); ++i)
+        {
+            if (i->second_.memoryBudget_)
+                UpdateResourceGroup(i->first_);
+        }
+    }
 }
 
-File* ResourceCache::SearchResourceDirs(const String& nameIn)
+File* ResourceCache::SearchResourceDirs(const ResourceSearchPaths& paths, const String& nameIn)
 {
     FileSystem* fileSystem = GetSubsystem<FileSystem>();
-    for (unsigned i = 0; i < resourceDirs_.Size(); ++i)
+    for (unsigned i = 0; i < paths.resourceDirs_.Size(); ++i)
     {
-        if (fileSystem->FileExists(resourceDirs_[i] + nameIn))
+        if (fileSystem->FileExists(paths.resourceDirs_[i] + nameIn))
         {
             // Construct the file first with full path, then rename it to not contain the resource path,
             // so that the file's name can be used in further GetFile() calls (for example over the network)
-            File* file(new File(context_, resourceDirs_[i] + nameIn));
+            File* file(new File(context_, paths.resourceDirs_[i] + nameIn));
             file->SetName(nameIn);
             return file;
         }
@@ -983,22 +1146,75 @@ File* ResourceCache::SearchResourceDirs(const String& nameIn)
     return 0;
 }
 
-File* ResourceCache::SearchPackages(const String& nameIn)
+File* ResourceCache::SearchPackages(const ResourceSearchPaths& paths, const String& nameIn)
 {
-    for (unsigned i = 0; i < packages_.Size(); ++i)
+    for (unsigned i = 0; i < paths.packages_.Size(); ++i)
     {
-        if (packages_[i]->Exists(nameIn))
-            return new File(context_, packages_[i], nameIn);
+        if (paths.packages_[i]->Exists(nameIn))
+            return new File(context_, paths.packages_[i], nameIn);
     }
 
     return 0;
 }
 
+void ResourceCache::UpdateSearchPaths()
+{
+    SharedPtr<ResourceSearchPaths> newPaths(new ResourceSearchPaths());
+    newPaths->resourceDirs_ = resourceDirs_;
+    newPaths->packages_ = packages_;
+    
+    retiredSearchPaths_.Push(searchPaths_);
+    searchPaths_ = newPaths;
+    FreeRetiredSearchPaths();
+}
+
+const ResourceSearchPaths* ResourceCache::BeginSearch(String& name, const String& nameIn, ResourceRequest requestType) const
+{
+    MutexLock lock(resourceMutex_);
+    
+    name = SanitateResourceName(nameIn);
+    if (resourceRouter_)
+        resourceRouter_->Route(name, requestType);
+    
+    ++activeSearches_;
+    return searchPaths_;
+}
+
+void ResourceCache::EndSearch() const
+{
+    MutexLock lock(resourceMutex_);
+    
+    --activeSearches_;
+    FreeRetiredSearchPaths();
+}
+
+void ResourceCache::FreeRetiredSearchPaths() const
+{
+    // The snapshots hold references to package files, so release them only in the main thread
+    if (activeSearches_ || retiredSearchPaths_.Empty() || !Thread::IsMainThread())
+        return;
+    
+    // Files opened from a memory-mapped package point to its mapping, so keep removed packages alive until such files
+    // have been closed
+    for (unsigned i = 0; i < retiredSearchPaths_.Size(); ++i)
+    {
+        const Vector<SharedPtr<PackageFile> >& packages = retiredSearchPaths_[i]->packages_;
+        for (unsigned j = 0; j < packages.Size(); ++j)
+        {
+            if (packages[j]->GetNumMappedFiles() && !searchPaths_->packages_.Contains(packages[j]))
+                return;
+        }
+    }
+    
+    retiredSearchPaths_.Clear();
+}
+
 void RegisterResourceLibrary(Context* context)
 {
     Image::RegisterObject(context);
     JSONFile::RegisterObject(context);
     PListFile::RegisterObject(context);
+    ResourceManifest::RegisterObject(context);
     XMLFile::RegisterObject(context);
 }
 
@@ -34,6 +34,7 @@ namespace Urho3D
 class BackgroundLoader;
 class FileWatcher;
 class PackageFile;
+class ResourceManifest;
 
 /// Sets to priority so that a package or file is pushed to the end of the vector.
 static const unsigned PRIORITY_LAST = 0xffffffff;
@@ -44,7 +45,11 @@ struct ResourceGroup
     /// Construct with defaults.
     ResourceGroup() :
         memoryBudget_(0),
-        memoryUse_(0)
+        memoryUse_(0),
+        hits_(0),
+        misses_(0),
+        evictions_(0),
+        reloads_(0)
     {
     }
     
@@ -52,8 +57,27 @@ struct ResourceGroup
     unsigned memoryBudget_;
     /// Current memory use.
     unsigned memoryUse_;
+    /// Number of resource requests served from the cache.
+    unsigned hits_;
+    /// Number of resource requests not served from the cache.
+    unsigned misses_;
+    /// Number of resources released due to exceeding the memory budget.
+    unsigned evictions_;
+    /// Number of released resources loaded again.
+    unsigned reloads_;
     /// Resources.
     HashMap<StringHash, SharedPtr<Resource> > resources_;
+    /// Name hashes of resources released due to exceeding the memory budget, with the eviction count when released. Only the most recent evictions are remembered.
+    HashMap<StringHash, unsigned> evicted_;
+};
+
+/// Snapshot of the resource directories and package files, which threads search for files without holding the resource mutex. Not modified after creation.
+struct ResourceSearchPaths : public RefCounted
+{
+    /// Resource load directories.
+    Vector<String> resourceDirs_;
+    /// Package files.
+    Vector<SharedPtr<PackageFile> > packages_;
 };
 
 /// Resource request types.
@@ -114,7 +138,7 @@ public:
     bool ReloadResource(Resource* resource);
     /// Reload a resource based on filename. Causes also reload of dependent resources if necessary.
     void ReloadResourceWithDependencies(const String &fileName);
-    /// Set memory budget for a specific resource type, default 0 is unlimited.
+    /// Set memory budget for a specific resource type, default 0 is unlimited. When exceeded, the least recently used resources which are not in use elsewhere or pinned are released.
     void SetMemoryBudget(StringHash type, unsigned budget);
     /// Enable or disable automatic reloading of resources as files are modified. Default false.
     void SetAutoReloadResources(bool enable);
@@ -124,19 +148,27 @@ public:
     void SetSearchPackagesFirst(bool value) { searchPackagesFirst_ = value; }
     /// Set how many milliseconds maximum per frame to spend on finishing background loaded resources.
     void SetFinishBackgroundResourcesMs(int ms) { finishBackgroundResourcesMs_ = Max(ms, 1); }
+    /// Set number of background loader threads, default 1. Resources are loaded in parallel when there are several.
+    void SetNumBackgroundLoadThreads(unsigned num);
     /// Set the resource router object. By default there is none, so the routing process is skipped.
     void SetResourceRouter(ResourceRouter* router) { resourceRouter_ = router; }
+    /// Set a manifest to record the resources requested from the cache into, along with their memory use and dependencies. Null stops recording.
+    void SetRecordingManifest(ResourceManifest* manifest);
     
     /// Open and return a file from the resource load paths or from inside a package file. If not found, use a fallback search with absolute path. Return null if fails. Can be called from outside the main thread.
     SharedPtr<File> GetFile(const String& name, bool sendEventOnFailure = true);
     /// Return a resource by type and name. Load if not loaded yet. Return null if not found or if fails, unless SetReturnFailedResources(true) has been called. Can be called only from the main thread.
     Resource* GetResource(StringHash type, const String& name, bool sendEventOnFailure = true);
+    /// Return an already loaded resource by type and name, or null if not loaded. A resource released due to exceeding the memory budget is queued for background loading to be available later. Can be called only from the main thread.
+    Resource* GetExistingResource(StringHash type, const String& name);
     /// Load a resource without storing it in the resource cache. Return null if not found or if fails. Can be called from outside the main thread if the resource itself is safe to load completely (it does not possess for example GPU data.)
     SharedPtr<Resource> GetTempResource(StringHash type, const String& name, bool sendEventOnFailure = true);
-    /// Background load a resource. An event will be sent when complete. Return true if successfully stored to the load queue, false if eg. already exists. Can be called from outside the main thread.
-    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = 0);
+    /// Background load a resource. An event will be sent when complete. Return true if successfully stored to the load queue, false if eg. already exists. Resources with higher priority are loaded first, and the resources a caller depends on get at least its priority. Can be called from outside the main thread.
+    bool BackgroundLoadResource(StringHash type, const String& name, bool sendEventOnFailure = true, Resource* caller = 0, int priority = 0);
     /// Return number of pending background-loaded resources.
     unsigned GetNumBackgroundLoadResources() const;
+    /// Return number of background loader threads.
+    unsigned GetNumBackgroundLoadThreads() const;
     /// Return all loaded resources of a specific type.
     void GetResources(PODVector<Resource*>& result, StringHash type) const;
     /// Return all loaded resources.
@@ -147,10 +179,12 @@ public:
     const Vector<SharedPtr<PackageFile> >& GetPackageFiles() const { return packages_; }
     /// Template version of returning a resource by name.
     template <class T> T* GetResource(const String& name, bool sendEventOnFailure = true);
+    /// Template version of returning an already loaded resource by name.
+    template <class T> T* GetExistingResource(const String& name);
     /// Template version of loading a resource without storing it to the cache.
     template <class T> SharedPtr<T> GetTempResource(const String& name, bool sendEventOnFailure = true);
     /// Template version of queueing a resource background load.
-    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = 0);
+    template <class T> bool BackgroundLoadResource(const String& name, bool sendEventOnFailure = true, Resource* caller = 0, int priority = 0);
     /// Template version of returning loaded resources of a specific type.
     template <class T> void GetResources(PODVector<T*>& result) const;
     /// Return whether a file exists by name.
@@ -173,6 +207,8 @@ public:
     int GetFinishBackgroundResourcesMs() const { return finishBackgroundResourcesMs_; }
     /// Return the resource router.
     ResourceRouter* GetResourceRouter() const { return resourceRouter_; }
+    /// Return the manifest being recorded, or null if not recording.
+    ResourceManifest* GetRecordingManifest() const { return recordingManifest_; }
 
     /// Return either the path itself or its parent, based on which of them has recognized resource subdirectories.
     String GetPreferredResourceDir(const String& path) const;
@@ -192,16 +228,28 @@ private:
     const SharedPtr<Resource>& FindResource(StringHash nameHash);
     /// Release resources loaded from a package file.
     void ReleasePackageResources(PackageFile* package, bool force = false);
-    /// Update a resource group. Recalculate memory use and release resources if over memory budget.
+    /// Update a resource group. Recalculate memory use and release least recently used resources if over memory budget.
     void UpdateResourceGroup(StringHash type);
+    /// Store a loaded resource to its resource group.
+    void StoreResource(Resource* resource);
+    /// Record a requested resource to the manifest being recorded, with its memory use if already loaded, and the resource waiting on it if any. The resource must be null when called from outside the main thread.
+    void RecordResource(StringHash type, const String& name, const Resource* resource, const Resource* dependent);
     /// Handle begin frame event. Automatic resource reloads and the finalization of background loaded resources are processed here.
     void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
     /// Search FileSystem for file.
-    File* SearchResourceDirs(const String& nameIn);
+    File* SearchResourceDirs(const ResourceSearchPaths& paths, const String& nameIn);
     /// Search resource packages for file.
-    File* SearchPackages(const String& nameIn);
+    File* SearchPackages(const ResourceSearchPaths& paths, const String& nameIn);
+    /// Create a new search path snapshot after the resource directories or package files have changed. Called with the resource mutex held.
+    void UpdateSearchPaths();
+    /// Sanitate and route a resource name, and return the current search path snapshot, which stays valid until EndSearch() is called.
+    const ResourceSearchPaths* BeginSearch(String& name, const String& nameIn, ResourceRequest requestType) const;
+    /// Finish using a search path snapshot.
+    void EndSearch() const;
+    /// Free search path snapshots that are no longer current, if not in use and no files are open from the memory mappings of their removed packages. Called with the resource mutex held.
+    void FreeRetiredSearchPaths() const;
     
-    /// Mutex for thread-safe access to the resource directories, resource packages and resource dependencies.
+    /// Mutex for thread-safe access to the resource directories, resource packages and resource dependencies. Only held briefly when searching for files.
     mutable Mutex resourceMutex_;
     /// Resources by type.
     HashMap<StringHash, ResourceGroup> resourceGroups_;
@@ -211,12 +259,26 @@ private:
     Vector<SharedPtr<FileWatcher> > fileWatchers_;
     /// Package files.
     Vector<SharedPtr<PackageFile> > packages_;
+    /// Current search path snapshot.
+    SharedPtr<ResourceSearchPaths> searchPaths_;
+    /// Search path snapshots that have been replaced, but may still be in use.
+    mutable Vector<SharedPtr<ResourceSearchPaths> > retiredSearchPaths_;
+    /// Number of searches using a search path snapshot.
+    mutable unsigned activeSearches_;
     /// Dependent resources. Only used with automatic reload to eg. trigger reload of a cube texture when any of its faces change.
     HashMap<StringHash, HashSet<StringHash> > dependentResources_;
     /// Resource background loader.
     SharedPtr<BackgroundLoader> backgroundLoader_;
     /// Resource router.
     SharedPtr<ResourceRouter> resourceRouter_;
+    /// Manifest being recorded.
+    SharedPtr<ResourceManifest> recordingManifest_;
+    /// Mutex for recording the manifest, as background loading resources may request more resources from the loader threads.
+    Mutex manifestMutex_;
+    /// Resources being loaded in the main thread, for recording the dependencies of the resources they request.
+    PODVector<Resource*> loadingResources_;
+    /// Timer for periodically enforcing the memory budgets.
+    Timer memoryBudgetTimer_;
     /// Automatic resource reloading flag.
     bool autoReloadResources_;
     /// Return failed resources flag.
@@ -233,16 +295,22 @@ template <class T> T* ResourceCache::GetResource(const String& name, bool sendEv
     return static_cast<T*>(GetResource(type, name, sendEventOnFailure));
 }
 
+template <class T> T* ResourceCache::GetExistingResource(const String& name)
+{
+    StringHash type = T::GetTypeStatic();
+    return static_cast<T*>(GetExistingResource(type, name));
+}
+
 template <class T> SharedPtr<T> ResourceCache::GetTempResource(const String& name, bool sendEventOnFailure)
 {
     StringHash type = T::GetTypeStatic();
     return StaticCast<T>(GetTempResource(type, name, sendEventOnFailure));
 }
 
-template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller)
+template <class T> bool ResourceCache::BackgroundLoadResource(const String& name, bool sendEventOnFailure, Resource* caller, int priority)
 {
     StringHash type = T::GetTypeStatic();
-    return BackgroundLoadResource(type, name, sendEventOnFailure, caller);
+    return BackgroundLoadResource(type, name, sendEventOnFailure, caller, priority);
 }
 
 template <class T> void ResourceCache::GetResources(PODVector<T*>& result) const
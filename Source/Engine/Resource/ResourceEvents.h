@@ -73,6 +73,9 @@ EVENT(E_RESOURCEBACKGROUNDLOADED, ResourceBackgroundLoaded)
     PARAM(P_RESOURCENAME, ResourceName);            // String
     PARAM(P_SUCCESS, Success);                      // bool
     PARAM(P_RESOURCE, Resource);                    // Resource pointer
+    PARAM(P_WAITTIME, WaitTime);                    // int (microseconds queued before loading started)
+    PARAM(P_BEGINLOADTIME, BeginLoadTime);          // int (microseconds in the loader thread)
+    PARAM(P_ENDLOADTIME, EndLoadTime);              // int (microseconds in the main thread)
 }
 
 }
@@ -0,0 +1,292 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "Log.h"
+#include "ResourceCache.h"
+#include "ResourceManifest.h"
+#include "Sort.h"
+#include "XMLFile.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+/// %Resource index with its prefetch priority.
+struct PrefetchEntry
+{
+    /// Test for sorting in descending priority order.
+    bool operator < (const PrefetchEntry& rhs) const { return priority_ > rhs.priority_; }
+    
+    /// Priority.
+    int priority_;
+    /// Resource index.
+    unsigned index_;
+};
+
+/// Return the size in kilobytes of the longest chain of resources waiting on a resource, including itself.
+static unsigned GetChainSize(unsigned index, const Vector<ManifestResource>& resources, const Vector<PODVector<unsigned> >& dependents,
+    PODVector<unsigned>& chainSizes, PODVector<unsigned char>& visited)
+{
+    // A dependency cycle should not exist, but if it does, do not follow it
+    if (visited[index])
+        return visited[index] == 2 ? chainSizes[index] : 0;
+    
+    visited[index] = 1;
+    unsigned maxDependentSize = 0;
+    const PODVector<unsigned>& indexDependents = dependents[index];
+    for (unsigned i = 0; i < indexDependents.Size(); ++i)
+    {
+        unsigned dependentSize = GetChainSize(indexDependents[i], resources, dependents, chainSizes, visited);
+        if (dependentSize > maxDependentSize)
+            maxDependentSize = dependentSize;
+    }
+    
+    chainSizes[index] = (resources[index].size_ + 1023) / 1024 + maxDependentSize;
+    visited[index] = 2;
+    return chainSizes[index];
+}
+
+ResourceManifest::ResourceManifest(Context* context) :
+    Resource(context)
+{
+}
+
+ResourceManifest::~ResourceManifest()
+{
+}
+
+void ResourceManifest::RegisterObject(Context* context)
+{
+    context->RegisterFactory<ResourceManifest>();
+}
+
+bool ResourceManifest::BeginLoad(Deserializer& source)
+{
+    XMLFile xmlFile(context_);
+    if (!xmlFile.Load(source))
+        return false;
+    
+    XMLElement rootElem = xmlFile.GetRoot("manifest");
+    if (!rootElem)
+    {
+        LOGERROR("Resource manifest " + source.GetName() + " has no manifest element");
+        return false;
+    }
+    
+    Clear();
+    
+    XMLElement resourceElem = rootElem.GetChild("resource");
+    while (resourceElem)
+    {
+        unsigned index = AddResource(StringHash(resourceElem.GetAttribute("type")), resourceElem.GetAttribute("name"));
+        ManifestResource& resource = resources_[index];
+        resource.size_ = resourceElem.GetUInt("size");
+        
+        Vector<String> dependencies = resourceElem.GetAttribute("dependencies").Split(' ');
+        for (unsigned i = 0; i < dependencies.Size(); ++i)
+            resource.dependencies_.Push(ToUInt(dependencies[i]));
+        
+        resourceElem = resourceElem.GetNext("resource");
+    }
+    
+    // Dependencies may refer forward, so validate them only after all resources are known
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+    {
+        PODVector<unsigned>& dependencies = resources_[i].dependencies_;
+        for (unsigned j = 0; j < dependencies.Size();)
+        {
+            if (dependencies[j] >= resources_.Size() || dependencies[j] == i)
+                dependencies.Erase(j);
+            else
+                ++j;
+        }
+    }
+    
+    SetMemoryUse(source.GetSize());
+    return true;
+}
+
+bool ResourceManifest::Save(Serializer& dest) const
+{
+    XMLFile xmlFile(context_);
+    XMLElement rootElem = xmlFile.CreateRoot("manifest");
+    
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+    {
+        const ManifestResource& resource = resources_[i];
+        XMLElement resourceElem = rootElem.CreateChild("resource");
+        resourceElem.SetAttribute("type", context_->GetTypeName(resource.type_));
+        resourceElem.SetAttribute("name", resource.name_);
+        resourceElem.SetUInt("size", resource.size_);
+        
+        if (!resource.dependencies_.Empty())
+        {
+            String dependencies;
+            for (unsigned j = 0; j < resource.dependencies_.Size(); ++j)
+            {
+                if (j)
+                    dependencies += ' ';
+                dependencies += String(resource.dependencies_[j]);
+            }
+            resourceElem.SetAttribute("dependencies", dependencies);
+        }
+    }
+    
+    return xmlFile.Save(dest);
+}
+
+unsigned ResourceManifest::AddResource(StringHash type, const String& name)
+{
+    Pair<StringHash, StringHash> key = MakePair(type, StringHash(name));
+    HashMap<Pair<StringHash, StringHash>, unsigned>::ConstIterator i = resourceIndices_.Find(key);
+    if (i != resourceIndices_.End())
+        return i->second_;
+    
+    unsigned index = resources_.Size();
+    resources_.Resize(index + 1);
+    resources_[index].type_ = type;
+    resources_[index].name_ = name;
+    resourceIndices_[key] = index;
+    return index;
+}
+
+void ResourceManifest::SetResourceSize(unsigned index, unsigned size)
+{
+    if (index < resources_.Size())
+        resources_[index].size_ = size;
+}
+
+void ResourceManifest::AddDependency(unsigned index, unsigned dependencyIndex)
+{
+    if (index >= resources_.Size() || dependencyIndex >= resources_.Size() || index == dependencyIndex)
+        return;
+    
+    PODVector<unsigned>& dependencies = resources_[index].dependencies_;
+    if (!dependencies.Contains(dependencyIndex))
+        dependencies.Push(dependencyIndex);
+}
+
+unsigned ResourceManifest::RemoveMissingResources()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    
+    // Map the old indices to new, and keep only the resources whose files exist
+    PODVector<unsigned> newIndices(resources_.Size());
+    Vector<ManifestResource> existing;
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+    {
+        if (cache->Exists(resources_[i].name_))
+        {
+            newIndices[i] = existing.Size();
+            existing.Push(resources_[i]);
+        }
+        else
+            newIndices[i] = M_MAX_UNSIGNED;
+    }
+    
+    unsigned numRemoved = resources_.Size() - existing.Size();
+    if (!numRemoved)
+        return 0;
+    
+    resourceIndices_.Clear();
+    for (unsigned i = 0; i < existing.Size(); ++i)
+    {
+        PODVector<unsigned>& dependencies = existing[i].dependencies_;
+        for (unsigned j = 0; j < dependencies.Size();)
+        {
+            unsigned newIndex = newIndices[dependencies[j]];
+            if (newIndex != M_MAX_UNSIGNED)
+            {
+                dependencies[j] = newIndex;
+                ++j;
+            }
+            else
+                dependencies.Erase(j);
+        }
+        
+        resourceIndices_[MakePair(existing[i].type_, StringHash(existing[i].name_))] = i;
+    }
+    
+    resources_ = existing;
+    return numRemoved;
+}
+
+void ResourceManifest::Clear()
+{
+    resources_.Clear();
+    resourceIndices_.Clear();
+}
+
+unsigned ResourceManifest::FindResource(StringHash type, StringHash nameHash) const
+{
+    HashMap<Pair<StringHash, StringHash>, unsigned>::ConstIterator i = resourceIndices_.Find(MakePair(type, nameHash));
+    return i != resourceIndices_.End() ? i->second_ : M_MAX_UNSIGNED;
+}
+
+unsigned ResourceManifest::GetTotalSize() const
+{
+    unsigned totalSize = 0;
+    for (unsigned i = 0; i < resources_.Size(); ++i)
+        totalSize += resources_[i].size_;
+    return totalSize;
+}
+
+void ResourceManifest::GetPrefetchOrder(PODVector<unsigned>& order, PODVector<int>& priorities) const
+{
+    unsigned numResources = resources_.Size();
+    
+    // Reverse the dependencies to know which resources wait on each resource
+    Vector<PODVector<unsigned> > dependents(numResources);
+    for (unsigned i = 0; i < numResources; ++i)
+    {
+        const PODVector<unsigned>& dependencies = resources_[i].dependencies_;
+        for (unsigned j = 0; j < dependencies.Size(); ++j)
+            dependents[dependencies[j]].Push(i);
+    }
+    
+    PODVector<unsigned> chainSizes(numResources);
+    PODVector<unsigned char> visited(numResources);
+    for (unsigned i = 0; i < numResources; ++i)
+        visited[i] = 0;
+    
+    PODVector<PrefetchEntry> entries(numResources);
+    priorities.Resize(numResources);
+    for (unsigned i = 0; i < numResources; ++i)
+    {
+        // Keep below the priority the background loader uses for resources the main thread waits on
+        unsigned chainSize = GetChainSize(i, resources_, dependents, chainSizes, visited);
+        priorities[i] = chainSize < (unsigned)M_MAX_INT ? (int)chainSize : M_MAX_INT - 1;
+        entries[i].priority_ = priorities[i];
+        entries[i].index_ = i;
+    }
+    
+    Sort(entries.Begin(), entries.End());
+    
+    order.Resize(numResources);
+    for (unsigned i = 0; i < numResources; ++i)
+        order[i] = entries[i].index_;
+}
+
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "Resource.h"
+
+namespace Urho3D
+{
+
+/// %Resource entry in a load manifest.
+struct ManifestResource
+{
+    /// Construct with defaults.
+    ManifestResource() :
+        size_(0)
+    {
+    }
+    
+    /// Resource type.
+    StringHash type_;
+    /// Resource name.
+    String name_;
+    /// Memory use in bytes when last loaded.
+    unsigned size_;
+    /// Indices of the resources needed for loading this resource.
+    PODVector<unsigned> dependencies_;
+};
+
+/// Record of the resources used while loading a scene, with their sizes and dependencies. Used to prefetch the resources in parallel when loading the scene again.
+class URHO3D_API ResourceManifest : public Resource
+{
+    OBJECT(ResourceManifest);
+    
+public:
+    /// Construct.
+    ResourceManifest(Context* context);
+    /// Destruct.
+    virtual ~ResourceManifest();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+    
+    /// Load resource from stream. May be called from a worker thread. Return true if successful.
+    virtual bool BeginLoad(Deserializer& source);
+    /// Save resource. Return true if successful.
+    virtual bool Save(Serializer& dest) const;
+    
+    /// Add a resource if not added yet. Return its index.
+    unsigned AddResource(StringHash type, const String& name);
+    /// Set memory use of a resource.
+    void SetResourceSize(unsigned index, unsigned size);
+    /// Store a dependency of a resource on another resource.
+    void AddDependency(unsigned index, unsigned dependencyIndex);
+    /// Remove resources whose files can not be found through the resource cache, for example manually created resources. Return number of resources removed.
+    unsigned RemoveMissingResources();
+    /// Remove all resources.
+    void Clear();
+    
+    /// Return all resources.
+    const Vector<ManifestResource>& GetResources() const { return resources_; }
+    /// Return number of resources.
+    unsigned GetNumResources() const { return resources_.Size(); }
+    /// Return index of a resource by type and name hash, or M_MAX_UNSIGNED if not found.
+    unsigned FindResource(StringHash type, StringHash nameHash) const;
+    /// Return total memory use of the resources.
+    unsigned GetTotalSize() const;
+    /// Return background load priorities for prefetching, and the resource indices sorted by descending priority. A resource's priority is the size of the longest chain of resources waiting on it, so that large resources many others depend on are loaded first.
+    void GetPrefetchOrder(PODVector<unsigned>& order, PODVector<int>& priorities) const;
+    
+private:
+    /// Resources in the order they were first used.
+    Vector<ManifestResource> resources_;
+    /// Resource indices by type and name hash. The same file may be loaded as several resource types.
+    HashMap<Pair<StringHash, StringHash>, unsigned> resourceIndices_;
+};
+
+}
@@ -82,18 +82,27 @@ void XMLFile::RegisterObject(Context* context)
 
 bool XMLFile::BeginLoad(Deserializer& source)
 {
-    unsigned dataSize = source.GetSize();
+    unsigned dataSize = source.GetSize() - source.GetPosition();
     if (!dataSize && !source.GetName().Empty())
     {
         LOGERROR("Zero sized XML data in " + source.GetName());
         return false;
     }
 
-    SharedArrayPtr<char> buffer(new char[dataSize]);
-    if (source.Read(buffer.Get(), dataSize) != dataSize)
-        return false;
+    // The parser copies the data, so parse directly from memory if possible
+    const void* data = source.GetReadPointer();
+    SharedArrayPtr<char> buffer;
+    if (data)
+        source.Seek(source.GetPosition() + dataSize);
+    else
+    {
+        buffer = new char[dataSize];
+        if (source.Read(buffer.Get(), dataSize) != dataSize)
+            return false;
+        data = buffer.Get();
+    }
 
-    if (!document_->load_buffer(buffer.Get(), dataSize))
+    if (!document_->load_buffer(data, dataSize))
     {
         LOGERROR("Could not parse XML data from " + source.GetName());
         document_->reset();
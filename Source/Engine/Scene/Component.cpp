@@ -133,6 +133,12 @@ void Component::AddReplicationState(ComponentReplicationState* state)
     networkState_->replicationStates_.Push(state);
 }
 
+void Component::RemoveReplicationState(ComponentReplicationState* state)
+{
+    if (networkState_)
+        networkState_->replicationStates_.Remove(state);
+}
+
 void Component::PrepareNetworkUpdate()
 {
     if (!networkState_)
@@ -148,13 +154,23 @@ void Component::PrepareNetworkUpdate()
     {
         networkState_->currentValues_.Resize(numAttributes);
         networkState_->previousValues_.Resize(numAttributes);
+        networkState_->changeSnapshots_.Resize(numAttributes);
 
         // Copy the default attribute values to the previous state as a starting point
         for (unsigned i = 0; i < numAttributes; ++i)
+        {
             networkState_->previousValues_[i] = attributes->At(i).defaultValue_;
+            networkState_->changeSnapshots_[i] = 0;
+        }
+
+        // The attribute layout changed, so the shared encodings are not valid anymore
+        networkState_->deltaUpdateData_.Clear();
+        networkState_->latestData_.Clear();
     }
 
     // Check for attribute changes
+    DirtyBits changedAttributes;
+    unsigned snapshotID = GetScene() ? GetScene()->GetSnapshotID() : 0;
     for (unsigned i = 0; i < numAttributes; ++i)
     {
         const AttributeInfo& attr = attributes->At(i);
@@ -162,11 +178,10 @@ void Component::PrepareNetworkUpdate()
         if (animationEnabled_ && IsAnimatedNetworkAttribute(attr))
             continue;
 
-        OnGetAttribute(attr, networkState_->currentValues_[i]);
-
-        if (networkState_->currentValues_[i] != networkState_->previousValues_[i])
+        if (UpdateNetworkAttribute(i))
         {
-            networkState_->previousValues_[i] = networkState_->currentValues_[i];
+            changedAttributes.Set(i);
+            networkState_->changeSnapshots_[i] = snapshotID;
 
             // Mark the attribute dirty in all replication states that are tracking this component
             for (PODVector<ReplicationState*>::Iterator j = networkState_->replicationStates_.Begin(); j !=
@@ -186,6 +201,8 @@ void Component::PrepareNetworkUpdate()
         }
     }
 
+    EncodeSharedNetworkUpdate(changedAttributes);
+
     networkUpdate_ = false;
 }
 
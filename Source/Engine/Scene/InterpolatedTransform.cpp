@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Context.h"
+#include "InterpolatedTransform.h"
+#include "Scene.h"
+#include "SceneEvents.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+static const float DEFAULT_DELAY = 0.1f;
+static const float DEFAULT_MAX_EXTRAPOLATION = 0.25f;
+static const float MIN_RESYNC_TIME = 0.25f;
+static const float CLOCK_CORRECTION_RATE = 2.0f;
+static const unsigned MAX_SAMPLES = 32;
+
+InterpolatedTransform::InterpolatedTransform(Context* context) :
+    Component(context),
+    delay_(DEFAULT_DELAY),
+    maxExtrapolation_(DEFAULT_MAX_EXTRAPOLATION),
+    playbackTime_(0.0),
+    latestTime_(-M_INFINITY),
+    timeSinceLatest_(0.0f),
+    playbackStarted_(false),
+    subscribed_(false)
+{
+}
+
+InterpolatedTransform::~InterpolatedTransform()
+{
+}
+
+void InterpolatedTransform::RegisterObject(Context* context)
+{
+    context->RegisterFactory<InterpolatedTransform>();
+    
+    ACCESSOR_ATTRIBUTE(InterpolatedTransform, VAR_FLOAT, "Delay", GetDelay, SetDelay, float, DEFAULT_DELAY, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(InterpolatedTransform, VAR_FLOAT, "Max Extrapolation", GetMaxExtrapolation, SetMaxExtrapolation, float, DEFAULT_MAX_EXTRAPOLATION, AM_DEFAULT);
+}
+
+void InterpolatedTransform::Update(float timeStep)
+{
+    if (node_ && (positionSamples_.Size() || rotationSamples_.Size()))
+    {
+        // Advance the playback clock in local time, steering it gradually toward the delayed server time so that jitter in
+        // the sample arrival times does not show as uneven motion. Resynchronize if too far off
+        timeSinceLatest_ += timeStep;
+        // The times are doubles, so only compute in float relative to the current playback time
+        double targetTime = latestTime_ + timeSinceLatest_ - delay_;
+        float drift = (float)(targetTime - playbackTime_);
+        if (!playbackStarted_ || Abs(drift) > Max(delay_, MIN_RESYNC_TIME))
+        {
+            playbackTime_ = targetTime;
+            playbackStarted_ = true;
+        }
+        else
+            playbackTime_ += timeStep + drift * Min(timeStep * CLOCK_CORRECTION_RATE, 1.0f);
+        
+        bool finished = true;
+        
+        if (positionSamples_.Size())
+        {
+            // Drop samples that playback has passed, but keep two for extrapolation
+            while (positionSamples_.Size() > 2 && positionSamples_[1].time_ <= playbackTime_)
+                positionSamples_.Erase(0);
+            
+            const TransformSample& first = positionSamples_.Front();
+            const TransformSample& last = positionSamples_.Back();
+            Vector3 position;
+            
+            if (playbackTime_ <= first.time_ || positionSamples_.Size() == 1)
+                position = first.position_;
+            else if (playbackTime_ < last.time_)
+            {
+                const TransformSample& next = positionSamples_[1];
+                position = first.position_.Lerp(next.position_, (float)((playbackTime_ - first.time_) / (next.time_ - first.time_)));
+            }
+            else
+            {
+                // Past the latest sample: continue at the latest velocity for a limited time
+                const TransformSample& previous = positionSamples_[positionSamples_.Size() - 2];
+                float interval = (float)(last.time_ - previous.time_);
+                float extrapolation = Min((float)(playbackTime_ - last.time_), maxExtrapolation_);
+                position = last.position_;
+                if (interval > M_EPSILON)
+                    position += (last.position_ - previous.position_) * (extrapolation / interval);
+            }
+            
+            node_->SetPosition(position);
+            if (playbackTime_ < last.time_ + maxExtrapolation_)
+                finished = false;
+        }
+        
+        if (rotationSamples_.Size())
+        {
+            while (rotationSamples_.Size() > 2 && rotationSamples_[1].time_ <= playbackTime_)
+                rotationSamples_.Erase(0);
+            
+            const TransformSample& first = rotationSamples_.Front();
+            const TransformSample& last = rotationSamples_.Back();
+            Quaternion rotation;
+            
+            if (playbackTime_ <= first.time_ || rotationSamples_.Size() == 1)
+                rotation = first.rotation_;
+            else if (playbackTime_ < last.time_)
+            {
+                const TransformSample& next = rotationSamples_[1];
+                rotation = first.rotation_.Slerp(next.rotation_, (float)((playbackTime_ - first.time_) / (next.time_ - first.time_)));
+            }
+            else
+                rotation = last.rotation_;
+            
+            node_->SetRotation(rotation);
+            if (playbackTime_ < last.time_)
+                finished = false;
+        }
+        
+        if (!finished)
+            return;
+    }
+    
+    // If playback has reached the end of the buffered samples, unsubscribe from the update event
+    UnsubscribeFromEvent(GetScene(), E_SCENEUPDATE);
+    subscribed_ = false;
+}
+
+void InterpolatedTransform::AddPositionSample(const Vector3& position, double time)
+{
+    TransformSample sample;
+    sample.time_ = time;
+    sample.position_ = position;
+    AddSample(positionSamples_, sample);
+}
+
+void InterpolatedTransform::AddRotationSample(const Quaternion& rotation, double time)
+{
+    TransformSample sample;
+    sample.time_ = time;
+    sample.rotation_ = rotation;
+    AddSample(rotationSamples_, sample);
+}
+
+void InterpolatedTransform::SetDelay(float delay)
+{
+    delay_ = Max(delay, 0.0f);
+}
+
+void InterpolatedTransform::SetMaxExtrapolation(float time)
+{
+    maxExtrapolation_ = Max(time, 0.0f);
+}
+
+void InterpolatedTransform::ClearSamples()
+{
+    positionSamples_.Clear();
+    rotationSamples_.Clear();
+    latestTime_ = -M_INFINITY;
+    playbackStarted_ = false;
+}
+
+void InterpolatedTransform::OnNodeSet(Node* node)
+{
+    if (!node)
+        ClearSamples();
+}
+
+void InterpolatedTransform::AddSample(PODVector<TransformSample>& samples, const TransformSample& sample)
+{
+    // Samples may arrive out of order, so insert in time order. A sample with the same time replaces the earlier one
+    unsigned index = samples.Size();
+    while (index > 0 && samples[index - 1].time_ > sample.time_)
+        --index;
+    if (index > 0 && samples[index - 1].time_ == sample.time_)
+        samples[index - 1] = sample;
+    else
+    {
+        samples.Insert(index, sample);
+        if (samples.Size() > MAX_SAMPLES)
+            samples.Erase(0);
+    }
+    
+    if (sample.time_ > latestTime_)
+    {
+        latestTime_ = sample.time_;
+        timeSinceLatest_ = 0.0f;
+    }
+    
+    SubscribeToUpdate();
+}
+
+void InterpolatedTransform::SubscribeToUpdate()
+{
+    if (!subscribed_)
+    {
+        SubscribeToEvent(GetScene(), E_SCENEUPDATE, HANDLER(InterpolatedTransform, HandleSceneUpdate));
+        subscribed_ = true;
+    }
+}
+
+void InterpolatedTransform::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SceneUpdate;
+    
+    Update(eventData[P_TIMESTEP].GetFloat());
+}
+
+}
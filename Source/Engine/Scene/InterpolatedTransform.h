@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Component.h"
+
+namespace Urho3D
+{
+
+/// Timestamped network transform sample.
+struct TransformSample
+{
+    /// Server time in seconds. Kept in double precision, as the server time keeps growing over the session.
+    double time_;
+    /// Position in parent space.
+    Vector3 position_;
+    /// Rotation in parent space.
+    Quaternion rotation_;
+};
+
+/// Transform interpolation component for network updates. Buffers the timestamped transforms received from the server and plays them back with a delay, so that motion stays smooth regardless of the server update rate.
+class URHO3D_API InterpolatedTransform : public Component
+{
+    OBJECT(InterpolatedTransform);
+
+public:
+    /// Construct.
+    InterpolatedTransform(Context* context);
+    /// Destruct.
+    ~InterpolatedTransform();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Advance playback and apply the interpolated transform to the node.
+    void Update(float timeStep);
+    /// Add a position sample in parent space at a server time.
+    void AddPositionSample(const Vector3& position, double time);
+    /// Add a rotation sample in parent space at a server time.
+    void AddRotationSample(const Quaternion& rotation, double time);
+    /// Set playback delay behind the latest sample in seconds. Should cover a few server updates to hide packet loss and jitter.
+    void SetDelay(float delay);
+    /// Set maximum time in seconds to extrapolate position past the latest sample.
+    void SetMaxExtrapolation(float time);
+    /// Remove all buffered samples.
+    void ClearSamples();
+
+    /// Return playback delay.
+    float GetDelay() const { return delay_; }
+    /// Return maximum extrapolation time.
+    float GetMaxExtrapolation() const { return maxExtrapolation_; }
+    /// Return current playback server time.
+    double GetPlaybackTime() const { return playbackTime_; }
+    /// Return number of buffered position samples.
+    unsigned GetNumPositionSamples() const { return positionSamples_.Size(); }
+    /// Return number of buffered rotation samples.
+    unsigned GetNumRotationSamples() const { return rotationSamples_.Size(); }
+    /// Return whether playback is in progress.
+    bool IsInProgress() const { return subscribed_; }
+
+protected:
+    /// Handle scene node being assigned at creation.
+    virtual void OnNodeSet(Node* node);
+
+private:
+    /// Add a sample to a buffer in time order.
+    void AddSample(PODVector<TransformSample>& samples, const TransformSample& sample);
+    /// Subscribe to scene update if not yet subscribed.
+    void SubscribeToUpdate();
+    /// Handle scene update event.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+
+    /// Buffered position samples.
+    PODVector<TransformSample> positionSamples_;
+    /// Buffered rotation samples.
+    PODVector<TransformSample> rotationSamples_;
+    /// Playback delay.
+    float delay_;
+    /// Maximum extrapolation time.
+    float maxExtrapolation_;
+    /// Current playback server time.
+    double playbackTime_;
+    /// Server time of the latest sample.
+    double latestTime_;
+    /// Local time elapsed since the latest sample was received.
+    float timeSinceLatest_;
+    /// Playback clock synchronized flag.
+    bool playbackStarted_;
+    /// Subscribed to scene update event flag.
+    bool subscribed_;
+};
+
+}
@@ -23,6 +23,7 @@
 #include "Precompiled.h"
 #include "Component.h"
 #include "Context.h"
+#include "InterpolatedTransform.h"
 #include "Log.h"
 #include "MemoryBuffer.h"
 #include "ObjectAnimation.h"
@@ -78,8 +79,12 @@ void Node::RegisterObject(Context* context)
     REF_ACCESSOR_ATTRIBUTE(Node, VAR_VECTOR3, "Scale", GetScale, SetScale, Vector3, Vector3::ONE, AM_DEFAULT);
     ATTRIBUTE(Node, VAR_VARIANTMAP, "Variables", vars_, Variant::emptyVariantMap, AM_FILE); // Network replication of vars uses custom data
     REF_ACCESSOR_ATTRIBUTE(Node, VAR_VECTOR3, "Network Position", GetNetPositionAttr, SetNetPositionAttr, Vector3, Vector3::ZERO, AM_NET | AM_LATESTDATA | AM_NOEDIT);
-    REF_ACCESSOR_ATTRIBUTE(Node, VAR_BUFFER, "Network Rotation", GetNetRotationAttr, SetNetRotationAttr, PODVector<unsigned char>, Variant::emptyBuffer, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    REF_ACCESSOR_ATTRIBUTE(Node, VAR_QUATERNION, "Network Rotation", GetNetRotationAttr, SetNetRotationAttr, Quaternion, Quaternion::IDENTITY, AM_NET | AM_LATESTDATA | AM_NOEDIT);
     REF_ACCESSOR_ATTRIBUTE(Node, VAR_BUFFER, "Network Parent Node", GetNetParentAttr, SetNetParentAttr, PODVector<unsigned char>, Variant::emptyBuffer, AM_NET | AM_NOEDIT);
+
+    // Send the network transform with 1/1024 unit position precision and 12 bits per rotation component
+    context->SetAttributeQuantization<Node>("Network Position", 10);
+    context->SetAttributeQuantization<Node>("Network Rotation", 12);
 }
 
 bool Node::Load(Deserializer& source, bool setInstanceDefault)
@@ -224,6 +229,12 @@ void Node::AddReplicationState(NodeReplicationState* state)
     networkState_->replicationStates_.Push(state);
 }
 
+void Node::RemoveReplicationState(NodeReplicationState* state)
+{
+    if (networkState_)
+        networkState_->replicationStates_.Remove(state);
+}
+
 bool Node::SaveXML(Serializer& dest) const
 {
     SharedPtr<XMLFile> xml(new XMLFile(context_));
@@ -1052,6 +1063,13 @@ void Node::ResetScene()
 
 void Node::SetNetPositionAttr(const Vector3& value)
 {
+    InterpolatedTransform* interpolated = GetComponent<InterpolatedTransform>();
+    if (interpolated)
+    {
+        interpolated->AddPositionSample(value, scene_ ? scene_->GetNetworkTime() : 0.0);
+        return;
+    }
+
     SmoothedTransform* transform = GetComponent<SmoothedTransform>();
     if (transform)
         transform->SetTargetPosition(value);
@@ -1059,14 +1077,20 @@ void Node::SetNetPositionAttr(const Vector3& value)
         SetPosition(value);
 }
 
-void Node::SetNetRotationAttr(const PODVector<unsigned char>& value)
+void Node::SetNetRotationAttr(const Quaternion& value)
 {
-    MemoryBuffer buf(value);
+    InterpolatedTransform* interpolated = GetComponent<InterpolatedTransform>();
+    if (interpolated)
+    {
+        interpolated->AddRotationSample(value, scene_ ? scene_->GetNetworkTime() : 0.0);
+        return;
+    }
+
     SmoothedTransform* transform = GetComponent<SmoothedTransform>();
     if (transform)
-        transform->SetTargetRotation(buf.ReadPackedQuaternion());
+        transform->SetTargetRotation(value);
     else
-        SetRotation(buf.ReadPackedQuaternion());
+        SetRotation(value);
 }
 
 void Node::SetNetParentAttr(const PODVector<unsigned char>& value)
@@ -1111,11 +1135,9 @@ const Vector3& Node::GetNetPositionAttr() const
     return position_;
 }
 
-const PODVector<unsigned char>& Node::GetNetRotationAttr() const
+const Quaternion& Node::GetNetRotationAttr() const
 {
-    attrBuffer_.Clear();
-    attrBuffer_.WritePackedQuaternion(rotation_);
-    return attrBuffer_.GetBuffer();
+    return rotation_;
 }
 
 const PODVector<unsigned char>& Node::GetNetParentAttr() const
@@ -1155,10 +1177,30 @@ bool Node::Load(Deserializer& source, SceneResolver& resolver, bool readChildren
     if (!Animatable::Load(source))
         return false;
 
+    // If the source is already in memory, component data can be read in place instead of copying to a separate buffer
+    MemoryBuffer* memorySource = dynamic_cast<MemoryBuffer*>(&source);
+    PODVector<unsigned char> compData;
+
     unsigned numComponents = source.ReadVLE();
     for (unsigned i = 0; i < numComponents; ++i)
     {
-        VectorBuffer compBuffer(source, source.ReadVLE());
+        unsigned compSize = source.ReadVLE();
+        const unsigned char* compPtr;
+        if (memorySource)
+        {
+            compSize = Min((int)compSize, (int)(source.GetSize() - source.GetPosition()));
+            compPtr = memorySource->GetData() + source.GetPosition();
+            source.Seek(source.GetPosition() + compSize);
+        }
+        else
+        {
+            compData.Resize(compSize);
+            if (compSize)
+                compSize = source.Read(&compData[0], compSize);
+            compPtr = compData.Empty() ? 0 : &compData[0];
+        }
+
+        MemoryBuffer compBuffer(compPtr, compSize);
         StringHash compType = compBuffer.ReadStringHash();
         unsigned compID = compBuffer.ReadUInt();
 
@@ -1269,13 +1311,23 @@ void Node::PrepareNetworkUpdate()
     {
         networkState_->currentValues_.Resize(numAttributes);
         networkState_->previousValues_.Resize(numAttributes);
+        networkState_->changeSnapshots_.Resize(numAttributes);
 
         // Copy the default attribute values to the previous state as a starting point
         for (unsigned i = 0; i < numAttributes; ++i)
+        {
             networkState_->previousValues_[i] = attributes->At(i).defaultValue_;
+            networkState_->changeSnapshots_[i] = 0;
+        }
+
+        // The attribute layout changed, so the shared encodings are not valid anymore
+        networkState_->deltaUpdateData_.Clear();
+        networkState_->latestData_.Clear();
     }
 
     // Check for attribute changes
+    DirtyBits changedAttributes;
+    unsigned snapshotID = scene_ ? scene_->GetSnapshotID() : 0;
     for (unsigned i = 0; i < numAttributes; ++i)
     {
         const AttributeInfo& attr = attributes->At(i);
@@ -1283,11 +1335,10 @@ void Node::PrepareNetworkUpdate()
         if (animationEnabled_ && IsAnimatedNetworkAttribute(attr))
             continue;
 
-        OnGetAttribute(attr, networkState_->currentValues_[i]);
-
-        if (networkState_->currentValues_[i] != networkState_->previousValues_[i])
+        if (UpdateNetworkAttribute(i))
         {
-            networkState_->previousValues_[i] = networkState_->currentValues_[i];
+            changedAttributes.Set(i);
+            networkState_->changeSnapshots_[i] = snapshotID;
 
             // Mark the attribute dirty in all replication states that are tracking this node
             for (PODVector<ReplicationState*>::Iterator j = networkState_->replicationStates_.Begin(); j !=
@@ -1307,6 +1358,8 @@ void Node::PrepareNetworkUpdate()
         }
     }
 
+    EncodeSharedNetworkUpdate(changedAttributes);
+
     // Finally check for user var changes
     for (VariantMap::ConstIterator i = vars_.Begin(); i != vars_.End(); ++i)
     {
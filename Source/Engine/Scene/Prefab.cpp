@@ -0,0 +1,410 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Precompiled.h"
+#include "Component.h"
+#include "Context.h"
+#include "FileSystem.h"
+#include "Log.h"
+#include "MemoryBuffer.h"
+#include "Prefab.h"
+#include "Profiler.h"
+#include "Scene.h"
+#include "SceneResolver.h"
+#include "VectorBuffer.h"
+#include "XMLFile.h"
+
+#include "DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Read file attribute values from binary data. Return true if successful.
+static bool ParseAttributes(const Vector<AttributeInfo>* attributes, Deserializer& source, PODVector<unsigned>& indices,
+    Vector<Variant>& values)
+{
+    if (!attributes)
+        return false;
+
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        const AttributeInfo& attr = attributes->At(i);
+        if (!(attr.mode_ & AM_FILE))
+            continue;
+
+        if (source.IsEof())
+            return false;
+
+        indices.Push(i);
+        values.Push(source.ReadVariant(attr.type_));
+    }
+
+    return true;
+}
+
+/// Read file attribute values from XML data. Return true if all attributes were recognized.
+static bool ParseAttributesXML(const Vector<AttributeInfo>* attributes, const XMLElement& source, PODVector<unsigned>& indices,
+    Vector<Variant>& values)
+{
+    bool allKnown = true;
+    XMLElement attrElem = source.GetChild("attribute");
+    unsigned startIndex = 0;
+
+    while (attrElem)
+    {
+        if (!attributes)
+            return false;
+
+        String name = attrElem.GetAttribute("name");
+        unsigned i = startIndex;
+        unsigned attempts = attributes->Size();
+
+        while (attempts)
+        {
+            const AttributeInfo& attr = attributes->At(i);
+            if ((attr.mode_ & AM_FILE) && !attr.name_.Compare(name, true))
+            {
+                Variant value;
+
+                // If enums specified, do enum lookup. Unknown enum values are left for the regular XML load to report
+                if (attr.enumNames_)
+                {
+                    String enumName = attrElem.GetAttribute("value");
+                    const char** enumPtr = attr.enumNames_;
+                    int enumValue = 0;
+                    while (*enumPtr && enumName.Compare(*enumPtr, false))
+                    {
+                        ++enumPtr;
+                        ++enumValue;
+                    }
+                    if (*enumPtr)
+                        value = enumValue;
+                    else
+                        allKnown = false;
+                }
+                else
+                    value = attrElem.GetVariantValue(attr.type_);
+
+                if (!value.IsEmpty())
+                {
+                    indices.Push(i);
+                    values.Push(value);
+                }
+
+                startIndex = (i + 1) % attributes->Size();
+                break;
+            }
+            else
+            {
+                i = (i + 1) % attributes->Size();
+                --attempts;
+            }
+        }
+
+        if (!attempts)
+        {
+            LOGWARNING("Unknown attribute " + name + " in XML data");
+            allKnown = false;
+        }
+
+        attrElem = attrElem.GetNext("attribute");
+    }
+
+    return allKnown;
+}
+
+/// Set pre-parsed attribute values to an object.
+static void SetAttributes(Serializable* dest, const PODVector<unsigned>& indices, const Vector<Variant>& values)
+{
+    const Vector<AttributeInfo>* attributes = dest->GetAttributes();
+    if (!attributes)
+        return;
+
+    for (unsigned i = 0; i < indices.Size(); ++i)
+    {
+        if (indices[i] < attributes->Size())
+            dest->OnSetAttribute(attributes->At(indices[i]), values[i]);
+    }
+}
+
+/// Compute the instance override keys of the registered attributes. The keys are the attribute names prefixed with the object's path.
+static void GetOverrideKeys(const Vector<AttributeInfo>* attributes, const String& path, PODVector<StringHash>& keys)
+{
+    if (!attributes)
+        return;
+
+    keys.Resize(attributes->Size());
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+        keys[i] = StringHash(path + attributes->At(i).name_);
+}
+
+/// Set instance override values to an object.
+static void SetOverrides(Serializable* dest, const String& path, const PODVector<StringHash>& keys, const VariantMap& overrides)
+{
+    const Vector<AttributeInfo>* attributes = dest->GetAttributes();
+    if (!attributes)
+        return;
+
+    // Objects with their own attributes, for example script objects, do not match the precomputed keys of the registered
+    // attributes, so hash their keys here
+    bool registered = attributes == dest->GetContext()->GetAttributes(dest->GetType()) && keys.Size() == attributes->Size();
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        VariantMap::ConstIterator j = overrides.Find(registered ? keys[i] : StringHash(path + attributes->At(i).name_));
+        if (j != overrides.End())
+            dest->SetAttribute(i, j->second_);
+    }
+}
+
+/// Return the path of the next component of a type within a node, and count the component.
+static String GetComponentPath(const String& nodePath, const String& typeName, HashMap<String, unsigned>& typeCounts)
+{
+    unsigned& count = typeCounts[typeName];
+    String path = nodePath + "@" + typeName;
+    if (count)
+        path += "#" + String(count);
+    ++count;
+    return path + "/";
+}
+
+Prefab::Prefab(Context* context) :
+    Resource(context)
+{
+}
+
+Prefab::~Prefab()
+{
+}
+
+void Prefab::RegisterObject(Context* context)
+{
+    context->RegisterFactory<Prefab>();
+}
+
+bool Prefab::BeginLoad(Deserializer& source)
+{
+    nodes_.Clear();
+    xmlFile_.Reset();
+
+    bool success;
+    if (GetExtension(source.GetName()) == ".xml")
+    {
+        xmlFile_ = new XMLFile(context_);
+        if (!xmlFile_->Load(source))
+            return false;
+        success = ReadNodeXML(xmlFile_->GetRoot(), M_MAX_UNSIGNED, String::EMPTY);
+    }
+    else
+        success = ReadNode(source, M_MAX_UNSIGNED, String::EMPTY);
+
+    if (!success)
+    {
+        LOGERROR("Could not load prefab " + source.GetName());
+        nodes_.Clear();
+        xmlFile_.Reset();
+        return false;
+    }
+
+    SetMemoryUse(source.GetSize());
+    return true;
+}
+
+Node* Prefab::Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, CreateMode mode) const
+{
+    return Instantiate(parent, position, rotation, Variant::emptyVariantMap, mode);
+}
+
+Node* Prefab::Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, const VariantMap& overrides,
+    CreateMode mode) const
+{
+    if (!parent)
+    {
+        LOGERROR("Null parent node for prefab instantiation");
+        return 0;
+    }
+    if (nodes_.Empty())
+    {
+        LOGERROR("Prefab " + GetName() + " has no nodes to instantiate");
+        return 0;
+    }
+
+    PROFILE(InstantiatePrefab);
+
+    SceneResolver resolver;
+    PODVector<Node*> newNodes(nodes_.Size());
+
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        const PrefabNode& nodeData = nodes_[i];
+
+        // Rewrite IDs when instantiating
+        Node* newNode;
+        if (nodeData.parentIndex_ < i)
+        {
+            newNode = newNodes[nodeData.parentIndex_]->CreateChild(0, (mode == REPLICATED && nodeData.id_ < FIRST_LOCAL_ID) ?
+                REPLICATED : LOCAL);
+        }
+        else
+            newNode = parent->CreateChild(0, mode);
+
+        newNodes[i] = newNode;
+        resolver.AddNode(nodeData.id_, newNode);
+        SetAttributes(newNode, nodeData.attributeIndices_, nodeData.attributeValues_);
+        if (!overrides.Empty())
+            SetOverrides(newNode, nodeData.path_, nodeData.overrideKeys_, overrides);
+
+        for (unsigned j = 0; j < nodeData.components_.Size(); ++j)
+        {
+            const PrefabComponent& compData = nodeData.components_[j];
+            Component* newComponent = newNode->SafeCreateComponent(compData.typeName_, compData.type_,
+                (mode == REPLICATED && compData.id_ < FIRST_LOCAL_ID) ? REPLICATED : LOCAL, 0);
+            if (!newComponent)
+                continue;
+
+            resolver.AddComponent(compData.id_, newComponent);
+            if (compData.parsed_)
+                SetAttributes(newComponent, compData.attributeIndices_, compData.attributeValues_);
+            else if (compData.xmlElement_)
+                newComponent->LoadXML(compData.xmlElement_);
+            else
+            {
+                MemoryBuffer compBuffer(compData.binaryData_);
+                newComponent->Load(compBuffer);
+            }
+            if (!overrides.Empty())
+                SetOverrides(newComponent, compData.path_, compData.overrideKeys_, overrides);
+        }
+    }
+
+    Node* rootNode = newNodes[0];
+    resolver.Resolve();
+    rootNode->ApplyAttributes();
+    rootNode->SetTransform(position, rotation);
+    return rootNode;
+}
+
+bool Prefab::ReadNode(Deserializer& source, unsigned parentIndex, const String& path)
+{
+    // Node data may move when child nodes are added, so refer to it by index
+    unsigned index = nodes_.Size();
+    nodes_.Resize(index + 1);
+    nodes_[index].id_ = source.ReadUInt();
+    nodes_[index].parentIndex_ = parentIndex;
+    nodes_[index].path_ = path;
+    GetOverrideKeys(context_->GetAttributes(Node::GetTypeStatic()), path, nodes_[index].overrideKeys_);
+
+    if (!ParseAttributes(context_->GetAttributes(Node::GetTypeStatic()), source, nodes_[index].attributeIndices_,
+        nodes_[index].attributeValues_))
+        return false;
+
+    HashMap<String, unsigned> typeCounts;
+    unsigned numComponents = source.ReadVLE();
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        PrefabComponent compData;
+        VectorBuffer compBuffer(source, source.ReadVLE());
+        compData.type_ = compBuffer.ReadStringHash();
+        compData.id_ = compBuffer.ReadUInt();
+        compData.path_ = GetComponentPath(path, context_->GetTypeName(compData.type_), typeCounts);
+        GetOverrideKeys(context_->GetAttributes(compData.type_), compData.path_, compData.overrideKeys_);
+        unsigned dataStart = compBuffer.GetPosition();
+
+        // Components whose data does not match the registered attributes exactly, for example script objects with their own
+        // attributes, are kept as binary data for the component's own load function
+        compData.parsed_ = ParseAttributes(context_->GetAttributes(compData.type_), compBuffer, compData.attributeIndices_,
+            compData.attributeValues_) && compBuffer.IsEof();
+        if (!compData.parsed_)
+        {
+            compData.attributeIndices_.Clear();
+            compData.attributeValues_.Clear();
+            compData.binaryData_.Resize(compBuffer.GetSize() - dataStart);
+            if (compData.binaryData_.Size())
+                memcpy(&compData.binaryData_[0], compBuffer.GetData() + dataStart, compData.binaryData_.Size());
+        }
+
+        nodes_[index].components_.Push(compData);
+    }
+
+    unsigned numChildren = source.ReadVLE();
+    for (unsigned i = 0; i < numChildren; ++i)
+    {
+        if (!ReadNode(source, index, path + "#" + String(i) + "/"))
+            return false;
+    }
+
+    return true;
+}
+
+bool Prefab::ReadNodeXML(const XMLElement& source, unsigned parentIndex, const String& path)
+{
+    if (!source)
+        return false;
+
+    unsigned index = nodes_.Size();
+    nodes_.Resize(index + 1);
+    nodes_[index].id_ = source.GetInt("id");
+    nodes_[index].parentIndex_ = parentIndex;
+    nodes_[index].path_ = path;
+    GetOverrideKeys(context_->GetAttributes(Node::GetTypeStatic()), path, nodes_[index].overrideKeys_);
+
+    ParseAttributesXML(context_->GetAttributes(Node::GetTypeStatic()), source, nodes_[index].attributeIndices_,
+        nodes_[index].attributeValues_);
+
+    HashMap<String, unsigned> typeCounts;
+    XMLElement compElem = source.GetChild("component");
+    while (compElem)
+    {
+        PrefabComponent compData;
+        compData.typeName_ = compElem.GetAttribute("type");
+        compData.type_ = StringHash(compData.typeName_);
+        compData.id_ = compElem.GetInt("id");
+        compData.path_ = GetComponentPath(path, compData.typeName_, typeCounts);
+        GetOverrideKeys(context_->GetAttributes(compData.type_), compData.path_, compData.overrideKeys_);
+
+        // Components with attributes that are not registered for the type are kept as XML for the component's own load function
+        compData.parsed_ = context_->GetAttributes(compData.type_) && ParseAttributesXML(context_->GetAttributes(compData.type_),
+            compElem, compData.attributeIndices_, compData.attributeValues_);
+        if (!compData.parsed_)
+        {
+            compData.attributeIndices_.Clear();
+            compData.attributeValues_.Clear();
+            compData.xmlElement_ = compElem;
+        }
+
+        nodes_[index].components_.Push(compData);
+        compElem = compElem.GetNext("component");
+    }
+
+    unsigned childIndex = 0;
+    XMLElement childElem = source.GetChild("node");
+    while (childElem)
+    {
+        if (!ReadNodeXML(childElem, index, path + "#" + String(childIndex++) + "/"))
+            return false;
+        childElem = childElem.GetNext("node");
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "Node.h"
+#include "Resource.h"
+#include "XMLElement.h"
+
+namespace Urho3D
+{
+
+class XMLFile;
+
+/// Pre-parsed component of a prefab.
+struct PrefabComponent
+{
+    /// Construct.
+    PrefabComponent() :
+        id_(0),
+        parsed_(false)
+    {
+    }
+
+    /// Component type.
+    StringHash type_;
+    /// Component type name. Empty if loaded from binary data.
+    String typeName_;
+    /// Original component ID.
+    unsigned id_;
+    /// Path of the component in the prefab for instance overrides.
+    String path_;
+    /// Instance override keys of the registered attributes.
+    PODVector<StringHash> overrideKeys_;
+    /// Indices of the file attributes.
+    PODVector<unsigned> attributeIndices_;
+    /// Values of the file attributes.
+    Vector<Variant> attributeValues_;
+    /// Whether the attributes could be pre-parsed. If not, the component is loaded from the binary data or XML element.
+    bool parsed_;
+    /// Component binary data after the type and ID, if not pre-parsed.
+    PODVector<unsigned char> binaryData_;
+    /// Component XML element, if not pre-parsed.
+    XMLElement xmlElement_;
+};
+
+/// Pre-parsed node of a prefab.
+struct PrefabNode
+{
+    /// Construct.
+    PrefabNode() :
+        id_(0),
+        parentIndex_(M_MAX_UNSIGNED)
+    {
+    }
+
+    /// Original node ID.
+    unsigned id_;
+    /// Index of the parent node in the prefab, or M_MAX_UNSIGNED for the root node.
+    unsigned parentIndex_;
+    /// Path of the node in the prefab for instance overrides. Empty for the root node.
+    String path_;
+    /// Instance override keys of the node attributes.
+    PODVector<StringHash> overrideKeys_;
+    /// Indices of the node attributes.
+    PODVector<unsigned> attributeIndices_;
+    /// Values of the node attributes.
+    Vector<Variant> attributeValues_;
+    /// Components.
+    Vector<PrefabComponent> components_;
+};
+
+/// %Node hierarchy template loaded once from a binary or XML object file, for fast repeated instantiation.
+class URHO3D_API Prefab : public Resource
+{
+    OBJECT(Prefab);
+
+public:
+    /// Construct.
+    Prefab(Context* context);
+    /// Destruct.
+    virtual ~Prefab();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Load resource from stream. May be called from a worker thread. Return true if successful.
+    virtual bool BeginLoad(Deserializer& source);
+
+    /// Instantiate the node hierarchy as a child of the parent node. Return the root node if successful.
+    Node* Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, CreateMode mode = REPLICATED) const;
+    /// Instantiate the node hierarchy with attribute values overridden for this instance. The override keys are attribute names prefixed with the path of the node and component, for example "Name", "@StaticModel/Material", "#0/@Light/Color" or "#1/#0/@RigidBody#1/Mass", where #n is the n:th child node and @Type#n the n:th component of a type. Return the root node if successful.
+    Node* Instantiate(Node* parent, const Vector3& position, const Quaternion& rotation, const VariantMap& overrides, CreateMode mode = REPLICATED) const;
+
+    /// Return number of nodes in the hierarchy.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+
+private:
+    /// Read a node and its child nodes from binary data.
+    bool ReadNode(Deserializer& source, unsigned parentIndex, const String& path);
+    /// Read a node and its child nodes from XML data.
+    bool ReadNodeXML(const XMLElement& source, unsigned parentIndex, const String& path);
+
+    /// Nodes in depth-first order.
+    Vector<PrefabNode> nodes_;
+    /// XML file for components that could not be pre-parsed.
+    SharedPtr<XMLFile> xmlFile_;
+};
+
+}
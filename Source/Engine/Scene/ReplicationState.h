@@ -27,6 +27,7 @@
 #include "HashSet.h"
 #include "Ptr.h"
 #include "StringHash.h"
+#include "VectorBuffer.h"
 
 #include <cstring>
 
@@ -92,6 +93,11 @@ struct URHO3D_API DirtyBits
         }
     }
     
+    /// Test for equality with another set of bits.
+    bool operator == (const DirtyBits& rhs) const { return count_ == rhs.count_ && !memcmp(data_, rhs.data_, MAX_NETWORK_ATTRIBUTES / 8); }
+    /// Test for inequality with another set of bits.
+    bool operator != (const DirtyBits& rhs) const { return !(*this == rhs); }
+    
     /// Clear all bits.
     void ClearAll()
     {
@@ -130,10 +136,18 @@ struct URHO3D_API NetworkState
     Vector<Variant> currentValues_;
     /// Previous network attribute values.
     Vector<Variant> previousValues_;
+    /// Scene snapshot ID of the last change of each network attribute.
+    PODVector<unsigned> changeSnapshots_;
     /// Replication states that are tracking this object.
     PODVector<ReplicationState*> replicationStates_;
     /// Previous user variables.
     VariantMap previousVars_;
+    /// Attribute bits of the shared delta update.
+    DirtyBits deltaUpdateBits_;
+    /// Delta update of the attributes changed in the last network update, shared by all replication states. Empty if not encoded.
+    VectorBuffer deltaUpdateData_;
+    /// Latest data update, shared by all replication states. Empty if not encoded.
+    VectorBuffer latestData_;
 };
 
 /// Base class for per-user network replication states.
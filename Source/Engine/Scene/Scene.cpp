@@ -25,13 +25,18 @@
 #include "Context.h"
 #include "CoreEvents.h"
 #include "File.h"
+#include "FileSystem.h"
+#include "InterpolatedTransform.h"
 #include "Log.h"
+#include "MemoryBuffer.h"
 #include "ObjectAnimation.h"
 #include "PackageFile.h"
+#include "Prefab.h"
 #include "Profiler.h"
 #include "ReplicationState.h"
 #include "ResourceCache.h"
 #include "ResourceEvents.h"
+#include "ResourceManifest.h"
 #include "Scene.h"
 #include "SceneEvents.h"
 #include "SmoothedTransform.h"
@@ -52,22 +57,150 @@ const char* SUBSYSTEM_CATEGORY = "Subsystem";
 
 static const float DEFAULT_SMOOTHING_CONSTANT = 50.0f;
 static const float DEFAULT_SNAP_THRESHOLD = 5.0f;
+/// Frames to keep recording the load manifest after loading has finished.
+static const unsigned LOAD_MANIFEST_FRAMES = 60;
+
+/// Return the load manifest file name of a scene file.
+static String GetLoadManifestName(const String& sceneFileName)
+{
+    return ReplaceExtension(sceneFileName, ".manifest.xml");
+}
+
+/// Read the rest of a stream into a memory buffer.
+static void ReadRemainingData(Deserializer& source, PODVector<unsigned char>& dest)
+{
+    dest.Resize(source.GetSize() - source.GetPosition());
+    if (dest.Size())
+        dest.Resize(source.Read(&dest[0], dest.Size()));
+}
+
+/// Background work item for searching resources to preload from binary scene or object prefab file data.
+struct AsyncPreloadItem : public WorkItem
+{
+    /// Construct.
+    AsyncPreloadItem(Context* context, SharedArrayPtr<unsigned char> data, unsigned size, bool isSceneFile) :
+        context_(context),
+        data_(data),
+        size_(size),
+        isSceneFile_(isSceneFile),
+        cancelled_(false)
+    {
+    }
+
+    /// Context for attribute lookups.
+    Context* context_;
+    /// File data. Held by the work item so that it stays valid even if the scene stops loading.
+    SharedArrayPtr<unsigned char> data_;
+    /// File data size.
+    unsigned size_;
+    /// Scene file flag. False for object prefabs.
+    bool isSceneFile_;
+    /// Cancel flag, set when the scene stops loading.
+    volatile bool cancelled_;
+    /// Resources found and not yet queued for loading.
+    Vector<ResourceRef> resources_;
+    /// Mutex for the found resources.
+    Mutex resourceMutex_;
+};
+
+/// Search resources referenced by a node, its components and child nodes.
+static void ScanPreloadResources(AsyncPreloadItem* item, Deserializer& source, bool isSceneFile)
+{
+    Context* context = item->context_;
+
+    // Read node ID (not needed)
+    /*unsigned nodeID = */source.ReadUInt();
+
+    // Read Node or Scene attributes; these do not include any resources
+    const Vector<AttributeInfo>* attributes = context->GetAttributes(isSceneFile ? Scene::GetTypeStatic() : Node::GetTypeStatic());
+    assert(attributes);
+
+    for (unsigned i = 0; i < attributes->Size(); ++i)
+    {
+        const AttributeInfo& attr = attributes->At(i);
+        if (!(attr.mode_ & AM_FILE))
+            continue;
+        Variant varValue = source.ReadVariant(attr.type_);
+    }
+
+    // Read component attributes. Collect the resources per node before handing them over to the main thread
+    Vector<ResourceRef> resources;
+    unsigned numComponents = source.ReadVLE();
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        unsigned compSize = source.ReadVLE();
+        unsigned compEnd = source.GetPosition() + compSize;
+        StringHash compType = source.ReadStringHash();
+        // Read component ID (not needed)
+        /*unsigned compID = */source.ReadUInt();
+
+        attributes = context->GetAttributes(compType);
+        if (attributes)
+        {
+            for (unsigned j = 0; j < attributes->Size() && source.GetPosition() < compEnd; ++j)
+            {
+                const AttributeInfo& attr = attributes->At(j);
+                if (!(attr.mode_ & AM_FILE))
+                    continue;
+                Variant varValue = source.ReadVariant(attr.type_);
+                if (attr.type_ == VAR_RESOURCEREF)
+                    resources.Push(varValue.GetResourceRef());
+                else if (attr.type_ == VAR_RESOURCEREFLIST)
+                {
+                    const ResourceRefList& refList = varValue.GetResourceRefList();
+                    for (unsigned k = 0; k < refList.names_.Size(); ++k)
+                        resources.Push(ResourceRef(refList.type_, refList.names_[k]));
+                }
+            }
+        }
+
+        source.Seek(compEnd);
+    }
+
+    if (!resources.Empty())
+    {
+        MutexLock lock(item->resourceMutex_);
+        item->resources_.Push(resources);
+    }
+
+    // Read child nodes
+    unsigned numChildren = source.ReadVLE();
+    for (unsigned i = 0; i < numChildren && !item->cancelled_ && !source.IsEof(); ++i)
+        ScanPreloadResources(item, source, false);
+}
+
+/// Work function for searching resources to preload.
+static void ScanPreloadResourcesWork(const WorkItem* item, unsigned threadIndex)
+{
+    AsyncPreloadItem* preloadItem = static_cast<AsyncPreloadItem*>(const_cast<WorkItem*>(item));
+    MemoryBuffer source(preloadItem->data_.Get(), preloadItem->size_);
+    ScanPreloadResources(preloadItem, source, preloadItem->isSceneFile_);
+}
 
 Scene::Scene(Context* context) :
     Node(context),
+    replicatedNodes_(FIRST_REPLICATED_ID),
+    localNodes_(FIRST_LOCAL_ID),
+    replicatedComponents_(FIRST_REPLICATED_ID),
+    localComponents_(FIRST_LOCAL_ID),
     replicatedNodeID_(FIRST_REPLICATED_ID),
     replicatedComponentID_(FIRST_REPLICATED_ID),
     localNodeID_(FIRST_LOCAL_ID),
     localComponentID_(FIRST_LOCAL_ID),
     checksum_(0),
+    snapshotID_(0),
     asyncLoadingMs_(5),
+    loadManifestFrames_(M_MAX_UNSIGNED),
     timeScale_(1.0f),
     elapsedTime_(0),
     smoothingConstant_(DEFAULT_SMOOTHING_CONSTANT),
     snapThreshold_(DEFAULT_SNAP_THRESHOLD),
+    interpolationDelay_(0.0f),
+    networkTime_(0.0),
     updateEnabled_(true),
     asyncLoading_(false),
-    threadedUpdate_(false)
+    threadedUpdate_(false),
+    loadManifestRecording_(false)
 {
     // Assign an ID to self so that nodes can refer to this node as a parent
     SetID(GetFreeNodeID(REPLICATED));
@@ -79,16 +212,21 @@ Scene::Scene(Context* context) :
 
 Scene::~Scene()
 {
+    if (loadManifest_)
+        StopManifestRecording(false);
+    
     // Remove root-level components first, so that scene subsystems such as the octree destroy themselves. This will speed up
     // the removal of child nodes' components
     RemoveAllComponents();
     RemoveAllChildren();
 
     // Remove scene reference and owner from all nodes that still exist
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        i->second_->ResetScene();
-    for (HashMap<unsigned, Node*>::Iterator i = localNodes_.Begin(); i != localNodes_.End(); ++i)
-        i->second_->ResetScene();
+    const PODVector<Node*>& replicatedNodes = replicatedNodes_.GetValues();
+    for (PODVector<Node*>::ConstIterator i = replicatedNodes.Begin(); i != replicatedNodes.End(); ++i)
+        (*i)->ResetScene();
+    const PODVector<Node*>& localNodes = localNodes_.GetValues();
+    for (PODVector<Node*>::ConstIterator i = localNodes.Begin(); i != localNodes.End(); ++i)
+        (*i)->ResetScene();
 }
 
 void Scene::RegisterObject(Context* context)
@@ -99,6 +237,7 @@ void Scene::RegisterObject(Context* context)
     ACCESSOR_ATTRIBUTE(Scene, VAR_FLOAT, "Time Scale", GetTimeScale, SetTimeScale, float, 1.0f, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(Scene, VAR_FLOAT, "Smoothing Constant", GetSmoothingConstant, SetSmoothingConstant, float, DEFAULT_SMOOTHING_CONSTANT, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(Scene, VAR_FLOAT, "Snap Threshold", GetSnapThreshold, SetSnapThreshold, float, DEFAULT_SNAP_THRESHOLD, AM_DEFAULT);
+    ACCESSOR_ATTRIBUTE(Scene, VAR_FLOAT, "Interpolation Delay", GetInterpolationDelay, SetInterpolationDelay, float, 0.0f, AM_DEFAULT);
     ACCESSOR_ATTRIBUTE(Scene, VAR_FLOAT, "Elapsed Time", GetElapsedTime, SetElapsedTime, float, 0.0f, AM_FILE);
     ATTRIBUTE(Scene, VAR_INT, "Next Replicated Node ID", replicatedNodeID_, FIRST_REPLICATED_ID, AM_FILE | AM_NOEDIT);
     ATTRIBUTE(Scene, VAR_INT, "Next Replicated Component ID", replicatedComponentID_, FIRST_REPLICATED_ID, AM_FILE | AM_NOEDIT);
@@ -124,15 +263,30 @@ bool Scene::Load(Deserializer& source, bool setInstanceDefault)
     LOGINFO("Loading scene from " + source.GetName());
 
     Clear();
+    
+    if (loadManifestRecording_)
+        StartManifestRecording();
+
+    // If not loading from memory, read the rest of the file into memory first so that node and component data can be parsed
+    // in place
+    MemoryBuffer* memorySource = dynamic_cast<MemoryBuffer*>(&source);
+    PODVector<unsigned char> sceneData;
+    if (!memorySource)
+        ReadRemainingData(source, sceneData);
+    MemoryBuffer sceneBuffer(sceneData);
 
     // Load the whole scene, then perform post-load if successfully loaded
-    if (Node::Load(source, setInstanceDefault))
+    if (Node::Load(memorySource ? *memorySource : sceneBuffer, setInstanceDefault))
     {
         FinishLoading(&source);
         return true;
     }
     else
+    {
+        if (loadManifest_)
+            StopManifestRecording(false);
         return false;
+    }
 }
 
 bool Scene::Save(Serializer& dest) const
@@ -190,8 +344,7 @@ void Scene::AddReplicationState(NodeReplicationState* state)
     Node::AddReplicationState(state);
 
     // This is the first update for a new connection. Mark all replicated nodes dirty
-    for (HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        state->sceneState_->dirtyNodes_.Insert(i->first_);
+    MarkAllReplicationDirty(*state->sceneState_);
 }
 
 bool Scene::LoadXML(Deserializer& source)
@@ -207,6 +360,9 @@ bool Scene::LoadXML(Deserializer& source)
     LOGINFO("Loading scene from " + source.GetName());
 
     Clear();
+    
+    if (loadManifestRecording_)
+        StartManifestRecording();
 
     if (Node::LoadXML(xml->GetRoot()))
     {
@@ -214,7 +370,11 @@ bool Scene::LoadXML(Deserializer& source)
         return true;
     }
     else
+    {
+        if (loadManifest_)
+            StopManifestRecording(false);
         return false;
+    }
 }
 
 bool Scene::SaveXML(Serializer& dest) const
@@ -275,38 +435,48 @@ bool Scene::LoadAsync(File* file, LoadMode mode)
     asyncProgress_.loadedNodes_ = asyncProgress_.totalNodes_ = asyncProgress_.loadedResources_ = asyncProgress_.totalResources_ = 0;
     asyncProgress_.resources_.Clear();
     
+    // Prefetch the resources recorded on an earlier load before starting to record again, so that resources no longer used
+    // are left out of the new manifest
+    if (mode != LOAD_SCENE)
+        PrefetchManifestResources(file->GetName());
+    if (loadManifestRecording_ && mode > LOAD_RESOURCES_ONLY)
+        StartManifestRecording();
+    
+    // Read the rest of the file into memory. The resources to preload are searched from it in a background work item, while
+    // the scene content is loaded from it in place on the main thread
+    asyncProgress_.fileDataSize_ = file->GetSize() - file->GetPosition();
+    asyncProgress_.fileDataPosition_ = 0;
+    asyncProgress_.fileData_ = new unsigned char[asyncProgress_.fileDataSize_];
+    if (asyncProgress_.fileDataSize_)
+        asyncProgress_.fileDataSize_ = file->Read(asyncProgress_.fileData_.Get(), asyncProgress_.fileDataSize_);
+    
     if (mode > LOAD_RESOURCES_ONLY)
     {
-        // Preload resources if appropriate, then return to the original position for loading the scene content
+        // Preload resources if appropriate
         if (mode != LOAD_SCENE)
-        {
-            PROFILE(FindResourcesToPreload);
-            
-            unsigned currentPos = file->GetPosition();
-            PreloadResources(file, isSceneFile);
-            file->Seek(currentPos);
-        }
+            PreloadResources(isSceneFile);
+        
+        MemoryBuffer source(asyncProgress_.fileData_.Get(), asyncProgress_.fileDataSize_);
         
         // Store own old ID for resolving possible root node references
-        unsigned nodeID = file->ReadUInt();
+        unsigned nodeID = source.ReadUInt();
         resolver_.AddNode(nodeID, this);
 
         // Load root level components first
-        if (!Node::Load(*file, resolver_, false))
+        if (!Node::Load(source, resolver_, false))
         {
             StopAsyncLoading();
             return false;
         }
         
         // Then prepare to load child nodes in the async updates
-        asyncProgress_.totalNodes_ = file->ReadVLE();
+        asyncProgress_.totalNodes_ = source.ReadVLE();
+        asyncProgress_.fileDataPosition_ = source.GetPosition();
     }
     else
     {
-        PROFILE(FindResourcesToPreload);
-        
         LOGINFO("Preloading resources from " + file->GetName());
-        PreloadResources(file, isSceneFile);
+        PreloadResources(isSceneFile);
     }
 
     return true;
@@ -339,6 +509,11 @@ bool Scene::LoadAsyncXML(File* file, LoadMode mode)
     asyncProgress_.loadedNodes_ = asyncProgress_.totalNodes_ = asyncProgress_.loadedResources_ = asyncProgress_.totalResources_ = 0;
     asyncProgress_.resources_.Clear();
     
+    if (mode != LOAD_SCENE)
+        PrefetchManifestResources(file->GetName());
+    if (loadManifestRecording_ && mode > LOAD_RESOURCES_ONLY)
+        StartManifestRecording();
+    
     if (mode > LOAD_RESOURCES_ONLY)
     {
         XMLElement rootElement = xml->GetRoot();
@@ -357,7 +532,10 @@ bool Scene::LoadAsyncXML(File* file, LoadMode mode)
 
         // Load the root level components first
         if (!Node::LoadXML(rootElement, resolver_, false))
+        {
+            StopAsyncLoading();
             return false;
+        }
 
         // Then prepare for loading all root level child nodes in the async update
         XMLElement childNodeElement = rootElement.GetChild("node");
@@ -383,8 +561,22 @@ bool Scene::LoadAsyncXML(File* file, LoadMode mode)
 
 void Scene::StopAsyncLoading()
 {
+    // The work queue keeps the preload work item alive until it finishes; just tell it to stop early
+    if (asyncProgress_.preloadItem_)
+    {
+        asyncProgress_.preloadItem_->cancelled_ = true;
+        asyncProgress_.preloadItem_.Reset();
+    }
+    
+    // A load manifest recorded from an unfinished load would be incomplete
+    if (loadManifest_ && loadManifestFrames_ == M_MAX_UNSIGNED)
+        StopManifestRecording(false);
+
     asyncLoading_ = false;
     asyncProgress_.file_.Reset();
+    asyncProgress_.fileData_.Reset();
+    asyncProgress_.fileDataSize_ = 0;
+    asyncProgress_.fileDataPosition_ = 0;
     asyncProgress_.xmlFile_.Reset();
     asyncProgress_.xmlElement_ = XMLElement::EMPTY;
     asyncProgress_.resources_.Clear();
@@ -395,6 +587,8 @@ Node* Scene::Instantiate(Deserializer& source, const Vector3& position, const Qu
 {
     PROFILE(Instantiate);
 
+    // Node::Load() parses component data in place when the source is a MemoryBuffer, and otherwise reads each component
+    // into a buffer of its own. The stream is not read further than the instantiated node
     SceneResolver resolver;
     unsigned nodeID = source.ReadInt();
     // Rewrite IDs when instantiating
@@ -498,11 +692,29 @@ void Scene::SetSnapThreshold(float threshold)
     Node::MarkNetworkUpdate();
 }
 
+void Scene::SetInterpolationDelay(float delay)
+{
+    interpolationDelay_ = Max(delay, 0.0f);
+    Node::MarkNetworkUpdate();
+}
+
+void Scene::SetNetworkTime(double time)
+{
+    networkTime_ = time;
+}
+
 void Scene::SetAsyncLoadingMs(int ms)
 {
     asyncLoadingMs_ = Max(ms, 1);
 }
 
+void Scene::SetLoadManifestRecording(bool enable)
+{
+    loadManifestRecording_ = enable;
+    if (!enable && loadManifest_)
+        StopManifestRecording(false);
+}
+
 void Scene::SetElapsedTime(float time)
 {
     elapsedTime_ = time;
@@ -540,41 +752,17 @@ void Scene::UnregisterAllVars()
 Node* Scene::GetNode(unsigned id) const
 {
     if (id < FIRST_LOCAL_ID)
-    {
-        HashMap<unsigned, Node*>::ConstIterator i = replicatedNodes_.Find(id);
-        if (i != replicatedNodes_.End())
-            return i->second_;
-        else
-            return 0;
-    }
+        return replicatedNodes_.Find(id);
     else
-    {
-        HashMap<unsigned, Node*>::ConstIterator i = localNodes_.Find(id);
-        if (i != localNodes_.End())
-            return i->second_;
-        else
-            return 0;
-    }
+        return localNodes_.Find(id);
 }
 
 Component* Scene::GetComponent(unsigned id) const
 {
     if (id < FIRST_LOCAL_ID)
-    {
-        HashMap<unsigned, Component*>::ConstIterator i = replicatedComponents_.Find(id);
-        if (i != replicatedComponents_.End())
-            return i->second_;
-        else
-            return 0;
-    }
+        return replicatedComponents_.Find(id);
     else
-    {
-        HashMap<unsigned, Component*>::ConstIterator i = localComponents_.Find(id);
-        if (i != localComponents_.End())
-            return i->second_;
-        else
-            return 0;
-    }
+        return localComponents_.Find(id);
 }
 
 float Scene::GetAsyncProgress() const
@@ -767,28 +955,24 @@ void Scene::NodeAdded(Node* node)
     // If node with same ID exists, remove the scene reference from it and overwrite with the new node
     if (id < FIRST_LOCAL_ID)
     {
-        HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Find(id);
-        if (i != replicatedNodes_.End() && i->second_ != node)
+        Node* oldNode = replicatedNodes_.Insert(id, node);
+        if (oldNode && oldNode != node)
         {
             LOGWARNING("Overwriting node with ID " + String(id));
-            i->second_->ResetScene();
+            oldNode->ResetScene();
         }
 
-        replicatedNodes_[id] = node;
-
         MarkNetworkUpdate(node);
         MarkReplicationDirty(node);
     }
     else
     {
-        HashMap<unsigned, Node*>::Iterator i = localNodes_.Find(id);
-        if (i != localNodes_.End() && i->second_ != node)
+        Node* oldNode = localNodes_.Insert(id, node);
+        if (oldNode && oldNode != node)
         {
             LOGWARNING("Overwriting node with ID " + String(id));
-            i->second_->ResetScene();
+            oldNode->ResetScene();
         }
-
-        localNodes_[id] = node;
     }
 }
 
@@ -818,25 +1002,21 @@ void Scene::ComponentAdded(Component* component)
     unsigned id = component->GetID();
     if (id < FIRST_LOCAL_ID)
     {
-        HashMap<unsigned, Component*>::Iterator i = replicatedComponents_.Find(id);
-        if (i != replicatedComponents_.End() && i->second_ != component)
+        Component* oldComponent = replicatedComponents_.Insert(id, component);
+        if (oldComponent && oldComponent != component)
         {
             LOGWARNING("Overwriting component with ID " + String(id));
-            i->second_->SetID(0);
+            oldComponent->SetID(0);
         }
-
-        replicatedComponents_[id] = component;
     }
     else
     {
-        HashMap<unsigned, Component*>::Iterator i = localComponents_.Find(id);
-        if (i != localComponents_.End() && i->second_ != component)
+        Component* oldComponent = localComponents_.Insert(id, component);
+        if (oldComponent && oldComponent != component)
         {
             LOGWARNING("Overwriting component with ID " + String(id));
-            i->second_->SetID(0);
+            oldComponent->SetID(0);
         }
-
-        localComponents_[id] = component;
     }
 }
 
@@ -880,6 +1060,9 @@ String Scene::GetVarNamesAttr() const
 
 void Scene::PrepareNetworkUpdate()
 {
+    // Attribute changes found during this update are stamped with the new snapshot ID
+    ++snapshotID_;
+
     for (HashSet<unsigned>::Iterator i = networkUpdateNodes_.Begin(); i != networkUpdateNodes_.End(); ++i)
     {
         Node* node = GetNode(*i);
@@ -902,11 +1085,13 @@ void Scene::CleanupConnection(Connection* connection)
 {
     Node::CleanupConnection(connection);
 
-    for (HashMap<unsigned, Node*>::Iterator i = replicatedNodes_.Begin(); i != replicatedNodes_.End(); ++i)
-        i->second_->CleanupConnection(connection);
+    const PODVector<Node*>& replicatedNodes = replicatedNodes_.GetValues();
+    for (PODVector<Node*>::ConstIterator i = replicatedNodes.Begin(); i != replicatedNodes.End(); ++i)
+        (*i)->CleanupConnection(connection);
 
-    for (HashMap<unsigned, Component*>::Iterator i = replicatedComponents_.Begin(); i != replicatedComponents_.End(); ++i)
-        i->second_->CleanupConnection(connection);
+    const PODVector<Component*>& replicatedComponents = replicatedComponents_.GetValues();
+    for (PODVector<Component*>::ConstIterator i = replicatedComponents.Begin(); i != replicatedComponents.End(); ++i)
+        (*i)->CleanupConnection(connection);
 }
 
 void Scene::MarkNetworkUpdate(Node* node)
@@ -952,12 +1137,23 @@ void Scene::MarkReplicationDirty(Node* node)
     }
 }
 
+void Scene::MarkAllReplicationDirty(SceneReplicationState& state) const
+{
+    const PODVector<unsigned>& replicatedNodeIDs = replicatedNodes_.GetIDs();
+    for (PODVector<unsigned>::ConstIterator i = replicatedNodeIDs.Begin(); i != replicatedNodeIDs.End(); ++i)
+        state.dirtyNodes_.Insert(*i);
+}
+
 void Scene::HandleUpdate(StringHash eventType, VariantMap& eventData)
 {
     using namespace Update;
 
     if (updateEnabled_)
         Update(eventData[P_TIMESTEP].GetFloat());
+    
+    // Keep recording the load manifest for a while after loading, as some resources are only requested when updating or rendering
+    if (loadManifest_ && loadManifestFrames_ != M_MAX_UNSIGNED && ++loadManifestFrames_ >= LOAD_MANIFEST_FRAMES)
+        StopManifestRecording(true);
 }
 
 void Scene::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
@@ -979,7 +1175,9 @@ void Scene::UpdateAsyncLoading()
 {
     PROFILE(UpdateAsyncLoading);
 
-    // If resources left to load, do not load nodes yet
+    // If still searching for resources to preload, or resources left to load, do not load nodes yet
+    if (asyncProgress_.preloadItem_ && !QueuePreloadResources())
+        return;
     if (asyncProgress_.loadedResources_ < asyncProgress_.totalResources_)
         return;
     
@@ -997,10 +1195,13 @@ void Scene::UpdateAsyncLoading()
         /// \todo Works poorly in scenes where one root-level child node contains all content
         if (!asyncProgress_.xmlFile_)
         {
-            unsigned nodeID = asyncProgress_.file_->ReadUInt();
+            MemoryBuffer source(asyncProgress_.fileData_.Get(), asyncProgress_.fileDataSize_);
+            source.Seek(asyncProgress_.fileDataPosition_);
+            unsigned nodeID = source.ReadUInt();
             Node* newNode = CreateChild(nodeID, nodeID < FIRST_LOCAL_ID ? REPLICATED : LOCAL);
             resolver_.AddNode(nodeID, newNode);
-            newNode->Load(*asyncProgress_.file_, resolver_);
+            newNode->Load(source, resolver_);
+            asyncProgress_.fileDataPosition_ = source.GetPosition();
         }
         else
         {
@@ -1055,6 +1256,9 @@ void Scene::FinishLoading(Deserializer* source)
         fileName_ = source->GetName();
         checksum_ = source->GetChecksum();
     }
+    
+    if (loadManifest_)
+        loadManifestFrames_ = 0;
 }
 
 void Scene::FinishSaving(Serializer* dest) const
@@ -1067,77 +1271,56 @@ void Scene::FinishSaving(Serializer* dest) const
     }
 }
 
-void Scene::PreloadResources(File* file, bool isSceneFile)
+void Scene::PreloadResources(bool isSceneFile)
 {
-    ResourceCache* cache = GetSubsystem<ResourceCache>();
-    
-    // Read node ID (not needed)
-    /*unsigned nodeID = */file->ReadUInt();
+    asyncProgress_.preloadItem_ = new AsyncPreloadItem(context_, asyncProgress_.fileData_, asyncProgress_.fileDataSize_, isSceneFile);
+    asyncProgress_.preloadItem_->workFunction_ = ScanPreloadResourcesWork;
 
-    // Read Node or Scene attributes; these do not include any resources
-    const Vector<AttributeInfo>* attributes = context_->GetAttributes(isSceneFile ? Scene::GetTypeStatic() : Node::GetTypeStatic());
-    assert(attributes);
-    
-    for (unsigned i = 0; i < attributes->Size(); ++i)
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (queue)
+        queue->AddWorkItem(SharedPtr<WorkItem>(asyncProgress_.preloadItem_));
+    else
     {
-        const AttributeInfo& attr = attributes->At(i);
-        if (!(attr.mode_ & AM_FILE))
-            continue;
-        Variant varValue = file->ReadVariant(attr.type_);
+        PROFILE(FindResourcesToPreload);
+
+        ScanPreloadResourcesWork(asyncProgress_.preloadItem_, 0);
+        asyncProgress_.preloadItem_->completed_ = true;
     }
-    
-    // Read component attributes
-    unsigned numComponents = file->ReadVLE();
-    for (unsigned i = 0; i < numComponents; ++i)
+}
+
+bool Scene::QueuePreloadResources()
+{
+    AsyncPreloadItem* item = asyncProgress_.preloadItem_;
+    // Check the completion first, so that no resources found after the check can be missed
+    bool completed = item->completed_;
+
+    Vector<ResourceRef> resources;
     {
-        VectorBuffer compBuffer(*file, file->ReadVLE());
-        StringHash compType = compBuffer.ReadStringHash();
-        // Read component ID (not needed)
-        /*unsigned compID = */compBuffer.ReadUInt();
-        
-        attributes = context_->GetAttributes(compType);
-        if (attributes)
-        {
-            for (unsigned j = 0; j < attributes->Size(); ++j)
-            {
-                const AttributeInfo& attr = attributes->At(j);
-                if (!(attr.mode_ & AM_FILE))
-                    continue;
-                Variant varValue = compBuffer.ReadVariant(attr.type_);
-                if (attr.type_ == VAR_RESOURCEREF)
-                {
-                    const ResourceRef& ref = varValue.GetResourceRef();
-                    // Sanitate resource name beforehand so that when we get the background load event, the name matches exactly
-                    String name = cache->SanitateResourceName(ref.name_);
-                    bool success = cache->BackgroundLoadResource(ref.type_, name);
-                    if (success)
-                    {
-                        ++asyncProgress_.totalResources_;
-                        asyncProgress_.resources_.Insert(StringHash(name));
-                    }
-                }
-                else if (attr.type_ == VAR_RESOURCEREFLIST)
-                {
-                    const ResourceRefList& refList = varValue.GetResourceRefList();
-                    for (unsigned k = 0; k < refList.names_.Size(); ++k)
-                    {
-                        String name = cache->SanitateResourceName(refList.names_[k]);
-                        bool success = cache->BackgroundLoadResource(refList.type_, name);
-                        if (success)
-                        {
-                            ++asyncProgress_.totalResources_;
-                            asyncProgress_.resources_.Insert(StringHash(name));
-                        }
-                    }
-                }
-             }
-        }
+        MutexLock lock(item->resourceMutex_);
+        resources = item->resources_;
+        item->resources_.Clear();
+    }
+
+    for (unsigned i = 0; i < resources.Size(); ++i)
+        PreloadResource(resources[i].type_, resources[i].name_);
+
+    if (completed)
+        asyncProgress_.preloadItem_.Reset();
+    return completed;
+}
+
+void Scene::PreloadResource(StringHash type, const String& name, int priority)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // Sanitate resource name beforehand so that when we get the background load event, the name matches exactly
+    String sanitatedName = cache->SanitateResourceName(name);
+    bool success = cache->BackgroundLoadResource(type, sanitatedName, true, 0, priority);
+    if (success)
+    {
+        ++asyncProgress_.totalResources_;
+        asyncProgress_.resources_.Insert(StringHash(sanitatedName));
     }
-    
-    // Read child nodes
-    unsigned numChildren = file->ReadVLE();
-    for (unsigned i = 0; i < numChildren; ++i)
-        PreloadResources(file, false);
 }
 
 void Scene::PreloadResourcesXML(const XMLElement& element)
@@ -1217,13 +1400,87 @@ void Scene::PreloadResourcesXML(const XMLElement& element)
     }
 }
 
+void Scene::PrefetchManifestResources(const String& fileName)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SharedPtr<ResourceManifest> manifest = cache->GetTempResource<ResourceManifest>(GetLoadManifestName(fileName), false);
+    if (!manifest)
+        return;
+    
+    PROFILE(PrefetchManifestResources);
+    
+    // Queue all resources at once with priorities from the recorded dependencies, so that the background loader threads do not
+    // need to wait for resources to be loaded before their dependencies are known
+    PODVector<unsigned> order;
+    PODVector<int> priorities;
+    manifest->GetPrefetchOrder(order, priorities);
+    
+    const Vector<ManifestResource>& resources = manifest->GetResources();
+    for (unsigned i = 0; i < order.Size(); ++i)
+    {
+        const ManifestResource& resource = resources[order[i]];
+        PreloadResource(resource.type_, resource.name_, priorities[order[i]]);
+    }
+    
+    LOGINFO("Prefetching " + String(resources.Size()) + " resources from " + manifest->GetName());
+}
+
+void Scene::StartManifestRecording()
+{
+    loadManifest_ = new ResourceManifest(context_);
+    loadManifestFrames_ = M_MAX_UNSIGNED;
+    GetSubsystem<ResourceCache>()->SetRecordingManifest(loadManifest_);
+}
+
+void Scene::StopManifestRecording(bool save)
+{
+    // The resource cache may already be gone when the scene is destroyed at exit
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!cache)
+    {
+        loadManifest_.Reset();
+        return;
+    }
+    
+    if (cache->GetRecordingManifest() == loadManifest_)
+        cache->SetRecordingManifest(0);
+    
+    if (save)
+    {
+        // Save alongside the scene file if it is in a resource directory or was loaded with an absolute path. Scenes loaded from
+        // package files can not have the manifest saved
+        String sceneFileName = cache->GetResourceFileName(fileName_);
+        if (sceneFileName.Empty() && IsAbsolutePath(fileName_))
+            sceneFileName = fileName_;
+        
+        if (!sceneFileName.Empty())
+        {
+            loadManifest_->RemoveMissingResources();
+            
+            String manifestFileName = GetLoadManifestName(sceneFileName);
+            File file(context_, manifestFileName, FILE_WRITE);
+            if (file.IsOpen() && loadManifest_->Save(file))
+                LOGINFO("Saved load manifest of " + String(loadManifest_->GetNumResources()) + " resources to " + manifestFileName);
+            else
+                LOGERROR("Could not save load manifest to " + manifestFileName);
+        }
+        else
+            LOGWARNING("Could not save load manifest, scene file " + fileName_ + " is not in a resource directory");
+    }
+    
+    loadManifest_.Reset();
+    loadManifestFrames_ = M_MAX_UNSIGNED;
+}
+
 void RegisterSceneLibrary(Context* context)
 {
     ValueAnimation::RegisterObject(context);
     ObjectAnimation::RegisterObject(context);
     Node::RegisterObject(context);
     Scene::RegisterObject(context);
+    Prefab::RegisterObject(context);
     SmoothedTransform::RegisterObject(context);
+    InterpolatedTransform::RegisterObject(context);
     UnknownComponent::RegisterObject(context);
     SplinePath::RegisterObject(context);
 }
@@ -22,9 +22,11 @@
 
 #pragma once
 
+#include "ArrayPtr.h"
 #include "HashSet.h"
 #include "Mutex.h"
 #include "Node.h"
+#include "SceneIDMap.h"
 #include "SceneResolver.h"
 #include "XMLElement.h"
 
@@ -33,6 +35,10 @@ namespace Urho3D
 
 class File;
 class PackageFile;
+class ResourceManifest;
+
+struct AsyncPreloadItem;
+struct SceneReplicationState;
 
 static const unsigned FIRST_REPLICATED_ID = 0x1;
 static const unsigned LAST_REPLICATED_ID = 0xffffff;
@@ -55,6 +61,14 @@ struct AsyncProgress
 {
     /// File for binary mode.
     SharedPtr<File> file_;
+    /// File data for binary mode, read into memory at load start.
+    SharedArrayPtr<unsigned char> fileData_;
+    /// File data size.
+    unsigned fileDataSize_;
+    /// Current read position in the file data.
+    unsigned fileDataPosition_;
+    /// Background work item searching the binary file data for resources to preload.
+    SharedPtr<AsyncPreloadItem> preloadItem_;
     /// XML file for XML mode.
     SharedPtr<XMLFile> xmlFile_;
     /// Current XML element for XML mode.
@@ -128,8 +142,14 @@ public:
     void SetSmoothingConstant(float constant);
     /// Set network client motion smoothing snap threshold.
     void SetSnapThreshold(float threshold);
+    /// Set network client interpolation delay in seconds. When non-zero, replicated nodes play back timestamped transforms this far behind the server instead of smoothing toward the latest.
+    void SetInterpolationDelay(float delay);
+    /// Set server time in seconds of the network update being sent or applied. Called by Network and Connection.
+    void SetNetworkTime(double time);
     /// Set maximum milliseconds per frame to spend on async scene loading.
     void SetAsyncLoadingMs(int ms);
+    /// Set whether to record the resources used while loading a scene file and during the first frames after, and save them to a load manifest alongside the scene file. Asynchronous loading prefetches the resources listed in the manifest.
+    void SetLoadManifestRecording(bool enable);
     /// Add a required package file for networking. To be called on the server.
     void AddRequiredPackageFile(PackageFile* package);
     /// Clear required package files.
@@ -157,6 +177,8 @@ public:
     const String& GetFileName() const { return fileName_; }
     /// Return source file checksum.
     unsigned GetChecksum() const { return checksum_; }
+    /// Return ID of the latest network update snapshot.
+    unsigned GetSnapshotID() const { return snapshotID_; }
     /// Return update time scale.
     float GetTimeScale() const { return timeScale_; }
     /// Return elapsed time in seconds.
@@ -165,8 +187,14 @@ public:
     float GetSmoothingConstant() const { return smoothingConstant_; }
     /// Return motion smoothing snap threshold.
     float GetSnapThreshold() const { return snapThreshold_; }
+    /// Return network client interpolation delay.
+    float GetInterpolationDelay() const { return interpolationDelay_; }
+    /// Return server time of the network update being sent or applied.
+    double GetNetworkTime() const { return networkTime_; }
     /// Return maximum milliseconds per frame to spend on async loading.
     int GetAsyncLoadingMs() const { return asyncLoadingMs_; }
+    /// Return whether load manifests are recorded.
+    bool GetLoadManifestRecording() const { return loadManifestRecording_; }
     /// Return required package files.
     const Vector<SharedPtr<PackageFile> >& GetRequiredPackageFiles() const { return requiredPackageFiles_; }
     /// Return a node user variable name, or empty if not registered.
@@ -208,6 +236,8 @@ public:
     void MarkNetworkUpdate(Component* component);
     /// Mark a node dirty in scene replication states. The node does not need to have own replication state yet.
     void MarkReplicationDirty(Node* node);
+    /// Mark all replicated nodes dirty in a scene replication state. Does not modify the scene, so can be called while preparing network updates in worker threads.
+    void MarkAllReplicationDirty(SceneReplicationState& state) const;
 
 private:
     /// Handle the logic update event to update the scene, if active.
@@ -222,23 +252,35 @@ private:
     void FinishLoading(Deserializer* source);
     /// Finish saving. Sets the scene filename and checksum.
     void FinishSaving(Serializer* dest) const;
-    /// Preload resources from a binary scene or object prefab file.
-    void PreloadResources(File* file, bool isSceneFile);
+    /// Start searching resources to preload from binary scene or object prefab file data in a background work item.
+    void PreloadResources(bool isSceneFile);
+    /// Queue resources found so far by the background search for loading. Return true when the search has finished.
+    bool QueuePreloadResources();
+    /// Queue a resource for background loading and track its completion.
+    void PreloadResource(StringHash type, const String& name, int priority = 0);
     /// Preload resources from an XML scene or object prefab file.
     void PreloadResourcesXML(const XMLElement& element);
+    /// Queue the resources listed in the load manifest of a scene file for background loading, if the manifest exists.
+    void PrefetchManifestResources(const String& fileName);
+    /// Start recording a load manifest.
+    void StartManifestRecording();
+    /// Stop recording the load manifest and optionally save it alongside the scene file.
+    void StopManifestRecording(bool save);
 
     /// Replicated scene nodes by ID.
-    HashMap<unsigned, Node*> replicatedNodes_;
+    SceneIDMap<Node> replicatedNodes_;
     /// Local scene nodes by ID.
-    HashMap<unsigned, Node*> localNodes_;
+    SceneIDMap<Node> localNodes_;
     /// Replicated components by ID.
-    HashMap<unsigned, Component*> replicatedComponents_;
+    SceneIDMap<Component> replicatedComponents_;
     /// Local components by ID.
-    HashMap<unsigned, Component*> localComponents_;
+    SceneIDMap<Component> localComponents_;
     /// Asynchronous loading progress.
     AsyncProgress asyncProgress_;
     /// Node and component ID resolver for asynchronous loading.
     SceneResolver resolver_;
+    /// Load manifest being recorded.
+    SharedPtr<ResourceManifest> loadManifest_;
     /// Source file name.
     mutable String fileName_;
     /// Required package files for networking.
@@ -265,8 +307,12 @@ private:
     unsigned localComponentID_;
     /// Scene source file checksum.
     mutable unsigned checksum_;
+    /// Latest network update snapshot ID.
+    unsigned snapshotID_;
     /// Maximum milliseconds per frame to spend on async scene loading.
     int asyncLoadingMs_;
+    /// Frames recorded to the load manifest after loading finished, or M_MAX_UNSIGNED while still loading.
+    unsigned loadManifestFrames_;
     /// Scene update time scale.
     float timeScale_;
     /// Elapsed time accumulator.
@@ -275,12 +321,18 @@ private:
     float smoothingConstant_;
     /// Motion smoothing snap threshold.
     float snapThreshold_;
+    /// Network client interpolation delay.
+    float interpolationDelay_;
+    /// Server time of the current network update.
+    double networkTime_;
     /// Update enabled flag.
     bool updateEnabled_;
     /// Asynchronous loading flag.
     bool asyncLoading_;
     /// Threaded update flag.
     bool threadedUpdate_;
+    /// Load manifest recording flag.
+    bool loadManifestRecording_;
 };
 
 /// Register Scene library objects.
@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "HashMap.h"
+#include "Vector.h"
+
+namespace Urho3D
+{
+
+/// Maximum ID offset from the start of the range that is stored in the dense lookup table. IDs above it go to a hash map.
+static const unsigned MAX_DENSE_SCENE_ID = 0x100000;
+
+/// Scene node or component lookup by ID. IDs are allocated sequentially from the start of their range, so they are looked up from a dense table without hashing; the objects themselves are kept packed for fast iteration.
+template <class T> class SceneIDMap
+{
+public:
+    /// Construct with the first ID of the range.
+    SceneIDMap(unsigned firstID) :
+        firstID_(firstID)
+    {
+    }
+
+    /// Insert or replace an object. Return the previous object with the same ID, or null if none.
+    T* Insert(unsigned id, T* object)
+    {
+        unsigned* slot = GetSlot(id, true);
+        if (*slot)
+        {
+            T* oldObject = values_[*slot - 1];
+            values_[*slot - 1] = object;
+            return oldObject;
+        }
+
+        values_.Push(object);
+        ids_.Push(id);
+        *slot = values_.Size();
+        return 0;
+    }
+
+    /// Erase an object by ID. Return true if was found.
+    bool Erase(unsigned id)
+    {
+        unsigned* slot = GetSlot(id, false);
+        if (!slot || !*slot)
+            return false;
+
+        // Move the last object into the vacated position to keep the storage packed
+        unsigned index = *slot - 1;
+        unsigned lastIndex = values_.Size() - 1;
+        if (index != lastIndex)
+        {
+            values_[index] = values_[lastIndex];
+            ids_[index] = ids_[lastIndex];
+            *GetSlot(ids_[index], false) = index + 1;
+        }
+        values_.Pop();
+        ids_.Pop();
+
+        unsigned offset = id - firstID_;
+        if (offset < MAX_DENSE_SCENE_ID)
+            *slot = 0;
+        else
+            sparseSlots_.Erase(id);
+        return true;
+    }
+
+    /// Remove all objects.
+    void Clear()
+    {
+        slots_.Clear();
+        sparseSlots_.Clear();
+        values_.Clear();
+        ids_.Clear();
+    }
+
+    /// Reserve storage for the given number of objects.
+    void Reserve(unsigned size)
+    {
+        values_.Reserve(size);
+        ids_.Reserve(size);
+    }
+
+    /// Return object by ID, or null if not found.
+    T* Find(unsigned id) const
+    {
+        unsigned offset = id - firstID_;
+        if (offset < MAX_DENSE_SCENE_ID)
+        {
+            unsigned slot = offset < slots_.Size() ? slots_[offset] : 0;
+            return slot ? values_[slot - 1] : 0;
+        }
+        else
+        {
+            HashMap<unsigned, unsigned>::ConstIterator i = sparseSlots_.Find(id);
+            return i != sparseSlots_.End() ? values_[i->second_ - 1] : 0;
+        }
+    }
+
+    /// Return whether an object with the ID exists.
+    bool Contains(unsigned id) const { return Find(id) != 0; }
+    /// Return number of objects.
+    unsigned Size() const { return values_.Size(); }
+    /// Return whether is empty.
+    bool Empty() const { return values_.Empty(); }
+    /// Return all objects in no particular order.
+    const PODVector<T*>& GetValues() const { return values_; }
+    /// Return IDs of all objects, in the same order as the objects.
+    const PODVector<unsigned>& GetIDs() const { return ids_; }
+
+private:
+    /// Return pointer to the storage index slot of an ID, optionally creating it. Slot value is index + 1, or 0 if empty.
+    unsigned* GetSlot(unsigned id, bool create)
+    {
+        unsigned offset = id - firstID_;
+        if (offset < MAX_DENSE_SCENE_ID)
+        {
+            if (offset >= slots_.Size())
+            {
+                if (!create)
+                    return 0;
+                unsigned oldSize = slots_.Size();
+                slots_.Resize(offset + 1);
+                for (unsigned i = oldSize; i < slots_.Size(); ++i)
+                    slots_[i] = 0;
+            }
+            return &slots_[offset];
+        }
+        else
+        {
+            HashMap<unsigned, unsigned>::Iterator i = sparseSlots_.Find(id);
+            if (i != sparseSlots_.End())
+                return &i->second_;
+            return create ? &sparseSlots_[id] : 0;
+        }
+    }
+
+    /// First ID of the range.
+    unsigned firstID_;
+    /// Storage index slots for IDs in the dense range.
+    PODVector<unsigned> slots_;
+    /// Storage index slots for IDs outside the dense range.
+    HashMap<unsigned, unsigned> sparseSlots_;
+    /// Packed objects.
+    PODVector<T*> values_;
+    /// Packed IDs.
+    PODVector<unsigned> ids_;
+};
+
+}
@@ -21,9 +21,12 @@
 //
 
 #include "Precompiled.h"
+#include "BitDeserializer.h"
+#include "BitSerializer.h"
 #include "Context.h"
 #include "Deserializer.h"
 #include "Log.h"
+#include "MemoryBuffer.h"
 #include "ReplicationState.h"
 #include "SceneEvents.h"
 #include "Serializable.h"
@@ -35,6 +38,282 @@
 namespace Urho3D
 {
 
+/// Return the size of an attribute that can be read and written directly in memory in its binary serialized form, or 0 if
+/// it needs conversion through the attribute accessor or a Variant.
+static unsigned GetPlainAttributeSize(const AttributeInfo& attr)
+{
+    if (attr.accessor_ || attr.ptr_ || attr.enumNames_)
+        return 0;
+
+    switch (attr.type_)
+    {
+    case VAR_INT:
+        return sizeof(int);
+
+    case VAR_BOOL:
+        return sizeof(bool);
+
+    case VAR_FLOAT:
+        return sizeof(float);
+
+    case VAR_VECTOR2:
+        return sizeof(Vector2);
+
+    case VAR_VECTOR3:
+        return sizeof(Vector3);
+
+    case VAR_VECTOR4:
+        return sizeof(Vector4);
+
+    case VAR_QUATERNION:
+        return sizeof(Quaternion);
+
+    case VAR_COLOR:
+        return sizeof(Color);
+
+    case VAR_INTRECT:
+        return sizeof(IntRect);
+
+    case VAR_INTVECTOR2:
+        return sizeof(IntVector2);
+
+    default:
+        return 0;
+    }
+}
+
+/// Compare a plain attribute in memory to a Variant value without converting.
+static bool PlainAttributeEquals(const AttributeInfo& attr, const void* src, const Variant& value)
+{
+    if (value.GetType() != attr.type_)
+        return false;
+
+    switch (attr.type_)
+    {
+    case VAR_INT:
+        return *(reinterpret_cast<const int*>(src)) == value.GetInt();
+
+    case VAR_BOOL:
+        return *(reinterpret_cast<const bool*>(src)) == value.GetBool();
+
+    case VAR_FLOAT:
+        return *(reinterpret_cast<const float*>(src)) == value.GetFloat();
+
+    case VAR_VECTOR2:
+        return *(reinterpret_cast<const Vector2*>(src)) == value.GetVector2();
+
+    case VAR_VECTOR3:
+        return *(reinterpret_cast<const Vector3*>(src)) == value.GetVector3();
+
+    case VAR_VECTOR4:
+        return *(reinterpret_cast<const Vector4*>(src)) == value.GetVector4();
+
+    case VAR_QUATERNION:
+        return *(reinterpret_cast<const Quaternion*>(src)) == value.GetQuaternion();
+
+    case VAR_COLOR:
+        return *(reinterpret_cast<const Color*>(src)) == value.GetColor();
+
+    case VAR_INTRECT:
+        return *(reinterpret_cast<const IntRect*>(src)) == value.GetIntRect();
+
+    case VAR_INTVECTOR2:
+        return *(reinterpret_cast<const IntVector2*>(src)) == value.GetIntVector2();
+
+    default:
+        return false;
+    }
+}
+
+/// Return whether an attribute is quantized in network replication.
+static bool IsQuantizedAttribute(const AttributeInfo& attr)
+{
+    if (!attr.quantizeBits_)
+        return false;
+
+    switch (attr.type_)
+    {
+    case VAR_FLOAT:
+    case VAR_VECTOR2:
+    case VAR_VECTOR3:
+    case VAR_VECTOR4:
+    case VAR_QUATERNION:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/// Return whether an attribute is included in a network update. If no attribute bits are given, include the latest data attributes.
+static bool IsNetworkUpdateAttribute(const AttributeInfo& attr, unsigned index, const DirtyBits* attributeBits)
+{
+    return attributeBits ? attributeBits->IsSet(index) : (attr.mode_ & AM_LATESTDATA) != 0;
+}
+
+/// Write a quantized network attribute value.
+static void WriteQuantizedAttribute(BitSerializer& dest, const AttributeInfo& attr, const Variant& value)
+{
+    if (attr.type_ == VAR_QUATERNION)
+    {
+        dest.WriteQuantizedQuaternion(value.GetQuaternion(), attr.quantizeBits_);
+        return;
+    }
+
+    float data[4];
+    unsigned numComponents = 1;
+    switch (attr.type_)
+    {
+    case VAR_VECTOR2:
+        numComponents = 2;
+        memcpy(data, value.GetVector2().Data(), sizeof(Vector2));
+        break;
+
+    case VAR_VECTOR3:
+        numComponents = 3;
+        memcpy(data, value.GetVector3().Data(), sizeof(Vector3));
+        break;
+
+    case VAR_VECTOR4:
+        numComponents = 4;
+        memcpy(data, value.GetVector4().Data(), sizeof(Vector4));
+        break;
+
+    default:
+        data[0] = value.GetFloat();
+        break;
+    }
+
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        if (attr.quantizeMax_ > attr.quantizeMin_)
+            dest.WriteQuantizedFloat(data[i], attr.quantizeMin_, attr.quantizeMax_, attr.quantizeBits_);
+        else
+            dest.WriteFixedFloat(data[i], attr.quantizeBits_);
+    }
+}
+
+/// Read a quantized network attribute value.
+static Variant ReadQuantizedAttribute(BitDeserializer& source, const AttributeInfo& attr)
+{
+    if (attr.type_ == VAR_QUATERNION)
+        return source.ReadQuantizedQuaternion(attr.quantizeBits_);
+
+    unsigned numComponents = attr.type_ == VAR_VECTOR2 ? 2 : attr.type_ == VAR_VECTOR3 ? 3 : attr.type_ == VAR_VECTOR4 ? 4 : 1;
+    float data[4];
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        if (attr.quantizeMax_ > attr.quantizeMin_)
+            data[i] = source.ReadQuantizedFloat(attr.quantizeMin_, attr.quantizeMax_, attr.quantizeBits_);
+        else
+            data[i] = source.ReadFixedFloat(attr.quantizeBits_);
+    }
+
+    switch (attr.type_)
+    {
+    case VAR_VECTOR2:
+        return Vector2(data);
+
+    case VAR_VECTOR3:
+        return Vector3(data);
+
+    case VAR_VECTOR4:
+        return Vector4(data);
+
+    default:
+        return data[0];
+    }
+}
+
+/// Return an attribute value as it will be received after quantization.
+static Variant QuantizeAttribute(const AttributeInfo& attr, const Variant& value)
+{
+    // Four fixed-point floats take at most 4 * (5 + 32) bits
+    unsigned char data[20];
+    MemoryBuffer buffer(data, sizeof data);
+    {
+        BitSerializer bitDest(buffer);
+        WriteQuantizedAttribute(bitDest, attr, value);
+    }
+    buffer.Seek(0);
+    BitDeserializer bitSource(buffer);
+    return ReadQuantizedAttribute(bitSource, attr);
+}
+
+/// Write network attribute values. The change bitfield (if attribute bits given) and the quantized attributes are written
+/// first as a bit stream, padded to a whole byte, followed by the byte-aligned data of the other attributes.
+static void WriteNetworkValues(Serializer& dest, const Vector<AttributeInfo>& attributes, const Vector<Variant>& values,
+    const DirtyBits* attributeBits)
+{
+    unsigned numAttributes = attributes.Size();
+
+    BitSerializer bitDest(dest);
+    if (attributeBits)
+    {
+        for (unsigned i = 0; i < numAttributes; ++i)
+            bitDest.WriteBool(attributeBits->IsSet(i));
+    }
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        const AttributeInfo& attr = attributes[i];
+        if (IsQuantizedAttribute(attr) && IsNetworkUpdateAttribute(attr, i, attributeBits))
+            WriteQuantizedAttribute(bitDest, attr, values[i]);
+    }
+    bitDest.Flush();
+
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        const AttributeInfo& attr = attributes[i];
+        if (!IsQuantizedAttribute(attr) && IsNetworkUpdateAttribute(attr, i, attributeBits))
+            dest.WriteVariantData(values[i]);
+    }
+}
+
+/// Read and apply network attribute values written by WriteNetworkValues().
+static void ReadNetworkValues(Serializable* dest, const Vector<AttributeInfo>& attributes, Deserializer& source, bool readBits)
+{
+    unsigned numAttributes = attributes.Size();
+    DirtyBits attributeBits;
+    Vector<Variant> quantizedValues;
+
+    BitDeserializer bitSource(source);
+    if (readBits)
+    {
+        for (unsigned i = 0; i < numAttributes; ++i)
+        {
+            if (bitSource.ReadBool())
+                attributeBits.Set(i);
+        }
+    }
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        const AttributeInfo& attr = attributes[i];
+        if (IsQuantizedAttribute(attr) && IsNetworkUpdateAttribute(attr, i, readBits ? &attributeBits : 0))
+        {
+            if (quantizedValues.Empty())
+                quantizedValues.Resize(numAttributes);
+            quantizedValues[i] = ReadQuantizedAttribute(bitSource, attr);
+        }
+    }
+
+    // Apply in attribute order, as attributes may depend on each other
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        const AttributeInfo& attr = attributes[i];
+        if (!IsNetworkUpdateAttribute(attr, i, readBits ? &attributeBits : 0))
+            continue;
+
+        if (IsQuantizedAttribute(attr))
+            dest->OnSetAttribute(attr, quantizedValues[i]);
+        else
+        {
+            if (source.IsEof())
+                break;
+            dest->OnSetAttribute(attr, source.ReadVariant(attr.type_));
+        }
+    }
+}
+
 Serializable::Serializable(Context* context) :
     Object(context),
     networkState_(0),
@@ -283,6 +562,18 @@ bool Serializable::Save(Serializer& dest) const
         if (!(attr.mode_ & AM_FILE))
             continue;
 
+        // Plain attributes are stored in memory in the same form as they are serialized; write them directly
+        unsigned plainSize = GetPlainAttributeSize(attr);
+        if (plainSize)
+        {
+            if (dest.Write(reinterpret_cast<const unsigned char*>(this) + attr.offset_, plainSize) != plainSize)
+            {
+                LOGERROR("Could not save " + GetTypeName() + ", writing to stream failed");
+                return false;
+            }
+            continue;
+        }
+
         OnGetAttribute(attr, value);
 
         if (!dest.WriteVariantData(value))
@@ -554,13 +845,7 @@ void Serializable::WriteInitialDeltaUpdate(Serializer& dest)
     }
 
     // First write the change bitfield, then attribute data for non-default attributes
-    dest.Write(attributeBits.data_, (numAttributes + 7) >> 3);
-
-    for (unsigned i = 0; i < numAttributes; ++i)
-    {
-        if (attributeBits.IsSet(i))
-            dest.WriteVariantData(networkState_->currentValues_[i]);
-    }
+    WriteNetworkValues(dest, *attributes, networkState_->currentValues_, &attributeBits);
 }
 
 void Serializable::WriteDeltaUpdate(Serializer& dest, const DirtyBits& attributeBits)
@@ -575,17 +860,16 @@ void Serializable::WriteDeltaUpdate(Serializer& dest, const DirtyBits& attribute
     if (!attributes)
         return;
 
-    unsigned numAttributes = attributes->Size();
+    // Copy the shared encoding if it was made for the same attributes
+    if (networkState_->deltaUpdateData_.GetSize() && networkState_->deltaUpdateBits_ == attributeBits)
+    {
+        dest.Write(networkState_->deltaUpdateData_.GetData(), networkState_->deltaUpdateData_.GetSize());
+        return;
+    }
 
     // First write the change bitfield, then attribute data for changed attributes
     // Note: the attribute bits should not contain LATESTDATA attributes
-    dest.Write(attributeBits.data_, (numAttributes + 7) >> 3);
-
-    for (unsigned i = 0; i < numAttributes; ++i)
-    {
-        if (attributeBits.IsSet(i))
-            dest.WriteVariantData(networkState_->currentValues_[i]);
-    }
+    WriteNetworkValues(dest, *attributes, networkState_->currentValues_, &attributeBits);
 }
 
 void Serializable::WriteLatestDataUpdate(Serializer& dest)
@@ -600,13 +884,14 @@ void Serializable::WriteLatestDataUpdate(Serializer& dest)
     if (!attributes)
         return;
 
-    unsigned numAttributes = attributes->Size();
-
-    for (unsigned i = 0; i < numAttributes; ++i)
+    // Copy the shared encoding if available
+    if (networkState_->latestData_.GetSize())
     {
-        if (attributes->At(i).mode_ & AM_LATESTDATA)
-            dest.WriteVariantData(networkState_->currentValues_[i]);
+        dest.Write(networkState_->latestData_.GetData(), networkState_->latestData_.GetSize());
+        return;
     }
+
+    WriteNetworkValues(dest, *attributes, networkState_->currentValues_, 0);
 }
 
 void Serializable::ReadDeltaUpdate(Deserializer& source)
@@ -615,19 +900,7 @@ void Serializable::ReadDeltaUpdate(Deserializer& source)
     if (!attributes)
         return;
 
-    unsigned numAttributes = attributes->Size();
-    DirtyBits attributeBits;
-
-    source.Read(attributeBits.data_, (numAttributes + 7) >> 3);
-
-    for (unsigned i = 0; i < numAttributes && !source.IsEof(); ++i)
-    {
-        if (attributeBits.IsSet(i))
-        {
-            const AttributeInfo& attr = attributes->At(i);
-            OnSetAttribute(attr, source.ReadVariant(attr.type_));
-        }
-    }
+    ReadNetworkValues(this, *attributes, source, true);
 }
 
 void Serializable::ReadLatestDataUpdate(Deserializer& source)
@@ -636,14 +909,7 @@ void Serializable::ReadLatestDataUpdate(Deserializer& source)
     if (!attributes)
         return;
 
-    unsigned numAttributes = attributes->Size();
-
-    for (unsigned i = 0; i < numAttributes && !source.IsEof(); ++i)
-    {
-        const AttributeInfo& attr = attributes->At(i);
-        if (attr.mode_ & AM_LATESTDATA)
-            OnSetAttribute(attr, source.ReadVariant(attr.type_));
-    }
+    ReadNetworkValues(this, *attributes, source, false);
 }
 
 Variant Serializable::GetAttribute(unsigned index) const
@@ -745,6 +1011,99 @@ unsigned Serializable::GetNumNetworkAttributes() const
     return attributes ? attributes->Size() : 0;
 }
 
+bool Serializable::GetNetworkChanges(DirtyBits& dest, unsigned snapshotID) const
+{
+    dest.ClearAll();
+    if (!networkState_)
+        return false;
+
+    const PODVector<unsigned>& changeSnapshots = networkState_->changeSnapshots_;
+    for (unsigned i = 0; i < changeSnapshots.Size(); ++i)
+    {
+        if (changeSnapshots[i] > snapshotID)
+            dest.Set(i);
+    }
+
+    return dest.Count() != 0;
+}
+
+bool Serializable::UpdateNetworkAttribute(unsigned index)
+{
+    const AttributeInfo& attr = networkState_->attributes_->At(index);
+    Variant& currentValue = networkState_->currentValues_[index];
+    Variant& previousValue = networkState_->previousValues_[index];
+
+    // The current value is left equal to the attribute after each check. For plain attributes compare the memory against it
+    // first, so that unchanged values need no Variant conversion
+    if (GetPlainAttributeSize(attr) && PlainAttributeEquals(attr, reinterpret_cast<const unsigned char*>(this) + attr.offset_,
+        currentValue))
+        return false;
+
+    OnGetAttribute(attr, currentValue);
+
+    // For quantized attributes compare the values as they would be sent, so that changes below the precision, such as
+    // floating point noise, do not cause updates. The previous value is then stored quantized
+    if (IsQuantizedAttribute(attr))
+    {
+        Variant quantizedValue = QuantizeAttribute(attr, currentValue);
+        if (quantizedValue != previousValue)
+        {
+            previousValue = quantizedValue;
+            return true;
+        }
+        else
+            return false;
+    }
+
+    if (currentValue != previousValue)
+    {
+        previousValue = currentValue;
+        return true;
+    }
+    else
+        return false;
+}
+
+void Serializable::EncodeSharedNetworkUpdate(const DirtyBits& changedAttributes)
+{
+    // If nothing changed, the previous encodings are still valid
+    if (!changedAttributes.Count())
+        return;
+
+    const Vector<AttributeInfo>* attributes = networkState_->attributes_;
+    unsigned numAttributes = attributes->Size();
+    DirtyBits deltaBits = changedAttributes;
+    bool latestDataChanged = false;
+
+    for (unsigned i = 0; i < numAttributes; ++i)
+    {
+        if (deltaBits.IsSet(i) && (attributes->At(i).mode_ & AM_LATESTDATA))
+        {
+            latestDataChanged = true;
+            deltaBits.Clear(i);
+        }
+    }
+
+    // If no replication states are tracking the object, only invalidate the old encodings. Note that the write functions
+    // encode from the current values when the shared encodings are empty
+    bool encode = !networkState_->replicationStates_.Empty();
+
+    if (latestDataChanged)
+    {
+        networkState_->latestData_.Clear();
+        if (encode)
+            WriteLatestDataUpdate(networkState_->latestData_);
+    }
+
+    if (deltaBits.Count())
+    {
+        networkState_->deltaUpdateData_.Clear();
+        networkState_->deltaUpdateBits_ = deltaBits;
+        if (encode)
+            WriteDeltaUpdate(networkState_->deltaUpdateData_, deltaBits);
+    }
+}
+
 void Serializable::SetInstanceDefault(const String& name, const Variant& defaultValue)
 {
     // Allocate the instance level default value
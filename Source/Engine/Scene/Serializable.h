@@ -52,7 +52,7 @@ public:
 
     /// Handle attribute write access. Default implementation writes to the variable at offset, or invokes the set accessor.
     virtual void OnSetAttribute(const AttributeInfo& attr, const Variant& src);
-    /// Handle attribute read access. Default implementation reads the variable at offset, or invokes the get accessor.
+    /// Handle attribute read access. Default implementation reads the variable at offset, or invokes the get accessor. Plain offset attributes are read directly from memory for binary save and network change checks, without calling this function.
     virtual void OnGetAttribute(const AttributeInfo& attr, Variant& dest) const;
     /// Return attribute descriptions, or null if none defined.
     virtual const Vector<AttributeInfo>* GetAttributes() const;
@@ -108,10 +108,17 @@ public:
     unsigned GetNumAttributes() const;
     /// Return number of network replication attributes.
     unsigned GetNumNetworkAttributes() const;
+    /// Return the network attributes that have changed after a scene snapshot. Return true if any.
+    bool GetNetworkChanges(DirtyBits& dest, unsigned snapshotID) const;
     /// Return whether is temporary.
     bool IsTemporary() const { return temporary_; }
 
 protected:
+    /// Read a network attribute into the network state's current value. Return true and update the previous value if it changed.
+    bool UpdateNetworkAttribute(unsigned index);
+    /// Encode the delta and latest data updates of the changed network attributes once, to be shared by all replication states.
+    void EncodeSharedNetworkUpdate(const DirtyBits& changedAttributes);
+
     /// Network attribute state.
     NetworkState* networkState_;
 
@@ -743,6 +743,8 @@ template <class T> void RegisterResource(asIScriptEngine* engine, const char* cl
     engine->RegisterObjectMethod(className, "const String& get_name() const", asMETHODPR(T, GetName, () const, const String&), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "uint get_memoryUse() const", asMETHODPR(T, GetMemoryUse, () const, unsigned), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "uint get_useTimer()" ,asMETHODPR(T, GetUseTimer, (), unsigned), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "void set_pinned(bool)", asMETHODPR(T, SetPinned, (bool), void), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "bool get_pinned() const", asMETHODPR(T, IsPinned, () const, bool), asCALL_THISCALL);
 }
 
 /// Template function for registering a class derived from Drawable.
@@ -817,6 +819,8 @@ template <class T> void RegisterTexture(asIScriptEngine* engine, const char* cla
     engine->RegisterObjectMethod(className, "uint get_levels() const", asMETHOD(T, GetLevels), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "int get_width() const", asMETHOD(T, GetWidth), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "int get_height() const", asMETHOD(T, GetHeight), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "int get_fullWidth() const", asMETHOD(T, GetFullWidth), asCALL_THISCALL);
+    engine->RegisterObjectMethod(className, "int get_fullHeight() const", asMETHOD(T, GetFullHeight), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "int get_levelWidth(uint) const", asMETHOD(T, GetLevelWidth), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "int get_levelHeight(uint) const", asMETHOD(T, GetLevelHeight), asCALL_THISCALL);
     engine->RegisterObjectMethod(className, "void set_filterMode(TextureFilterMode)", asMETHOD(T, SetFilterMode), asCALL_THISCALL);
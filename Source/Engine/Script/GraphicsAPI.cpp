@@ -453,6 +453,8 @@ static void RegisterTextures(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Texture2D", "bool SetSize(int, int, uint, TextureUsage usage = TEXTURE_STATIC)", asMETHOD(Texture2D, SetSize), asCALL_THISCALL);
     engine->RegisterObjectMethod("Texture2D", "bool SetData(Image@+, bool useAlpha = false)", asFUNCTION(Texture2DSetData), asCALL_CDECL_OBJLAST);
     engine->RegisterObjectMethod("Texture2D", "RenderSurface@+ get_renderSurface() const", asMETHOD(Texture2D, GetRenderSurface), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Texture2D", "void set_streaming(bool)", asMETHOD(Texture2D, SetStreaming), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Texture2D", "bool get_streaming() const", asMETHOD(Texture2D, GetStreaming), asCALL_THISCALL);
 
     RegisterTexture<Texture3D>(engine, "Texture3D");
     engine->RegisterObjectMethod("Texture3D", "bool SetSize(int, int, uint, TextureUsage usage = TEXTURE_STATIC)", asMETHOD(Texture3D, SetSize), asCALL_THISCALL);
@@ -1413,6 +1415,10 @@ static void RegisterRenderer(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Renderer", "TextureFilterMode get_textureFilterMode() const", asMETHOD(Renderer, GetTextureFilterMode), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_textureQuality(int)", asMETHOD(Renderer, SetTextureQuality), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "int get_textureQuality() const", asMETHOD(Renderer, GetTextureQuality), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "void set_textureStreaming(bool)", asMETHOD(Renderer, SetTextureStreaming), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "bool get_textureStreaming() const", asMETHOD(Renderer, GetTextureStreaming), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "void set_textureStreamingBudget(uint)", asMETHOD(Renderer, SetTextureStreamingBudget), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Renderer", "uint get_textureStreamingBudget() const", asMETHOD(Renderer, GetTextureStreamingBudget), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_materialQuality(int)", asMETHOD(Renderer, SetMaterialQuality), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "int get_materialQuality() const", asMETHOD(Renderer, GetMaterialQuality), asCALL_THISCALL);
     engine->RegisterObjectMethod("Renderer", "void set_drawShadows(bool)", asMETHOD(Renderer, SetDrawShadows), asCALL_THISCALL);
@@ -28,6 +28,7 @@
 #include "Network.h"
 #include "NetworkPriority.h"
 #include "Protocol.h"
+#include "SimulatedLink.h"
 
 namespace Urho3D
 {
@@ -99,6 +100,15 @@ static void RegisterConnection(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Connection", "Scene@+ get_scene() const", asMETHOD(Connection, GetScene), asCALL_THISCALL);
     engine->RegisterObjectMethod("Connection", "void set_logStatistics(bool)", asMETHOD(Connection, SetLogStatistics), asCALL_THISCALL);
     engine->RegisterObjectMethod("Connection", "bool get_logStatistics() const", asMETHOD(Connection, GetLogStatistics), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "void set_trackStatistics(bool)", asMETHOD(Connection, SetTrackStatistics), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "bool get_trackStatistics() const", asMETHOD(Connection, GetTrackStatistics), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "void set_relevanceDistance(float)", asMETHOD(Connection, SetRelevanceDistance), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "float get_relevanceDistance() const", asMETHOD(Connection, GetRelevanceDistance), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "void set_snapshotReplication(bool)", asMETHOD(Connection, SetSnapshotReplication), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "bool get_snapshotReplication() const", asMETHOD(Connection, GetSnapshotReplication), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "uint get_controlsSequence() const", asMETHOD(Connection, GetControlsSequence), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "uint get_ackedControlsSequence() const", asMETHOD(Connection, GetAckedControlsSequence), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Connection", "double get_serverTime() const", asMETHOD(Connection, GetServerTime), asCALL_THISCALL);
     engine->RegisterObjectMethod("Connection", "bool get_client() const", asMETHOD(Connection, IsClient), asCALL_THISCALL);
     engine->RegisterObjectMethod("Connection", "bool get_connected() const", asMETHOD(Connection, IsConnected), asCALL_THISCALL);
     engine->RegisterObjectMethod("Connection", "bool get_connectPending() const", asMETHOD(Connection, IsConnectPending), asCALL_THISCALL);
@@ -121,6 +131,31 @@ static void RegisterConnection(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Node", "Connection@+ get_owner() const", asMETHOD(Node, GetOwner), asCALL_THISCALL);
 }
 
+static void RegisterSimulatedLink(asIScriptEngine* engine)
+{
+    RegisterRefCounted<SimulatedLink>(engine, "SimulatedLink");
+    engine->RegisterObjectMethod("SimulatedLink", "void Disconnect()", asMETHOD(SimulatedLink, Disconnect), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "void SetRandomSeed(uint)", asMETHOD(SimulatedLink, SetRandomSeed), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "uint GetNumPendingMessages(Connection@+) const", asMETHOD(SimulatedLink, GetNumPendingMessages), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "uint GetBytesSent(Connection@+) const", asMETHOD(SimulatedLink, GetBytesSent), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "uint GetMessagesSent(Connection@+) const", asMETHOD(SimulatedLink, GetMessagesSent), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "uint GetMessagesDropped(Connection@+) const", asMETHOD(SimulatedLink, GetMessagesDropped), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "void set_latency(float)", asMETHOD(SimulatedLink, SetLatency), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "float get_latency() const", asMETHOD(SimulatedLink, GetLatency), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "void set_jitter(float)", asMETHOD(SimulatedLink, SetJitter), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "float get_jitter() const", asMETHOD(SimulatedLink, GetJitter), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "void set_packetLoss(float)", asMETHOD(SimulatedLink, SetPacketLoss), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "float get_packetLoss() const", asMETHOD(SimulatedLink, GetPacketLoss), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "void set_bandwidth(uint)", asMETHOD(SimulatedLink, SetBandwidth), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "uint get_bandwidth() const", asMETHOD(SimulatedLink, GetBandwidth), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "bool get_connected() const", asMETHOD(SimulatedLink, IsConnected), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "Connection@+ get_clientConnection() const", asMETHOD(SimulatedLink, GetClientConnection), asCALL_THISCALL);
+    engine->RegisterObjectMethod("SimulatedLink", "Connection@+ get_serverConnection() const", asMETHOD(SimulatedLink, GetServerConnection), asCALL_THISCALL);
+    
+    // Register GetSimulatedLink now
+    engine->RegisterObjectMethod("Connection", "SimulatedLink@+ get_simulatedLink() const", asMETHOD(Connection, GetSimulatedLink), asCALL_THISCALL);
+}
+
 static void RegisterHttpRequest(asIScriptEngine* engine)
 {
     engine->RegisterEnum("HttpRequestState");
@@ -194,6 +229,7 @@ void RegisterNetwork(asIScriptEngine* engine)
 {
     RegisterObject<Network>(engine, "Network");
     engine->RegisterObjectMethod("Network", "bool Connect(const String&in, uint16, Scene@+, const VariantMap&in identity = VariantMap())", asMETHOD(Network, Connect), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Network", "Connection@+ ConnectLoopback(Scene@+, const VariantMap&in identity = VariantMap())", asMETHOD(Network, ConnectLoopback), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "void Disconnect(int waitMSec = 0)", asMETHOD(Network, Disconnect), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "bool StartServer(uint16)", asMETHOD(Network, StartServer), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "void StopServer()", asMETHOD(Network, StopServer), asCALL_THISCALL);
@@ -211,6 +247,8 @@ void RegisterNetwork(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Network", "int get_updateFps() const", asMETHOD(Network, GetUpdateFps), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "void set_packageCacheDir(const String&in)", asMETHOD(Network, SetPackageCacheDir), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "const String& get_packageCacheDir() const", asMETHOD(Network, GetPackageCacheDir), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Network", "void set_trackStatistics(bool)", asMETHOD(Network, SetTrackStatistics), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Network", "bool get_trackStatistics() const", asMETHOD(Network, GetTrackStatistics), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "bool get_serverRunning() const", asMETHOD(Network, IsServerRunning), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "Connection@+ get_serverConnection() const", asMETHOD(Network, GetServerConnection), asCALL_THISCALL);
     engine->RegisterObjectMethod("Network", "Array<Connection@>@ get_clientConnections() const", asFUNCTION(NetworkGetClientConnections), asCALL_CDECL_OBJLAST);
@@ -222,6 +260,7 @@ void RegisterNetworkAPI(asIScriptEngine* engine)
     RegisterControls(engine);
     RegisterNetworkPriority(engine);
     RegisterConnection(engine);
+    RegisterSimulatedLink(engine);
     RegisterHttpRequest(engine);
     RegisterNetwork(engine);
 }
@@ -24,7 +24,9 @@
 #include "APITemplates.h"
 #include "Animatable.h"
 #include "DebugRenderer.h"
+#include "InterpolatedTransform.h"
 #include "ObjectAnimation.h"
+#include "Prefab.h"
 #include "PackageFile.h"
 #include "Scene.h"
 #include "SmoothedTransform.h"
@@ -239,6 +241,21 @@ static void RegisterSmoothedTransform(asIScriptEngine* engine)
     engine->RegisterObjectMethod("SmoothedTransform", "bool get_inProgress() const", asMETHOD(SmoothedTransform, IsInProgress), asCALL_THISCALL);
 }
 
+static void RegisterInterpolatedTransform(asIScriptEngine* engine)
+{
+    RegisterComponent<InterpolatedTransform>(engine, "InterpolatedTransform");
+    engine->RegisterObjectMethod("InterpolatedTransform", "void Update(float)", asMETHOD(InterpolatedTransform, Update), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "void AddPositionSample(const Vector3&in, double)", asMETHOD(InterpolatedTransform, AddPositionSample), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "void AddRotationSample(const Quaternion&in, double)", asMETHOD(InterpolatedTransform, AddRotationSample), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "void ClearSamples()", asMETHOD(InterpolatedTransform, ClearSamples), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "void set_delay(float)", asMETHOD(InterpolatedTransform, SetDelay), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "float get_delay() const", asMETHOD(InterpolatedTransform, GetDelay), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "void set_maxExtrapolation(float)", asMETHOD(InterpolatedTransform, SetMaxExtrapolation), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "float get_maxExtrapolation() const", asMETHOD(InterpolatedTransform, GetMaxExtrapolation), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "double get_playbackTime() const", asMETHOD(InterpolatedTransform, GetPlaybackTime), asCALL_THISCALL);
+    engine->RegisterObjectMethod("InterpolatedTransform", "bool get_inProgress() const", asMETHOD(InterpolatedTransform, IsInProgress), asCALL_THISCALL);
+}
+
 static void RegisterSplinePath(asIScriptEngine* engine)
 {
     RegisterComponent<SplinePath>(engine, "SplinePath");
@@ -307,11 +324,15 @@ static void RegisterScene(asIScriptEngine* engine)
     engine->RegisterObjectMethod("Scene", "float get_smoothingConstant() const", asMETHOD(Scene, GetSmoothingConstant), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "void set_snapThreshold(float)", asMETHOD(Scene, SetSnapThreshold), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "float get_snapThreshold() const", asMETHOD(Scene, GetSnapThreshold), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Scene", "void set_interpolationDelay(float)", asMETHOD(Scene, SetInterpolationDelay), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Scene", "float get_interpolationDelay() const", asMETHOD(Scene, GetInterpolationDelay), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "bool get_asyncLoading() const", asMETHOD(Scene, IsAsyncLoading), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "float get_asyncProgress() const", asMETHOD(Scene, GetAsyncProgress), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "LoadMode get_asyncLoadMode() const", asMETHOD(Scene, GetAsyncLoadMode), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "void set_asyncLoadingMs(int)", asMETHOD(Scene, SetAsyncLoadingMs), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "int get_asyncLoadingMs() const", asMETHOD(Scene, GetAsyncLoadingMs), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Scene", "void set_loadManifestRecording(bool)", asMETHOD(Scene, SetLoadManifestRecording), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Scene", "bool get_loadManifestRecording() const", asMETHOD(Scene, GetLoadManifestRecording), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "uint get_checksum() const", asMETHOD(Scene, GetChecksum), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "const String& get_fileName() const", asMETHOD(Scene, GetFileName), asCALL_THISCALL);
     engine->RegisterObjectMethod("Scene", "Array<PackageFile@>@ get_requiredPackageFiles() const", asFUNCTION(SceneGetRequiredPackageFiles), asCALL_CDECL_OBJLAST);
@@ -322,6 +343,14 @@ static void RegisterScene(asIScriptEngine* engine)
     engine->RegisterGlobalFunction("Array<String>@ GetObjectsByCategory(const String&in)", asFUNCTION(GetObjectsByCategory), asCALL_CDECL);
 }
 
+static void RegisterPrefab(asIScriptEngine* engine)
+{
+    RegisterResource<Prefab>(engine, "Prefab");
+    engine->RegisterObjectMethod("Prefab", "Node@+ Instantiate(Node@+, const Vector3&in, const Quaternion&in, CreateMode mode = REPLICATED) const", asMETHODPR(Prefab, Instantiate, (Node*, const Vector3&, const Quaternion&, CreateMode) const, Node*), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Prefab", "Node@+ Instantiate(Node@+, const Vector3&in, const Quaternion&in, const VariantMap&in, CreateMode mode = REPLICATED) const", asMETHODPR(Prefab, Instantiate, (Node*, const Vector3&, const Quaternion&, const VariantMap&, CreateMode) const, Node*), asCALL_THISCALL);
+    engine->RegisterObjectMethod("Prefab", "uint get_numNodes() const", asMETHOD(Prefab, GetNumNodes), asCALL_THISCALL);
+}
+
 void RegisterSceneAPI(asIScriptEngine* engine)
 {
     RegisterSerializable(engine);
@@ -330,8 +359,10 @@ void RegisterSceneAPI(asIScriptEngine* engine)
     RegisterAnimatable(engine);
     RegisterNode(engine);
     RegisterSmoothedTransform(engine);
+    RegisterInterpolatedTransform(engine);
     RegisterSplinePath(engine);
     RegisterScene(engine);
+    RegisterPrefab(engine);
 }
 
 }
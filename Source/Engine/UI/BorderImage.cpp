@@ -75,6 +75,10 @@ void BorderImage::GetBatches(PODVector<UIBatch>& batches, PODVector<float>& vert
 
 void BorderImage::SetTexture(Texture* texture)
 {
+    // The UI does not request textures from the texture streaming, so keep them at full size
+    if (texture && texture->GetType() == Texture2D::GetTypeStatic())
+        static_cast<Texture2D*>(texture)->SetStreaming(false);
+    
     texture_ = texture;
     if (imageRect_ == IntRect::ZERO)
         SetFullImageRect();
@@ -89,7 +93,7 @@ void BorderImage::SetImageRect(const IntRect& rect)
 void BorderImage::SetFullImageRect()
 {
     if (texture_)
-        SetImageRect(IntRect(0, 0, texture_->GetWidth(), texture_->GetHeight()));
+        SetImageRect(IntRect(0, 0, texture_->GetFullWidth(), texture_->GetFullHeight()));
 }
 
 void BorderImage::SetBorder(const IntRect& rect)
@@ -126,13 +126,18 @@ void Cursor::DefineShape(CursorShape shape, Image* image, const IntRect& imageRe
     CursorShapeInfo& info = shapeInfos_[shape];
 
     // Prefer to get the texture with same name from cache to prevent creating several copies of the texture
-    info.texture_ = cache->GetResource<Texture2D>(image->GetName(), false);
-    if (!info.texture_)
+    Texture2D* texture = cache->GetResource<Texture2D>(image->GetName(), false);
+    if (!texture)
     {
-        Texture2D* texture = new Texture2D(context_);
+        texture = new Texture2D(context_);
         texture->SetData(SharedPtr<Image>(image));
-        info.texture_ = texture;
     }
+    else
+    {
+        // The UI does not request textures from texture streaming, so keep the texture at full size
+        texture->SetStreaming(false);
+    }
+    info.texture_ = texture;
 
     info.image_ = image;
     info.imageRect_ = imageRect;
@@ -176,6 +176,10 @@ void Sprite::SetRotation(float angle)
 
 void Sprite::SetTexture(Texture* texture)
 {
+    // The UI does not request textures from the texture streaming, so keep them at full size
+    if (texture && texture->GetType() == Texture2D::GetTypeStatic())
+        static_cast<Texture2D*>(texture)->SetStreaming(false);
+    
     texture_ = texture;
     if (imageRect_ == IntRect::ZERO)
         SetFullImageRect();
@@ -190,7 +194,7 @@ void Sprite::SetImageRect(const IntRect& rect)
 void Sprite::SetFullImageRect()
 {
     if (texture_)
-        SetImageRect(IntRect(0, 0, texture_->GetWidth(), texture_->GetHeight()));
+        SetImageRect(IntRect(0, 0, texture_->GetFullWidth(), texture_->GetFullHeight()));
 }
 
 void Sprite::SetBlendMode(BlendMode mode)
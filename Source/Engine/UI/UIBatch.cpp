@@ -57,7 +57,7 @@ UIBatch::UIBatch(UIElement* element, BlendMode blendMode, const IntRect& scissor
     blendMode_(blendMode),
     scissor_(scissor),
     texture_(texture),
-    invTextureSize_(texture ? Vector2(1.0f / (float)texture->GetWidth(), 1.0f / (float)texture->GetHeight()) : Vector2::ONE),
+    invTextureSize_(texture ? Vector2(1.0f / (float)texture->GetFullWidth(), 1.0f / (float)texture->GetFullHeight()) : Vector2::ONE),
     vertexData_(vertexData),
     vertexStart_(vertexData->Size()),
     vertexEnd_(vertexData->Size())
@@ -77,7 +77,7 @@ bool Sprite2D::EndLoad()
         SetTexture(loadTexture_);
         
         if (texture_)
-            SetRectangle(IntRect(0, 0, texture_->GetWidth(), texture_->GetHeight()));
+            SetRectangle(IntRect(0, 0, texture_->GetFullWidth(), texture_->GetFullHeight()));
     }
 
     loadTexture_.Reset();
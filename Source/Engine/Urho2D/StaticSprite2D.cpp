@@ -206,8 +206,8 @@ void StaticSprite2D::UpdateVertices()
     vertex2.position_ = worldTransform * Vector3(rightX, topY, 0.0f);
     vertex3.position_ = worldTransform * Vector3(rightX, bottomY, 0.0f);
 
-    float invTexW = 1.0f / (float)texture->GetWidth();
-    float invTexH = 1.0f / (float)texture->GetHeight();
+    float invTexW = 1.0f / (float)texture->GetFullWidth();
+    float invTexH = 1.0f / (float)texture->GetFullHeight();
 
     float leftU = rectangle_.left_ * invTexW;
     float rightU = rectangle_.right_ * invTexW;
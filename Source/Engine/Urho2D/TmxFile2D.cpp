@@ -253,7 +253,7 @@ bool TmxImageLayer2D::Load(const XMLElement& element, const TileMapInfo2D& info)
 
     sprite_ = new Sprite2D(tmxFile_->GetContext());
     sprite_->SetTexture(texture);
-    sprite_->SetRectangle(IntRect(0, 0, texture->GetWidth(), texture->GetHeight()));
+    sprite_->SetRectangle(IntRect(0, 0, texture->GetFullWidth(), texture->GetFullHeight()));
     // Set image hot spot at left top
     sprite_->SetHotSpot(Vector2(0.0f, 1.0f));
 
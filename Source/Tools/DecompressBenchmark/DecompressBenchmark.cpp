@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "ArrayPtr.h"
+#include "Context.h"
+#include "Decompress.h"
+#include "Image.h"
+#include "ProcessUtils.h"
+#include "Random.h"
+#include "StringUtils.h"
+#include "Timer.h"
+#include "WorkQueue.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <cstring>
+
+#include "DebugNew.h"
+
+using namespace Urho3D;
+
+static const unsigned NUM_ITERATIONS = 5;
+
+SharedPtr<Context> context_(new Context());
+// The time subsystem initializes the high-resolution timer
+SharedPtr<Time> time_(new Time(context_));
+SharedPtr<WorkQueue> workQueue_(new WorkQueue(context_));
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+bool Benchmark(CompressedFormat format, const String& formatName, int size);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+    
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+    
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    int size = arguments.Size() > 0 ? ToInt(arguments[0]) : 4096;
+    unsigned numThreads = arguments.Size() > 1 ? ToUInt(arguments[1]) : GetNumPhysicalCPUs() - 1;
+    if (size < 4 || (size & (size - 1)))
+        ErrorExit(
+            "Usage: DecompressBenchmark [size] [worker threads]\n"
+            "\n"
+            "Decompresses a random size x size image of each compressed format with the whole-image decoder and split by rows\n"
+            "between the worker threads, checks that the results match and prints the timings. Size must be a power of two,\n"
+            "4096 by default. Worker threads default to the number of physical CPUs minus one.\n"
+        );
+    
+    if (numThreads)
+        workQueue_->CreateThreads(numThreads);
+    PrintLine("Decompressing " + String(size) + "x" + String(size) + " images with " + String(numThreads) + " worker threads");
+    
+    bool success = true;
+    success &= Benchmark(CF_DXT1, "DXT1", size);
+    success &= Benchmark(CF_DXT5, "DXT5", size);
+    success &= Benchmark(CF_ETC1, "ETC1", size);
+    success &= Benchmark(CF_PVRTC_RGBA_2BPP, "PVRTC 2bpp", size);
+    success &= Benchmark(CF_PVRTC_RGBA_4BPP, "PVRTC 4bpp", size);
+    
+    if (!success)
+        ErrorExit("Row decompression does not match the whole-image decoder");
+}
+
+bool Benchmark(CompressedFormat format, const String& formatName, int size)
+{
+    // Fill the level with random blocks. Any bit pattern is a valid block in all the formats
+    CompressedLevel level;
+    level.format_ = format;
+    level.width_ = size;
+    level.height_ = size;
+    level.depth_ = 1;
+    if (format < CF_PVRTC_RGB_2BPP)
+    {
+        level.blockSize_ = (format == CF_DXT1 || format == CF_ETC1) ? 8 : 16;
+        level.rowSize_ = ((size + 3) / 4) * level.blockSize_;
+        level.rows_ = (size + 3) / 4;
+        level.dataSize_ = level.rows_ * level.rowSize_;
+    }
+    else
+    {
+        level.blockSize_ = format < CF_PVRTC_RGB_4BPP ? 2 : 4;
+        level.dataSize_ = (size * size * level.blockSize_ + 7) >> 3;
+        level.rows_ = size;
+        level.rowSize_ = level.dataSize_ / level.rows_;
+    }
+    
+    SharedArrayPtr<unsigned char> data(new unsigned char[level.dataSize_]);
+    SetRandomSeed(1);
+    for (unsigned i = 0; i < level.dataSize_; ++i)
+        data[i] = (unsigned char)Rand();
+    level.data_ = data.Get();
+    
+    unsigned destSize = size * size * 4;
+    SharedArrayPtr<unsigned char> reference(new unsigned char[destSize]);
+    SharedArrayPtr<unsigned char> dest(new unsigned char[destSize]);
+    HiresTimer timer;
+    
+    long long wholeTime = 0;
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        timer.Reset();
+        switch (format)
+        {
+        case CF_DXT1:
+        case CF_DXT3:
+        case CF_DXT5:
+            DecompressImageDXT(reference.Get(), level.data_, size, size, 1, format);
+            break;
+            
+        case CF_ETC1:
+            DecompressImageETC(reference.Get(), level.data_, size, size);
+            break;
+            
+        default:
+            DecompressImagePVRTC(reference.Get(), level.data_, size, size, format);
+            break;
+        }
+        wholeTime += timer.GetUSec(false);
+    }
+    
+    long long rowsTime = 0;
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        // Clear the destination so that rows left undecoded can not match by accident
+        memset(dest.Get(), 0, destSize);
+        timer.Reset();
+        level.Decompress(dest.Get(), workQueue_);
+        rowsTime += timer.GetUSec(false);
+        // Purge the finished work items, as there are no frames to do it
+        workQueue_->Complete(M_MAX_UNSIGNED);
+    }
+    
+    bool match = !memcmp(reference.Get(), dest.Get(), destSize);
+    float wholeMs = wholeTime / 1000.0f / NUM_ITERATIONS;
+    float rowsMs = rowsTime / 1000.0f / NUM_ITERATIONS;
+    PrintLine(formatName + ": whole image " + ToString("%.2f", wholeMs) + " ms, by rows " + ToString("%.2f", rowsMs) +
+        " ms, speedup " + ToString("%.2f", rowsMs > 0.0f ? wholeMs / rowsMs : 0.0f) + "x" + (match ? "" : ", MISMATCH"));
+    return match;
+}
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Connection.h"
+#include "Context.h"
+#include "FileSystem.h"
+#include "Network.h"
+#include "ProcessUtils.h"
+#include "ResourceCache.h"
+#include "Scene.h"
+#include "SimulatedLink.h"
+#include "StringUtils.h"
+#include "Timer.h"
+#include "WorkQueue.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "DebugNew.h"
+
+using namespace Urho3D;
+
+static const float TIME_STEP = 1.0f / 60.0f;
+
+SharedPtr<Context> context_(new Context());
+// The time subsystem initializes the high-resolution timer
+SharedPtr<Time> time_(new Time(context_));
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+    
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+    
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned numClients = arguments.Size() > 0 ? ToUInt(arguments[0]) : 100;
+    unsigned numNodes = arguments.Size() > 1 ? ToUInt(arguments[1]) : 1000;
+    unsigned numFrames = arguments.Size() > 2 ? ToUInt(arguments[2]) : 600;
+    float latency = arguments.Size() > 3 ? ToFloat(arguments[3]) : 0.05f;
+    float packetLoss = arguments.Size() > 4 ? ToFloat(arguments[4]) : 0.0f;
+    if (!numClients || !numNodes || !numFrames)
+        ErrorExit(
+            "Usage: NetworkBenchmark [clients] [nodes] [frames] [latency] [packet loss]\n"
+            "\n"
+            "Replicates a scene of moving nodes to clients connected in this process through simulated links, and prints the\n"
+            "time spent and the bytes sent. Defaults are 100 clients, 1000 nodes, 600 frames at 60 FPS, 0.05 seconds latency\n"
+            "and no packet loss.\n"
+        );
+    
+    context_->RegisterSubsystem(time_);
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    context_->RegisterSubsystem(new WorkQueue(context_));
+    context_->RegisterSubsystem(new Network(context_));
+    RegisterSceneLibrary(context_);
+    
+    unsigned numThreads = GetNumPhysicalCPUs() - 1;
+    if (numThreads)
+        context_->GetSubsystem<WorkQueue>()->CreateThreads(numThreads);
+    Network* network = context_->GetSubsystem<Network>();
+    
+    SharedPtr<Scene> serverScene(new Scene(context_));
+    for (unsigned i = 0; i < numNodes; ++i)
+        serverScene->CreateChild("Node")->SetPosition(Vector3((float)(i % 100), 0.0f, (float)(i / 100)));
+    
+    // Each link has its own seed, so that the runs are reproducible
+    Vector<SharedPtr<Scene> > clientScenes;
+    Vector<SharedPtr<Connection> > clientConnections;
+    for (unsigned i = 0; i < numClients; ++i)
+    {
+        SharedPtr<Scene> clientScene(new Scene(context_));
+        Connection* connection = network->ConnectLoopback(clientScene);
+        SimulatedLink* link = connection->GetSimulatedLink();
+        link->SetLatency(latency);
+        link->SetPacketLoss(packetLoss);
+        link->SetRandomSeed(i + 1);
+        clientScenes.Push(clientScene);
+        clientConnections.Push(SharedPtr<Connection>(connection));
+    }
+    
+    Vector<SharedPtr<Connection> > serverConnections = network->GetClientConnections();
+    for (unsigned i = 0; i < serverConnections.Size(); ++i)
+        serverConnections[i]->SetScene(serverScene);
+    
+    PrintLine("Replicating " + String(numNodes) + " nodes to " + String(numClients) + " clients for " + String(numFrames) +
+        " frames with " + String(numThreads) + " worker threads");
+    
+    // Move a tenth of the nodes each frame, so that there are both changed and unchanged nodes in the updates
+    const Vector<SharedPtr<Node> >& nodes = serverScene->GetChildren();
+    HiresTimer timer;
+    for (unsigned i = 0; i < numFrames; ++i)
+    {
+        for (unsigned j = i % 10; j < nodes.Size(); j += 10)
+            nodes[j]->Translate(Vector3(0.0f, TIME_STEP, 0.0f));
+        
+        // Begin frame processes the incoming messages
+        time_->BeginFrame(TIME_STEP);
+        network->PostUpdate(TIME_STEP);
+        time_->EndFrame();
+    }
+    long long time = timer.GetUSec(false);
+    
+    unsigned long long bytesSent = 0;
+    unsigned numSynced = 0;
+    for (unsigned i = 0; i < numClients; ++i)
+    {
+        SimulatedLink* link = clientConnections[i]->GetSimulatedLink();
+        bytesSent += link->GetBytesSent(link->GetServerConnection());
+        if (clientScenes[i]->GetNumChildren() == numNodes)
+            ++numSynced;
+    }
+    
+    float seconds = time / 1000000.0f;
+    PrintLine("Time " + ToString("%.2f", seconds) + " s, " + ToString("%.3f", seconds * 1000.0f / numFrames) + " ms per frame");
+    PrintLine("Sent " + ToString("%.0f", (double)bytesSent / 1024.0) + " kB from the server, " +
+        ToString("%.0f", (double)bytesSent / 1024.0 / numClients / (numFrames * TIME_STEP)) + " kB/s per client");
+    PrintLine(String(numSynced) + " of " + String(numClients) + " clients received all the nodes");
+}
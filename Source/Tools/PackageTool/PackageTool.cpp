@@ -47,6 +47,7 @@ struct FileEntry
     unsigned offset_;
     unsigned size_;
     unsigned checksum_;
+    bool compressed_;
 };
 
 SharedPtr<Context> context_(new Context());
@@ -55,6 +56,7 @@ String basePath_;
 Vector<FileEntry> entries_;
 unsigned checksum_ = 0;
 bool compress_ = false;
+bool legacyFormat_ = false;
 unsigned blockSize_ = COMPRESSED_BLOCK_SIZE;
 
 String ignoreExtensions_[] = {
@@ -63,11 +65,15 @@ String ignoreExtensions_[] = {
     ""
 };
 
+// Already compressed file types, which are stored uncompressed in a block-indexed package
+Vector<String> storeExtensions_ = String(".dds;.ktx;.pvr;.png;.jpg;.jpeg;.ogg").Split(';');
+
 int main(int argc, char** argv);
 void Run(const Vector<String>& arguments);
 void ProcessFile(const String& fileName, const String& rootDir);
 void WritePackageFile(const String& fileName, const String& rootDir);
 void WriteHeader(File& dest);
+void WriteEntry(File& dest, const FileEntry& entry);
 
 int main(int argc, char** argv)
 {
@@ -91,6 +97,8 @@ void Run(const Vector<String>& arguments)
             "\n"
             "Options:\n"
             "-c      Enable package file LZ4 compression\n"
+            "-l      Use the legacy compressed format without block index, readable by older versions\n"
+            "-s<ext> Semicolon-separated file extensions to store uncompressed, default .dds;.ktx;.pvr;.png;.jpg;.jpeg;.ogg\n"
         );
     
     const String& dirName = arguments[0];
@@ -110,6 +118,14 @@ void Run(const Vector<String>& arguments)
                     case 'c':
                         compress_ = true;
                         break;
+                        
+                    case 'l':
+                        legacyFormat_ = true;
+                        break;
+                        
+                    case 's':
+                        storeExtensions_ = arguments[i].Substring(2).ToLower().Split(';');
+                        break;
                     }
                 }
             }
@@ -158,6 +174,7 @@ void ProcessFile(const String& fileName, const String& rootDir)
     newEntry.offset_ = 0; // Offset not yet known
     newEntry.size_ = file.GetSize();
     newEntry.checksum_ = 0; // Will be calculated later
+    newEntry.compressed_ = compress_;
     entries_.Push(newEntry);
 }
 
@@ -172,14 +189,9 @@ void WritePackageFile(const String& fileName, const String& rootDir)
     // Write ID, number of files & placeholder for checksum
     WriteHeader(dest);
     
+    // Write entries (correct offsets are still unknown, will be filled in later)
     for (unsigned i = 0; i < entries_.Size(); ++i)
-    {
-        // Write entry (correct offset is still unknown, will be filled in later)
-        dest.WriteString(entries_[i].name_);
-        dest.WriteUInt(entries_[i].offset_);
-        dest.WriteUInt(entries_[i].size_);
-        dest.WriteUInt(entries_[i].checksum_);
-    }
+        WriteEntry(dest, entries_[i]);
     
     unsigned totalDataSize = 0;
     
@@ -207,7 +219,55 @@ void WritePackageFile(const String& fileName, const String& rootDir)
             entries_[i].checksum_ = SDBMHash(entries_[i].checksum_, buffer[j]);
         }
         
-        if (!compress_)
+        if (compress_ && !legacyFormat_)
+        {
+            // Compress the blocks first to know whether it is worth it. Blocks are preceded by their offsets from the start
+            // of the entry, with the end offset of the last block included
+            unsigned numBlocks = (dataSize + blockSize_ - 1) / blockSize_;
+            PODVector<unsigned> blockOffsets(numBlocks + 1);
+            PODVector<unsigned char> packedData;
+            unsigned tableSize = blockOffsets.Size() * sizeof(unsigned);
+            
+            if (storeExtensions_.Contains(GetExtension(entries_[i].name_)))
+                entries_[i].compressed_ = false;
+            else
+            {
+                SharedArrayPtr<unsigned char> compressBuffer(new unsigned char[LZ4_compressBound(blockSize_)]);
+                
+                for (unsigned j = 0; j < numBlocks; ++j)
+                {
+                    unsigned pos = j * blockSize_;
+                    unsigned unpackedSize = blockSize_;
+                    if (pos + unpackedSize > dataSize)
+                        unpackedSize = dataSize - pos;
+                    
+                    unsigned packedSize = LZ4_compressHC((const char*)&buffer[pos], (char*)compressBuffer.Get(), unpackedSize);
+                    if (!packedSize)
+                        ErrorExit("LZ4 compression failed for file " + entries_[i].name_ + " at offset " + pos);
+                    
+                    blockOffsets[j] = tableSize + packedData.Size();
+                    packedData.Resize(packedData.Size() + packedSize);
+                    memcpy(&packedData[packedData.Size() - packedSize], compressBuffer.Get(), packedSize);
+                }
+                blockOffsets[numBlocks] = tableSize + packedData.Size();
+                
+                // Store uncompressed if compression does not reduce size
+                entries_[i].compressed_ = tableSize + packedData.Size() < dataSize;
+            }
+            
+            if (entries_[i].compressed_)
+            {
+                dest.Write(&blockOffsets[0], tableSize);
+                dest.Write(&packedData[0], packedData.Size());
+                PrintLine(entries_[i].name_ + " in " + String(dataSize) + " out " + String(tableSize + packedData.Size()));
+            }
+            else
+            {
+                PrintLine(entries_[i].name_ + " size " + String(dataSize) + " stored");
+                dest.Write(&buffer[0], dataSize);
+            }
+        }
+        else if (!compress_)
         {
             PrintLine(entries_[i].name_ + " size " + String(dataSize));
             dest.Write(&buffer[0], entries_[i].size_);
@@ -250,12 +310,7 @@ void WritePackageFile(const String& fileName, const String& rootDir)
     WriteHeader(dest);
     
     for (unsigned i = 0; i < entries_.Size(); ++i)
-    {
-        dest.WriteString(entries_[i].name_);
-        dest.WriteUInt(entries_[i].offset_);
-        dest.WriteUInt(entries_[i].size_);
-        dest.WriteUInt(entries_[i].checksum_);
-    }
+        WriteEntry(dest, entries_[i]);
     
     PrintLine("Number of files " + String(entries_.Size()));
     PrintLine("File data size " + String(totalDataSize));
@@ -266,8 +321,22 @@ void WriteHeader(File& dest)
 {
     if (!compress_)
         dest.WriteFileID("UPAK");
-    else
+    else if (legacyFormat_)
         dest.WriteFileID("ULZ4");
+    else
+        dest.WriteFileID("ULZ5");
     dest.WriteUInt(entries_.Size());
     dest.WriteUInt(checksum_);
+    if (compress_ && !legacyFormat_)
+        dest.WriteUInt(blockSize_);
+}
+
+void WriteEntry(File& dest, const FileEntry& entry)
+{
+    dest.WriteString(entry.name_);
+    dest.WriteUInt(entry.offset_);
+    dest.WriteUInt(entry.size_);
+    dest.WriteUInt(entry.checksum_);
+    if (compress_ && !legacyFormat_)
+        dest.WriteUByte(entry.compressed_ ? 1 : 0);
 }
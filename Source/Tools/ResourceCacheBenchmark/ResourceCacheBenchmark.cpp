@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Context.h"
+#include "File.h"
+#include "FileSystem.h"
+#include "PackageFile.h"
+#include "ProcessUtils.h"
+#include "ResourceCache.h"
+#include "StringUtils.h"
+#include "Thread.h"
+#include "Timer.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "DebugNew.h"
+
+using namespace Urho3D;
+
+SharedPtr<Context> context_(new Context());
+// The time subsystem initializes the high-resolution timer
+SharedPtr<Time> time_(new Time(context_));
+Vector<String> fileNames_;
+unsigned iterations_ = 20;
+
+/// Thread that opens and checks the existence of all the benchmark files repeatedly.
+class SearchThread : public RefCounted, public Thread
+{
+public:
+    /// Construct.
+    SearchThread() :
+        numOperations_(0)
+    {
+    }
+    
+    /// Search the files.
+    virtual void ThreadFunction()
+    {
+        ResourceCache* cache = context_->GetSubsystem<ResourceCache>();
+        for (unsigned i = 0; i < iterations_; ++i)
+        {
+            for (unsigned j = 0; j < fileNames_.Size(); ++j)
+            {
+                // Open the file, check that it exists, and check a name that does not exist, which probes all the paths
+                SharedPtr<File> file = cache->GetFile(fileNames_[j], false);
+                if (!file)
+                    ErrorExit("Could not open " + fileNames_[j]);
+                cache->Exists(fileNames_[j]);
+                cache->Exists(fileNames_[j] + ".missing");
+                numOperations_ += 3;
+            }
+        }
+    }
+    
+    /// Number of operations performed.
+    unsigned numOperations_;
+};
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+void Benchmark(unsigned numThreads);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+    
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+    
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    if (arguments.Size() < 1)
+        ErrorExit(
+            "Usage: ResourceCacheBenchmark <resource directory or package file> [threads] [iterations]\n"
+            "\n"
+            "Opens each file of the resource directory or package through the resource cache and checks its existence from\n"
+            "1, 2, 4... up to the given number of threads at once, and prints the throughput. Threads default to the number of\n"
+            "physical CPUs, and iterations over all the files per thread to 20.\n"
+        );
+    
+    unsigned maxThreads = arguments.Size() > 1 ? ToUInt(arguments[1]) : GetNumPhysicalCPUs();
+    if (arguments.Size() > 2)
+        iterations_ = ToUInt(arguments[2]);
+    
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    FileSystem* fileSystem = context_->GetSubsystem<FileSystem>();
+    ResourceCache* cache = context_->GetSubsystem<ResourceCache>();
+    
+    const String& pathName = arguments[0];
+    if (fileSystem->DirExists(pathName))
+    {
+        if (!cache->AddResourceDir(pathName))
+            ErrorExit("Could not add resource directory " + pathName);
+        fileSystem->ScanDir(fileNames_, pathName, "*.*", SCAN_FILES, true);
+    }
+    else
+    {
+        SharedPtr<PackageFile> package(new PackageFile(context_));
+        if (!package->Open(pathName))
+            ErrorExit("Could not open resource directory or package file " + pathName);
+        cache->AddPackageFile(package);
+        const HashMap<String, PackageEntry>& entries = package->GetEntries();
+        for (HashMap<String, PackageEntry>::ConstIterator i = entries.Begin(); i != entries.End(); ++i)
+            fileNames_.Push(i->first_);
+    }
+    
+    if (fileNames_.Empty())
+        ErrorExit("No files found in " + pathName);
+    
+    PrintLine("Searching " + String(fileNames_.Size()) + " files " + String(iterations_) + " times per thread");
+    for (unsigned numThreads = 1; numThreads < maxThreads; numThreads *= 2)
+        Benchmark(numThreads);
+    Benchmark(maxThreads);
+}
+
+void Benchmark(unsigned numThreads)
+{
+    Vector<SharedPtr<SearchThread> > threads;
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads.Push(SharedPtr<SearchThread>(new SearchThread()));
+    
+    HiresTimer timer;
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i]->Run();
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i]->Stop();
+    long long time = timer.GetUSec(false);
+    
+    unsigned numOperations = 0;
+    for (unsigned i = 0; i < numThreads; ++i)
+        numOperations += threads[i]->numOperations_;
+    
+    float seconds = time / 1000000.0f;
+    PrintLine(String(numThreads) + " threads: " + ToString("%.2f", seconds) + " s, " + ToString("%.0f", seconds > 0.0f ?
+        numOperations / seconds : 0.0f) + " operations per second");
+}
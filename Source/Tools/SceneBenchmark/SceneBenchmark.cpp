@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Context.h"
+#include "FileSystem.h"
+#include "Graphics.h"
+#include "Light.h"
+#include "ProcessUtils.h"
+#include "ResourceCache.h"
+#include "Scene.h"
+#include "StringUtils.h"
+#include "Timer.h"
+#include "VectorBuffer.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "DebugNew.h"
+
+using namespace Urho3D;
+
+SharedPtr<Context> context_(new Context());
+// The time subsystem initializes the high-resolution timer
+SharedPtr<Time> time_(new Time(context_));
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+void PrintTime(const String& operation, long long time, unsigned iterations);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+    
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+    
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    unsigned numComponents = arguments.Size() > 0 ? ToUInt(arguments[0]) : 10000;
+    unsigned iterations = arguments.Size() > 1 ? ToUInt(arguments[1]) : 10;
+    if (!numComponents || !iterations)
+        ErrorExit(
+            "Usage: SceneBenchmark [components] [iterations]\n"
+            "\n"
+            "Creates a scene with one light component per node and times saving it in binary and XML format and loading it\n"
+            "back. Components default to 10000 and iterations to 10.\n"
+        );
+    
+    context_->RegisterSubsystem(new FileSystem(context_));
+    context_->RegisterSubsystem(new ResourceCache(context_));
+    RegisterSceneLibrary(context_);
+    RegisterGraphicsLibrary(context_);
+    
+    // Lights have both plain member attributes and accessor attributes. Vary the values so that they are not all defaults
+    SharedPtr<Scene> scene(new Scene(context_));
+    for (unsigned i = 0; i < numComponents; ++i)
+    {
+        Node* node = scene->CreateChild("Light");
+        node->SetPosition(Vector3((float)(i % 100), 0.0f, (float)(i / 100)));
+        Light* light = node->CreateComponent<Light>();
+        light->SetLightType(LIGHT_POINT);
+        light->SetRange(10.0f + (float)(i % 10));
+        light->SetColor(Color((float)(i % 3) / 2.0f, 1.0f, 0.5f));
+        light->SetCastShadows((i & 1) != 0);
+    }
+    
+    PrintLine("Saving and loading " + String(numComponents) + " components " + String(iterations) + " times");
+    
+    VectorBuffer buffer;
+    HiresTimer timer;
+    long long time = 0;
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        buffer.Clear();
+        timer.Reset();
+        if (!scene->Save(buffer))
+            ErrorExit("Could not save scene");
+        time += timer.GetUSec(false);
+    }
+    PrintTime("Save", time, iterations);
+    
+    SharedPtr<Scene> loadedScene(new Scene(context_));
+    time = 0;
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        buffer.Seek(0);
+        timer.Reset();
+        if (!loadedScene->Load(buffer))
+            ErrorExit("Could not load scene");
+        time += timer.GetUSec(false);
+    }
+    PrintTime("Load", time, iterations);
+    
+    VectorBuffer xmlBuffer;
+    time = 0;
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        xmlBuffer.Clear();
+        timer.Reset();
+        if (!scene->SaveXML(xmlBuffer))
+            ErrorExit("Could not save scene as XML");
+        time += timer.GetUSec(false);
+    }
+    PrintTime("SaveXML", time, iterations);
+    
+    time = 0;
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        xmlBuffer.Seek(0);
+        timer.Reset();
+        if (!loadedScene->LoadXML(xmlBuffer))
+            ErrorExit("Could not load scene from XML");
+        time += timer.GetUSec(false);
+    }
+    PrintTime("LoadXML", time, iterations);
+}
+
+void PrintTime(const String& operation, long long time, unsigned iterations)
+{
+    PrintLine(operation + ": " + ToString("%.2f", time / 1000.0f / iterations) + " ms");
+}
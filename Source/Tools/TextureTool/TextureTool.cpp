@@ -0,0 +1,390 @@
+//
+// Copyright (c) 2008-2014 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Context.h"
+#include "File.h"
+#include "FileSystem.h"
+#include "Image.h"
+#include "ProcessUtils.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include <cstring>
+
+#include "DebugNew.h"
+
+using namespace Urho3D;
+
+static const unsigned DDSD_CAPS = 0x1;
+static const unsigned DDSD_HEIGHT = 0x2;
+static const unsigned DDSD_WIDTH = 0x4;
+static const unsigned DDSD_PITCH = 0x8;
+static const unsigned DDSD_PIXELFORMAT = 0x1000;
+static const unsigned DDSD_MIPMAPCOUNT = 0x20000;
+static const unsigned DDSD_LINEARSIZE = 0x80000;
+static const unsigned DDPF_ALPHAPIXELS = 0x1;
+static const unsigned DDPF_FOURCC = 0x4;
+static const unsigned DDPF_RGB = 0x40;
+static const unsigned DDPF_LUMINANCE = 0x20000;
+static const unsigned DDSCAPS_COMPLEX = 0x8;
+static const unsigned DDSCAPS_TEXTURE = 0x1000;
+static const unsigned DDSCAPS_MIPMAP = 0x400000;
+
+SharedPtr<Context> context_(new Context());
+SharedPtr<FileSystem> fileSystem_(new FileSystem(context_));
+bool compress_ = false;
+bool generateMips_ = true;
+
+int main(int argc, char** argv);
+void Run(const Vector<String>& arguments);
+bool HasAlpha(Image* image);
+void GetBlock(Image* image, int blockX, int blockY, unsigned char* block);
+void CompressColorBlock(const unsigned char* block, unsigned char* dest);
+void CompressAlphaBlock(const unsigned char* block, unsigned char* dest);
+void WriteHeader(File& dest, Image* image, unsigned levels, CompressedFormat format);
+
+int main(int argc, char** argv)
+{
+    Vector<String> arguments;
+    
+    #ifdef WIN32
+    arguments = ParseArguments(GetCommandLineW());
+    #else
+    arguments = ParseArguments(argc, argv);
+    #endif
+    
+    Run(arguments);
+    return 0;
+}
+
+void Run(const Vector<String>& arguments)
+{
+    if (arguments.Size() < 2)
+        ErrorExit(
+            "Usage: TextureTool <input image> <output dds file> [options]\n"
+            "\n"
+            "Options:\n"
+            "-c      Compress to DXT1, or DXT5 if the image has alpha\n"
+            "-n      Do not generate mip levels\n"
+        );
+    
+    const String& inputName = arguments[0];
+    const String& outputName = arguments[1];
+    for (unsigned i = 2; i < arguments.Size(); ++i)
+    {
+        if (arguments[i].Length() > 1 && arguments[i][0] == '-')
+        {
+            switch (arguments[i][1])
+            {
+            case 'c':
+                compress_ = true;
+                break;
+                
+            case 'n':
+                generateMips_ = false;
+                break;
+            }
+        }
+    }
+    
+    File source(context_);
+    if (!source.Open(inputName))
+        ErrorExit("Could not open input file " + inputName);
+    SharedPtr<Image> image(new Image(context_));
+    if (!image->Load(source))
+        ErrorExit("Could not load image " + inputName);
+    if (image->IsCompressed())
+        ErrorExit("Input image is already compressed");
+    if (image->GetDepth() > 1)
+        ErrorExit("3D images are not supported");
+    
+    // Collect the mip chain down to 1x1. When compressing, levels smaller than 4x4 are padded to whole blocks
+    Vector<SharedPtr<Image> > levels;
+    levels.Push(image);
+    while (generateMips_)
+    {
+        Image* last = levels.Back();
+        if (last->GetWidth() <= 1 && last->GetHeight() <= 1)
+            break;
+        levels.Push(last->GetNextLevel());
+    }
+    
+    CompressedFormat format = CF_NONE;
+    if (compress_)
+        format = HasAlpha(image) ? CF_DXT5 : CF_DXT1;
+    
+    File dest(context_);
+    if (!dest.Open(outputName, FILE_WRITE))
+        ErrorExit("Could not open output file " + outputName);
+    WriteHeader(dest, image, levels.Size(), format);
+    
+    for (unsigned i = 0; i < levels.Size(); ++i)
+    {
+        Image* level = levels[i];
+        int width = level->GetWidth();
+        int height = level->GetHeight();
+        
+        if (format == CF_NONE)
+        {
+            dest.Write(level->GetData(), width * height * level->GetComponents());
+            continue;
+        }
+        
+        // Compress 4x4 blocks: DXT5 stores an alpha block before each color block
+        for (int y = 0; y < height; y += 4)
+        {
+            for (int x = 0; x < width; x += 4)
+            {
+                unsigned char block[64];
+                unsigned char compressed[16];
+                GetBlock(level, x, y, block);
+                if (format == CF_DXT5)
+                {
+                    CompressAlphaBlock(block, compressed);
+                    CompressColorBlock(block, compressed + 8);
+                    dest.Write(compressed, 16);
+                }
+                else
+                {
+                    CompressColorBlock(block, compressed);
+                    dest.Write(compressed, 8);
+                }
+            }
+        }
+    }
+    
+    PrintLine("Wrote " + outputName + " with " + String(levels.Size()) + " mip levels");
+}
+
+bool HasAlpha(Image* image)
+{
+    unsigned components = image->GetComponents();
+    if (components != 2 && components != 4)
+        return false;
+    
+    const unsigned char* data = image->GetData();
+    unsigned size = image->GetWidth() * image->GetHeight() * components;
+    for (unsigned i = components - 1; i < size; i += components)
+    {
+        if (data[i] != 255)
+            return true;
+    }
+    return false;
+}
+
+void GetBlock(Image* image, int blockX, int blockY, unsigned char* block)
+{
+    // Read a 4x4 block of RGBA pixels, repeating the edge pixels for blocks extending outside the image
+    for (int y = 0; y < 4; ++y)
+    {
+        for (int x = 0; x < 4; ++x)
+        {
+            unsigned color = image->GetPixelInt(Min(blockX + x, image->GetWidth() - 1), Min(blockY + y, image->GetHeight() - 1));
+            unsigned char* pixel = block + (y * 4 + x) * 4;
+            pixel[0] = color & 0xff;
+            pixel[1] = (color >> 8) & 0xff;
+            pixel[2] = (color >> 16) & 0xff;
+            pixel[3] = (color >> 24) & 0xff;
+        }
+    }
+}
+
+/// Convert an RGB color to 565 format.
+static unsigned short ToRGB565(const int* color)
+{
+    return (unsigned short)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+/// Expand a 565 format color to RGB.
+static void FromRGB565(unsigned short value, int* color)
+{
+    color[0] = ((value >> 11) & 0x1f) * 255 / 31;
+    color[1] = ((value >> 5) & 0x3f) * 255 / 63;
+    color[2] = (value & 0x1f) * 255 / 31;
+}
+
+void CompressColorBlock(const unsigned char* block, unsigned char* dest)
+{
+    // Use the color bounding box, inset slightly to reduce the error of the extremes, as the endpoints
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            minColor[j] = Min(minColor[j], (int)block[i * 4 + j]);
+            maxColor[j] = Max(maxColor[j], (int)block[i * 4 + j]);
+        }
+    }
+    for (unsigned j = 0; j < 3; ++j)
+    {
+        int inset = (maxColor[j] - minColor[j]) >> 4;
+        minColor[j] += inset;
+        maxColor[j] -= inset;
+    }
+    
+    unsigned short color0 = ToRGB565(maxColor);
+    unsigned short color1 = ToRGB565(minColor);
+    
+    // The endpoints must be in descending order for the opaque four-color mode. With equal endpoints all indices are 0
+    unsigned indices = 0;
+    if (color0 < color1)
+        Swap(color0, color1);
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        FromRGB565(color0, palette[0]);
+        FromRGB565(color1, palette[1]);
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+            palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+        }
+        
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            int bestError = M_MAX_INT;
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                int error = 0;
+                for (unsigned j = 0; j < 3; ++j)
+                {
+                    int delta = (int)block[i * 4 + j] - palette[k][j];
+                    error += delta * delta;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = k;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+    
+    dest[0] = color0 & 0xff;
+    dest[1] = color0 >> 8;
+    dest[2] = color1 & 0xff;
+    dest[3] = color1 >> 8;
+    for (unsigned i = 0; i < 4; ++i)
+        dest[4 + i] = (indices >> (i * 8)) & 0xff;
+}
+
+void CompressAlphaBlock(const unsigned char* block, unsigned char* dest)
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        minAlpha = Min(minAlpha, (int)block[i * 4 + 3]);
+        maxAlpha = Max(maxAlpha, (int)block[i * 4 + 3]);
+    }
+    
+    // Use the eight-value mode, where the first endpoint is larger. With equal endpoints all indices are 0
+    unsigned long long indices = 0;
+    if (maxAlpha != minAlpha)
+    {
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int k = 1; k < 7; ++k)
+            palette[k + 1] = ((7 - k) * maxAlpha + k * minAlpha) / 7;
+        
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            int bestError = M_MAX_INT;
+            for (unsigned k = 0; k < 8; ++k)
+            {
+                int error = Abs((int)block[i * 4 + 3] - palette[k]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = k;
+                }
+            }
+            indices |= (unsigned long long)best << (i * 3);
+        }
+    }
+    
+    dest[0] = (unsigned char)maxAlpha;
+    dest[1] = (unsigned char)minAlpha;
+    for (unsigned i = 0; i < 6; ++i)
+        dest[2 + i] = (indices >> (i * 8)) & 0xff;
+}
+
+void WriteHeader(File& dest, Image* image, unsigned levels, CompressedFormat format)
+{
+    int width = image->GetWidth();
+    int height = image->GetHeight();
+    unsigned components = image->GetComponents();
+    
+    // The header layout is the same as DDSurfaceDesc2 used by Image
+    unsigned header[31];
+    memset(header, 0, sizeof header);
+    header[0] = sizeof header;
+    header[1] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+    header[2] = height;
+    header[3] = width;
+    header[6] = levels;
+    
+    // Pixel format
+    header[18] = 32;
+    if (format != CF_NONE)
+    {
+        header[1] |= DDSD_LINEARSIZE;
+        header[4] = ((width + 3) / 4) * ((height + 3) / 4) * (format == CF_DXT1 ? 8 : 16);
+        header[19] = DDPF_FOURCC;
+        header[20] = format == CF_DXT1 ? 0x31545844 : 0x35545844; // "DXT1" or "DXT5"
+    }
+    else
+    {
+        header[1] |= DDSD_PITCH;
+        header[4] = width * components;
+        header[19] = components >= 3 ? DDPF_RGB : DDPF_LUMINANCE;
+        if (components == 2 || components == 4)
+            header[19] |= DDPF_ALPHAPIXELS;
+        header[21] = components * 8;
+        header[22] = 0xff;
+        if (components >= 3)
+        {
+            header[23] = 0xff00;
+            header[24] = 0xff0000;
+        }
+        if (components == 2)
+            header[25] = 0xff00;
+        else if (components == 4)
+            header[25] = 0xff000000;
+    }
+    
+    // Capabilities
+    header[26] = DDSCAPS_TEXTURE;
+    if (levels > 1)
+        header[26] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+    
+    dest.WriteFileID("DDS ");
+    dest.Write(header, sizeof header);
+}